@@ -0,0 +1 @@
+../../../xen/include/public/arch-ia64.h
\ No newline at end of file
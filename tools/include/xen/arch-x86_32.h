@@ -0,0 +1 @@
+../../../xen/include/public/arch-x86_32.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../xen/include/public/dom0_ops.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../xen/include/public/grant_table.h
\ No newline at end of file
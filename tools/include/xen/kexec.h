@@ -0,0 +1 @@
+../../../xen/include/public/kexec.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../xen/include/xen/elfstructs.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../xen/include/xen/libelf.h
\ No newline at end of file
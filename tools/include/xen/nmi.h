@@ -0,0 +1 @@
+../../../xen/include/public/nmi.h
\ No newline at end of file
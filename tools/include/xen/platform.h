@@ -0,0 +1 @@
+../../../xen/include/public/platform.h
\ No newline at end of file
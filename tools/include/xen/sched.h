@@ -0,0 +1 @@
+../../../xen/include/public/sched.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../xen/include/public/sysctl.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../xen/include/public/trace.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../xen/include/public/vcpu.h
\ No newline at end of file
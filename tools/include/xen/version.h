@@ -0,0 +1 @@
+../../../xen/include/public/version.h
\ No newline at end of file
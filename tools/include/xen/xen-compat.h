@@ -0,0 +1 @@
+../../../xen/include/public/xen-compat.h
\ No newline at end of file
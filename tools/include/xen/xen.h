@@ -0,0 +1 @@
+../../../xen/include/public/xen.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../xen/include/public/xencomm.h
\ No newline at end of file
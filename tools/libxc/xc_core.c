@@ -39,6 +39,8 @@
  *  +--------------------------------------------------------+
  *  |.xen_pages                                              |
  *  |    page * nr_pages                                     |
+ *  |or .xen_pages_zlib if compressed                        |
+ *  |    struct xen_dumpcore_zchunk + zlib data, repeated    |
  *  +--------------------------------------------------------+
  *  |.xen_p2m or .xen_pfn                                    |
  *  |    .xen_p2m: struct xen_dumpcore_p2m[nr_pages]         |
@@ -54,10 +56,18 @@
 #include "xc_dom.h"
 #include <stdlib.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
 
 /* number of pages to write at a time */
 #define DUMP_INCREMENT (4 * 1024)
 
+/* number of pages to map with one xc_map_foreign_batch() */
+#define DUMP_BATCH     1024
+
+/* upper bound on compressor threads */
+#define DUMP_MAX_ZTHREADS 16
+
 /* string table */
 struct xc_core_strtab {
     char       *strings;
@@ -299,9 +309,9 @@ elfnote_fill_xen_version(int xc_handle,
 
 static void
 elfnote_fill_format_version(struct xen_dumpcore_elfnote_format_version_desc
-                            *format_version)
+                            *format_version, uint64_t version)
 {
-    format_version->version = XEN_DUMPCORE_FORMAT_VERSION_CURRENT;
+    format_version->version = version;
 }
 
 static void
@@ -382,7 +392,8 @@ elfnote_dump_xen_version(void *args, dumpcore_rtn_t dump_rtn, int xc_handle,
 }
 
 static int
-elfnote_dump_format_version(void *args, dumpcore_rtn_t dump_rtn)
+elfnote_dump_format_version(void *args, dumpcore_rtn_t dump_rtn,
+                            uint64_t version)
 {
     int sts;
     struct elfnote elfnote;
@@ -393,7 +404,7 @@ elfnote_dump_format_version(void *args, dumpcore_rtn_t dump_rtn)
     
     elfnote.descsz = sizeof(format_version);
     elfnote.type = XEN_ELFNOTE_DUMPCORE_FORMAT_VERSION;
-    elfnote_fill_format_version(&format_version);
+    elfnote_fill_format_version(&format_version, version);
     sts = dump_rtn(args, (char*)&elfnote, sizeof(elfnote));
     if ( sts != 0 )
         return sts;
@@ -418,18 +429,233 @@ get_guest_width(int xc_handle,
     return 0;
 }
 
-int
-xc_domain_dumpcore_via_callback(int xc_handle,
-                                uint32_t domid,
-                                void *args,
-                                dumpcore_rtn_t dump_rtn)
+
+/* Compression state for a dump with .xen_pages_zlib. */
+struct dump_zlib {
+    int             fd;         /* corefile; section headers are rewritten */
+    unsigned int    nr_threads;
+    char           *zbuf;       /* one slot per chunk of the staging buffer */
+    unsigned long   zslot;
+    uint64_t        size;       /* bytes of .xen_pages_zlib written so far */
+};
+
+/* One compressor thread's share of the staging buffer. */
+struct dump_zlib_job {
+    struct dump_zlib   *zlib;
+    const char         *src;
+    unsigned long       nr_pages;
+    unsigned int        first;
+    int                 rc;
+};
+
+/* Guest pages on their way into .xen_pages or .xen_pages_zlib. */
+struct dump_pages {
+    int                         xc_handle;
+    uint32_t                    domid;
+    void                       *args;
+    dumpcore_rtn_t             *dump_rtn;
+    struct dump_zlib           *zlib;       /* NULL for plain .xen_pages */
+
+    char                       *mem_start;  /* DUMP_INCREMENT pages */
+    char                       *mem;
+
+    /* candidates for the next xc_map_foreign_batch() */
+    unsigned int                nr_batch;
+    uint64_t                    pfn[DUMP_BATCH];
+    xen_pfn_t                   gmfn[DUMP_BATCH];
+    xen_pfn_t                   map[DUMP_BATCH];
+
+    struct xen_dumpcore_p2m    *p2m_array;
+    uint64_t                   *pfn_array;
+    unsigned long               j;          /* pages dumped so far */
+};
+
+static void *
+dump_zlib_worker(void *arg)
+{
+    struct dump_zlib_job *job = arg;
+    struct dump_zlib *zlib = job->zlib;
+    unsigned long nr_chunks, c;
+
+    nr_chunks = (job->nr_pages + XEN_DUMPCORE_ZCHUNK_PAGES - 1) /
+        XEN_DUMPCORE_ZCHUNK_PAGES;
+    job->rc = 0;
+    for ( c = job->first; c < nr_chunks; c += zlib->nr_threads )
+    {
+        struct xen_dumpcore_zchunk *hdr =
+            (struct xen_dumpcore_zchunk *)(zlib->zbuf + c * zlib->zslot);
+        unsigned long first = c * XEN_DUMPCORE_ZCHUNK_PAGES;
+        uLongf zlen = zlib->zslot - sizeof(*hdr);
+
+        hdr->nr_pages = job->nr_pages - first;
+        if ( hdr->nr_pages > XEN_DUMPCORE_ZCHUNK_PAGES )
+            hdr->nr_pages = XEN_DUMPCORE_ZCHUNK_PAGES;
+        if ( compress2((Bytef *)(hdr + 1), &zlen,
+                       (const Bytef *)job->src + first * PAGE_SIZE,
+                       (uLong)hdr->nr_pages * PAGE_SIZE,
+                       Z_BEST_SPEED) != Z_OK )
+        {
+            job->rc = -1;
+            break;
+        }
+        hdr->zlen = zlen;
+    }
+
+    return NULL;
+}
+
+/* Compress the staging buffer chunk by chunk and write the chunks out. */
+static int
+dump_pages_zlib(struct dump_pages *dp, unsigned long nr_pages)
+{
+    struct dump_zlib *zlib = dp->zlib;
+    struct dump_zlib_job job[DUMP_MAX_ZTHREADS];
+    pthread_t thread[DUMP_MAX_ZTHREADS];
+    int started[DUMP_MAX_ZTHREADS];
+    unsigned long nr_chunks, c;
+    unsigned int t;
+    int sts;
+
+    for ( t = 0; t < zlib->nr_threads; t++ )
+    {
+        job[t].zlib = zlib;
+        job[t].src = dp->mem_start;
+        job[t].nr_pages = nr_pages;
+        job[t].first = t;
+        started[t] = (t != 0) &&
+            (pthread_create(&thread[t], NULL, dump_zlib_worker, &job[t]) == 0);
+    }
+    /* Our own share, and that of any thread which failed to start. */
+    for ( t = 0; t < zlib->nr_threads; t++ )
+        if ( !started[t] )
+            dump_zlib_worker(&job[t]);
+    for ( t = 0; t < zlib->nr_threads; t++ )
+        if ( started[t] )
+            pthread_join(thread[t], NULL);
+    for ( t = 0; t < zlib->nr_threads; t++ )
+    {
+        if ( job[t].rc != 0 )
+        {
+            ERROR("Could not compress guest pages");
+            return -1;
+        }
+    }
+
+    nr_chunks = (nr_pages + XEN_DUMPCORE_ZCHUNK_PAGES - 1) /
+        XEN_DUMPCORE_ZCHUNK_PAGES;
+    for ( c = 0; c < nr_chunks; c++ )
+    {
+        struct xen_dumpcore_zchunk *hdr =
+            (struct xen_dumpcore_zchunk *)(zlib->zbuf + c * zlib->zslot);
+
+        sts = dp->dump_rtn(dp->args, (char *)hdr, sizeof(*hdr) + hdr->zlen);
+        if ( sts != 0 )
+            return sts;
+        zlib->size += sizeof(*hdr) + hdr->zlen;
+    }
+
+    return 0;
+}
+
+/* Write out whatever has been staged so far. */
+static int
+dump_pages_flush(struct dump_pages *dp)
+{
+    unsigned long nr_pages = (dp->mem - dp->mem_start) >> PAGE_SHIFT;
+    int sts;
+
+    if ( nr_pages == 0 )
+        return 0;
+    if ( dp->zlib != NULL )
+        sts = dump_pages_zlib(dp, nr_pages);
+    else
+        sts = dp->dump_rtn(dp->args, dp->mem_start, nr_pages << PAGE_SHIFT);
+    dp->mem = dp->mem_start;
+
+    return sts;
+}
+
+/* Stage one page (zeroes if src is NULL) as page j of the dump. */
+static int
+dump_pages_add(struct dump_pages *dp, uint64_t pfn, uint64_t gmfn,
+               const void *src)
+{
+    if ( dp->p2m_array != NULL )
+    {
+        dp->p2m_array[dp->j].pfn = pfn;
+        dp->p2m_array[dp->j].gmfn = gmfn;
+    }
+    else
+        dp->pfn_array[dp->j] = pfn;
+
+    if ( src != NULL )
+        memcpy(dp->mem, src, PAGE_SIZE);
+    else
+        memset(dp->mem, 0, PAGE_SIZE);
+    dp->mem += PAGE_SIZE;
+    dp->j++;
+
+    if ( dp->mem - dp->mem_start == DUMP_INCREMENT * PAGE_SIZE )
+        return dump_pages_flush(dp);
+    return 0;
+}
+
+/* Map the collected candidates in one go and stage those that mapped. */
+static int
+dump_pages_batch(struct dump_pages *dp)
+{
+    unsigned int i, nr = dp->nr_batch;
+    char *region;
+    void *vaddr;
+    int sts = 0;
+
+    if ( nr == 0 )
+        return 0;
+    dp->nr_batch = 0;
+
+    memcpy(dp->map, dp->gmfn, nr * sizeof(dp->map[0]));
+    region = xc_map_foreign_batch(dp->xc_handle, dp->domid, PROT_READ,
+                                  dp->map, nr);
+    for ( i = 0; (i < nr) && (sts == 0); i++ )
+    {
+        if ( region != NULL )
+        {
+            /* Frames which could not be mapped are flagged: skip them. */
+            if ( (dp->map[i] & 0xF0000000UL) == 0xF0000000UL )
+                continue;
+            sts = dump_pages_add(dp, dp->pfn[i], dp->gmfn[i],
+                                 region + i * PAGE_SIZE);
+        }
+        else
+        {
+            /* The batch failed as a whole: go one page at a time. */
+            vaddr = xc_map_foreign_range(dp->xc_handle, dp->domid,
+                                         PAGE_SIZE, PROT_READ, dp->gmfn[i]);
+            if ( vaddr == NULL )
+                continue;
+            sts = dump_pages_add(dp, dp->pfn[i], dp->gmfn[i], vaddr);
+            munmap(vaddr, PAGE_SIZE);
+        }
+    }
+    if ( region != NULL )
+        munmap(region, nr * PAGE_SIZE);
+
+    return sts;
+}
+
+static int
+xc_domain_dumpcore_internal(int xc_handle,
+                            uint32_t domid,
+                            void *args,
+                            dumpcore_rtn_t dump_rtn,
+                            struct dump_zlib *zlib)
 {
     xc_dominfo_t info;
     shared_info_any_t *live_shinfo = NULL;
     unsigned int guest_width; 
 
     int nr_vcpus = 0;
-    char *dump_mem, *dump_mem_start = NULL;
+    struct dump_pages *dp = NULL;
     vcpu_guest_context_any_t *ctxt = NULL;
     struct xc_core_arch_context arch_ctxt;
     char dummy[PAGE_SIZE];
@@ -437,7 +663,6 @@ xc_domain_dumpcore_via_callback(int xc_handle,
     int sts = -1;
 
     unsigned long i;
-    unsigned long j;
     unsigned long nr_pages;
 
     xc_core_memory_map_t *memory_map = NULL;
@@ -458,6 +683,7 @@ xc_domain_dumpcore_via_callback(int xc_handle,
 
     struct xc_core_strtab *strtab = NULL;
     uint16_t strtab_idx;
+    uint16_t pages_idx;
     struct xc_core_section_headers *sheaders = NULL;
     Elf64_Shdr *shdr;
  
@@ -468,7 +694,8 @@ xc_domain_dumpcore_via_callback(int xc_handle,
     }
 
     xc_core_arch_context_init(&arch_ctxt);
-    if ( (dump_mem_start = malloc(DUMP_INCREMENT*PAGE_SIZE)) == NULL )
+    if ( (dp = calloc(1, sizeof(*dp))) == NULL ||
+         (dp->mem_start = malloc(DUMP_INCREMENT*PAGE_SIZE)) == NULL )
     {
         PERROR("Could not allocate dump_mem");
         goto out;
@@ -680,9 +907,22 @@ xc_domain_dumpcore_via_callback(int xc_handle,
         PERROR("could not get section headers for .xen_pages");
         goto out;
     }
-    filesz = (uint64_t)nr_pages * PAGE_SIZE;
-    sts = xc_core_shdr_set(shdr, strtab, XEN_DUMPCORE_SEC_PAGES, SHT_PROGBITS,
-                           offset, filesz, PAGE_SIZE, PAGE_SIZE);
+    pages_idx = shdr - sheaders->shdrs;
+    if ( zlib == NULL )
+    {
+        filesz = (uint64_t)nr_pages * PAGE_SIZE;
+        sts = xc_core_shdr_set(shdr, strtab, XEN_DUMPCORE_SEC_PAGES,
+                               SHT_PROGBITS, offset, filesz,
+                               PAGE_SIZE, PAGE_SIZE);
+    }
+    else
+    {
+        /* the compressed size is only known at the end. fix up later. */
+        filesz = 0;
+        sts = xc_core_shdr_set(shdr, strtab, XEN_DUMPCORE_SEC_PAGES_ZLIB,
+                               SHT_PROGBITS, offset, filesz,
+                               sizeof(uint64_t), 0);
+    }
     if ( sts != 0 )
         goto out;
     offset += filesz;
@@ -749,7 +989,11 @@ xc_domain_dumpcore_via_callback(int xc_handle,
         goto out;
 
     /* elf note section: format version */
-    sts = elfnote_dump_format_version(args, dump_rtn);
+    sts = elfnote_dump_format_version(
+        args, dump_rtn,
+        (zlib == NULL) ? XEN_DUMPCORE_FORMAT_VERSION_CURRENT :
+        XEN_DUMPCORE_FORMAT_VERSION(XEN_DUMPCORE_FORMAT_MAJOR_CURRENT,
+                                    XEN_DUMPCORE_FORMAT_MINOR_ZLIB));
     if ( sts != 0 )
         goto out;
 
@@ -778,8 +1022,14 @@ xc_domain_dumpcore_via_callback(int xc_handle,
         goto out;
 
     /* dump pages: .xen_pages */
-    j = 0;
-    dump_mem = dump_mem_start;
+    dp->xc_handle = xc_handle;
+    dp->domid = domid;
+    dp->args = args;
+    dp->dump_rtn = dump_rtn;
+    dp->zlib = zlib;
+    dp->mem = dp->mem_start;
+    dp->p2m_array = p2m_array;
+    dp->pfn_array = pfn_array;
     for ( map_idx = 0; map_idx < nr_memory_map; map_idx++ )
     {
         uint64_t pfn_start;
@@ -790,9 +1040,14 @@ xc_domain_dumpcore_via_callback(int xc_handle,
         for ( i = pfn_start; i < pfn_end; i++ )
         {
             uint64_t gmfn;
-            void *vaddr;
-            
-            if ( j >= nr_pages )
+
+            if ( dp->j + dp->nr_batch >= nr_pages )
+            {
+                sts = dump_pages_batch(dp);
+                if ( sts != 0 )
+                    goto out;
+            }
+            if ( dp->j >= nr_pages )
             {
                 /*
                  * When live dump-mode (-L option) is specified,
@@ -819,9 +1074,6 @@ xc_domain_dumpcore_via_callback(int xc_handle,
                     if ( gmfn == (uint32_t)INVALID_P2M_ENTRY )
                        continue;
                 }
-
-                p2m_array[j].pfn = i;
-                p2m_array[j].gmfn = gmfn;
             }
             else
             {
@@ -829,53 +1081,57 @@ xc_domain_dumpcore_via_callback(int xc_handle,
                     continue;
 
                 gmfn = i;
-                pfn_array[j] = i;
             }
 
-            vaddr = xc_map_foreign_range(
-                xc_handle, domid, PAGE_SIZE, PROT_READ, gmfn);
-            if ( vaddr == NULL )
-                continue;
-            memcpy(dump_mem, vaddr, PAGE_SIZE);
-            munmap(vaddr, PAGE_SIZE);
-            dump_mem += PAGE_SIZE;
-            if ( (j + 1) % DUMP_INCREMENT == 0 )
+            dp->pfn[dp->nr_batch] = i;
+            dp->gmfn[dp->nr_batch] = gmfn;
+            if ( ++dp->nr_batch == DUMP_BATCH )
             {
-                sts = dump_rtn(
-                    args, dump_mem_start, dump_mem - dump_mem_start);
+                sts = dump_pages_batch(dp);
                 if ( sts != 0 )
                     goto out;
-                dump_mem = dump_mem_start;
             }
-
-            j++;
         }
     }
-
-copy_done:
-    sts = dump_rtn(args, dump_mem_start, dump_mem - dump_mem_start);
+    sts = dump_pages_batch(dp);
     if ( sts != 0 )
         goto out;
-    if ( j < nr_pages )
+
+copy_done:
+    if ( dp->j < nr_pages )
     {
         /* When live dump-mode (-L option) is specified,
          * guest domain may reduce memory. pad with zero pages.
          */
-        IPRINTF("j (%ld) != nr_pages (%ld)", j, nr_pages);
-        memset(dump_mem_start, 0, PAGE_SIZE);
-        for (; j < nr_pages; j++) {
-            sts = dump_rtn(args, dump_mem_start, PAGE_SIZE);
+        IPRINTF("j (%ld) != nr_pages (%ld)", dp->j, nr_pages);
+        while ( dp->j < nr_pages )
+        {
+            sts = dump_pages_add(dp, XC_CORE_INVALID_PFN,
+                                 XC_CORE_INVALID_GMFN, NULL);
             if ( sts != 0 )
                 goto out;
-            if ( !auto_translated_physmap )
-            {
-                p2m_array[j].pfn = XC_CORE_INVALID_PFN;
-                p2m_array[j].gmfn = XC_CORE_INVALID_GMFN;
-            }
-            else
-                pfn_array[j] = XC_CORE_INVALID_PFN;
         }
     }
+    sts = dump_pages_flush(dp);
+    if ( sts != 0 )
+        goto out;
+
+    if ( zlib != NULL )
+    {
+        /*
+         * Now that the size of .xen_pages_zlib is known, pad it and move
+         * the sections behind it along.
+         */
+        dummy_len = -zlib->size & (sizeof(uint64_t) - 1);
+        sts = dump_rtn(args, dummy, dummy_len);
+        if ( sts != 0 )
+            goto out;
+        fixup = zlib->size + dummy_len;
+        sheaders->shdrs[pages_idx].sh_size = zlib->size;
+        for ( i = pages_idx + 1; i < sheaders->num; i++ )
+            sheaders->shdrs[i].sh_offset += fixup;
+        sheaders->shdrs[strtab_idx].sh_offset += fixup;
+    }
 
     /* p2m/pfn table: .xen_p2m/.xen_pfn */
     if ( !auto_translated_physmap )
@@ -892,6 +1148,18 @@ copy_done:
     if ( sts != 0 )
         goto out;
 
+    /* rewrite the section headers with the fixed up offsets */
+    if ( zlib != NULL &&
+         pwrite(zlib->fd, sheaders->shdrs,
+                sheaders->num * sizeof(sheaders->shdrs[0]),
+                ehdr.e_shoff) !=
+         (ssize_t)(sheaders->num * sizeof(sheaders->shdrs[0])) )
+    {
+        PERROR("Could not rewrite section headers");
+        sts = -errno;
+        goto out;
+    }
+
     sts = 0;
 
 out:
@@ -909,8 +1177,11 @@ out:
         xc_core_strtab_free(strtab);
     if ( ctxt != NULL )
         free(ctxt);
-    if ( dump_mem_start != NULL )
-        free(dump_mem_start);
+    if ( dp != NULL )
+    {
+        free(dp->mem_start);
+        free(dp);
+    }
     if ( live_shinfo != NULL )
         munmap(live_shinfo, PAGE_SIZE);
     xc_core_arch_context_free(&arch_ctxt);
@@ -918,20 +1189,75 @@ out:
     return sts;
 }
 
+int
+xc_domain_dumpcore_via_callback(int xc_handle,
+                                uint32_t domid,
+                                void *args,
+                                dumpcore_rtn_t dump_rtn)
+{
+    return xc_domain_dumpcore_internal(xc_handle, domid, args, dump_rtn,
+                                       NULL);
+}
+
 /* Callback args for writing to a local dump file. */
 struct dump_args {
     int     fd;
 };
 
+static int
+page_is_zero(const char *page)
+{
+    const unsigned long *p = (const unsigned long *)page;
+    unsigned int i;
+
+    for ( i = 0; i < PAGE_SIZE / sizeof(*p); i++ )
+        if ( p[i] != 0 )
+            return 0;
+    return 1;
+}
+
 /* Callback routine for writing to a local dump file. */
 static int local_file_dump(void *args, char *buffer, unsigned int length)
 {
     struct dump_args *da = args;
+    unsigned int done, len;
 
-    if ( write_exact(da->fd, buffer, length) == -1 )
+    if ( (length % PAGE_SIZE) != 0 )
     {
-        PERROR("Failed to write buffer");
-        return -errno;
+        if ( write_exact(da->fd, buffer, length) == -1 )
+        {
+            PERROR("Failed to write buffer");
+            return -errno;
+        }
+        return 0;
+    }
+
+    /*
+     * Whole pages are guest memory, most of which is usually zero.
+     * Seek over runs of zero pages so that they end up as holes in a
+     * sparse file rather than being written out.
+     */
+    for ( done = 0; done < length; done += len )
+    {
+        int zero = page_is_zero(buffer + done);
+
+        for ( len = PAGE_SIZE; done + len < length; len += PAGE_SIZE )
+            if ( page_is_zero(buffer + done + len) != zero )
+                break;
+
+        if ( zero )
+        {
+            if ( lseek(da->fd, len, SEEK_CUR) == (off_t)-1 )
+            {
+                PERROR("Failed to seek over zero pages");
+                return -errno;
+            }
+        }
+        else if ( write_exact(da->fd, buffer + done, len) == -1 )
+        {
+            PERROR("Failed to write buffer");
+            return -errno;
+        }
     }
 
     if ( length >= (DUMP_INCREMENT * PAGE_SIZE) )
@@ -944,12 +1270,14 @@ static int local_file_dump(void *args, char *buffer, unsigned int length)
     return 0;
 }
 
-int
-xc_domain_dumpcore(int xc_handle,
-                   uint32_t domid,
-                   const char *corename)
+static int
+dumpcore_to_file(int xc_handle,
+                 uint32_t domid,
+                 const char *corename,
+                 struct dump_zlib *zlib)
 {
     struct dump_args da;
+    off_t end;
     int sts;
 
     if ( (da.fd = open(corename, O_CREAT|O_RDWR|O_TRUNC, S_IWUSR|S_IRUSR)) < 0 )
@@ -957,9 +1285,19 @@ xc_domain_dumpcore(int xc_handle,
         PERROR("Could not open corefile %s", corename);
         return -errno;
     }
+    if ( zlib != NULL )
+        zlib->fd = da.fd;
+
+    sts = xc_domain_dumpcore_internal(
+        xc_handle, domid, &da, &local_file_dump, zlib);
 
-    sts = xc_domain_dumpcore_via_callback(
-        xc_handle, domid, &da, &local_file_dump);
+    /* a trailing hole doesn't extend the file by itself */
+    end = lseek(da.fd, 0, SEEK_CUR);
+    if ( sts == 0 && (end == (off_t)-1 || ftruncate(da.fd, end) != 0) )
+    {
+        PERROR("Could not set size of corefile %s", corename);
+        sts = -errno;
+    }
 
     /* flush and discard any remaining portion of the file from cache */
     discard_file_cache(da.fd, 1/* flush first*/);
@@ -969,6 +1307,52 @@ xc_domain_dumpcore(int xc_handle,
     return sts;
 }
 
+int
+xc_domain_dumpcore(int xc_handle,
+                   uint32_t domid,
+                   const char *corename)
+{
+    return dumpcore_to_file(xc_handle, domid, corename, NULL);
+}
+
+int
+xc_domain_dumpcore_compressed(int xc_handle,
+                              uint32_t domid,
+                              const char *corename,
+                              unsigned int nr_threads)
+{
+    struct dump_zlib zlib;
+    long nr_cpus;
+    int sts;
+
+    if ( nr_threads == 0 )
+    {
+        nr_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nr_threads = (nr_cpus > 0) ? nr_cpus : 1;
+    }
+    if ( nr_threads > DUMP_MAX_ZTHREADS )
+        nr_threads = DUMP_MAX_ZTHREADS;
+
+    memset(&zlib, 0, sizeof(zlib));
+    zlib.nr_threads = nr_threads;
+    zlib.zslot = ROUNDUP(sizeof(struct xen_dumpcore_zchunk) +
+                         compressBound(XEN_DUMPCORE_ZCHUNK_PAGES * PAGE_SIZE),
+                         3);
+    zlib.zbuf = malloc(DUMP_INCREMENT / XEN_DUMPCORE_ZCHUNK_PAGES *
+                       zlib.zslot);
+    if ( zlib.zbuf == NULL )
+    {
+        PERROR("Could not allocate compression buffer");
+        return -errno;
+    }
+
+    sts = dumpcore_to_file(xc_handle, domid, corename, &zlib);
+
+    free(zlib.zbuf);
+
+    return sts;
+}
+
 /*
  * Local variables:
  * mode: C
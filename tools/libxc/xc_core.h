@@ -32,6 +32,7 @@
 #define XEN_DUMPCORE_SEC_P2M                    ".xen_p2m"
 #define XEN_DUMPCORE_SEC_PFN                    ".xen_pfn"
 #define XEN_DUMPCORE_SEC_PAGES                  ".xen_pages"
+#define XEN_DUMPCORE_SEC_PAGES_ZLIB             ".xen_pages_zlib"
 
 #define XEN_DUMPCORE_SEC_IA64_MAPPED_REGS       ".xen_ia64_mapped_regs"
 
@@ -78,6 +79,8 @@ struct xen_dumpcore_elfnote_xen_version_desc {
 
 #define XEN_DUMPCORE_FORMAT_MAJOR_CURRENT       ((uint64_t)0)
 #define XEN_DUMPCORE_FORMAT_MINOR_CURRENT       ((uint64_t)1)
+/* minor version 2: .xen_pages_zlib instead of .xen_pages */
+#define XEN_DUMPCORE_FORMAT_MINOR_ZLIB          ((uint64_t)2)
 #define XEN_DUMPCORE_FORMAT_VERSION_CURRENT                         \
     XEN_DUMPCORE_FORMAT_VERSION(XEN_DUMPCORE_FORMAT_MAJOR_CURRENT,  \
                                 XEN_DUMPCORE_FORMAT_MINOR_CURRENT)
@@ -114,6 +117,18 @@ struct xen_dumpcore_p2m {
     uint64_t    gmfn;
 };
 
+/*
+ * .xen_pages_zlib is a sequence of chunks, each a chunk header followed
+ * by zlen bytes of zlib data which inflate to the next nr_pages pages of
+ * what would otherwise have been .xen_pages.  Chunks hold at most
+ * XEN_DUMPCORE_ZCHUNK_PAGES pages.
+ */
+#define XEN_DUMPCORE_ZCHUNK_PAGES   32
+struct xen_dumpcore_zchunk {
+    uint32_t    zlen;
+    uint32_t    nr_pages;
+};
+
 
 struct xc_core_strtab;
 struct xc_core_section_headers;
@@ -192,7 +192,9 @@ static void xc_cpuid_hvm_policy(
                     bitmaskof(X86_FEATURE_CX16) |
                     bitmaskof(X86_FEATURE_SSE4_1) |
                     bitmaskof(X86_FEATURE_SSE4_2) |
-                    bitmaskof(X86_FEATURE_POPCNT));
+                    bitmaskof(X86_FEATURE_POPCNT) |
+                    bitmaskof(X86_FEATURE_XSAVE) |
+                    bitmaskof(X86_FEATURE_AVX));
 
         regs[2] |= bitmaskof(X86_FEATURE_HYPERVISOR);
 
@@ -312,6 +314,7 @@ static void xc_cpuid_pv_policy(
         clear_bit(X86_FEATURE_PDCM, regs[2]);
         clear_bit(X86_FEATURE_DCA, regs[2]);
         clear_bit(X86_FEATURE_XSAVE, regs[2]);
+        clear_bit(X86_FEATURE_OSXSAVE, regs[2]);
         set_bit(X86_FEATURE_HYPERVISOR, regs[2]);
         break;
     case 0x80000001:
@@ -162,6 +162,10 @@ size_t xc_dom_check_gzip(void *blob, size_t ziplen);
 int xc_dom_do_gunzip(void *src, size_t srclen, void *dst, size_t dstlen);
 int xc_dom_try_gunzip(struct xc_dom_image *dom, void **blob, size_t * size);
 
+size_t xc_dom_decompressed_size(void *blob, size_t len);
+int xc_dom_decompress(void *src, size_t srclen, void *dst, size_t dstlen);
+int xc_dom_try_decompress(struct xc_dom_image *dom, void **blob, size_t *size);
+
 int xc_dom_kernel_file(struct xc_dom_image *dom, const char *filename);
 int xc_dom_ramdisk_file(struct xc_dom_image *dom, const char *filename);
 int xc_dom_kernel_mem(struct xc_dom_image *dom, const void *mem,
@@ -203,6 +207,7 @@ void *xc_dom_malloc(struct xc_dom_image *dom, size_t size);
 void *xc_dom_malloc_page_aligned(struct xc_dom_image *dom, size_t size);
 void *xc_dom_malloc_filemap(struct xc_dom_image *dom,
                             const char *filename, size_t * size);
+int xc_dom_register_mmap(struct xc_dom_image *dom, void *ptr, size_t size);
 char *xc_dom_strdup(struct xc_dom_image *dom, const char *str);
 
 /* --- alloc memory pool ------------------------------------------- */
@@ -5,7 +5,9 @@
  *
  * This relies on version 2.08 of the boot protocol, which contains an
  * ELF file embedded in the bzImage.  The loader extracts this ELF
- * image and passes it off to the standard ELF loader.
+ * image, unpacking it if the payload is compressed (see
+ * xc_dom_decompress.c for the formats), and passes it off to the
+ * standard ELF loader.
  *
  * This code is licenced under the GPL.
  * written 2006 by Gerd Hoffmann <kraxel@suse.de>.
@@ -110,7 +112,8 @@ static int check_bzimage_kernel(struct xc_dom_image *dom, int verbose)
     dom->kernel_blob = dom->kernel_blob + payload_offset(hdr);
     dom->kernel_size = hdr->payload_length;
 
-    if ( xc_dom_try_gunzip(dom, &dom->kernel_blob, &dom->kernel_size) == -1 )
+    if ( xc_dom_try_decompress(dom, &dom->kernel_blob,
+                               &dom->kernel_size) == -1 )
     {
         if ( verbose )
             xc_dom_panic(XC_INVALID_KERNEL, "%s: unable to decompress kernel\n",
@@ -177,6 +177,26 @@ void *xc_dom_malloc_filemap(struct xc_dom_image *dom,
     return NULL;
 }
 
+/* Hand an anonymous mapping over to the pool, to be unmapped with it. */
+int xc_dom_register_mmap(struct xc_dom_image *dom, void *ptr, size_t size)
+{
+    struct xc_dom_mem *block;
+
+    block = malloc(sizeof(*block));
+    if ( block == NULL )
+        return -1;
+    memset(block, 0, sizeof(*block));
+    block->mmap_ptr = ptr;
+    block->mmap_len = size;
+    block->next = dom->memblocks;
+    dom->memblocks = block;
+    dom->alloc_malloc += sizeof(*block);
+    dom->alloc_mem_map += block->mmap_len;
+    if ( size > (100 * 1024) )
+        print_mem(__FUNCTION__, size);
+    return 0;
+}
+
 static void xc_dom_free_all(struct xc_dom_image *dom)
 {
     struct xc_dom_mem *block;
@@ -575,7 +595,7 @@ int xc_dom_kernel_file(struct xc_dom_image *dom, const char *filename)
     dom->kernel_blob = xc_dom_malloc_filemap(dom, filename, &dom->kernel_size);
     if ( dom->kernel_blob == NULL )
         return -1;
-    return xc_dom_try_gunzip(dom, &dom->kernel_blob, &dom->kernel_size);
+    return xc_dom_try_decompress(dom, &dom->kernel_blob, &dom->kernel_size);
 }
 
 int xc_dom_ramdisk_file(struct xc_dom_image *dom, const char *filename)
@@ -594,7 +614,7 @@ int xc_dom_kernel_mem(struct xc_dom_image *dom, const void *mem, size_t memsize)
     xc_dom_printf("%s: called\n", __FUNCTION__);
     dom->kernel_blob = (void *)mem;
     dom->kernel_size = memsize;
-    return xc_dom_try_gunzip(dom, &dom->kernel_blob, &dom->kernel_size);
+    return xc_dom_try_decompress(dom, &dom->kernel_blob, &dom->kernel_size);
 }
 
 int xc_dom_ramdisk_mem(struct xc_dom_image *dom, const void *mem,
@@ -741,7 +761,19 @@ int xc_dom_build_image(struct xc_dom_image *dom)
         size_t unziplen, ramdisklen;
         void *ramdiskmap;
 
-        unziplen = xc_dom_check_gzip(dom->ramdisk_blob, dom->ramdisk_size);
+        /*
+         * Where the unpacked size is known up front, unpack straight into
+         * the guest.  Otherwise unpack to scratch memory first, and if that
+         * fails (no decoder built in, or the data only looked compressed)
+         * hand the ramdisk to the guest as it is, like we always used to.
+         */
+        unziplen = xc_dom_decompressed_size(dom->ramdisk_blob,
+                                            dom->ramdisk_size);
+        if ( (unziplen == 0) &&
+             (xc_dom_try_decompress(dom, &dom->ramdisk_blob,
+                                    &dom->ramdisk_size) != 0) )
+            xc_dom_printf("%s: can't unpack ramdisk, loading it verbatim\n",
+                          __FUNCTION__);
         ramdisklen = unziplen ? unziplen : dom->ramdisk_size;
         if ( xc_dom_alloc_segment(dom, &dom->ramdisk_seg, "ramdisk", 0,
                                   ramdisklen) != 0 )
@@ -749,8 +781,8 @@ int xc_dom_build_image(struct xc_dom_image *dom)
         ramdiskmap = xc_dom_seg_to_ptr(dom, &dom->ramdisk_seg);
         if ( unziplen )
         {
-            if ( xc_dom_do_gunzip(dom->ramdisk_blob, dom->ramdisk_size,
-                                  ramdiskmap, ramdisklen) == -1 )
+            if ( xc_dom_decompress(dom->ramdisk_blob, dom->ramdisk_size,
+                                   ramdiskmap, ramdisklen) == -1 )
                 goto err;
         }
         else
@@ -0,0 +1,566 @@
+/*
+ * Xen domain builder -- unpacking of compressed kernels and ramdisks.
+ *
+ * gzip is always available.  bzip2, LZMA/xz and LZO (lzop) support is
+ * built in when the respective library is found at build time
+ * (HAVE_BZLIB, HAVE_LZMA, HAVE_LZO1X).
+ *
+ * Images are unpacked into anonymous memory owned by the domain's memory
+ * pool.  When the unpacked size is known up front (gzip, and LZMA/xz
+ * streams which record it) ramdisks are unpacked straight into guest
+ * memory instead, see xc_dom_build_image().
+ *
+ * This code is licenced under the GPL.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+
+#include "xg_private.h"
+#include "xc_dom.h"
+
+/* same sanity limit as xc_dom_check_gzip() */
+#define UNPACK_MAX      (1024*1024*1024)
+
+enum xc_dom_packing {
+    PACKING_NONE,
+    PACKING_GZIP,
+    PACKING_BZIP2,
+    PACKING_LZMA,
+    PACKING_XZ,
+    PACKING_LZO,
+};
+
+static const char *packing_name[] = {
+    [PACKING_NONE]  = "none",
+    [PACKING_GZIP]  = "gzip",
+    [PACKING_BZIP2] = "bzip2",
+    [PACKING_LZMA]  = "lzma",
+    [PACKING_XZ]    = "xz",
+    [PACKING_LZO]   = "lzo",
+};
+
+#define LZOP_MAGIC      "\x89\x4c\x5a\x4f\x00\x0d\x0a\x1a\x0a"
+#define LZOP_MAGIC_SZ   9
+
+/*
+ * lzma_alone has no magic, so check the header the way liblzma's
+ * lzma_alone_decoder does: a valid lc/lp/pb properties byte with
+ * lc + lp <= 4, a dictionary size of 2^n or 2^n + 2^(n-1) within the
+ * range the encoder produces, and an unpacked size which is either
+ * unknown (all ones) or below 256GB.
+ */
+static int lzma_alone_header(const unsigned char *p)
+{
+    uint32_t dict = p[1] | p[2] << 8 | p[3] << 16 | (uint32_t)p[4] << 24;
+    uint32_t top;
+    unsigned int props = p[0], lc, lp;
+
+    if ( props >= 9 * 5 * 5 )
+        return 0;
+    lc = props % 9;
+    lp = (props / 9) % 5;
+    if ( lc + lp > 4 )
+        return 0;
+
+    if ( memcmp(p + 5, "\xff\xff\xff\xff\xff\xff\xff\xff", 8) != 0 &&
+         (p[9] >= 0x40 || p[10] || p[11] || p[12]) )
+        return 0;
+
+    if ( dict < 4096 || dict > (3U << 29) )
+        return 0;
+    top = 1U << (31 - __builtin_clz(dict));
+    return (dict == top) || (dict == top + (top >> 1));
+}
+
+static enum xc_dom_packing packing(const unsigned char *p, size_t len)
+{
+    if ( len < 16 )
+        return PACKING_NONE;
+    if ( p[0] == 0x1f && p[1] == 0x8b )
+        return PACKING_GZIP;
+    if ( memcmp(p, "BZh", 3) == 0 && p[3] >= '1' && p[3] <= '9' )
+        return PACKING_BZIP2;
+    if ( memcmp(p, "\xfd" "7zXZ\0", 6) == 0 )
+        return PACKING_XZ;
+    if ( lzma_alone_header(p) )
+        return PACKING_LZMA;
+    if ( memcmp(p, LZOP_MAGIC, LZOP_MAGIC_SZ) == 0 )
+        return PACKING_LZO;
+    return PACKING_NONE;
+}
+
+/*
+ * Where a decoder writes to: a fixed buffer (guest memory) or an
+ * anonymous mapping which is grown as needed.
+ */
+struct unpack_buf {
+    unsigned char *ptr;
+    size_t len;                 /* bytes produced */
+    size_t size;                /* bytes available at ptr */
+    int fixed;
+};
+
+static int unpack_reserve(struct unpack_buf *out, size_t need)
+{
+    unsigned char *ptr;
+    size_t size;
+
+    if ( out->size - out->len >= need )
+        return 0;
+    if ( out->fixed )
+    {
+        xc_dom_panic(XC_INTERNAL_ERROR, "%s: image larger than expected\n",
+                     __FUNCTION__);
+        return -1;
+    }
+
+    size = out->size * 2;
+    if ( size < out->len + need )
+        size = out->len + need;
+    size = (size + PAGE_SIZE - 1) & PAGE_MASK;
+    if ( size > UNPACK_MAX )
+    {
+        xc_dom_panic(XC_INTERNAL_ERROR, "%s: image larger than %d bytes\n",
+                     __FUNCTION__, UNPACK_MAX);
+        return -1;
+    }
+
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON,
+               -1, 0);
+    if ( ptr == MAP_FAILED )
+    {
+        xc_dom_panic(XC_OUT_OF_MEMORY, "%s: failed to map 0x%zx bytes\n",
+                     __FUNCTION__, size);
+        return -1;
+    }
+    if ( out->ptr != NULL )
+    {
+        memcpy(ptr, out->ptr, out->len);
+        munmap(out->ptr, out->size);
+    }
+    out->ptr = ptr;
+    out->size = size;
+    return 0;
+}
+
+static int unpack_gzip(const void *src, size_t srclen, struct unpack_buf *out)
+{
+    if ( unpack_reserve(out, xc_dom_check_gzip((void *)src, srclen)) != 0 )
+        return -1;
+    if ( xc_dom_do_gunzip((void *)src, srclen, out->ptr + out->len,
+                          out->size - out->len) == -1 )
+        return -1;
+    /* xc_dom_do_gunzip() doesn't say how much it produced */
+    out->len = xc_dom_check_gzip((void *)src, srclen) - 16;
+    return 0;
+}
+
+#if defined(HAVE_BZLIB)
+
+#include <bzlib.h>
+
+static int unpack_bzip2(const void *src, size_t srclen, struct unpack_buf *out)
+{
+    bz_stream stream;
+    int ret, rc = -1;
+
+    memset(&stream, 0, sizeof(stream));
+    ret = BZ2_bzDecompressInit(&stream, 0, 0);
+    if ( ret != BZ_OK )
+    {
+        xc_dom_panic(XC_INTERNAL_ERROR, "%s: BZ2_bzDecompressInit failed "
+                     "(rc=%d)\n", __FUNCTION__, ret);
+        return -1;
+    }
+
+    stream.next_in = (char *)src;
+    stream.avail_in = srclen;
+    for ( ; ; )
+    {
+        if ( unpack_reserve(out, 1) != 0 )
+            break;
+        stream.next_out = (char *)out->ptr + out->len;
+        stream.avail_out = out->size - out->len;
+        ret = BZ2_bzDecompress(&stream);
+        out->len = (unsigned char *)stream.next_out - out->ptr;
+        if ( ret == BZ_STREAM_END )
+        {
+            rc = 0;
+            break;
+        }
+        if ( ret != BZ_OK || (stream.avail_in == 0 && stream.avail_out != 0) )
+        {
+            xc_dom_panic(XC_INTERNAL_ERROR, "%s: BZ2_bzDecompress failed "
+                         "(rc=%d)\n", __FUNCTION__, ret);
+            break;
+        }
+    }
+
+    BZ2_bzDecompressEnd(&stream);
+    return rc;
+}
+
+#else /* !defined(HAVE_BZLIB) */
+
+static int unpack_bzip2(const void *src, size_t srclen, struct unpack_buf *out)
+{
+    xc_dom_panic(XC_INTERNAL_ERROR, "%s: built without bzip2 support\n",
+                 __FUNCTION__);
+    return -1;
+}
+
+#endif
+
+#if defined(HAVE_LZMA)
+
+#include <lzma.h>
+
+/* Handles both xz and the older lzma_alone format. */
+static int unpack_lzma(const void *src, size_t srclen, struct unpack_buf *out)
+{
+    lzma_stream stream = LZMA_STREAM_INIT;
+    lzma_ret ret;
+    int rc = -1;
+
+    ret = lzma_auto_decoder(&stream, UINT64_MAX, 0);
+    if ( ret != LZMA_OK )
+    {
+        xc_dom_panic(XC_INTERNAL_ERROR, "%s: lzma_auto_decoder failed "
+                     "(rc=%d)\n", __FUNCTION__, ret);
+        return -1;
+    }
+
+    stream.next_in = src;
+    stream.avail_in = srclen;
+    for ( ; ; )
+    {
+        if ( unpack_reserve(out, 1) != 0 )
+            break;
+        stream.next_out = out->ptr + out->len;
+        stream.avail_out = out->size - out->len;
+        ret = lzma_code(&stream, LZMA_FINISH);
+        out->len = stream.next_out - out->ptr;
+        if ( ret == LZMA_STREAM_END )
+        {
+            rc = 0;
+            break;
+        }
+        if ( ret != LZMA_OK )
+        {
+            xc_dom_panic(XC_INTERNAL_ERROR, "%s: lzma_code failed (rc=%d)\n",
+                         __FUNCTION__, ret);
+            break;
+        }
+    }
+
+    lzma_end(&stream);
+    return rc;
+}
+
+/* The unpacked size of a single-stream xz image, from its index. */
+static size_t xz_size(const unsigned char *p, size_t len)
+{
+    lzma_stream_flags footer;
+    lzma_index *index = NULL;
+    uint64_t memlimit = UINT64_MAX, size = 0;
+    size_t pos = 0;
+
+    /* skip stream padding */
+    while ( len >= 4 && memcmp(p + len - 4, "\0\0\0\0", 4) == 0 )
+        len -= 4;
+    if ( len < 2 * LZMA_STREAM_HEADER_SIZE )
+        return 0;
+    if ( lzma_stream_footer_decode(&footer,
+                                   p + len - LZMA_STREAM_HEADER_SIZE) !=
+         LZMA_OK )
+        return 0;
+    if ( footer.backward_size > len - 2 * LZMA_STREAM_HEADER_SIZE )
+        return 0;
+    if ( lzma_index_buffer_decode(&index, &memlimit, NULL,
+                                  p + len - LZMA_STREAM_HEADER_SIZE -
+                                  footer.backward_size,
+                                  &pos, footer.backward_size) != LZMA_OK )
+        return 0;
+    /* concatenated streams: the last index only covers the last one */
+    if ( lzma_index_stream_size(index) == len )
+        size = lzma_index_uncompressed_size(index);
+    lzma_index_end(index, NULL);
+
+    return (size <= UNPACK_MAX) ? size : 0;
+}
+
+#else /* !defined(HAVE_LZMA) */
+
+static int unpack_lzma(const void *src, size_t srclen, struct unpack_buf *out)
+{
+    xc_dom_panic(XC_INTERNAL_ERROR, "%s: built without LZMA support\n",
+                 __FUNCTION__);
+    return -1;
+}
+
+static size_t xz_size(const unsigned char *p, size_t len)
+{
+    return 0;
+}
+
+#endif
+
+#if defined(HAVE_LZO1X)
+
+#include <lzo/lzo1x.h>
+
+#define LZOP_F_ADLER32_D    0x00000001
+#define LZOP_F_ADLER32_C    0x00000002
+#define LZOP_F_H_EXTRA      0x00000040
+#define LZOP_F_CRC32_D      0x00000100
+#define LZOP_F_CRC32_C      0x00000200
+#define LZOP_F_H_FILTER     0x00000800
+#define LZOP_MAX_BLOCK      (64*1024*1024)
+
+static uint32_t lzop_get(const unsigned char **p, const unsigned char *end,
+                         unsigned int bytes, int *err)
+{
+    uint32_t val = 0;
+
+    if ( end - *p < bytes )
+    {
+        *err = 1;
+        return 0;
+    }
+    while ( bytes-- )
+        val = (val << 8) | *(*p)++;
+    return val;
+}
+
+/* lzop container of LZO1X blocks; checksums are not verified. */
+static int unpack_lzo(const void *src, size_t srclen, struct unpack_buf *out)
+{
+    const unsigned char *p = src, *end = p + srclen;
+    unsigned int version, method;
+    uint32_t flags, dst_len, src_len;
+    lzo_uint len;
+    int err = 0;
+
+    if ( lzo_init() != LZO_E_OK )
+    {
+        xc_dom_panic(XC_INTERNAL_ERROR, "%s: lzo_init failed\n", __FUNCTION__);
+        return -1;
+    }
+
+    p += LZOP_MAGIC_SZ;
+    version = lzop_get(&p, end, 2, &err);
+    lzop_get(&p, end, 2, &err);                 /* library version */
+    if ( version >= 0x0940 )
+        lzop_get(&p, end, 2, &err);             /* version needed */
+    method = lzop_get(&p, end, 1, &err);
+    if ( version >= 0x0940 )
+        lzop_get(&p, end, 1, &err);             /* level */
+    flags = lzop_get(&p, end, 4, &err);
+    if ( flags & LZOP_F_H_FILTER )
+        lzop_get(&p, end, 4, &err);
+    lzop_get(&p, end, 4, &err);                 /* mode */
+    lzop_get(&p, end, 4, &err);                 /* mtime */
+    if ( version >= 0x0940 )
+        lzop_get(&p, end, 4, &err);             /* mtime, high half */
+    len = lzop_get(&p, end, 1, &err);           /* file name */
+    if ( !err && (size_t)(end - p) >= len )
+        p += len;
+    else
+        err = 1;
+    lzop_get(&p, end, 4, &err);                 /* header checksum */
+    if ( err || method < 1 || method > 3 || (flags & LZOP_F_H_EXTRA) )
+    {
+        xc_dom_panic(XC_INVALID_KERNEL, "%s: unsupported lzop header\n",
+                     __FUNCTION__);
+        return -1;
+    }
+
+    while ( (dst_len = lzop_get(&p, end, 4, &err)) != 0 && !err )
+    {
+        src_len = lzop_get(&p, end, 4, &err);
+        if ( flags & LZOP_F_ADLER32_D )
+            lzop_get(&p, end, 4, &err);
+        if ( flags & LZOP_F_CRC32_D )
+            lzop_get(&p, end, 4, &err);
+        if ( src_len < dst_len )
+        {
+            if ( flags & LZOP_F_ADLER32_C )
+                lzop_get(&p, end, 4, &err);
+            if ( flags & LZOP_F_CRC32_C )
+                lzop_get(&p, end, 4, &err);
+        }
+        if ( err || dst_len > LZOP_MAX_BLOCK || src_len > dst_len ||
+             (size_t)(end - p) < src_len )
+            break;
+        if ( unpack_reserve(out, dst_len) != 0 )
+            return -1;
+
+        if ( src_len == dst_len )
+            memcpy(out->ptr + out->len, p, dst_len);
+        else
+        {
+            len = dst_len;
+            if ( lzo1x_decompress_safe(p, src_len, out->ptr + out->len,
+                                       &len, NULL) != LZO_E_OK ||
+                 len != dst_len )
+            {
+                err = 1;
+                break;
+            }
+        }
+        out->len += dst_len;
+        p += src_len;
+    }
+
+    if ( err )
+    {
+        xc_dom_panic(XC_INVALID_KERNEL, "%s: corrupt lzop image\n",
+                     __FUNCTION__);
+        return -1;
+    }
+    return 0;
+}
+
+#else /* !defined(HAVE_LZO1X) */
+
+static int unpack_lzo(const void *src, size_t srclen, struct unpack_buf *out)
+{
+    xc_dom_panic(XC_INTERNAL_ERROR, "%s: built without LZO support\n",
+                 __FUNCTION__);
+    return -1;
+}
+
+#endif
+
+static int unpack(enum xc_dom_packing type, const void *src, size_t srclen,
+                  struct unpack_buf *out)
+{
+    int rc;
+
+    switch ( type )
+    {
+    case PACKING_GZIP:
+        rc = unpack_gzip(src, srclen, out);
+        break;
+    case PACKING_BZIP2:
+        rc = unpack_bzip2(src, srclen, out);
+        break;
+    case PACKING_LZMA:
+    case PACKING_XZ:
+        rc = unpack_lzma(src, srclen, out);
+        break;
+    case PACKING_LZO:
+        rc = unpack_lzo(src, srclen, out);
+        break;
+    default:
+        return -1;
+    }
+
+    if ( rc == 0 )
+        xc_dom_printf("%s: %s unpack ok, 0x%zx -> 0x%zx\n", __FUNCTION__,
+                      packing_name[type], srclen, out->len);
+    return rc;
+}
+
+/*
+ * The unpacked size of blob if it is compressed and the size can be
+ * told without unpacking it, 0 otherwise.
+ */
+size_t xc_dom_decompressed_size(void *blob, size_t len)
+{
+    const unsigned char *p = blob;
+
+    switch ( packing(p, len) )
+    {
+    case PACKING_GZIP:
+        return xc_dom_check_gzip(blob, len);
+    case PACKING_LZMA:
+#if defined(HAVE_LZMA)
+    {
+        /* lzma_alone header: props, dict size, then the unpacked size */
+        uint64_t size = (uint64_t)p[5] | (uint64_t)p[6] << 8 | (uint64_t)p[7] << 16 |
+            (uint64_t)p[8] << 24 | (uint64_t)p[9] << 32 |
+            (uint64_t)p[10] << 40 | (uint64_t)p[11] << 48 |
+            (uint64_t)p[12] << 56;
+        return (size <= UNPACK_MAX) ? size : 0; /* ~0: unknown */
+    }
+#else
+        return 0;
+#endif
+    case PACKING_XZ:
+        return xz_size(p, len);
+    default:
+        return 0;
+    }
+}
+
+/* Unpack src into a buffer of (at least) the xc_dom_decompressed_size(). */
+int xc_dom_decompress(void *src, size_t srclen, void *dst, size_t dstlen)
+{
+    struct unpack_buf out = {
+        .ptr = dst, .len = 0, .size = dstlen, .fixed = 1,
+    };
+
+    return unpack(packing(src, srclen), src, srclen, &out);
+}
+
+/*
+ * Unpack *blob in place if it is compressed.  A bzImage payload carries
+ * its unpacked size in the last four bytes, which is also a fine first
+ * guess for anything else as long as it's sane.
+ */
+int xc_dom_try_decompress(struct xc_dom_image *dom, void **blob, size_t *size)
+{
+    enum xc_dom_packing type = packing(*blob, *size);
+    struct unpack_buf out = { .ptr = NULL, .len = 0, .size = 0, .fixed = 0 };
+    const unsigned char *tail;
+    size_t guess;
+
+    if ( type == PACKING_NONE )
+        return 0;
+    if ( type == PACKING_GZIP )
+        return xc_dom_try_gunzip(dom, blob, size);
+
+    tail = (const unsigned char *)*blob + *size - 4;
+    guess = tail[0] | tail[1] << 8 | tail[2] << 16 | (size_t)tail[3] << 24;
+    if ( guess < *size || guess > UNPACK_MAX / 2 )
+        guess = *size * 4;
+    if ( unpack_reserve(&out, guess) != 0 )
+        return -1;
+
+    if ( unpack(type, *blob, *size, &out) != 0 )
+    {
+        munmap(out.ptr, out.size);
+        return -1;
+    }
+
+    /* give back what the guess overshot by */
+    guess = (out.len + PAGE_SIZE - 1) & PAGE_MASK;
+    if ( guess != 0 && guess < out.size )
+    {
+        munmap(out.ptr + guess, out.size - guess);
+        out.size = guess;
+    }
+    if ( xc_dom_register_mmap(dom, out.ptr, out.size) != 0 )
+    {
+        munmap(out.ptr, out.size);
+        return -1;
+    }
+
+    *blob = out.ptr;
+    *size = out.len;
+    return 0;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-set-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
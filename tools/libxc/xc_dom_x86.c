@@ -28,6 +28,7 @@
 
 #define SUPERPAGE_PFN_SHIFT  9
 #define SUPERPAGE_NR_PFNS    (1UL << SUPERPAGE_PFN_SHIFT)
+#define SUPERPAGE_BATCH      512 /* 1GB per populate_physmap call */
 
 #define bits_to_mask(bits)       (((xen_vaddr_t)1 << (bits))-1)
 #define round_down(addr, mask)   ((addr) & ~(mask))
@@ -713,26 +714,60 @@ int arch_setup_meminit(struct xc_dom_image *dom)
     dom->p2m_host = xc_dom_malloc(dom, sizeof(xen_pfn_t) * dom->total_pages);
     if ( dom->superpages )
     {
-        int count = dom->total_pages >> SUPERPAGE_PFN_SHIFT;
-        xen_pfn_t extents[count];
-
-        xc_dom_printf("Populating memory with %d superpages\n", count);
-        for ( pfn = 0; pfn < count; pfn++ )
-            extents[pfn] = pfn << SUPERPAGE_PFN_SHIFT;
-        rc = xc_domain_memory_populate_physmap(dom->guest_xc, dom->guest_domid,
-                                               count, SUPERPAGE_PFN_SHIFT, 0,
-                                               extents);
-        if ( rc )
-            return rc;
-
-        /* Expand the returned mfn into the p2m array */
-        pfn = 0;
-        for ( i = 0; i < count; i++ )
+        /*
+         * Populate in 2MB extents, SUPERPAGE_BATCH extents per hypercall.
+         * Whatever Xen cannot back with superpages, and any tail smaller
+         * than 2MB, falls back to 4kB pages rather than failing the build.
+         */
+        xen_pfn_t extents[SUPERPAGE_BATCH];
+        unsigned long nr_super = 0;
+
+        for ( pfn = rc = 0; (pfn < dom->total_pages) && !rc; pfn += allocsz )
         {
-            mfn = extents[i];
-            for ( j = 0; j < SUPERPAGE_NR_PFNS; j++, pfn++ )
-                dom->p2m_host[pfn] = mfn + j;
+            long done = 0;
+            struct xen_memory_reservation sp_req = {
+                .extent_order = SUPERPAGE_PFN_SHIFT,
+                .domid        = dom->guest_domid
+            };
+
+            allocsz = dom->total_pages - pfn;
+            if ( allocsz > (SUPERPAGE_BATCH << SUPERPAGE_PFN_SHIFT) )
+                allocsz = SUPERPAGE_BATCH << SUPERPAGE_PFN_SHIFT;
+
+            sp_req.nr_extents = allocsz >> SUPERPAGE_PFN_SHIFT;
+            if ( sp_req.nr_extents != 0 )
+            {
+                for ( i = 0; i < sp_req.nr_extents; i++ )
+                    extents[i] = pfn + (i << SUPERPAGE_PFN_SHIFT);
+                set_xen_guest_handle(sp_req.extent_start, extents);
+                done = xc_memory_op(dom->guest_xc, XENMEM_populate_physmap,
+                                    &sp_req);
+                if ( done < 0 )
+                    done = 0;
+
+                /* Expand the returned mfns into the p2m array. */
+                for ( i = 0; i < done; i++ )
+                {
+                    mfn = extents[i];
+                    for ( j = 0; j < SUPERPAGE_NR_PFNS; j++ )
+                        dom->p2m_host[pfn + (i << SUPERPAGE_PFN_SHIFT) + j] =
+                            mfn + j;
+                }
+                nr_super += done;
+                done <<= SUPERPAGE_PFN_SHIFT;
+            }
+
+            if ( done < allocsz )
+            {
+                for ( i = pfn + done; i < pfn + allocsz; i++ )
+                    dom->p2m_host[i] = i;
+                rc = xc_domain_memory_populate_physmap(
+                    dom->guest_xc, dom->guest_domid, allocsz - done,
+                    0, 0, &dom->p2m_host[pfn + done]);
+            }
         }
+
+        xc_dom_printf("Populated memory with %lu superpages\n", nr_super);
     }
     else
     {
@@ -245,6 +245,38 @@ int xc_domain_getinfolist(int xc_handle,
     return ret;
 }
 
+int xc_domain_getstats(int xc_handle,
+                       uint32_t first_domain,
+                       void *buf,
+                       unsigned int size,
+                       unsigned int *used,
+                       uint32_t *next_domain)
+{
+    int ret = 0;
+    DECLARE_SYSCTL;
+
+    if ( lock_pages(buf, size) != 0 )
+        return -1;
+
+    sysctl.cmd = XEN_SYSCTL_getdomstats;
+    sysctl.u.getdomstats.first_domain = first_domain;
+    sysctl.u.getdomstats.size         = size;
+    set_xen_guest_handle(sysctl.u.getdomstats.buffer, buf);
+
+    if ( xc_sysctl(xc_handle, &sysctl) < 0 )
+        ret = -1;
+    else
+    {
+        ret = sysctl.u.getdomstats.num_domains;
+        *used = sysctl.u.getdomstats.used;
+        *next_domain = sysctl.u.getdomstats.next_domain;
+    }
+
+    unlock_pages(buf, size);
+
+    return ret;
+}
+
 /* get info from hvm guest for save */
 int xc_domain_hvm_getcontext(int xc_handle,
                              uint32_t domid,
@@ -383,6 +415,49 @@ int xc_shadow_control(int xc_handle,
     return (rc == 0) ? domctl.u.shadow_op.pages : rc;
 }
 
+int xc_shadow_dirty_ranges(int xc_handle,
+                           uint32_t domid,
+                           unsigned int sop,
+                           unsigned long begin_pfn,
+                           unsigned long *pages,
+                           xc_shadow_op_range_t *ranges,
+                           unsigned int *nr_ranges,
+                           xc_shadow_op_stats_t *stats)
+{
+    int rc;
+    size_t size = *nr_ranges * sizeof(*ranges);
+    DECLARE_DOMCTL;
+
+    domctl.cmd = XEN_DOMCTL_shadow_op;
+    domctl.domain = (domid_t)domid;
+    domctl.u.shadow_op.op        = sop;
+    domctl.u.shadow_op.begin_pfn = begin_pfn;
+    domctl.u.shadow_op.pages     = *pages;
+    domctl.u.shadow_op.nr_ranges = *nr_ranges;
+    set_xen_guest_handle(domctl.u.shadow_op.dirty_ranges, ranges);
+
+    if ( lock_pages(ranges, size) != 0 )
+    {
+        PERROR("Could not lock memory for dirty ranges");
+        return -1;
+    }
+
+    rc = do_domctl(xc_handle, &domctl);
+
+    unlock_pages(ranges, size);
+
+    if ( rc == 0 )
+    {
+        *pages = domctl.u.shadow_op.pages;
+        *nr_ranges = domctl.u.shadow_op.nr_ranges;
+        if ( stats )
+            memcpy(stats, &domctl.u.shadow_op.stats,
+                   sizeof(xc_shadow_op_stats_t));
+    }
+
+    return rc;
+}
+
 int xc_domain_setmaxmem(int xc_handle,
                         uint32_t domid,
                         unsigned int max_memkb)
@@ -63,41 +63,56 @@ unsigned int guest_width;
 #define SUPERPAGE_PFN_SHIFT  9
 #define SUPERPAGE_NR_PFNS    (1UL << SUPERPAGE_PFN_SHIFT)
 
-static int allocate_mfn(int xc_handle, uint32_t dom, unsigned long pfn, int superpages)
+/*
+ * Back a whole 2MB-aligned extent of the p2m with a superpage. This is only
+ * possible if none of its pfns has been populated yet and the extent lies
+ * entirely within the p2m. Returns 0 if the caller should fall back to
+ * allocating a single page.
+ */
+static int allocate_superpage(int xc_handle, uint32_t dom, unsigned long pfn)
 {
-    unsigned long mfn;
+    unsigned long base_pfn, mfn, i;
 
-    if (superpages)
-    {
-        unsigned long base_pfn;
+    base_pfn = pfn & ~(SUPERPAGE_NR_PFNS-1);
+    if (base_pfn + SUPERPAGE_NR_PFNS > p2m_size)
+        return 0;
 
-        base_pfn = pfn & ~(SUPERPAGE_NR_PFNS-1);
-        mfn = base_pfn;
+    for (i = base_pfn; i < base_pfn + SUPERPAGE_NR_PFNS; i++)
+        if (p2m[i] != INVALID_P2M_ENTRY)
+            return 0;
 
-        if (xc_domain_memory_populate_physmap(xc_handle, dom, 1,
-                                              SUPERPAGE_PFN_SHIFT, 0, &mfn) != 0)
-        {
-            ERROR("Failed to allocate physical memory at pfn 0x%x, base 0x%x.\n", pfn, base_pfn); 
-            errno = ENOMEM;
-            return 1;
-        }
-        for (pfn = base_pfn; pfn < base_pfn + SUPERPAGE_NR_PFNS; pfn++, mfn++)
-        {
-            p2m[pfn] = mfn;
-        }
+    mfn = base_pfn;
+    if (xc_domain_memory_populate_physmap(xc_handle, dom, 1,
+                                          SUPERPAGE_PFN_SHIFT, 0, &mfn) != 0)
+    {
+        /* Host memory is fragmented: use 4kB pages for this extent. */
+        DPRINTF("No superpage for pfn 0x%lx, base 0x%lx.\n", pfn, base_pfn);
+        return 0;
     }
-    else
+
+    for (i = base_pfn; i < base_pfn + SUPERPAGE_NR_PFNS; i++, mfn++)
+        p2m[i] = mfn;
+
+    return 1;
+}
+
+static int allocate_mfn(int xc_handle, uint32_t dom, unsigned long pfn, int superpages)
+{
+    unsigned long mfn;
+
+    if (superpages && allocate_superpage(xc_handle, dom, pfn))
+        return 0;
+
+    mfn = pfn;
+    if (xc_domain_memory_populate_physmap(xc_handle, dom, 1, 0,
+                                          0, &mfn) != 0)
     {
-        mfn = pfn;
-        if (xc_domain_memory_populate_physmap(xc_handle, dom, 1, 0,
-                                              0, &mfn) != 0)
-        {
-            ERROR("Failed to allocate physical memory.!\n"); 
-            errno = ENOMEM;
-            return 1;
-        }
-        p2m[pfn] = mfn;
+        ERROR("Failed to allocate physical memory.!\n"); 
+        errno = ENOMEM;
+        return 1;
     }
+    p2m[pfn] = mfn;
+
     return 0;
 }
 
@@ -306,6 +306,53 @@ static int print_stats(int xc_handle, uint32_t domid, int pages_sent,
 }
 
 
+/*
+** Rather than peeking the whole dirty bitmap for every batch, refresh
+** to_skip one window at a time from the hypervisor's list of dirty ranges.
+*/
+#define SKIP_WINDOW_PFNS (1UL << 20)
+#define SKIP_RANGES      256
+
+/* Refresh to_skip for [start, start + nr); returns -1 if Xen can't do it. */
+static int peek_skip_window(int xc_handle, uint32_t domid,
+                            unsigned long start, unsigned long nr,
+                            unsigned long *to_skip)
+{
+    xc_shadow_op_range_t ranges[SKIP_RANGES];
+    unsigned long pages, pfn, end;
+    unsigned int i, nr_ranges;
+
+    memset(&to_skip[start / BITS_PER_LONG], 0,
+           BITS_TO_LONGS(nr) * sizeof(unsigned long));
+
+    while ( nr )
+    {
+        pages = nr;
+        nr_ranges = SKIP_RANGES;
+        if ( xc_shadow_dirty_ranges(xc_handle, domid,
+                                    XEN_DOMCTL_SHADOW_OP_PEEK_RANGES,
+                                    start, &pages, ranges, &nr_ranges,
+                                    NULL) != 0 )
+            return -1;
+
+        for ( i = 0; i < nr_ranges; i++ )
+        {
+            end = ranges[i].first_pfn + ranges[i].nr_pfns;
+            if ( end > start + nr )
+                end = start + nr;
+            for ( pfn = ranges[i].first_pfn; pfn < end; pfn++ )
+                set_bit(pfn, to_skip);
+        }
+
+        if ( pages == 0 )
+            break;
+        start += pages;
+        nr -= pages;
+    }
+
+    return 0;
+}
+
 static int analysis_phase(int xc_handle, uint32_t domid, int p2m_size,
                           unsigned long *arr, int runs)
 {
@@ -759,6 +806,9 @@ int xc_domain_save(int xc_handle, int io_fd, uint32_t dom, uint32_t max_iters,
     int debug = (flags & XCFLAGS_DEBUG);
     int race = 0, sent_last_iter, skip_this_iter;
 
+    /* Whether Xen can report dirty pfns as ranges (see peek_skip_window). */
+    int skip_ranges = 1;
+
     /* The new domain's shared-info frame number. */
     unsigned long shared_info_frame;
 
@@ -1000,6 +1050,7 @@ int xc_domain_save(int xc_handle, int io_fd, uint32_t dom, uint32_t max_iters,
     for ( ; ; )
     {
         unsigned int prev_pc, sent_this_iter, N, batch, run;
+        unsigned long skip_end = 0;
 
         iter++;
         sent_this_iter = 0;
@@ -1019,28 +1070,50 @@ int xc_domain_save(int xc_handle, int io_fd, uint32_t dom, uint32_t max_iters,
                 prev_pc = this_pc;
             }
 
-            if ( !last_iter )
+            if ( !last_iter && (N >= skip_end) )
             {
-                /* Slightly wasteful to peek the whole array evey time,
-                   but this is fast enough for the moment. */
-                frc = xc_shadow_control(
-                    xc_handle, dom, XEN_DOMCTL_SHADOW_OP_PEEK, to_skip, 
-                    p2m_size, NULL, 0, NULL);
-                if ( frc != p2m_size )
+                unsigned long start = N & ~(BITS_PER_LONG - 1);
+
+                skip_end = start + SKIP_WINDOW_PFNS;
+                if ( skip_end > p2m_size )
+                    skip_end = p2m_size;
+
+                if ( !skip_ranges ||
+                     peek_skip_window(xc_handle, dom, start,
+                                      skip_end - start, to_skip) )
                 {
-                    ERROR("Error peeking shadow bitmap");
-                    goto out;
+                    /* Older Xen: peek the whole array every batch. */
+                    skip_ranges = 0;
+                    skip_end = 0;
+                    frc = xc_shadow_control(
+                        xc_handle, dom, XEN_DOMCTL_SHADOW_OP_PEEK, to_skip, 
+                        p2m_size, NULL, 0, NULL);
+                    if ( frc != p2m_size )
+                    {
+                        ERROR("Error peeking shadow bitmap");
+                        goto out;
+                    }
                 }
             }
 
             /* load pfn_type[] with the mfn of all the pages we're doing in
                this batch. */
             for  ( batch = 0;
-                   (batch < MAX_BATCH_SIZE) && (N < p2m_size);
+                   (batch < MAX_BATCH_SIZE) && (N < p2m_size) &&
+                   (last_iter || !skip_ranges || (N < skip_end));
                    N++ )
             {
                 int n = N;
 
+                /* Skip a whole word of pfns if none of them can be sent. */
+                if ( !debug && !BITMAP_SHIFT(n) &&
+                     !(BITMAP_ENTRY(n, to_send) |
+                       (last_iter ? BITMAP_ENTRY(n, to_fix) : 0)) )
+                {
+                    N += BITS_PER_LONG - 1;
+                    continue;
+                }
+
                 if ( debug )
                 {
                     DPRINTF("%d pfn= %08lx mfn= %08lx %d",
@@ -1105,7 +1178,7 @@ int xc_domain_save(int xc_handle, int io_fd, uint32_t dom, uint32_t max_iters,
             }
 
             if ( batch == 0 )
-                goto skip; /* vanishingly unlikely... */
+                continue; /* end of the array, or of a to_skip window */
 
             region_base = xc_map_foreign_batch(
                 xc_handle, dom, PROT_READ, pfn_type, batch);
@@ -1263,8 +1336,6 @@ int xc_domain_save(int xc_handle, int io_fd, uint32_t dom, uint32_t max_iters,
 
         } /* end of this while loop for this iteration */
 
-      skip:
-
         total_sent += sent_this_iter;
 
         DPRINTF("\r %d: sent %d, skipped %d, ",
@@ -64,3 +64,43 @@ int xc_evtchn_status(int xc_handle, xc_evtchn_status_t *status)
     return do_evtchn_op(xc_handle, EVTCHNOP_status, status,
                         sizeof(*status), 1);
 }
+
+static int do_evtchn_port_batch(int xc_handle, int cmd,
+                                evtchn_port_t *ports, unsigned int nr_ports)
+{
+    int rc;
+    struct evtchn_port_batch arg = {
+        .nr_ports = nr_ports,
+        .done = 0
+    };
+
+    set_xen_guest_handle(arg.ports, ports);
+
+    if ( lock_pages(ports, nr_ports * sizeof(*ports)) != 0 )
+    {
+        PERROR("do_evtchn_port_batch: ports lock failed");
+        return -1;
+    }
+
+    rc = do_evtchn_op(xc_handle, cmd, &arg, sizeof(arg), 0);
+
+    unlock_pages(ports, nr_ports * sizeof(*ports));
+
+    return rc;
+}
+
+int xc_evtchn_send_batch(int xc_handle,
+                         evtchn_port_t *ports,
+                         unsigned int nr_ports)
+{
+    return do_evtchn_port_batch(xc_handle, EVTCHNOP_send_batch,
+                                ports, nr_ports);
+}
+
+int xc_evtchn_unmask_batch(int xc_handle,
+                           evtchn_port_t *ports,
+                           unsigned int nr_ports)
+{
+    return do_evtchn_port_batch(xc_handle, EVTCHNOP_unmask_batch,
+                                ports, nr_ports);
+}
@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <zlib.h>
+#include <pthread.h>
 
 #include "xg_private.h"
 #include "xc_private.h"
@@ -21,6 +22,11 @@
 
 #define SUPERPAGE_PFN_SHIFT  9
 #define SUPERPAGE_NR_PFNS    (1UL << SUPERPAGE_PFN_SHIFT)
+#define SUPERPAGE_1GB_SHIFT   18
+#define SUPERPAGE_1GB_NR_PFNS (1UL << SUPERPAGE_1GB_SHIFT)
+
+/* Upper bound on concurrent populate threads (one per NUMA node). */
+#define MAX_POPULATE_THREADS 8
 
 #define SPECIALPAGE_BUFIOREQ 0
 #define SPECIALPAGE_XENSTORE 1
@@ -100,6 +106,204 @@ static int loadelfimage(
     return rc;
 }
 
+struct populate_job {
+    int xc_handle;
+    uint32_t dom;
+    xen_pfn_t *page_array;
+    unsigned long start, end;     /* page_array indices [start, end) */
+    unsigned int memflags;        /* XENMEMF_node() hint, or 0 */
+    int pod_mode;
+    unsigned long target_pages;
+    long pod_pages;               /* contribution to the PoD target */
+    int no_1gb;                   /* a 1GB allocation has failed */
+    int rc;
+};
+
+/* Populate @nr extents of 2^@order pages from @cur.  Returns pages done. */
+static unsigned long populate_extents(
+    struct populate_job *job, unsigned long cur,
+    unsigned long nr, unsigned int order)
+{
+    unsigned long i;
+    long done;
+    xen_pfn_t sp_extents[nr];
+    struct xen_memory_reservation sp_req = {
+        .nr_extents   = nr,
+        .extent_order = order,
+        .mem_flags    = job->memflags,
+        .domid        = job->dom
+    };
+
+    if ( job->pod_mode )
+        sp_req.mem_flags |= XENMEMF_populate_on_demand;
+
+    set_xen_guest_handle(sp_req.extent_start, sp_extents);
+    for ( i = 0; i < nr; i++ )
+        sp_extents[i] = job->page_array[cur + (i << order)];
+    done = xc_memory_op(job->xc_handle, XENMEM_populate_physmap, &sp_req);
+
+    return (done > 0) ? ((unsigned long)done << order) : 0;
+}
+
+static void *populate_range(void *arg)
+{
+    struct populate_job *job = arg;
+    xen_pfn_t *page_array = job->page_array;
+    unsigned long cur_pages = job->start;
+
+    while ( (job->rc == 0) && (job->end > cur_pages) )
+    {
+        unsigned long count = job->end - cur_pages;
+        unsigned long gpfn = page_array[cur_pages];
+        unsigned long done;
+
+        /*
+         * Try a 1GB extent first.  The range must be 1GB aligned in the
+         * guest physical address space and must not straddle the MMIO hole.
+         * PoD only deals in 2MB and 4kB extents.
+         */
+        if ( !job->pod_mode && !job->no_1gb &&
+             ((gpfn & (SUPERPAGE_1GB_NR_PFNS - 1)) == 0) &&
+             (count >= SUPERPAGE_1GB_NR_PFNS) &&
+             (page_array[cur_pages + SUPERPAGE_1GB_NR_PFNS - 1] ==
+              gpfn + SUPERPAGE_1GB_NR_PFNS - 1) )
+        {
+            if ( populate_extents(job, cur_pages, 1,
+                                  SUPERPAGE_1GB_SHIFT) != 0 )
+            {
+                cur_pages += SUPERPAGE_1GB_NR_PFNS;
+                continue;
+            }
+            job->no_1gb = 1;
+        }
+
+        /*
+         * Clip count to maximum 8MB extent, so that we can be preempted
+         * and dom0 remains responsive, and stop at the next 1GB boundary
+         * so that a 1GB extent can be tried there.
+         */
+        if ( count > 2048 )
+            count = 2048;
+        if ( count > SUPERPAGE_1GB_NR_PFNS -
+             (gpfn & (SUPERPAGE_1GB_NR_PFNS - 1)) )
+            count = SUPERPAGE_1GB_NR_PFNS -
+                (gpfn & (SUPERPAGE_1GB_NR_PFNS - 1));
+
+        /* Clip partial superpage extents to superpage boundaries. */
+        if ( ((cur_pages & (SUPERPAGE_NR_PFNS-1)) != 0) &&
+             (count > (-cur_pages & (SUPERPAGE_NR_PFNS-1))) )
+            count = -cur_pages & (SUPERPAGE_NR_PFNS-1); /* clip s.p. tail */
+        else if ( ((count & (SUPERPAGE_NR_PFNS-1)) != 0) &&
+                  (count > SUPERPAGE_NR_PFNS) )
+            count &= ~(SUPERPAGE_NR_PFNS - 1); /* clip non-s.p. tail */
+
+        /* Attempt to allocate superpage extents. */
+        if ( ((count | cur_pages) & (SUPERPAGE_NR_PFNS - 1)) == 0 )
+        {
+            done = populate_extents(job, cur_pages,
+                                    count >> SUPERPAGE_PFN_SHIFT,
+                                    SUPERPAGE_PFN_SHIFT);
+            if ( job->pod_mode && job->target_pages > cur_pages )
+            {
+                unsigned long d = job->target_pages - cur_pages;
+                job->pod_pages += ( done < d ) ? done : d;
+            }
+            cur_pages += done;
+            count -= done;
+        }
+
+        /* Fall back to 4kB extents. */
+        if ( count != 0 )
+        {
+            job->rc = xc_domain_memory_populate_physmap(
+                job->xc_handle, job->dom, count, 0, job->memflags,
+                &page_array[cur_pages]);
+            cur_pages += count;
+            if ( job->pod_mode )
+                job->pod_pages -= count;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Populate guest pages [0xc0, nr_pages).  On a NUMA host the range is split
+ * into 1GB-aligned slices, one per node, which are populated concurrently
+ * with each slice preferring memory from its own node.  Xen no longer zeroes
+ * memory at allocation time (freed pages are scrubbed when idle), so the
+ * cost is dominated by hypercall and p2m work that overlaps well.
+ */
+static int populate_guest(int xc_handle, uint32_t dom,
+                          xen_pfn_t *page_array, unsigned long nr_pages,
+                          int pod_mode, unsigned long target_pages,
+                          unsigned long *pod_pages)
+{
+    struct populate_job job[MAX_POPULATE_THREADS];
+    pthread_t tid[MAX_POPULATE_THREADS];
+    int started[MAX_POPULATE_THREADS] = { 0 };
+    unsigned int i, nr_jobs = 1;
+    unsigned long chunk;
+    xc_physinfo_t physinfo;
+    int rc = 0;
+
+    memset(&physinfo, 0, sizeof(physinfo));
+    if ( !pod_mode && (xc_physinfo(xc_handle, &physinfo) == 0) &&
+         (physinfo.nr_nodes > 1) )
+    {
+        nr_jobs = physinfo.nr_nodes;
+        if ( nr_jobs > MAX_POPULATE_THREADS )
+            nr_jobs = MAX_POPULATE_THREADS;
+        if ( nr_jobs > nr_pages / SUPERPAGE_1GB_NR_PFNS )
+            nr_jobs = nr_pages / SUPERPAGE_1GB_NR_PFNS ? : 1;
+    }
+
+    chunk = (nr_pages + nr_jobs - 1) / nr_jobs;
+    chunk = (chunk + SUPERPAGE_1GB_NR_PFNS - 1) &
+        ~(SUPERPAGE_1GB_NR_PFNS - 1);
+
+    for ( i = 0; i < nr_jobs; i++ )
+    {
+        memset(&job[i], 0, sizeof(job[i]));
+        job[i].xc_handle    = xc_handle;
+        job[i].dom          = dom;
+        job[i].page_array   = page_array;
+        job[i].start        = (i == 0) ? 0xc0 : i * chunk;
+        job[i].end          = (i + 1) * chunk;
+        if ( job[i].end > nr_pages )
+            job[i].end = nr_pages;
+        if ( job[i].start > job[i].end )
+            job[i].start = job[i].end;
+        job[i].memflags     = (nr_jobs > 1) ? XENMEMF_node(i) : 0;
+        job[i].pod_mode     = pod_mode;
+        job[i].target_pages = target_pages;
+    }
+
+    /* Job 0 runs in this thread; fall back to running inline on error. */
+    for ( i = 1; i < nr_jobs; i++ )
+        started[i] = (pthread_create(&tid[i], NULL,
+                                     populate_range, &job[i]) == 0);
+
+    populate_range(&job[0]);
+
+    for ( i = 1; i < nr_jobs; i++ )
+    {
+        if ( started[i] )
+            pthread_join(tid[i], NULL);
+        else
+            populate_range(&job[i]);
+    }
+
+    for ( i = 0; i < nr_jobs; i++ )
+    {
+        if ( job[i].rc != 0 )
+            rc = job[i].rc;
+        *pod_pages += job[i].pod_pages;
+    }
+
+    return rc;
+}
+
 static int setup_guest(int xc_handle,
                        uint32_t dom, int memsize, int target,
                        char *image, unsigned long image_size)
@@ -108,7 +312,7 @@ static int setup_guest(int xc_handle,
     unsigned long i, nr_pages = (unsigned long)memsize << (20 - PAGE_SHIFT);
     unsigned long target_pages = (unsigned long)target << (20 - PAGE_SHIFT);
     unsigned long pod_pages = 0;
-    unsigned long entry_eip, cur_pages;
+    unsigned long entry_eip;
     struct xen_add_to_physmap xatp;
     struct shared_info *shared_info;
     void *hvm_info_page;
@@ -166,68 +370,14 @@ static int setup_guest(int xc_handle,
 
     /*
      * Allocate memory for HVM guest, skipping VGA hole 0xA0000-0xC0000.
-     * We allocate pages in batches of no more than 8MB to ensure that
-     * we can be preempted and hence dom0 remains responsive.
+     * Everything above the hole is populated by populate_guest(), which
+     * prefers 1GB, then 2MB, then 4kB extents.
      */
     rc = xc_domain_memory_populate_physmap(
         xc_handle, dom, 0xa0, 0, 0, &page_array[0x00]);
-    cur_pages = 0xc0;
-    while ( (rc == 0) && (nr_pages > cur_pages) )
-    {
-        /* Clip count to maximum 8MB extent. */
-        unsigned long count = nr_pages - cur_pages;
-        if ( count > 2048 )
-            count = 2048;
-
-        /* Clip partial superpage extents to superpage boundaries. */
-        if ( ((cur_pages & (SUPERPAGE_NR_PFNS-1)) != 0) &&
-             (count > (-cur_pages & (SUPERPAGE_NR_PFNS-1))) )
-            count = -cur_pages & (SUPERPAGE_NR_PFNS-1); /* clip s.p. tail */
-        else if ( ((count & (SUPERPAGE_NR_PFNS-1)) != 0) &&
-                  (count > SUPERPAGE_NR_PFNS) )
-            count &= ~(SUPERPAGE_NR_PFNS - 1); /* clip non-s.p. tail */
-
-        /* Attempt to allocate superpage extents. */
-        if ( ((count | cur_pages) & (SUPERPAGE_NR_PFNS - 1)) == 0 )
-        {
-            long done;
-            xen_pfn_t sp_extents[count >> SUPERPAGE_PFN_SHIFT];
-            struct xen_memory_reservation sp_req = {
-                .nr_extents   = count >> SUPERPAGE_PFN_SHIFT,
-                .extent_order = SUPERPAGE_PFN_SHIFT,
-                .domid        = dom
-            };
-
-            if ( pod_mode )
-                sp_req.mem_flags = XENMEMF_populate_on_demand;
-
-            set_xen_guest_handle(sp_req.extent_start, sp_extents);
-            for ( i = 0; i < sp_req.nr_extents; i++ )
-                sp_extents[i] = page_array[cur_pages+(i<<SUPERPAGE_PFN_SHIFT)];
-            done = xc_memory_op(xc_handle, XENMEM_populate_physmap, &sp_req);
-            if ( done > 0 )
-            {
-                done <<= SUPERPAGE_PFN_SHIFT;
-                if ( pod_mode && target_pages > cur_pages )
-                {
-                    int d = target_pages - cur_pages;
-                    pod_pages += ( done < d ) ? done : d;
-                }
-                cur_pages += done;
-                count -= done;
-            }
-        }
-
-        /* Fall back to 4kB extents. */
-        if ( count != 0 )
-        {
-            rc = xc_domain_memory_populate_physmap(
-                xc_handle, dom, count, 0, 0, &page_array[cur_pages]);
-            cur_pages += count;
-            if ( pod_mode )
-                pod_pages -= count;
-        }
-    }
+    if ( rc == 0 )
+        rc = populate_guest(xc_handle, dom, page_array, nr_pages,
+                            pod_mode, target_pages, &pod_pages);
 
     if ( pod_mode )
         rc = xc_domain_memory_set_pod_target(xc_handle,
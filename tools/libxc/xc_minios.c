@@ -40,6 +40,7 @@ int xc_interface_open(void)
 
 int xc_interface_close(int xc_handle)
 {
+    hcall_buf_free();
     files[xc_handle].type = FTYPE_NONE;
     return 0;
 }
@@ -121,6 +121,86 @@ int xc_perfc_control(int xc_handle,
     return rc;
 }
 
+int xc_lockprof_control(int xc_handle,
+                        uint32_t opcode,
+                        uint32_t *n_elems,
+                        uint64_t *time,
+                        xc_lockprof_data_t *data)
+{
+    int rc;
+    uint32_t max_elem = (n_elems && data) ? *n_elems : 0;
+    DECLARE_SYSCTL;
+
+    sysctl.cmd = XEN_SYSCTL_lockprof_op;
+    sysctl.u.lockprof_op.cmd = opcode;
+    sysctl.u.lockprof_op.max_elem = max_elem;
+    set_xen_guest_handle(sysctl.u.lockprof_op.data, data);
+
+    if ( (max_elem != 0) &&
+         ((rc = lock_pages(data, max_elem * sizeof(*data))) != 0) )
+        return rc;
+
+    rc = do_sysctl(xc_handle, &sysctl);
+
+    if ( max_elem != 0 )
+        unlock_pages(data, max_elem * sizeof(*data));
+
+    if ( n_elems )
+        *n_elems = sysctl.u.lockprof_op.nr_elem;
+    if ( time )
+        *time = sysctl.u.lockprof_op.time;
+
+    return rc;
+}
+
+int xc_sched_stats_control(int xc_handle,
+                           uint32_t opcode,
+                           uint32_t *nr_pcpus,
+                           xc_sched_pcpustats_t *pcpu,
+                           uint32_t *nr_vcpus,
+                           xc_sched_vcpustats_t *vcpu,
+                           uint64_t *time)
+{
+    int rc;
+    uint32_t max_pcpus = (nr_pcpus && pcpu) ? *nr_pcpus : 0;
+    uint32_t max_vcpus = (nr_vcpus && vcpu) ? *nr_vcpus : 0;
+    DECLARE_SYSCTL;
+
+    sysctl.cmd = XEN_SYSCTL_schedstats_op;
+    sysctl.u.schedstats_op.cmd = opcode;
+    sysctl.u.schedstats_op.max_pcpus = max_pcpus;
+    sysctl.u.schedstats_op.max_vcpus = max_vcpus;
+    set_xen_guest_handle(sysctl.u.schedstats_op.pcpu, pcpu);
+    set_xen_guest_handle(sysctl.u.schedstats_op.vcpu, vcpu);
+
+    if ( (max_pcpus != 0) &&
+         ((rc = lock_pages(pcpu, max_pcpus * sizeof(*pcpu))) != 0) )
+        return rc;
+    if ( (max_vcpus != 0) &&
+         ((rc = lock_pages(vcpu, max_vcpus * sizeof(*vcpu))) != 0) )
+        goto unlock_pcpu;
+
+    rc = do_sysctl(xc_handle, &sysctl);
+
+    if ( max_vcpus != 0 )
+        unlock_pages(vcpu, max_vcpus * sizeof(*vcpu));
+ unlock_pcpu:
+    if ( max_pcpus != 0 )
+        unlock_pages(pcpu, max_pcpus * sizeof(*pcpu));
+
+    if ( rc == 0 )
+    {
+        if ( nr_pcpus )
+            *nr_pcpus = sysctl.u.schedstats_op.nr_pcpus;
+        if ( nr_vcpus )
+            *nr_vcpus = sysctl.u.schedstats_op.nr_vcpus;
+        if ( time )
+            *time = sysctl.u.schedstats_op.time;
+    }
+
+    return rc;
+}
+
 int xc_getcpuinfo(int xc_handle, int max_cpus,
                   xc_cpuinfo_t *info, int *nr_cpus)
 {
@@ -53,6 +53,7 @@ int xc_interface_open(void)
 
 int xc_interface_close(int xc_handle)
 {
+    hcall_buf_free();
     return close(xc_handle);
 }
 
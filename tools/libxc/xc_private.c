@@ -16,6 +16,9 @@ static pthread_once_t last_error_pkey_once = PTHREAD_ONCE_INIT;
 static pthread_key_t errbuf_pkey;
 static pthread_once_t errbuf_pkey_once = PTHREAD_ONCE_INIT;
 
+static pthread_key_t hcall_buf_pkey;
+static pthread_once_t hcall_buf_pkey_once = PTHREAD_ONCE_INIT;
+
 #if DEBUG
 static xc_error_handler error_handler = xc_default_error_handler;
 #else
@@ -148,6 +151,176 @@ void unlock_pages(void *addr, size_t len)
 #endif
 }
 
+/*
+ * Hypercall bounce buffers.
+ *
+ * Every hypercall argument must sit in memory that cannot be paged out
+ * while Xen is looking at it.  Locking and unlocking the caller's buffer
+ * around each call costs two system calls and, for small arguments on the
+ * stack, repeatedly pins and unpins the same page.  Instead each thread
+ * keeps a small region that is locked once, on first use, and stays locked
+ * until the thread exits or closes its interface handle.  Small arguments
+ * are copied into that region before the hypercall and back out after it.
+ * Allocations are carved from the region as a stack, so nested arguments
+ * (a reservation and its extent list, say) can be bounced together.
+ * Anything that does not fit falls back to locking the caller's memory.
+ */
+#define HCALL_BUF_PAGES   4
+#define HCALL_BUF_SIZE    (HCALL_BUF_PAGES * PAGE_SIZE)
+#define HCALL_BUF_NEST    8
+#define HCALL_BUF_ALIGN   16
+
+struct hcall_buf {
+    void *buf;                          /* locked region, or NULL */
+    size_t used;                        /* bytes in use from the base */
+    unsigned int nr;                    /* entries in the bounce stack */
+    struct {
+        void *bounce;                   /* address handed to the caller */
+        void *orig;                     /* caller's own buffer */
+        size_t start;                   /* offset of this entry */
+    } stack[HCALL_BUF_NEST];
+};
+
+static void *hcall_buf_memalign(size_t alignment, size_t size)
+{
+#if defined(_POSIX_C_SOURCE) && !defined(__sun__)
+    void *ptr;
+    if ( posix_memalign(&ptr, alignment, size) != 0 )
+        return NULL;
+    return ptr;
+#elif defined(__NetBSD__) || defined(__OpenBSD__)
+    return valloc(size);
+#else
+    return memalign(alignment, size);
+#endif
+}
+
+static void hcall_buf_destroy(struct hcall_buf *hcall_buf)
+{
+    if ( hcall_buf->buf != NULL )
+    {
+        unlock_pages(hcall_buf->buf, HCALL_BUF_SIZE);
+        free(hcall_buf->buf);
+    }
+    free(hcall_buf);
+}
+
+static void
+_xc_clean_hcall_buf(void *m)
+{
+    hcall_buf_destroy(m);
+    pthread_setspecific(hcall_buf_pkey, NULL);
+}
+
+static void
+_xc_init_hcall_buf(void)
+{
+    pthread_key_create(&hcall_buf_pkey, _xc_clean_hcall_buf);
+}
+
+static struct hcall_buf *hcall_buf_get(void)
+{
+    struct hcall_buf *hcall_buf;
+
+    pthread_once(&hcall_buf_pkey_once, _xc_init_hcall_buf);
+
+    hcall_buf = pthread_getspecific(hcall_buf_pkey);
+    if ( hcall_buf != NULL )
+        return hcall_buf;
+
+    hcall_buf = calloc(1, sizeof(*hcall_buf));
+    if ( hcall_buf == NULL )
+        return NULL;
+
+    hcall_buf->buf = hcall_buf_memalign(PAGE_SIZE, HCALL_BUF_SIZE);
+    if ( (hcall_buf->buf != NULL) &&
+         (lock_pages(hcall_buf->buf, HCALL_BUF_SIZE) != 0) )
+    {
+        free(hcall_buf->buf);
+        hcall_buf->buf = NULL;
+    }
+
+    /* Remember a failed setup too, so we do not retry on every call. */
+    pthread_setspecific(hcall_buf_pkey, hcall_buf);
+
+    return hcall_buf;
+}
+
+int hcall_buf_prep(void **addr, size_t len)
+{
+    struct hcall_buf *hcall_buf;
+    size_t start;
+
+    if ( (len == 0) || (len > HCALL_BUF_SIZE) ||
+         ((hcall_buf = hcall_buf_get()) == NULL) ||
+         (hcall_buf->buf == NULL) ||
+         (hcall_buf->nr == HCALL_BUF_NEST) )
+        goto lock;
+
+    start = (hcall_buf->used + HCALL_BUF_ALIGN - 1) & ~(HCALL_BUF_ALIGN - 1);
+    if ( len > (HCALL_BUF_SIZE - start) )
+        goto lock;
+
+    hcall_buf->stack[hcall_buf->nr].bounce = (char *)hcall_buf->buf + start;
+    hcall_buf->stack[hcall_buf->nr].orig   = *addr;
+    hcall_buf->stack[hcall_buf->nr].start  = hcall_buf->used;
+    hcall_buf->nr++;
+    hcall_buf->used = start + len;
+
+    memcpy((char *)hcall_buf->buf + start, *addr, len);
+    *addr = (char *)hcall_buf->buf + start;
+    return 0;
+
+ lock:
+    return lock_pages(*addr, len);
+}
+
+void hcall_buf_release(void **addr, size_t len)
+{
+    struct hcall_buf *hcall_buf;
+    unsigned int i;
+
+    if ( len == 0 )
+        return;
+
+    hcall_buf = (len > HCALL_BUF_SIZE) ? NULL :
+        pthread_getspecific(hcall_buf_pkey);
+    if ( hcall_buf != NULL )
+    {
+        for ( i = hcall_buf->nr; i-- > 0; )
+        {
+            if ( hcall_buf->stack[i].bounce != *addr )
+                continue;
+
+            memcpy(hcall_buf->stack[i].orig, *addr, len);
+            *addr = hcall_buf->stack[i].orig;
+            hcall_buf->stack[i].bounce = NULL;
+
+            /* Pop this entry and any released ones above it. */
+            while ( (hcall_buf->nr != 0) &&
+                    (hcall_buf->stack[hcall_buf->nr - 1].bounce == NULL) )
+                hcall_buf->used = hcall_buf->stack[--hcall_buf->nr].start;
+            return;
+        }
+    }
+
+    unlock_pages(*addr, len);
+}
+
+void hcall_buf_free(void)
+{
+    struct hcall_buf *hcall_buf;
+
+    pthread_once(&hcall_buf_pkey_once, _xc_init_hcall_buf);
+
+    hcall_buf = pthread_getspecific(hcall_buf_pkey);
+    if ( (hcall_buf == NULL) || (hcall_buf->nr != 0) )
+        return;
+
+    hcall_buf_destroy(hcall_buf);
+    pthread_setspecific(hcall_buf_pkey, NULL);
+}
+
 /* NB: arr must be locked */
 int xc_get_pfn_type_batch(int xc_handle,
                           uint32_t dom, int num, uint32_t *arr)
@@ -169,21 +342,21 @@ int xc_mmuext_op(
     DECLARE_HYPERCALL;
     long ret = -EINVAL;
 
+    if ( hcall_buf_prep((void **)&op, nr_ops*sizeof(*op)) != 0 )
+    {
+        PERROR("Could not lock memory for Xen hypercall");
+        goto out1;
+    }
+
     hypercall.op     = __HYPERVISOR_mmuext_op;
     hypercall.arg[0] = (unsigned long)op;
     hypercall.arg[1] = (unsigned long)nr_ops;
     hypercall.arg[2] = (unsigned long)0;
     hypercall.arg[3] = (unsigned long)dom;
 
-    if ( lock_pages(op, nr_ops*sizeof(*op)) != 0 )
-    {
-        PERROR("Could not lock memory for Xen hypercall");
-        goto out1;
-    }
-
     ret = do_xen_hypercall(xc_handle, &hypercall);
 
-    unlock_pages(op, nr_ops*sizeof(*op));
+    hcall_buf_release((void **)&op, nr_ops*sizeof(*op));
 
  out1:
     return ret;
@@ -192,24 +365,26 @@ int xc_mmuext_op(
 static int flush_mmu_updates(int xc_handle, struct xc_mmu *mmu)
 {
     int err = 0;
+    void *updates = mmu->updates;
+    size_t len = mmu->idx * sizeof(mmu->updates[0]);
     DECLARE_HYPERCALL;
 
     if ( mmu->idx == 0 )
         return 0;
 
-    hypercall.op     = __HYPERVISOR_mmu_update;
-    hypercall.arg[0] = (unsigned long)mmu->updates;
-    hypercall.arg[1] = (unsigned long)mmu->idx;
-    hypercall.arg[2] = 0;
-    hypercall.arg[3] = mmu->subject;
-
-    if ( lock_pages(mmu->updates, sizeof(mmu->updates)) != 0 )
+    if ( hcall_buf_prep(&updates, len) != 0 )
     {
         PERROR("flush_mmu_updates: mmu updates lock_pages failed");
         err = 1;
         goto out;
     }
 
+    hypercall.op     = __HYPERVISOR_mmu_update;
+    hypercall.arg[0] = (unsigned long)updates;
+    hypercall.arg[1] = (unsigned long)mmu->idx;
+    hypercall.arg[2] = 0;
+    hypercall.arg[3] = mmu->subject;
+
     if ( do_xen_hypercall(xc_handle, &hypercall) < 0 )
     {
         ERROR("Failure when submitting mmu updates");
@@ -218,7 +393,7 @@ static int flush_mmu_updates(int xc_handle, struct xc_mmu *mmu)
 
     mmu->idx = 0;
 
-    unlock_pages(mmu->updates, sizeof(mmu->updates));
+    hcall_buf_release(&updates, len);
 
  out:
     return err;
@@ -256,109 +431,109 @@ int xc_memory_op(int xc_handle,
                  void *arg)
 {
     DECLARE_HYPERCALL;
-    struct xen_memory_reservation *reservation = arg;
-    struct xen_machphys_mfn_list *xmml = arg;
-    xen_pfn_t *extent_start;
+    struct xen_memory_reservation *reservation;
+    struct xen_machphys_mfn_list *xmml;
+    xen_pfn_t *extent_start, *orig_extent_start = NULL;
+    size_t argsize = 0, extsize = 0;
     long ret = -EINVAL;
 
-    hypercall.op     = __HYPERVISOR_memory_op;
-    hypercall.arg[0] = (unsigned long)cmd;
-    hypercall.arg[1] = (unsigned long)arg;
-
     switch ( cmd )
     {
     case XENMEM_increase_reservation:
     case XENMEM_decrease_reservation:
     case XENMEM_populate_physmap:
-        if ( lock_pages(reservation, sizeof(*reservation)) != 0 )
-        {
-            PERROR("Could not lock");
-            goto out1;
-        }
-        get_xen_guest_handle(extent_start, reservation->extent_start);
-        if ( (extent_start != NULL) &&
-             (lock_pages(extent_start,
-                    reservation->nr_extents * sizeof(xen_pfn_t)) != 0) )
-        {
-            PERROR("Could not lock");
-            unlock_pages(reservation, sizeof(*reservation));
-            goto out1;
-        }
+        argsize = sizeof(*reservation);
         break;
     case XENMEM_machphys_mfn_list:
-        if ( lock_pages(xmml, sizeof(*xmml)) != 0 )
-        {
-            PERROR("Could not lock");
-            goto out1;
-        }
-        get_xen_guest_handle(extent_start, xmml->extent_start);
-        if ( lock_pages(extent_start,
-                   xmml->max_extents * sizeof(xen_pfn_t)) != 0 )
-        {
-            PERROR("Could not lock");
-            unlock_pages(xmml, sizeof(*xmml));
-            goto out1;
-        }
+        argsize = sizeof(*xmml);
         break;
     case XENMEM_add_to_physmap:
-        if ( lock_pages(arg, sizeof(struct xen_add_to_physmap)) )
-        {
-            PERROR("Could not lock");
-            goto out1;
-        }
+        argsize = sizeof(struct xen_add_to_physmap);
         break;
     case XENMEM_current_reservation:
     case XENMEM_maximum_reservation:
     case XENMEM_maximum_gpfn:
-        if ( lock_pages(arg, sizeof(domid_t)) )
-        {
-            PERROR("Could not lock");
-            goto out1;
-        }
+        argsize = sizeof(domid_t);
         break;
     case XENMEM_set_pod_target:
     case XENMEM_get_pod_target:
-        if ( lock_pages(arg, sizeof(struct xen_pod_target)) )
-        {
-            PERROR("Could not lock");
-            goto out1;
-        }
+        argsize = sizeof(struct xen_pod_target);
         break;
     }
 
-    ret = do_xen_hypercall(xc_handle, &hypercall);
+    if ( (argsize != 0) && (hcall_buf_prep(&arg, argsize) != 0) )
+    {
+        PERROR("Could not lock");
+        goto out1;
+    }
 
+    /*
+     * The extent list is referenced from within the (possibly bounced)
+     * argument, so it is bounced separately and the handle in the copy
+     * is redirected.  The caller's own structure is never modified.
+     */
+    reservation = arg;
+    xmml = arg;
     switch ( cmd )
     {
     case XENMEM_increase_reservation:
     case XENMEM_decrease_reservation:
     case XENMEM_populate_physmap:
-        unlock_pages(reservation, sizeof(*reservation));
-        get_xen_guest_handle(extent_start, reservation->extent_start);
-        if ( extent_start != NULL )
-            unlock_pages(extent_start,
-                         reservation->nr_extents * sizeof(xen_pfn_t));
+        get_xen_guest_handle(orig_extent_start, reservation->extent_start);
+        if ( orig_extent_start != NULL )
+            extsize = reservation->nr_extents * sizeof(xen_pfn_t);
         break;
     case XENMEM_machphys_mfn_list:
-        unlock_pages(xmml, sizeof(*xmml));
-        get_xen_guest_handle(extent_start, xmml->extent_start);
-        unlock_pages(extent_start,
-                     xmml->max_extents * sizeof(xen_pfn_t));
+        get_xen_guest_handle(orig_extent_start, xmml->extent_start);
+        extsize = xmml->max_extents * sizeof(xen_pfn_t);
         break;
-    case XENMEM_add_to_physmap:
-        unlock_pages(arg, sizeof(struct xen_add_to_physmap));
+    }
+
+    extent_start = orig_extent_start;
+    if ( (extsize != 0) &&
+         (hcall_buf_prep((void **)&extent_start, extsize) != 0) )
+    {
+        PERROR("Could not lock");
+        hcall_buf_release(&arg, argsize);
+        goto out1;
+    }
+
+    switch ( cmd )
+    {
+    case XENMEM_increase_reservation:
+    case XENMEM_decrease_reservation:
+    case XENMEM_populate_physmap:
+        set_xen_guest_handle(reservation->extent_start, extent_start);
         break;
-    case XENMEM_current_reservation:
-    case XENMEM_maximum_reservation:
-    case XENMEM_maximum_gpfn:
-        unlock_pages(arg, sizeof(domid_t));
+    case XENMEM_machphys_mfn_list:
+        set_xen_guest_handle(xmml->extent_start, extent_start);
         break;
-    case XENMEM_set_pod_target:
-    case XENMEM_get_pod_target:
-        unlock_pages(arg, sizeof(struct xen_pod_target));
+    }
+
+    hypercall.op     = __HYPERVISOR_memory_op;
+    hypercall.arg[0] = (unsigned long)cmd;
+    hypercall.arg[1] = (unsigned long)arg;
+
+    ret = do_xen_hypercall(xc_handle, &hypercall);
+
+    if ( extsize != 0 )
+        hcall_buf_release((void **)&extent_start, extsize);
+
+    switch ( cmd )
+    {
+    case XENMEM_increase_reservation:
+    case XENMEM_decrease_reservation:
+    case XENMEM_populate_physmap:
+        set_xen_guest_handle(reservation->extent_start, orig_extent_start);
+        break;
+    case XENMEM_machphys_mfn_list:
+        set_xen_guest_handle(xmml->extent_start, orig_extent_start);
         break;
     }
 
+    if ( argsize != 0 )
+        hcall_buf_release(&arg, argsize);
+
  out1:
     return ret;
 }
@@ -480,7 +655,7 @@ int xc_version(int xc_handle, int cmd, void *arg)
         break;
     }
 
-    if ( (argsize != 0) && (lock_pages(arg, argsize) != 0) )
+    if ( (argsize != 0) && (hcall_buf_prep(&arg, argsize) != 0) )
     {
         PERROR("Could not lock memory for version hypercall");
         return -ENOMEM;
@@ -494,7 +669,7 @@ int xc_version(int xc_handle, int cmd, void *arg)
     rc = do_xen_version(xc_handle, cmd, arg);
 
     if ( argsize != 0 )
-        unlock_pages(arg, argsize);
+        hcall_buf_release(&arg, argsize);
 
     return rc;
 }
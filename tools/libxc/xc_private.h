@@ -81,6 +81,18 @@ void xc_set_error(int code, const char *fmt, ...);
 int lock_pages(void *addr, size_t len);
 void unlock_pages(void *addr, size_t len);
 
+/*
+ * Make *addr safe to pass to Xen.  Small buffers are copied into a
+ * per-thread region that stays locked across calls, and *addr is pointed
+ * at the copy; larger ones are locked in place.  hcall_buf_release()
+ * copies any results back, restores *addr and drops the lock.  Nested
+ * buffers must be released in the reverse order they were prepared.
+ */
+int hcall_buf_prep(void **addr, size_t len);
+void hcall_buf_release(void **addr, size_t len);
+/* Drop the calling thread's locked region, e.g. on handle close. */
+void hcall_buf_free(void);
+
 static inline void safe_munlock(const void *addr, size_t len)
 {
     int saved_errno = errno;
@@ -137,14 +149,14 @@ static inline int do_domctl(int xc_handle, struct xen_domctl *domctl)
     domctl->interface_version = XEN_DOMCTL_INTERFACE_VERSION;
 
     hypercall.op     = __HYPERVISOR_domctl;
-    hypercall.arg[0] = (unsigned long)domctl;
-
-    if ( lock_pages(domctl, sizeof(*domctl)) != 0 )
+    if ( hcall_buf_prep((void **)&domctl, sizeof(*domctl)) != 0 )
     {
         PERROR("Could not lock memory for Xen hypercall");
         goto out1;
     }
 
+    hypercall.arg[0] = (unsigned long)domctl;
+
     if ( (ret = do_xen_hypercall(xc_handle, &hypercall)) < 0 )
     {
         if ( errno == EACCES )
@@ -152,7 +164,7 @@ static inline int do_domctl(int xc_handle, struct xen_domctl *domctl)
                     " rebuild the user-space tool set?\n");
     }
 
-    unlock_pages(domctl, sizeof(*domctl));
+    hcall_buf_release((void **)&domctl, sizeof(*domctl));
 
  out1:
     return ret;
@@ -166,14 +178,14 @@ static inline int do_sysctl(int xc_handle, struct xen_sysctl *sysctl)
     sysctl->interface_version = XEN_SYSCTL_INTERFACE_VERSION;
 
     hypercall.op     = __HYPERVISOR_sysctl;
-    hypercall.arg[0] = (unsigned long)sysctl;
-
-    if ( lock_pages(sysctl, sizeof(*sysctl)) != 0 )
+    if ( hcall_buf_prep((void **)&sysctl, sizeof(*sysctl)) != 0 )
     {
         PERROR("Could not lock memory for Xen hypercall");
         goto out1;
     }
 
+    hypercall.arg[0] = (unsigned long)sysctl;
+
     if ( (ret = do_xen_hypercall(xc_handle, &hypercall)) < 0 )
     {
         if ( errno == EACCES )
@@ -181,7 +193,7 @@ static inline int do_sysctl(int xc_handle, struct xen_sysctl *sysctl)
                     " rebuild the user-space tool set?\n");
     }
 
-    unlock_pages(sysctl, sizeof(*sysctl));
+    hcall_buf_release((void **)&sysctl, sizeof(*sysctl));
 
  out1:
     return ret;
@@ -11,6 +11,7 @@
 #include "xc_ptrace.h"
 #include <time.h>
 #include <inttypes.h>
+#include <zlib.h>
 
 static unsigned int    max_nr_vcpus;
 static unsigned long  *cr3;
@@ -31,9 +32,9 @@ ptrace_core_get_vcpu_ctxt(unsigned int nr_vcpus)
         new = realloc(what, nr_vcpus * sizeof(*what)); \
         if (!new) \
             return NULL; \
+        what = new; \
         memset(what + max_nr_vcpus, 0, \
-              (nr_vcpus - max_nr_vcpus) * sizeof(*what)); \
-        what = new
+              (nr_vcpus - max_nr_vcpus) * sizeof(*what))
 
         REALLOC(cr3);
         REALLOC(cr3_phys);
@@ -375,7 +376,7 @@ elf_core_shdr_by_name(struct elf_core* ecore, const char* name)
          s += ecore->ehdr.e_shentsize) {
         Elf64_Shdr* shdr = (Elf64_Shdr*)s;
 
-        if (strncmp(ecore->shstrtab + shdr->sh_name, name, strlen(name)) == 0)
+        if (strcmp(ecore->shstrtab + shdr->sh_name, name) == 0)
             return shdr;
     }
 
@@ -411,16 +412,29 @@ static uint64_t pfn_array_size = 0;
 static long nr_pages = 0;
 static uint64_t pages_offset;
 
+/* for .xen_pages_zlib: where each chunk starts, and the last one inflated */
+struct zchunk {
+    unsigned long first_page;
+    uint32_t nr_pages;
+    uint32_t zlen;
+    uint64_t offset;
+};
+static struct zchunk* zchunks = NULL;
+static unsigned long nr_zchunks = 0;
+static char* zchunk_cache = NULL;
+static long zchunk_cached = -1;
+
 static const struct xen_dumpcore_elfnote_format_version_desc
 known_format_version[] =
 {
     {XEN_DUMPCORE_FORMAT_VERSION((uint64_t)0, (uint64_t)1)},
+    {XEN_DUMPCORE_FORMAT_VERSION((uint64_t)0, (uint64_t)2)},
 };
 #define KNOWN_FORMAT_VERSION_NR \
     (sizeof(known_format_version)/sizeof(known_format_version[0]))
 
-static unsigned long
-map_gmfn_to_offset_elf(unsigned long gmfn)
+static long
+map_gmfn_to_index_elf(unsigned long gmfn)
 {
     /* 
      * linear search
@@ -428,30 +442,133 @@ map_gmfn_to_offset_elf(unsigned long gmfn)
     unsigned long i;
     if (current_is_auto_translated_physmap) {
         if (pfn_array == NULL)
-            return 0;
+            return -1;
         for (i = 0; i < pfn_array_size; i++) {
             if (pfn_array[i] == gmfn) {
-                return pages_offset + (i << PAGE_SHIFT);
+                return i;
             }
         }
     } else {
         if (p2m_array == NULL)
-            return 0;
+            return -1;
         for (i = 0; i < p2m_array_size; i++) {
             if (p2m_array[i].gmfn == gmfn) {
-                return pages_offset + (i << PAGE_SHIFT);
+                return i;
             }
         }
     }
+    return -1;
+}
+
+/* Walk the chunk headers of .xen_pages_zlib once to index them. */
+static int
+zchunk_index_elf(int domfd, const Elf64_Shdr* shdr)
+{
+    struct xen_dumpcore_zchunk hdr;
+    uint64_t off = 0;
+    unsigned long page = 0;
+    struct zchunk* z;
+
+    free(zchunks);
+    zchunks = NULL;
+    nr_zchunks = 0;
+    zchunk_cached = -1;
+    if (zchunk_cache == NULL &&
+        (zchunk_cache = malloc(XEN_DUMPCORE_ZCHUNK_PAGES * PAGE_SIZE)) == NULL)
+        return -1;
+
+    while (off < shdr->sh_size) {
+        if (pread_exact(domfd, &hdr, sizeof(hdr), shdr->sh_offset + off) < 0)
+            return -1;
+        if (hdr.nr_pages == 0 || hdr.nr_pages > XEN_DUMPCORE_ZCHUNK_PAGES)
+            return -1;
+        z = realloc(zchunks, (nr_zchunks + 1) * sizeof(*zchunks));
+        if (z == NULL)
+            return -1;
+        zchunks = z;
+        z += nr_zchunks++;
+        z->first_page = page;
+        z->nr_pages = hdr.nr_pages;
+        z->zlen = hdr.zlen;
+        z->offset = shdr->sh_offset + off + sizeof(hdr);
+        page += hdr.nr_pages;
+        off += sizeof(hdr) + hdr.zlen;
+    }
+    return (page == nr_pages) ? 0 : -1;
+}
+
+static int
+zchunk_read_elf(int domfd, unsigned long idx, char* buf)
+{
+    unsigned long lo = 0, hi = nr_zchunks, c;
+    struct zchunk* z;
+    uLongf len;
+    char* zbuf;
+
+    if (nr_zchunks == 0)
+        return -1;
+    while (hi - lo > 1) {
+        c = (lo + hi) / 2;
+        if (zchunks[c].first_page <= idx)
+            lo = c;
+        else
+            hi = c;
+    }
+    z = &zchunks[lo];
+
+    if (zchunk_cached != (long)lo) {
+        zchunk_cached = -1;
+        if ((zbuf = malloc(z->zlen)) == NULL)
+            return -1;
+        len = z->nr_pages * PAGE_SIZE;
+        if (pread_exact(domfd, zbuf, z->zlen, z->offset) < 0 ||
+            uncompress((Bytef*)zchunk_cache, &len,
+                       (Bytef*)zbuf, z->zlen) != Z_OK ||
+            len != z->nr_pages * PAGE_SIZE) {
+            free(zbuf);
+            return -1;
+        }
+        free(zbuf);
+        zchunk_cached = lo;
+    }
+    memcpy(buf, zchunk_cache + ((idx - z->first_page) << PAGE_SHIFT),
+           PAGE_SIZE);
     return 0;
 }
 
+/*
+ * Map a page of the dump.  Returns NULL if gmfn isn't in the dump and
+ * MAP_FAILED if it is but couldn't be mapped.  Compressed pages are
+ * inflated into anonymous memory, so either way munmap() releases them.
+ */
+static void *
+map_gmfn_elf(unsigned long domfd, unsigned long gmfn)
+{
+    long idx = map_gmfn_to_index_elf(gmfn);
+    void *v;
+
+    if (idx < 0)
+        return NULL;
+    if (zchunks == NULL)
+        return mmap(NULL, PAGE_SIZE, PROT_READ, MAP_PRIVATE, domfd,
+                    pages_offset + ((unsigned long)idx << PAGE_SHIFT));
+
+    v = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (v == MAP_FAILED)
+        return v;
+    if (zchunk_read_elf(domfd, idx, v) < 0) {
+        munmap(v, PAGE_SIZE);
+        return MAP_FAILED;
+    }
+    return v;
+}
+
 static void *
 map_domain_va_core_elf(unsigned long domfd, int cpu, void *guest_va)
 {
     unsigned long pde, page;
     unsigned long va = (unsigned long)guest_va;
-    unsigned long offset;
     void *v;
 
     if (cr3[cpu] != cr3_phys[cpu])
@@ -462,10 +579,9 @@ map_domain_va_core_elf(unsigned long domfd, int cpu, void *guest_va)
             cr3_virt[cpu] = NULL;
             cr3_phys[cpu] = 0;
         }
-        offset = map_gmfn_to_offset_elf(xen_cr3_to_pfn(cr3[cpu]));
-        if (offset == 0)
+        v = map_gmfn_elf(domfd, xen_cr3_to_pfn(cr3[cpu]));
+        if (v == NULL)
             return NULL;
-        v = mmap(NULL, PAGE_SIZE, PROT_READ, MAP_PRIVATE, domfd, offset);
         if (v == MAP_FAILED)
         {
             perror("mmap failed");
@@ -484,11 +600,8 @@ map_domain_va_core_elf(unsigned long domfd, int cpu, void *guest_va)
             pde_virt[cpu] = NULL;
             pde_phys[cpu] = 0;
         }
-        offset = map_gmfn_to_offset_elf(pde >> PAGE_SHIFT);
-        if (offset == 0)
-            return NULL;
-        v = mmap(NULL, PAGE_SIZE, PROT_READ, MAP_PRIVATE, domfd, offset);
-        if (v == MAP_FAILED)
+        v = map_gmfn_elf(domfd, pde >> PAGE_SHIFT);
+        if (v == NULL || v == MAP_FAILED)
             return NULL;
         pde_phys[cpu] = pde;
         pde_virt[cpu] = v;
@@ -503,10 +616,9 @@ map_domain_va_core_elf(unsigned long domfd, int cpu, void *guest_va)
             page_virt[cpu] = NULL;
             page_phys[cpu] = 0;
         }
-        offset = map_gmfn_to_offset_elf(page >> PAGE_SHIFT);
-        if (offset == 0)
+        v = map_gmfn_elf(domfd, page >> PAGE_SHIFT);
+        if (v == NULL)
             return NULL;
-        v = mmap(NULL, PAGE_SIZE, PROT_READ, MAP_PRIVATE, domfd, offset);
         if (v == MAP_FAILED)
         {
             IPRINTF("cr3 %lx pde %lx page %lx pti %lx\n",
@@ -625,6 +737,17 @@ xc_waitdomain_core_elf(
     if (table_shdr->sh_size / table_shdr->sh_entsize != nr_pages)
         goto out;
 
+    /* pages may be compressed instead: index the chunks */
+    free(zchunks);
+    zchunks = NULL;
+    pages_shdr = elf_core_shdr_by_name(&ecore, XEN_DUMPCORE_SEC_PAGES_ZLIB);
+    if (pages_shdr != NULL) {
+        if (zchunk_index_elf(domfd, pages_shdr) < 0)
+            goto out;
+        elf_core_free(&ecore);
+        return 0;
+    }
+
     /* pages_offset and check the file size */
     pages_shdr = elf_core_shdr_by_name(&ecore, XEN_DUMPCORE_SEC_PAGES);
     if (pages_shdr == NULL)
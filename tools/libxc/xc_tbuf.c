@@ -57,6 +57,33 @@ int xc_tbuf_get_size(int xc_handle, unsigned long *size)
     return rc;
 }
 
+int xc_tbuf_set_format(int xc_handle, uint32_t format)
+{
+    DECLARE_SYSCTL;
+
+    sysctl.cmd = XEN_SYSCTL_tbuf_op;
+    sysctl.interface_version = XEN_SYSCTL_INTERFACE_VERSION;
+    sysctl.u.tbuf_op.cmd    = XEN_SYSCTL_TBUFOP_set_format;
+    sysctl.u.tbuf_op.format = format;
+
+    return xc_sysctl(xc_handle, &sysctl);
+}
+
+int xc_tbuf_get_format(int xc_handle, uint32_t *format)
+{
+    int rc;
+    DECLARE_SYSCTL;
+
+    sysctl.cmd = XEN_SYSCTL_tbuf_op;
+    sysctl.interface_version = XEN_SYSCTL_INTERFACE_VERSION;
+    sysctl.u.tbuf_op.cmd  = XEN_SYSCTL_TBUFOP_get_info;
+
+    rc = xc_sysctl(xc_handle, &sysctl);
+    if (rc == 0)
+        *format = sysctl.u.tbuf_op.format;
+    return rc;
+}
+
 int xc_tbuf_enable(int xc_handle, unsigned long pages, unsigned long *mfn,
                    unsigned long *size)
 {
@@ -122,6 +149,44 @@ int xc_tbuf_set_cpu_mask(int xc_handle, uint32_t mask)
     return ret;
 }
 
+int xc_tbuf_set_highwater(int xc_handle, uint32_t cpu_mask,
+                          uint32_t percent)
+{
+    DECLARE_SYSCTL;
+    int ret = -1;
+    uint64_t mask64 = cpu_mask;
+    uint8_t bytemap[sizeof(mask64)];
+
+    sysctl.cmd = XEN_SYSCTL_tbuf_op;
+    sysctl.interface_version = XEN_SYSCTL_INTERFACE_VERSION;
+    sysctl.u.tbuf_op.cmd  = XEN_SYSCTL_TBUFOP_set_highwater;
+    sysctl.u.tbuf_op.highwater = percent;
+
+    if ( cpu_mask == 0 )
+    {
+        set_xen_guest_handle(sysctl.u.tbuf_op.cpu_mask.bitmap, NULL);
+        return do_sysctl(xc_handle, &sysctl);
+    }
+
+    bitmap_64_to_byte(bytemap, &mask64, sizeof (mask64) * 8);
+
+    set_xen_guest_handle(sysctl.u.tbuf_op.cpu_mask.bitmap, bytemap);
+    sysctl.u.tbuf_op.cpu_mask.nr_cpus = sizeof(bytemap) * 8;
+
+    if ( lock_pages(&bytemap, sizeof(bytemap)) != 0 )
+    {
+        PERROR("Could not lock memory for Xen hypercall");
+        goto out;
+    }
+
+    ret = do_sysctl(xc_handle, &sysctl);
+
+    unlock_pages(&bytemap, sizeof(bytemap));
+
+ out:
+    return ret;
+}
+
 int xc_tbuf_set_evt_mask(int xc_handle, uint32_t mask)
 {
     DECLARE_SYSCTL;
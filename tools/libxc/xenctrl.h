@@ -207,6 +207,9 @@ int xc_domain_create(int xc_handle,
 
 /* Functions to produce a dump of a given domain
  *  xc_domain_dumpcore - produces a dump to a specified file
+ *  xc_domain_dumpcore_compressed - produces a dump to a specified file with
+ *                                  guest memory zlib compressed by
+ *                                  nr_threads threads (0: one per cpu)
  *  xc_domain_dumpcore_via_callback - produces a dump, using a specified
  *                                    callback function
  */
@@ -214,6 +217,11 @@ int xc_domain_dumpcore(int xc_handle,
                        uint32_t domid,
                        const char *corename);
 
+int xc_domain_dumpcore_compressed(int xc_handle,
+                                  uint32_t domid,
+                                  const char *corename,
+                                  unsigned int nr_threads);
+
 /* Define the callback function type for xc_domain_dumpcore_via_callback.
  *
  * This function is called by the coredump code for every "write",
@@ -362,6 +370,31 @@ int xc_domain_getinfolist(int xc_handle,
                           unsigned int max_domains,
                           xc_domaininfo_t *info);
 
+typedef xen_sysctl_domstats_t xc_domstats_t;
+typedef xen_sysctl_vcpustats_t xc_vcpustats_t;
+
+/**
+ * This function returns information about one or more domains and all of
+ * their vcpus, using a single hypercall.  The buffer is filled with an
+ * xc_domstats_t for each domain, each immediately followed by nr_vcpus
+ * xc_vcpustats_t records.
+ *
+ * @parm xc_handle a handle to an open hypervisor interface
+ * @parm first_domain the first domain to enumerate information from
+ * @parm buf the buffer to fill
+ * @parm size the size of buf in bytes
+ * @parm used set to the number of bytes filled in
+ * @parm next_domain set to the domain to continue from, or
+ *                   DOMID_FIRST_RESERVED if all domains were returned
+ * @return the number of domains enumerated or -1 on error
+ */
+int xc_domain_getstats(int xc_handle,
+                       uint32_t first_domain,
+                       void *buf,
+                       unsigned int size,
+                       unsigned int *used,
+                       uint32_t *next_domain);
+
 /**
  * This function returns information about the context of a hvm domain
  * @parm xc_handle a handle to an open hypervisor interface
@@ -448,6 +481,23 @@ int xc_shadow_control(int xc_handle,
                       uint32_t mode,
                       xc_shadow_op_stats_t *stats);
 
+typedef xen_domctl_shadow_op_range_t xc_shadow_op_range_t;
+/*
+ * Fetch the dirty pfns in [begin_pfn, begin_pfn + *pages) as a list of up
+ * to *nr_ranges ranges (sop is XEN_DOMCTL_SHADOW_OP_{PEEK,CLEAN}_RANGES).
+ * On return *nr_ranges holds the number of ranges written and *pages the
+ * number of pfns examined, which is smaller than requested if the list
+ * filled up.
+ */
+int xc_shadow_dirty_ranges(int xc_handle,
+                           uint32_t domid,
+                           unsigned int sop,
+                           unsigned long begin_pfn,
+                           unsigned long *pages,
+                           xc_shadow_op_range_t *ranges,
+                           unsigned int *nr_ranges,
+                           xc_shadow_op_stats_t *stats);
+
 int xc_sedf_domain_set(int xc_handle,
                        uint32_t domid,
                        uint64_t period, uint64_t slice,
@@ -468,6 +518,14 @@ int xc_sched_credit_domain_get(int xc_handle,
                                uint32_t domid,
                                struct xen_domctl_sched_credit *sdom);
 
+int xc_sched_credit2_domain_set(int xc_handle,
+                                uint32_t domid,
+                                struct xen_domctl_sched_credit2 *sdom);
+
+int xc_sched_credit2_domain_get(int xc_handle,
+                                uint32_t domid,
+                                struct xen_domctl_sched_credit2 *sdom);
+
 /**
  * This function sends a trigger to a domain.
  *
@@ -526,6 +584,29 @@ int xc_evtchn_reset(int xc_handle,
 typedef struct evtchn_status xc_evtchn_status_t;
 int xc_evtchn_status(int xc_handle, xc_evtchn_status_t *status);
 
+/*
+ * Notify, or unmask, each of @nr_ports event channels of the calling
+ * domain in a single hypercall.  Wakeups due to the same physical CPU
+ * share an IPI.
+ *
+ * Unlike xc_evtchn_notify() and xc_evtchn_unmask(), these take a handle
+ * from xc_interface_open(), not from xc_evtchn_open(); the ports may
+ * however have been bound through either.
+ *
+ * @parm xc_handle a handle to an open hypervisor interface
+ * @parm ports the event channels to notify or unmask
+ * @parm nr_ports the number of entries in @ports
+ * @return 0 on success, -1 on failure, in which case errno will be set
+ *         appropriately and the ports before the failing one will have
+ *         been processed
+ */
+int xc_evtchn_send_batch(int xc_handle,
+                         evtchn_port_t *ports,
+                         unsigned int nr_ports);
+int xc_evtchn_unmask_batch(int xc_handle,
+                           evtchn_port_t *ports,
+                           unsigned int nr_ports);
+
 /*
  * Return a handle to the event channel driver, or -1 on failure, in which case
  * errno will be set appropriately.
@@ -698,6 +779,38 @@ int xc_perfc_control(int xc_handle,
                      int *nbr_desc,
                      int *nbr_val);
 
+typedef xen_sysctl_lockprof_data_t xc_lockprof_data_t;
+/*
+ * Reset or query the hypervisor's spinlock profile.  For a query, @n_elems
+ * holds the number of records @data has room for on entry and the number
+ * of profiled locks on return; @time receives the length of the
+ * measurement period in nanoseconds.  Requires a lock_profile=y build.
+ */
+int xc_lockprof_control(int xc_handle,
+                        uint32_t opcode,
+                        uint32_t *n_elems,
+                        uint64_t *time,
+                        xc_lockprof_data_t *data);
+
+typedef xen_sysctl_sched_pcpustats_t xc_sched_pcpustats_t;
+typedef xen_sysctl_sched_vcpustats_t xc_sched_vcpustats_t;
+/*
+ * Reset or query the scheduler statistics.  For a query, @nr_pcpus and
+ * @nr_vcpus hold the number of records @pcpu and @vcpu have room for on
+ * entry (either buffer may be NULL) and the number of online CPUs and of
+ * vCPUs in all domains on return; @time receives the nanoseconds since
+ * the last reset.  Histogram bucket 0 counts zeroes, bucket i counts values
+ * in [2^(i-1), 2^i) and the last bucket everything larger; wake latencies
+ * are in microseconds.
+ */
+int xc_sched_stats_control(int xc_handle,
+                           uint32_t opcode,
+                           uint32_t *nr_pcpus,
+                           xc_sched_pcpustats_t *pcpu,
+                           uint32_t *nr_vcpus,
+                           xc_sched_vcpustats_t *vcpu,
+                           uint64_t *time);
+
 /**
  * Memory maps a range within one domain to a local address range.  Mappings
  * should be unmapped with munmap and should follow the same rules as mmap
@@ -831,10 +944,43 @@ int xc_tbuf_set_size(int xc_handle, unsigned long size);
  */
 int xc_tbuf_get_size(int xc_handle, unsigned long *size);
 
+/**
+ * This function selects the timestamp layout of trace records
+ * (XEN_SYSCTL_TBUF_FORMAT_*).  Like the size, it can only be changed
+ * before the trace buffers have been allocated; afterwards only a request
+ * for the current format succeeds.
+ *
+ * @parm xc_handle a handle to an open hypervisor interface
+ * @parm format the record format to use
+ * @return 0 on success, -1 on failure.
+ */
+int xc_tbuf_set_format(int xc_handle, uint32_t format);
+
+/**
+ * This function retrieves the record format of the trace buffers.
+ *
+ * @parm xc_handle a handle to an open hypervisor interface
+ * @parm format will contain the XEN_SYSCTL_TBUF_FORMAT_* in use
+ * @return 0 on success, -1 on failure.
+ */
+int xc_tbuf_get_format(int xc_handle, uint32_t *format);
+
 int xc_tbuf_set_cpu_mask(int xc_handle, uint32_t mask);
 
 int xc_tbuf_set_evt_mask(int xc_handle, uint32_t mask);
 
+/**
+ * This function sets the fill level at which Xen notifies the trace
+ * consumer (VIRQ_TBUF) about a CPU's trace buffer.
+ *
+ * @parm xc_handle a handle to an open hypervisor interface
+ * @parm cpu_mask the CPUs to apply the setting to, 0 for all CPUs
+ * @parm percent the high water mark, in percent (1-100) of a buffer
+ * @return 0 on success, -1 on failure.
+ */
+int xc_tbuf_set_highwater(int xc_handle, uint32_t cpu_mask,
+                          uint32_t percent);
+
 int xc_domctl(int xc_handle, struct xen_domctl *domctl);
 int xc_sysctl(int xc_handle, struct xen_sysctl *sysctl);
 
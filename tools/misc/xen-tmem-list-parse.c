@@ -110,6 +110,10 @@ void parse_global(char *s)
     unsigned long long rtree_node_max = parse(s,"Nm");
     unsigned long long pgp_count = parse(s,"Pc");
     unsigned long long pgp_max = parse(s,"Pm");
+    unsigned long long pcd_count = parse(s,"Dc");
+    unsigned long long pcd_max = parse(s,"Dm");
+    unsigned long long dedup_hits = parse(s,"Dh");
+    unsigned long long dedup_misses = parse(s,"Dx");
 
     printf("total tmem ops=%llu (errors=%llu) -- tmem pages avail=%llu\n",
            total_ops, errored_ops, avail_pages);
@@ -125,6 +129,9 @@ void parse_global(char *s)
            evicted_pgs, evict_attempts, relinq_pgs, relinq_attempts,
            max_evicts_per_relinq, total_flush_pool,
            global_eph_count, global_eph_max);
+    if ( dedup_hits || dedup_misses )
+        printf("dedup: shared data=%llu (max=%llu) hits=%llu misses=%llu\n",
+               pcd_count, pcd_max, dedup_hits, dedup_misses);
 }
 
 #define PARSE_CYC_COUNTER(s,x,prefix) unsigned long long \
@@ -0,0 +1,151 @@
+/******************************************************************************
+ * xenlockprof.c
+ *
+ * Print or reset the hypervisor's spinlock profile.  Requires a hypervisor
+ * built with lock_profile=y.
+ *
+ * Usage: xenlockprof [-r] [-s]
+ *   -r : reset all profile data
+ *   -s : sort locks by total time spent waiting for them
+ */
+
+#include <xenctrl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+
+static int cmp_block_time(const void *a, const void *b)
+{
+    const xc_lockprof_data_t *da = a, *db = b;
+
+    if ( da->block_time == db->block_time )
+        return 0;
+    return (da->block_time < db->block_time) ? 1 : -1;
+}
+
+static void usage(const char *prog)
+{
+    printf("%s: [-r] [-s]\n", prog);
+    printf("no args: print lock profile data\n");
+    printf("    -r : reset profile data\n");
+    printf("    -s : sort by time spent waiting for the lock\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int               xc_handle, opt, sort = 0;
+    uint32_t          i, j, n;
+    uint64_t          time;
+    double            l, b, sl, sb;
+    char              name[100];
+    xc_lockprof_data_t *data;
+
+    while ( (opt = getopt(argc, argv, "rsh")) != -1 )
+    {
+        switch ( opt )
+        {
+        case 'r':
+            if ( (xc_handle = xc_interface_open()) == -1 )
+                goto open_err;
+            if ( xc_lockprof_control(xc_handle, XEN_SYSCTL_LOCKPROF_reset,
+                                     NULL, NULL, NULL) != 0 )
+            {
+                fprintf(stderr, "Error reseting profile data: %d (%s)\n",
+                        errno, strerror(errno));
+                return 1;
+            }
+            return 0;
+        case 's':
+            sort = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    if ( (xc_handle = xc_interface_open()) == -1 )
+        goto open_err;
+
+    n = 0;
+    if ( xc_lockprof_control(xc_handle, XEN_SYSCTL_LOCKPROF_query,
+                             &n, NULL, NULL) != 0 )
+    {
+        fprintf(stderr, "Error getting number of profiling records: "
+                "%d (%s)\n", errno, strerror(errno));
+        return 1;
+    }
+
+    /* Allow for locks registered between the two queries. */
+    n += 32;
+
+    data = malloc(sizeof(*data) * n);
+    if ( data == NULL )
+    {
+        fprintf(stderr, "Could not alloc buffer: %d (%s)\n",
+                errno, strerror(errno));
+        return 1;
+    }
+
+    i = n;
+    if ( xc_lockprof_control(xc_handle, XEN_SYSCTL_LOCKPROF_query,
+                             &i, &time, data) != 0 )
+    {
+        fprintf(stderr, "Error getting profiling records: %d (%s)\n",
+                errno, strerror(errno));
+        return 1;
+    }
+
+    if ( i > n )
+    {
+        printf("data incomplete, %u records are missing!\n\n", i - n);
+        i = n;
+    }
+
+    if ( sort )
+        qsort(data, i, sizeof(*data), cmp_block_time);
+
+    sl = 0;
+    sb = 0;
+    for ( j = 0; j < i; j++ )
+    {
+        switch ( data[j].type )
+        {
+        case LOCKPROF_TYPE_GLOBAL:
+            snprintf(name, sizeof(name), "global lock %s", data[j].name);
+            break;
+        case LOCKPROF_TYPE_PERDOM:
+            snprintf(name, sizeof(name), "domain %d lock %s",
+                     data[j].idx, data[j].name);
+            break;
+        default:
+            snprintf(name, sizeof(name), "unknown type(%d) %d lock %s",
+                     data[j].type, data[j].idx, data[j].name);
+            break;
+        }
+        l = (double)(data[j].lock_time) / 1E+09;
+        b = (double)(data[j].block_time) / 1E+09;
+        sl += l;
+        sb += b;
+        printf("%-50s: lock:%12"PRIu64"(%20.9fs), "
+               "block:%12"PRIu64"(%20.9fs)\n",
+               name, data[j].lock_cnt, l, data[j].block_cnt, b);
+    }
+    l = (double)time / 1E+09;
+    printf("total profiling time: %20.9fs\n", l);
+    printf("total locked time:    %20.9fs\n", sl);
+    printf("total blocked time:   %20.9fs\n", sb);
+
+    free(data);
+    xc_interface_close(xc_handle);
+
+    return 0;
+
+ open_err:
+    fprintf(stderr, "Error opening xc interface: %d (%s)\n",
+            errno, strerror(errno));
+    return 1;
+}
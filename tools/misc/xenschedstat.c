@@ -0,0 +1,184 @@
+/******************************************************************************
+ * xenschedstat.c
+ *
+ * Print or reset the hypervisor's scheduler statistics: per physical CPU
+ * scheduling and preemption counts, work stealing, wakeup-to-run latency
+ * and runqueue length histograms, and optionally the same per vCPU.
+ *
+ * Usage: xenschedstat [-r] [-v]
+ *   -r : reset all statistics
+ *   -v : also print per-vCPU statistics
+ */
+
+#include <xenctrl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+
+#define NR_BUCKETS XEN_SCHEDSTATS_BUCKETS
+
+static void usage(const char *prog)
+{
+    printf("%s: [-r] [-v]\n", prog);
+    printf("no args: print per-CPU scheduler statistics\n");
+    printf("    -r : reset statistics\n");
+    printf("    -v : also print per-vCPU statistics\n");
+}
+
+/* Lower bound of histogram bucket b. */
+static uint32_t bucket_floor(unsigned int b)
+{
+    return b ? (1U << (b - 1)) : 0;
+}
+
+static void print_hist(const char *title, const char *unit,
+                       const uint32_t *hist)
+{
+    uint64_t total = 0;
+    unsigned int b;
+
+    for ( b = 0; b < NR_BUCKETS; b++ )
+        total += hist[b];
+    if ( total == 0 )
+        return;
+
+    printf("    %s (%s):\n", title, unit);
+    for ( b = 0; b < NR_BUCKETS; b++ )
+    {
+        if ( hist[b] == 0 )
+            continue;
+        if ( b == 0 )
+            printf("      %10u        : ", 0);
+        else if ( b == NR_BUCKETS - 1 )
+            printf("      >= %-10u    : ", bucket_floor(b));
+        else
+            printf("      %10u-%-7u: ", bucket_floor(b), (1U << b) - 1);
+        printf("%10u (%5.1f%%)\n", hist[b], hist[b] * 100.0 / total);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int                   xc_handle, opt, verbose = 0;
+    uint32_t              i, np, nv, max_p, max_v;
+    uint64_t              time;
+    xc_sched_pcpustats_t *pcpu;
+    xc_sched_vcpustats_t *vcpu = NULL;
+
+    while ( (opt = getopt(argc, argv, "rvh")) != -1 )
+    {
+        switch ( opt )
+        {
+        case 'r':
+            if ( (xc_handle = xc_interface_open()) == -1 )
+                goto open_err;
+            if ( xc_sched_stats_control(xc_handle, XEN_SYSCTL_SCHEDSTATS_reset,
+                                        NULL, NULL, NULL, NULL, NULL) != 0 )
+            {
+                fprintf(stderr, "Error resetting statistics: %d (%s)\n",
+                        errno, strerror(errno));
+                return 1;
+            }
+            return 0;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    if ( (xc_handle = xc_interface_open()) == -1 )
+        goto open_err;
+
+    np = nv = 0;
+    if ( xc_sched_stats_control(xc_handle, XEN_SYSCTL_SCHEDSTATS_query,
+                                &np, NULL, &nv, NULL, NULL) != 0 )
+    {
+        fprintf(stderr, "Error getting number of records: %d (%s)\n",
+                errno, strerror(errno));
+        return 1;
+    }
+
+    /* Allow for CPUs and vCPUs coming up between the two queries. */
+    max_p = np + 8;
+    max_v = verbose ? nv + 32 : 0;
+
+    pcpu = malloc(sizeof(*pcpu) * max_p);
+    if ( verbose )
+        vcpu = malloc(sizeof(*vcpu) * max_v);
+    if ( pcpu == NULL || (verbose && vcpu == NULL) )
+    {
+        fprintf(stderr, "Could not alloc buffer: %d (%s)\n",
+                errno, strerror(errno));
+        return 1;
+    }
+
+    np = max_p;
+    nv = max_v;
+    if ( xc_sched_stats_control(xc_handle, XEN_SYSCTL_SCHEDSTATS_query,
+                                &np, pcpu, &nv, vcpu, &time) != 0 )
+    {
+        fprintf(stderr, "Error getting statistics: %d (%s)\n",
+                errno, strerror(errno));
+        return 1;
+    }
+
+    if ( np > max_p )
+    {
+        printf("data incomplete, %u CPUs are missing!\n\n", np - max_p);
+        np = max_p;
+    }
+    if ( verbose && nv > max_v )
+    {
+        printf("data incomplete, %u vCPUs are missing!\n\n", nv - max_v);
+        nv = max_v;
+    }
+
+    printf("statistics period: %20.9fs\n\n", (double)time / 1E+09);
+
+    printf("%-5s %14s %14s %14s %14s\n",
+           "cpu", "schedules", "preemptions", "steal tries", "steals");
+    for ( i = 0; i < np; i++ )
+        printf("%-5u %14"PRIu64" %14"PRIu64" %14"PRIu64" %14"PRIu64"\n",
+               pcpu[i].cpu, pcpu[i].schedules, pcpu[i].preemptions,
+               pcpu[i].steal_attempts, pcpu[i].steal_successes);
+
+    for ( i = 0; i < np; i++ )
+    {
+        printf("\ncpu %u:\n", pcpu[i].cpu);
+        print_hist("wakeup latency", "us", pcpu[i].wake_latency);
+        print_hist("runqueue length", "vCPUs waiting", pcpu[i].runq_len);
+    }
+
+    if ( verbose )
+    {
+        printf("\n%-7s %-5s %14s %14s\n",
+               "domain", "vcpu", "wakeups", "preemptions");
+        for ( i = 0; i < nv; i++ )
+            printf("%-7u %-5u %14"PRIu64" %14"PRIu64"\n",
+                   vcpu[i].domid, vcpu[i].vcpu,
+                   vcpu[i].wakeups, vcpu[i].preemptions);
+
+        for ( i = 0; i < nv; i++ )
+        {
+            printf("\ndomain %u vcpu %u:\n", vcpu[i].domid, vcpu[i].vcpu);
+            print_hist("wakeup latency", "us", vcpu[i].wake_latency);
+        }
+    }
+
+    free(vcpu);
+    free(pcpu);
+    xc_interface_close(xc_handle);
+
+    return 0;
+
+ open_err:
+    fprintf(stderr, "Error opening xc interface: %d (%s)\n",
+            errno, strerror(errno));
+    return 1;
+}
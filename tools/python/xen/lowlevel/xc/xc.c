@@ -70,18 +70,30 @@ static PyObject *pyxc_error_to_exception(void)
     return NULL;
 }
 
-static PyObject *pyxc_domain_dumpcore(XcObject *self, PyObject *args)
+static PyObject *pyxc_domain_dumpcore(XcObject *self,
+                                      PyObject *args,
+                                      PyObject *kwds)
 {
     uint32_t dom;
     char *corefile;
+    int compress = 0, threads = 0, rc;
 
-    if ( !PyArg_ParseTuple(args, "is", &dom, &corefile) )
+    static char *kwd_list[] = { "dom", "corefile", "compress", "threads",
+                                NULL };
+
+    if ( !PyArg_ParseTupleAndKeywords(args, kwds, "is|ii", kwd_list,
+                                      &dom, &corefile, &compress, &threads) )
         return NULL;
 
     if ( (corefile == NULL) || (corefile[0] == '\0') )
         return NULL;
 
-    if ( xc_domain_dumpcore(self->xc_handle, dom, corefile) != 0 )
+    if ( compress )
+        rc = xc_domain_dumpcore_compressed(self->xc_handle, dom, corefile,
+                                           (threads > 0) ? threads : 0);
+    else
+        rc = xc_domain_dumpcore(self->xc_handle, dom, corefile);
+    if ( rc != 0 )
         return pyxc_error_to_exception();
     
     Py_INCREF(zero);
@@ -1294,18 +1306,21 @@ static PyObject *pyxc_sched_credit_domain_set(XcObject *self,
     uint32_t domid;
     uint16_t weight;
     uint16_t cap;
-    static char *kwd_list[] = { "domid", "weight", "cap", NULL };
-    static char kwd_type[] = "I|HH";
+    uint16_t cosched;
+    static char *kwd_list[] = { "domid", "weight", "cap", "cosched", NULL };
+    static char kwd_type[] = "I|HHH";
     struct xen_domctl_sched_credit sdom;
     
     weight = 0;
     cap = (uint16_t)~0U;
+    cosched = (uint16_t)~0U;
     if( !PyArg_ParseTupleAndKeywords(args, kwds, kwd_type, kwd_list, 
-                                     &domid, &weight, &cap) )
+                                     &domid, &weight, &cap, &cosched) )
         return NULL;
 
     sdom.weight = weight;
     sdom.cap = cap;
+    sdom.cosched = cosched;
 
     if ( xc_sched_credit_domain_set(self->xc_handle, domid, &sdom) != 0 )
         return pyxc_error_to_exception();
@@ -1325,9 +1340,10 @@ static PyObject *pyxc_sched_credit_domain_get(XcObject *self, PyObject *args)
     if ( xc_sched_credit_domain_get(self->xc_handle, domid, &sdom) != 0 )
         return pyxc_error_to_exception();
 
-    return Py_BuildValue("{s:H,s:H}",
+    return Py_BuildValue("{s:H,s:H,s:H}",
                          "weight",  sdom.weight,
-                         "cap",     sdom.cap);
+                         "cap",     sdom.cap,
+                         "cosched", sdom.cosched);
 }
 
 static PyObject *pyxc_domain_setmaxmem(XcObject *self, PyObject *args)
@@ -1582,10 +1598,12 @@ static PyMethodDef pyxc_methods[] = {
 
     { "domain_dumpcore", 
       (PyCFunction)pyxc_domain_dumpcore, 
-      METH_VARARGS, "\n"
+      METH_VARARGS | METH_KEYWORDS, "\n"
       "Dump core of a domain.\n"
       " dom [int]: Identifier of domain to dump core of.\n"
-      " corefile [string]: Name of corefile to be created.\n\n"
+      " corefile [string]: Name of corefile to be created.\n"
+      " compress [int, 0]: Compress guest memory in the corefile.\n"
+      " threads [int, 0]: Compression threads (0: one per CPU).\n\n"
       "Returns: [int] 0 on success; -1 on error.\n" },
 
     { "domain_pause", 
@@ -1797,6 +1815,8 @@ static PyMethodDef pyxc_methods[] = {
       "SMP credit scheduler.\n"
       " domid     [int]:   domain id to set\n"
       " weight    [short]: domain's scheduling weight\n"
+      " cap       [short]: domain's CPU cap, in percent of one CPU\n"
+      " cosched   [short]: 1 to co-schedule the domain's VCPUs, 0 not to\n"
       "Returns: [int] 0 on success; -1 on error.\n" },
 
     { "sched_credit_domain_get",
@@ -1806,7 +1826,9 @@ static PyMethodDef pyxc_methods[] = {
       "SMP credit scheduler.\n"
       " domid     [int]:   domain id to get\n"
       "Returns:   [dict]\n"
-      " weight    [short]: domain's scheduling weight\n"},
+      " weight    [short]: domain's scheduling weight\n"
+      " cap       [short]: domain's CPU cap, in percent of one CPU\n"
+      " cosched   [short]: whether the domain's VCPUs are co-scheduled\n"},
 
     { "evtchn_alloc_unbound", 
       (PyCFunction)pyxc_evtchn_alloc_unbound,
@@ -2143,6 +2165,7 @@ PyMODINIT_FUNC initxc(void)
     /* Expose some libxc constants to Python */
     PyModule_AddIntConstant(m, "XEN_SCHEDULER_SEDF", XEN_SCHEDULER_SEDF);
     PyModule_AddIntConstant(m, "XEN_SCHEDULER_CREDIT", XEN_SCHEDULER_CREDIT);
+    PyModule_AddIntConstant(m, "XEN_SCHEDULER_CREDIT2", XEN_SCHEDULER_CREDIT2);
 
 }
 
@@ -1223,7 +1223,8 @@ class XendDomain:
             log.exception("domain_pause")
             raise XendError(str(ex))
 
-    def domain_dump(self, domid, filename=None, live=False, crash=False, reset=False):
+    def domain_dump(self, domid, filename=None, live=False, crash=False, reset=False,
+                    compress=False):
         """Dump domain core."""
 
         dominfo = self.domain_lookup_nr(domid)
@@ -1244,9 +1245,10 @@ class XendDomain:
         try:
             try:
                 log.info("Domain core dump requested for domain %s (%d) "
-                         "live=%d crash=%d reset=%d.",
-                         dominfo.getName(), dominfo.getDomid(), live, crash, reset)
-                dominfo.dumpCore(filename)
+                         "live=%d crash=%d reset=%d compress=%d.",
+                         dominfo.getName(), dominfo.getDomid(), live, crash, reset,
+                         compress)
+                dominfo.dumpCore(filename, compress)
                 if crash:
                     self.domain_destroy(domid)
                 elif reset:
@@ -2155,9 +2155,10 @@ class XendDomainInfo:
     # Debugging ..
     #
 
-    def dumpCore(self, corefile = None):
+    def dumpCore(self, corefile = None, compress = False):
         """Create a core dump for this domain.
 
+        @param compress: zlib compress guest memory in the core file
         @raise: XendError if core dumping failed.
         """
         
@@ -2173,7 +2174,8 @@ class XendDomainInfo:
         try:
             try:
                 self._writeVm(DUMPCORE_IN_PROGRESS, 'True')
-                xc.domain_dumpcore(self.domid, corefile)
+                xc.domain_dumpcore(self.domid, corefile,
+                                   compress = int(bool(compress)))
             except RuntimeError, ex:
                 corefile_incomp = corefile+'-incomplete'
                 try:
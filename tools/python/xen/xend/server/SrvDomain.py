@@ -105,7 +105,8 @@ class SrvDomain(SrvDir):
                      ['file',        'str'],
                      ['live',        'int'],
                      ['crash',       'int'],
-                     ['reset',       'int']])
+                     ['reset',       'int'],
+                     ['compress',    'int']])
         return fn(req.args, {'dom': self.dom.domid})
 
     def op_migrate(self, op, req):
@@ -142,7 +142,8 @@ SUBCOMMAND_HELP = {
                      'Read and/or clear Xend\'s message buffer.'),
     'domid'       : ('<DomainName>', 'Convert a domain name to domain id.'),
     'domname'     : ('<DomId>', 'Convert a domain id to domain name.'),
-    'dump-core'   : ('[-L|--live] [-C|--crash] [-R|--reset] <Domain> [Filename]',
+    'dump-core'   : ('[-L|--live] [-C|--crash] [-R|--reset] [-z|--compress] '
+                     '<Domain> [Filename]',
                      'Dump core for a specific domain.'),
     'info'        : ('[-c|--config]', 'Get information about Xen host.'),
     'log'         : ('', 'Print Xend log'),
@@ -273,6 +274,7 @@ SUBCOMMAND_OPTIONS = {
        ('-L', '--live', 'Dump core without pausing the domain'),
        ('-C', '--crash', 'Crash domain after dumping core'),
        ('-R', '--reset', 'Reset domain after dumping core'),
+       ('-z', '--compress', 'Compress guest memory in the core file'),
     ),
     'start': (
        ('-p', '--paused', 'Do not unpause domain after starting it'),
@@ -1354,8 +1356,11 @@ def xm_dump_core(args):
     live = False
     crash = False
     reset = False
+    compress = False
     try:
-        (options, params) = getopt.gnu_getopt(args, 'LCR', ['live', 'crash', 'reset'])
+        (options, params) = getopt.gnu_getopt(args, 'LCRz',
+                                              ['live', 'crash', 'reset',
+                                               'compress'])
         for (k, v) in options:
             if k in ('-L', '--live'):
                 live = True
@@ -1363,6 +1368,8 @@ def xm_dump_core(args):
                 crash = True
             elif k in ('-R', '--reset'):
                 reset = True
+            elif k in ('-z', '--compress'):
+                compress = True
 
         if crash and reset:
             raise OptionError("You may not specify more than one '-CR' option")
@@ -1378,7 +1385,7 @@ def xm_dump_core(args):
         filename = None
 
     print "Dumping core of domain: %s ..." % str(dom)
-    server.xend.domain.dump(dom, filename, live, crash, reset)
+    server.xend.domain.dump(dom, filename, live, crash, reset, compress)
 
 def xm_rename(args):
     arg_check(args, "rename", 2)
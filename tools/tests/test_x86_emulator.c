@@ -63,6 +63,7 @@ static struct x86_emulate_ops emulops = {
 int main(int argc, char **argv)
 {
     struct x86_emulate_ctxt ctxt;
+    struct x86_emulate_decode decode;
     struct cpu_user_regs regs;
     char *instr;
     unsigned int *res, i;
@@ -73,6 +74,7 @@ int main(int argc, char **argv)
 
     ctxt.regs = &regs;
     ctxt.force_writeback = 0;
+    ctxt.decode = NULL;
     ctxt.addr_size = 32;
     ctxt.sp_size   = 32;
 
@@ -372,6 +374,39 @@ int main(int argc, char **argv)
         goto fail;
     printf("okay\n");
 
+    printf("%-40s", "Testing movl 8(%%eax,%%ecx,4),%%edx...");
+    instr[0] = 0x8b; instr[1] = 0x54; instr[2] = 0x88; instr[3] = 0x08;
+    regs.eflags = 0x200;
+    regs.eip    = (unsigned long)&instr[0];
+    regs.eax    = (unsigned long)res;
+    regs.ecx    = 0;
+    regs.edx    = 0;
+    res[2]      = 0x11111111;
+    res[3]      = 0x22222222;
+    decode.valid = 0;
+    ctxt.decode = &decode;
+    rc = x86_emulate(&ctxt, &emulops);
+    if ( (rc != X86EMUL_OKAY) ||
+         (regs.edx != 0x11111111) ||
+         !decode.valid ||
+         (decode.len != 4) ||
+         (regs.eip != (unsigned long)&instr[4]) )
+        goto fail;
+    printf("okay\n");
+
+    printf("%-40s", "Testing cached decode of the same...");
+    /* Scribble on the ModRM/SIB bytes: the cached decode must be used. */
+    instr[1] = 0x90; instr[2] = 0x90; instr[3] = 0x90;
+    regs.eip    = (unsigned long)&instr[0];
+    regs.ecx    = 1;
+    rc = x86_emulate(&ctxt, &emulops);
+    ctxt.decode = NULL;
+    if ( (rc != X86EMUL_OKAY) ||
+         (regs.edx != 0x22222222) ||
+         (regs.eip != (unsigned long)&instr[4]) )
+        goto fail;
+    printf("okay\n");
+
     printf("%-40s", "Testing daa/das (all inputs)...");
 #ifndef __x86_64__
     /* Bits 0-7: AL; Bit 8: EFLG_AF; Bit 9: EFLG_CF; Bit 10: DAA vs. DAS. */
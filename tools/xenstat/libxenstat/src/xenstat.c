@@ -24,9 +24,13 @@
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
 
 #include "xenstat_priv.h"
 
+#include <xen/vcpu.h>
+
 /*
  * Data-collection types
  */
@@ -54,13 +58,19 @@ typedef struct xenstat_collector {
 
 static int  xenstat_collect_vcpus(xenstat_node * node);
 static int  xenstat_collect_xen_version(xenstat_node * node);
+static int  xenstat_collect_sched(xenstat_node * node);
 static void xenstat_free_vcpus(xenstat_node * node);
 static void xenstat_free_networks(xenstat_node * node);
 static void xenstat_free_xen_version(xenstat_node * node);
 static void xenstat_free_vbds(xenstat_node * node);
 static void xenstat_uninit_vcpus(xenstat_handle * handle);
 static void xenstat_uninit_xen_version(xenstat_handle * handle);
+static void xenstat_free_sched(xenstat_node * node);
+static void xenstat_uninit_sched(xenstat_handle * handle);
 static char *xenstat_get_domain_name(xenstat_handle * handle, unsigned int domain_id);
+static char *xenstat_cached_domain_name(xenstat_handle * handle,
+					xc_domaininfo_t *info);
+static void xenstat_prune_name_cache(xenstat_handle * handle);
 static void xenstat_prune_domain(xenstat_node *node, unsigned int entry);
 
 static xenstat_collector collectors[] = {
@@ -71,7 +81,10 @@ static xenstat_collector collectors[] = {
 	{ XENSTAT_XEN_VERSION, xenstat_collect_xen_version,
 	  xenstat_free_xen_version, xenstat_uninit_xen_version },
 	{ XENSTAT_VBD, xenstat_collect_vbds,
-	  xenstat_free_vbds, xenstat_uninit_vbds }
+	  xenstat_free_vbds, xenstat_uninit_vbds },
+	/* Must come after XENSTAT_VCPU: it fills in the VCPU array */
+	{ XENSTAT_SCHED, xenstat_collect_sched,
+	  xenstat_free_sched, xenstat_uninit_sched }
 };
 
 #define NUM_COLLECTORS (sizeof(collectors)/sizeof(xenstat_collector))
@@ -126,11 +139,153 @@ void xenstat_uninit(xenstat_handle * handle)
 			collectors[i].uninit(handle);
 		xc_interface_close(handle->xc_handle);
 		xs_daemon_close(handle->xshandle);
+		for (i = 0; i < handle->num_names; i++)
+			free(handle->names[i].name);
+		free(handle->names);
+		free(handle->stats_buf);
 		free(handle->priv);
 		free(handle);
 	}
 }
 
+/* Fill in domain using info.  Returns 0 if the domain should be skipped,
+ * -1 on fatal error, and 1 on success. */
+static int xenstat_fill_domain(xenstat_handle * handle,
+			       xenstat_domain * domain, xc_domaininfo_t *info)
+{
+	memset(domain, 0, sizeof(*domain));
+
+	domain->id = info->domain;
+	domain->name = xenstat_cached_domain_name(handle, info);
+	if (domain->name == NULL) {
+		if (errno == ENOMEM)
+			return -1;
+		/* failed to get name -- this means the domain is being
+		   destroyed so simply ignore this entry */
+		return 0;
+	}
+	domain->state = info->flags;
+	domain->cpu_ns = info->cpu_time;
+	domain->num_vcpus = (info->max_vcpu_id+1);
+	domain->vcpus = NULL;
+	domain->cur_mem =
+	    ((unsigned long long)info->tot_pages)
+	    * handle->page_size;
+	domain->max_mem =
+	    info->max_pages == UINT_MAX
+	    ? (unsigned long long)-1
+	    : (unsigned long long)(info->max_pages
+				   * handle->page_size);
+	domain->ssid = info->ssidref;
+	domain->num_networks = 0;
+	domain->networks = NULL;
+	domain->num_vbds = 0;
+	domain->vbds = NULL;
+
+	return 1;
+}
+
+/* Make room for count more domains in node.  Returns 0 on failure. */
+static int xenstat_grow_domains(xenstat_node * node, unsigned int count)
+{
+	xenstat_domain *tmp;
+
+	tmp = realloc(node->domains,
+		      (node->num_domains + count) * sizeof(xenstat_domain));
+	if (tmp == NULL)
+		return 0;
+	node->domains = tmp;
+
+	/* zero out newly allocated memory in case error occurs below */
+	memset(node->domains + node->num_domains, 0,
+	       count * sizeof(xenstat_domain));
+	return 1;
+}
+
+/* Collect the domains (and, if wanted, their VCPUs) with as few
+ * hypercalls as possible.  Returns 1 on success, 0 on fatal error and -1
+ * if the hypervisor does not support XEN_SYSCTL_getdomstats. */
+static int xenstat_collect_domstats(xenstat_node * node, unsigned int flags)
+{
+#define STATS_BUF_MIN (64 * 1024)
+	xenstat_handle *handle = node->handle;
+	uint32_t first_domain = 0, next_domain;
+	unsigned int used, offset, vcpu;
+	int i, count, rc;
+
+	do {
+		if (handle->stats_buf == NULL) {
+			handle->stats_buf_size = STATS_BUF_MIN;
+			handle->stats_buf = malloc(handle->stats_buf_size);
+			if (handle->stats_buf == NULL)
+				return 0;
+		}
+
+		count = xc_domain_getstats(handle->xc_handle, first_domain,
+					   handle->stats_buf,
+					   handle->stats_buf_size,
+					   &used, &next_domain);
+		/* An older hypervisor either lacks the sysctl or, as the
+		 * sysctl interface version has moved on, refuses all of
+		 * them with EACCES; the per-domain domctls still work. */
+		if (count < 0)
+			return (errno == ENOSYS || errno == EINVAL ||
+				errno == EACCES) ? -1 : 0;
+
+		if (count == 0 && next_domain != DOMID_FIRST_RESERVED) {
+			/* A single domain did not fit; retry with more room */
+			free(handle->stats_buf);
+			handle->stats_buf = NULL;
+			handle->stats_buf_size *= 2;
+			handle->stats_buf = malloc(handle->stats_buf_size);
+			if (handle->stats_buf == NULL)
+				return 0;
+			continue;
+		}
+
+		if (!xenstat_grow_domains(node, count))
+			return 0;
+
+		for (i = 0, offset = 0; i < count; i++) {
+			xc_domstats_t *ds = (xc_domstats_t *)
+				((char *)handle->stats_buf + offset);
+			xc_vcpustats_t *vs = (xc_vcpustats_t *)(ds + 1);
+			xenstat_domain *domain =
+				&node->domains[node->num_domains];
+
+			offset += sizeof(*ds) + ds->nr_vcpus * sizeof(*vs);
+
+			rc = xenstat_fill_domain(handle, domain, &ds->info);
+			if (rc < 0)
+				return 0;
+			if (rc == 0)
+				continue;
+			node->num_domains++;
+
+			if (!(flags & XENSTAT_VCPU))
+				continue;
+
+			/* VCPU ids are dense, but be robust to holes */
+			domain->vcpus = calloc(domain->num_vcpus,
+					       sizeof(xenstat_vcpu));
+			if (domain->vcpus == NULL)
+				return 0;
+			for (vcpu = 0; vcpu < ds->nr_vcpus; vcpu++) {
+				if (vs[vcpu].vcpu >= domain->num_vcpus)
+					continue;
+				domain->vcpus[vs[vcpu].vcpu].online =
+					!!(vs[vcpu].flags & XEN_VCPUSTATS_online);
+				domain->vcpus[vs[vcpu].vcpu].ns =
+					vs[vcpu].time[RUNSTATE_running];
+			}
+		}
+
+		first_domain = next_domain;
+	} while (next_domain != DOMID_FIRST_RESERVED);
+
+	return 1;
+}
+
 xenstat_node *xenstat_get_node(xenstat_handle * handle, unsigned int flags)
 {
 #define DOMAIN_CHUNK_SIZE 256
@@ -139,6 +294,7 @@ xenstat_node *xenstat_get_node(xenstat_handle * handle, unsigned int flags)
 	xc_domaininfo_t domaininfo[DOMAIN_CHUNK_SIZE];
 	unsigned int new_domains;
 	unsigned int i;
+	int rc;
 
 	/* Create the node */
 	node = (xenstat_node *) calloc(1, sizeof(xenstat_node));
@@ -170,69 +326,60 @@ xenstat_node *xenstat_get_node(xenstat_handle * handle, unsigned int flags)
 	}
 
 	node->num_domains = 0;
-	do {
-		xenstat_domain *domain, *tmp;
+	handle->name_gen++;
 
-		new_domains = xc_domain_getinfolist(handle->xc_handle,
-						    node->num_domains, 
-						    DOMAIN_CHUNK_SIZE, 
-						    domaininfo);
+	rc = handle->no_domstats ? -1 : xenstat_collect_domstats(node, flags);
+	if (rc == 0) {
+		/* Only VCPUs the VCPU collector frees can have been set up */
+		node->flags = flags & XENSTAT_VCPU;
+		xenstat_free_node(node);
+		return NULL;
+	}
 
-		tmp = realloc(node->domains,
-			      (node->num_domains + new_domains)
-			      * sizeof(xenstat_domain));
-		if (tmp == NULL) {
-			free(node->domains);
-			free(node);
-			return NULL;
+	/* Old hypervisor: one hypercall per chunk of domains, and one per
+	 * VCPU in the VCPU collector */
+	if (rc < 0) {
+		handle->no_domstats = 1;
+		for (i = 0; i < node->num_domains; i++) {
+			free(node->domains[i].name);
+			free(node->domains[i].vcpus);
 		}
-		node->domains = tmp;
+		node->num_domains = 0;
 
-		domain = node->domains + node->num_domains;
+		do {
+			xenstat_domain *domain;
 
-		/* zero out newly allocated memory in case error occurs below */
-		memset(domain, 0, new_domains * sizeof(xenstat_domain));
+			new_domains = xc_domain_getinfolist(handle->xc_handle,
+							    node->num_domains,
+							    DOMAIN_CHUNK_SIZE,
+							    domaininfo);
 
-		for (i = 0; i < new_domains; i++) {
-			/* Fill in domain using domaininfo[i] */
-			domain->id = domaininfo[i].domain;
-			domain->name = xenstat_get_domain_name(handle, 
-							       domain->id);
-			if (domain->name == NULL) {
-				if (errno == ENOMEM) {
+			if (!xenstat_grow_domains(node, new_domains)) {
+				free(node->domains);
+				free(node);
+				return NULL;
+			}
+
+			domain = node->domains + node->num_domains;
+
+			for (i = 0; i < new_domains; i++) {
+				rc = xenstat_fill_domain(handle, domain,
+							 &domaininfo[i]);
+				if (rc < 0) {
 					/* fatal error */
 					xenstat_free_node(node);
 					return NULL;
 				}
-				else {
-					/* failed to get name -- this means the
-					   domain is being destroyed so simply
-					   ignore this entry */
+				if (rc == 0)
 					continue;
-				}
+
+				domain++;
+				node->num_domains++;
 			}
-			domain->state = domaininfo[i].flags;
-			domain->cpu_ns = domaininfo[i].cpu_time;
-			domain->num_vcpus = (domaininfo[i].max_vcpu_id+1);
-			domain->vcpus = NULL;
-			domain->cur_mem =
-			    ((unsigned long long)domaininfo[i].tot_pages)
-			    * handle->page_size;
-			domain->max_mem =
-			    domaininfo[i].max_pages == UINT_MAX
-			    ? (unsigned long long)-1
-			    : (unsigned long long)(domaininfo[i].max_pages
-						   * handle->page_size);
-			domain->ssid = domaininfo[i].ssidref;
-			domain->num_networks = 0;
-			domain->networks = NULL;
-			domain->num_vbds = 0;
-			domain->vbds = NULL;
-
-			domain++;
-			node->num_domains++;
-		}
-	} while (new_domains == DOMAIN_CHUNK_SIZE);
+		} while (new_domains == DOMAIN_CHUNK_SIZE);
+	}
+
+	xenstat_prune_name_cache(handle);
 
 	/* Run all the extra data collectors requested */
 	node->flags = 0;
@@ -446,6 +593,10 @@ static int xenstat_collect_vcpus(xenstat_node * node)
 	for (i = 0; i < node->num_domains; i+=inc_index) {
 		inc_index = 1; /* default is to increment to next domain */
 
+		/* Already filled in from XEN_SYSCTL_getdomstats? */
+		if (node->domains[i].vcpus != NULL)
+			continue;
+
 		node->domains[i].vcpus = malloc(node->domains[i].num_vcpus
 						* sizeof(xenstat_vcpu));
 		if (node->domains[i].vcpus == NULL)
@@ -505,6 +656,98 @@ unsigned long long xenstat_vcpu_ns(xenstat_vcpu * vcpu)
 	return vcpu->ns;
 }
 
+/*
+ * Scheduler statistics functions
+ */
+
+/* Collect per-VCPU scheduler statistics into the VCPU arrays */
+static int xenstat_collect_sched(xenstat_node * node)
+{
+	xc_sched_vcpustats_t *stats;
+	xenstat_domain *domain;
+	xenstat_vcpu *vcpu;
+	uint32_t i, b, nr = 0, max;
+
+	if (!(node->flags & XENSTAT_VCPU))
+		return 1;
+
+	for (i = 0; i < node->num_domains; i++)
+		for (b = 0; b < node->domains[i].num_vcpus; b++) {
+			vcpu = &node->domains[i].vcpus[b];
+			vcpu->wakeups = vcpu->preemptions = 0;
+			memset(vcpu->wake_latency, 0,
+			       sizeof(vcpu->wake_latency));
+		}
+
+	/* Older hypervisors lack the statistics: leave them zero. */
+	if (xc_sched_stats_control(node->handle->xc_handle,
+				   XEN_SYSCTL_SCHEDSTATS_query,
+				   NULL, NULL, &nr, NULL, NULL) != 0)
+		return errno != ENOMEM;
+
+	/* Allow for VCPUs created between the two queries. */
+	max = nr + 32;
+	stats = malloc(max * sizeof(*stats));
+	if (stats == NULL)
+		return 0;
+
+	nr = max;
+	if (xc_sched_stats_control(node->handle->xc_handle,
+				   XEN_SYSCTL_SCHEDSTATS_query,
+				   NULL, NULL, &nr, stats, NULL) != 0) {
+		free(stats);
+		return errno != ENOMEM;
+	}
+	if (nr > max)
+		nr = max;
+
+	for (i = 0; i < nr; i++) {
+		domain = xenstat_node_domain(node, stats[i].domid);
+		if (domain == NULL || stats[i].vcpu >= domain->num_vcpus)
+			continue;
+		vcpu = &domain->vcpus[stats[i].vcpu];
+		vcpu->wakeups = stats[i].wakeups;
+		vcpu->preemptions = stats[i].preemptions;
+		for (b = 0; b < XENSTAT_SCHED_BUCKETS &&
+			    b < XEN_SCHEDSTATS_BUCKETS; b++)
+			vcpu->wake_latency[b] = stats[i].wake_latency[b];
+	}
+
+	free(stats);
+	return 1;
+}
+
+/* Free scheduler statistics - they live in the VCPU arrays */
+static void xenstat_free_sched(xenstat_node * node)
+{
+}
+
+/* Free scheduler statistics in handle - nothing to do */
+static void xenstat_uninit_sched(xenstat_handle * handle)
+{
+}
+
+/* Get the number of times the VCPU was woken up */
+unsigned long long xenstat_vcpu_wakeups(xenstat_vcpu * vcpu)
+{
+	return vcpu->wakeups;
+}
+
+/* Get the number of times the VCPU was descheduled while runnable */
+unsigned long long xenstat_vcpu_preemptions(xenstat_vcpu * vcpu)
+{
+	return vcpu->preemptions;
+}
+
+/* Get one bucket of the VCPU's wakeup latency histogram */
+unsigned int xenstat_vcpu_wake_latency(xenstat_vcpu * vcpu,
+				       unsigned int bucket)
+{
+	if (bucket >= XENSTAT_SCHED_BUCKETS)
+		return 0;
+	return vcpu->wake_latency[bucket];
+}
+
 /*
  * Network functions
  */
@@ -670,6 +913,76 @@ static char *xenstat_get_domain_name(xenstat_handle *handle, unsigned int domain
 	return xs_read(handle->xshandle, XBT_NULL, path, NULL);
 }
 
+/* Domain names only change on rename, so look them up in xenstore (two
+ * reads per domain) at most every NAME_CACHE_TTL seconds.  The domain
+ * handle guards against a domain id being reused. */
+#define NAME_CACHE_TTL 10
+
+static char *xenstat_cached_domain_name(xenstat_handle * handle,
+					xc_domaininfo_t *info)
+{
+	struct xenstat_name_cache *entry = NULL, *tmp;
+	time_t now = time(NULL);
+	unsigned int i;
+	char *name;
+
+	for (i = 0; i < handle->num_names; i++)
+		if (handle->names[i].domid == info->domain) {
+			entry = &handle->names[i];
+			break;
+		}
+
+	if (entry != NULL &&
+	    memcmp(entry->handle, info->handle, sizeof(entry->handle)) == 0 &&
+	    now - entry->fetched < NAME_CACHE_TTL) {
+		entry->gen = handle->name_gen;
+		return strdup(entry->name);
+	}
+
+	name = xenstat_get_domain_name(handle, info->domain);
+	if (name == NULL)
+		return NULL;
+
+	if (entry == NULL) {
+		tmp = realloc(handle->names, (handle->num_names + 1)
+			      * sizeof(struct xenstat_name_cache));
+		if (tmp == NULL)
+			return name; /* just don't cache it */
+		handle->names = tmp;
+		entry = &handle->names[handle->num_names++];
+		entry->domid = info->domain;
+		entry->name = NULL;
+	}
+
+	free(entry->name);
+	entry->name = strdup(name);
+	if (entry->name == NULL) {
+		/* forget the entry rather than keep a NULL name */
+		*entry = handle->names[--handle->num_names];
+		return name;
+	}
+	memcpy(entry->handle, info->handle, sizeof(entry->handle));
+	entry->fetched = now;
+	entry->gen = handle->name_gen;
+
+	return name;
+}
+
+/* Drop cached names of domains not seen during this collection */
+static void xenstat_prune_name_cache(xenstat_handle * handle)
+{
+	unsigned int i = 0;
+
+	while (i < handle->num_names) {
+		if (handle->names[i].gen == handle->name_gen) {
+			i++;
+			continue;
+		}
+		free(handle->names[i].name);
+		handle->names[i] = handle->names[--handle->num_names];
+	}
+}
+
 /* Remove specified entry from list of domains */
 static void xenstat_prune_domain(xenstat_node *node, unsigned int entry)
 {
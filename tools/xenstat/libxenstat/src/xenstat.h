@@ -41,6 +41,11 @@ void xenstat_uninit(xenstat_handle * handle);
 #define XENSTAT_XEN_VERSION 0x4
 #define XENSTAT_VBD 0x8
 #define XENSTAT_ALL (XENSTAT_VCPU|XENSTAT_NETWORK|XENSTAT_XEN_VERSION|XENSTAT_VBD)
+/* Scheduler statistics per VCPU; needs XENSTAT_VCPU, not part of ALL */
+#define XENSTAT_SCHED 0x10
+
+/* Number of buckets in the VCPU wakeup latency histogram */
+#define XENSTAT_SCHED_BUCKETS 16
 
 /* Get all available information about a node */
 xenstat_node *xenstat_get_node(xenstat_handle * handle, unsigned int flags);
@@ -137,6 +142,14 @@ xenstat_vbd *xenstat_domain_vbd(xenstat_domain * domain,
 unsigned int xenstat_vcpu_online(xenstat_vcpu * vcpu);
 unsigned long long xenstat_vcpu_ns(xenstat_vcpu * vcpu);
 
+/* Get VCPU scheduler statistics (zero unless XENSTAT_SCHED was given).
+ * Latency bucket 0 counts wakeups that ran at once, bucket b those that
+ * waited [2^(b-1), 2^b) microseconds, and the last bucket all longer. */
+unsigned long long xenstat_vcpu_wakeups(xenstat_vcpu * vcpu);
+unsigned long long xenstat_vcpu_preemptions(xenstat_vcpu * vcpu);
+unsigned int xenstat_vcpu_wake_latency(xenstat_vcpu * vcpu,
+				       unsigned int bucket);
+
 
 /*
  * Network functions - extract information from a xenstat_network
@@ -24,6 +24,7 @@
 #define XENSTAT_PRIV_H
 
 #include <sys/types.h>
+#include <time.h>
 #include <xs.h>
 #include "xenstat.h"
 
@@ -32,12 +33,26 @@
 #define SHORT_ASC_LEN 5                 /* length of 65535 */
 #define VERSION_SIZE (2 * SHORT_ASC_LEN + 1 + sizeof(xen_extraversion_t) + 1)
 
+struct xenstat_name_cache {
+	unsigned int domid;
+	xen_domain_handle_t handle;	/* detects domain id reuse */
+	char *name;
+	time_t fetched;
+	unsigned long gen;		/* last collection that saw it */
+};
+
 struct xenstat_handle {
 	int xc_handle;
 	struct xs_handle *xshandle; /* xenstore handle */
 	int page_size;
 	void *priv;
 	char xen_version[VERSION_SIZE]; /* xen version running on this node */
+	int no_domstats;		/* XEN_SYSCTL_getdomstats unsupported */
+	void *stats_buf;		/* XEN_SYSCTL_getdomstats buffer */
+	unsigned int stats_buf_size;
+	struct xenstat_name_cache *names; /* Array of length num_names */
+	unsigned int num_names;
+	unsigned long name_gen;
 };
 
 struct xenstat_node {
@@ -70,6 +85,9 @@ struct xenstat_domain {
 struct xenstat_vcpu {
 	unsigned int online;
 	unsigned long long ns;
+	unsigned long long wakeups;	/* XENSTAT_SCHED */
+	unsigned long long preemptions;
+	unsigned int wake_latency[XENSTAT_SCHED_BUCKETS];
 };
 
 struct xenstat_network {
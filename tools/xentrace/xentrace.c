@@ -25,6 +25,8 @@
 #include <assert.h>
 #include <sys/poll.h>
 #include <sys/statvfs.h>
+#include <pthread.h>
+#include <zlib.h>
 
 #include <xen/xen.h>
 #include <xen/trace.h>
@@ -45,7 +47,16 @@ do {                                                            \
 /* sleep for this long (milliseconds) between checking the trace buffers */
 #define POLL_SLEEP_MILLIS 100
 
+/* never poll more often than this while buffers are filling quickly */
+#define POLL_SLEEP_MIN_MILLIS 5
+
 #define DEFAULT_TBUF_SIZE 20
+
+/* zlib level used by --compress without an argument */
+#define DEFAULT_COMPRESS_LEVEL 6
+
+/* bytes of uncompressed windows a writer thread may lag behind by */
+#define COMPRESS_MAX_QUEUED (64 << 20)
 /***** The code **************************************************************/
 
 typedef struct settings_st {
@@ -57,8 +68,11 @@ typedef struct settings_st {
     unsigned long disk_rsvd;
     unsigned long timeout;
     unsigned long memory_buffer;
+    int compress_level;       /* 0 = write raw records */
+    unsigned int highwater;   /* 0 = leave Xen's high water mark alone */
     uint8_t discard:1,
-        disable_tracing:1;
+        disable_tracing:1,
+        tsc_delta:1;
 } settings_t;
 
 settings_t opts;
@@ -69,6 +83,7 @@ static int xc_handle = -1;
 static int event_fd = -1;
 static int virq_port = -1;
 static int outfd = 1;
+static uint32_t tbuf_format = XEN_SYSCTL_TBUF_FORMAT_tsc64;
 
 static void close_handler(int signal)
 {
@@ -119,6 +134,39 @@ struct cpu_change_record {
      | (((sizeof(struct cpu_change_record)/sizeof(uint32_t)) - 1)   \
         << TRACE_EXTRA_SHIFT) )
 
+struct format_record {
+    uint32_t header;
+    uint32_t format;
+};
+
+#define FORMAT_HEADER \
+    (TRC_TRACE_FORMAT | (1 << TRACE_EXTRA_SHIFT))
+
+/*
+ * Compressed output: every CPU gets a writer thread which deflates the
+ * windows read from its trace buffer into self-contained gzip members.
+ * Members are written to the output whole, so the file is a valid
+ * multi-member gzip stream, and the polling loop never waits for zlib.
+ */
+struct window {
+    struct window *next;
+    unsigned long size, filled;
+    unsigned char data[0];     /* cpu_change record, then trace records */
+};
+
+struct cpu_writer {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct window *head, **tail;
+    struct window *pending;    /* window still being copied */
+    unsigned long queued;
+    int done;
+};
+
+static struct cpu_writer *writers;
+static pthread_mutex_t outfd_lock = PTHREAD_MUTEX_INITIALIZER;
+
 void membuf_alloc(unsigned long size)
 {
     membuf.buf = malloc(size);
@@ -307,6 +355,244 @@ fail:
     return;
 }
 
+static void write_out(const void *start, size_t size)
+{
+    ssize_t written;
+
+    while ( size > 0 )
+    {
+        written = write(outfd, start, size);
+        if ( written <= 0 )
+        {
+            if ( written < 0 && errno == EINTR )
+                continue;
+            PERROR("Failed to write trace data");
+            exit(EXIT_FAILURE);
+        }
+        start += written;
+        size -= written;
+    }
+}
+
+static void *writer_thread(void *arg)
+{
+    struct cpu_writer *w = arg;
+    struct window *list, *win;
+    unsigned char *out = NULL;
+    unsigned long out_size = 0, in_size;
+    z_stream zs;
+    int done, rc;
+
+    memset(&zs, 0, sizeof(zs));
+    /* windowBits + 16 selects gzip framing. */
+    if ( deflateInit2(&zs, opts.compress_level, Z_DEFLATED, 15 + 16, 8,
+                      Z_DEFAULT_STRATEGY) != Z_OK )
+    {
+        fprintf(stderr, "deflateInit2 failed: %s\n", zs.msg ? : "");
+        exit(EXIT_FAILURE);
+    }
+
+    for ( ; ; )
+    {
+        pthread_mutex_lock(&w->lock);
+        while ( w->head == NULL && !w->done )
+            pthread_cond_wait(&w->cond, &w->lock);
+        list = w->head;
+        in_size = w->queued;
+        w->head = NULL;
+        w->tail = &w->head;
+        done = w->done;
+        pthread_mutex_unlock(&w->lock);
+
+        if ( list == NULL )
+        {
+            if ( done )
+                break;
+            continue;
+        }
+
+        /* Compress everything queued into one member. */
+        if ( deflateBound(&zs, in_size) > out_size )
+        {
+            out_size = deflateBound(&zs, in_size);
+            free(out);
+            if ( (out = malloc(out_size)) == NULL )
+            {
+                PERROR("Failed to allocate compression buffer");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        deflateReset(&zs);
+        zs.next_out = out;
+        zs.avail_out = out_size;
+        while ( (win = list) != NULL )
+        {
+            list = win->next;
+            zs.next_in = win->data;
+            zs.avail_in = win->size;
+            rc = deflate(&zs, list ? Z_NO_FLUSH : Z_FINISH);
+            if ( rc != (list ? Z_OK : Z_STREAM_END) || zs.avail_in != 0 )
+            {
+                fprintf(stderr, "deflate failed (%d)\n", rc);
+                exit(EXIT_FAILURE);
+            }
+            free(win);
+        }
+
+        pthread_mutex_lock(&outfd_lock);
+        write_out(out, zs.total_out);
+        pthread_mutex_unlock(&outfd_lock);
+
+        /* Let a throttled producer continue. */
+        pthread_mutex_lock(&w->lock);
+        w->queued -= in_size;
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+    }
+
+    deflateEnd(&zs);
+    free(out);
+
+    return NULL;
+}
+
+static void writers_start(unsigned int num)
+{
+    unsigned int i;
+
+    writers = calloc(num, sizeof(*writers));
+    if ( writers == NULL )
+    {
+        PERROR("Failed to allocate writer threads");
+        exit(EXIT_FAILURE);
+    }
+
+    for ( i = 0; i < num; i++ )
+    {
+        struct cpu_writer *w = &writers[i];
+
+        pthread_mutex_init(&w->lock, NULL);
+        pthread_cond_init(&w->cond, NULL);
+        w->tail = &w->head;
+        if ( pthread_create(&w->thread, NULL, writer_thread, w) != 0 )
+        {
+            PERROR("Failed to start writer thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static void writers_stop(unsigned int num)
+{
+    unsigned int i;
+
+    for ( i = 0; i < num; i++ )
+    {
+        struct cpu_writer *w = &writers[i];
+
+        pthread_mutex_lock(&w->lock);
+        w->done = 1;
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+        pthread_join(w->thread, NULL);
+    }
+
+    free(writers);
+}
+
+/* Copy (part of) a window into the CPU's queue for compression. */
+static void compress_window(unsigned int cpu, unsigned char *start, int size,
+                            int total_size)
+{
+    struct cpu_writer *w = &writers[cpu];
+    struct window *win = w->pending;
+
+    if ( total_size != 0 )
+    {
+        struct cpu_change_record *rec;
+
+        win = malloc(sizeof(*win) + sizeof(*rec) + total_size);
+        if ( win == NULL )
+        {
+            PERROR("Failed to allocate trace window");
+            exit(EXIT_FAILURE);
+        }
+        win->next = NULL;
+        win->size = sizeof(*rec) + total_size;
+
+        rec = (struct cpu_change_record *)win->data;
+        rec->header = CPU_CHANGE_HEADER;
+        rec->data.cpu = cpu;
+        rec->data.window_size = total_size;
+        win->filled = sizeof(*rec);
+        w->pending = win;
+    }
+
+    assert(win != NULL && win->filled + size <= win->size);
+    memcpy(win->data + win->filled, start, size);
+    win->filled += size;
+    if ( win->filled < win->size )
+        return;
+
+    w->pending = NULL;
+
+    pthread_mutex_lock(&w->lock);
+    while ( w->queued > COMPRESS_MAX_QUEUED )
+        pthread_cond_wait(&w->cond, &w->lock);
+    *w->tail = win;
+    w->tail = &win->next;
+    w->queued += win->size;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/*
+ * Tell decoders how timestamps are laid out.  Only written for non-default
+ * formats, so that plain traces are unchanged.
+ */
+static void write_format_record(void)
+{
+    struct format_record rec;
+    unsigned char *out;
+    uLongf out_size;
+    z_stream zs;
+
+    if ( tbuf_format == XEN_SYSCTL_TBUF_FORMAT_tsc64 )
+        return;
+
+    rec.header = FORMAT_HEADER;
+    rec.format = tbuf_format;
+
+    if ( !opts.compress_level )
+    {
+        write_out(&rec, sizeof(rec));
+        return;
+    }
+
+    memset(&zs, 0, sizeof(zs));
+    if ( deflateInit2(&zs, opts.compress_level, Z_DEFLATED, 15 + 16, 8,
+                      Z_DEFAULT_STRATEGY) != Z_OK )
+        goto fail;
+    out_size = deflateBound(&zs, sizeof(rec));
+    if ( (out = malloc(out_size)) == NULL )
+        goto fail;
+    zs.next_in = (unsigned char *)&rec;
+    zs.avail_in = sizeof(rec);
+    zs.next_out = out;
+    zs.avail_out = out_size;
+    if ( deflate(&zs, Z_FINISH) != Z_STREAM_END )
+        goto fail;
+    write_out(out, zs.total_out);
+    deflateEnd(&zs);
+    free(out);
+    return;
+
+fail:
+    fprintf(stderr, "Failed to compress format record\n");
+    exit(EXIT_FAILURE);
+}
+
 /**
  * write_buffer - write a section of the trace buffer
  * @cpu      - source buffer CPU ID
@@ -351,6 +637,12 @@ static void write_buffer(unsigned int cpu, unsigned char *start, int size,
         }
     }
 
+    if ( opts.compress_level )
+    {
+        compress_window(cpu, start, size, total_size);
+        return;
+    }
+
     /* Write a CPU_BUF record on each buffer "window" written.  Wrapped
      * windows may involve two writes, so only write the record on the
      * first write. */
@@ -429,6 +721,12 @@ static void get_tbufs(unsigned long *mfn, unsigned long *size)
     if(!opts.tbuf_size)
       opts.tbuf_size = DEFAULT_TBUF_SIZE;
 
+    /* The format, like the size, sticks once buffers are allocated. */
+    if ( opts.tsc_delta &&
+         xc_tbuf_set_format(xc_handle, XEN_SYSCTL_TBUF_FORMAT_delta32) != 0 )
+        fprintf(stderr, "Couldn't select TSC-delta records, "
+                "trace buffers already allocated in another format.\n");
+
     ret = xc_tbuf_enable(xc_handle, opts.tbuf_size, mfn, size);
 
     if ( ret != 0 )
@@ -436,6 +734,12 @@ static void get_tbufs(unsigned long *mfn, unsigned long *size)
         perror("Couldn't enable trace buffers");
         exit(1);
     }
+
+    if ( xc_tbuf_get_format(xc_handle, &tbuf_format) != 0 )
+    {
+        PERROR("Couldn't get trace buffer format");
+        exit(EXIT_FAILURE);
+    }
 }
 
 /**
@@ -630,6 +934,178 @@ static void wait_for_event_or_timeout(unsigned long milliseconds)
 }
 
 
+/*
+ * Every CPU's trace buffer is drained by its own reader thread, so that a
+ * slow write on one buffer does not hold up the others.  The main thread
+ * waits for VIRQ_TBUF or the poll timeout and then releases all readers
+ * for one sweep.
+ */
+static struct t_buf **meta;      /* pointers to the trace buffer metadata    */
+static unsigned char **data;     /* pointers to the trace buffer data areas
+                                  * where they are mapped into user space.   */
+static unsigned long data_size;  /* size of a buffer's data area             */
+
+static pthread_t *readers;
+static pthread_mutex_t sweep_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sweep_start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t sweep_end = PTHREAD_COND_INITIALIZER;
+static unsigned long sweep_gen;      /* bumped to start a sweep             */
+static unsigned int sweep_busy;      /* readers still draining this sweep   */
+static unsigned long sweep_max_fill; /* largest window seen this sweep      */
+static int sweep_exit;
+
+/**
+ * drain_buffer - write out the records currently in one CPU's buffer
+ * @cpu:          the trace buffer to drain
+ *
+ * Returns the number of bytes consumed.
+ */
+static unsigned long drain_buffer(unsigned int cpu)
+{
+    unsigned long start_offset, end_offset, window_size, cons, prod;
+
+    /* Read window information only once. */
+    cons = meta[cpu]->cons;
+    prod = meta[cpu]->prod;
+    xen_rmb(); /* read prod, then read item. */
+
+    if ( cons == prod )
+        return 0;
+
+    assert(cons < 2*data_size);
+    assert(prod < 2*data_size);
+
+    // NB: if (prod<cons), then (prod-cons)%data_size will not yield
+    // the correct answer because data_size is not a power of 2.
+    if ( prod < cons )
+        window_size = (prod + 2*data_size) - cons;
+    else
+        window_size = prod - cons;
+    assert(window_size > 0);
+    assert(window_size <= data_size);
+
+    start_offset = cons % data_size;
+    end_offset = prod % data_size;
+
+    /* Compressed windows are queued per CPU; others share the output. */
+    if ( !opts.compress_level )
+        pthread_mutex_lock(&outfd_lock);
+
+    if ( end_offset > start_offset )
+    {
+        /* If window does not wrap, write in one big chunk */
+        write_buffer(cpu, data[cpu]+start_offset,
+                     window_size,
+                     window_size);
+    }
+    else
+    {
+        /* If wrapped, write in two chunks:
+         * - first, start to the end of the buffer
+         * - second, start of buffer to end of window
+         */
+        write_buffer(cpu, data[cpu] + start_offset,
+                     data_size - start_offset,
+                     window_size);
+        write_buffer(cpu, data[cpu],
+                     end_offset,
+                     0);
+    }
+
+    if ( !opts.compress_level )
+        pthread_mutex_unlock(&outfd_lock);
+
+    xen_mb(); /* read buffer, then update cons. */
+    meta[cpu]->cons = prod;
+
+    return window_size;
+}
+
+static void *reader_thread(void *arg)
+{
+    unsigned int cpu = (unsigned long)arg;
+    unsigned long gen = 0, drained;
+
+    pthread_mutex_lock(&sweep_lock);
+    for ( ; ; )
+    {
+        while ( sweep_gen == gen && !sweep_exit )
+            pthread_cond_wait(&sweep_start, &sweep_lock);
+        if ( sweep_gen == gen )
+            break;
+        gen = sweep_gen;
+        pthread_mutex_unlock(&sweep_lock);
+
+        drained = drain_buffer(cpu);
+
+        pthread_mutex_lock(&sweep_lock);
+        if ( drained > sweep_max_fill )
+            sweep_max_fill = drained;
+        if ( --sweep_busy == 0 )
+            pthread_cond_signal(&sweep_end);
+    }
+    pthread_mutex_unlock(&sweep_lock);
+
+    return NULL;
+}
+
+static void readers_start(unsigned int num)
+{
+    unsigned long i;
+
+    readers = calloc(num, sizeof(*readers));
+    if ( readers == NULL )
+    {
+        PERROR("Failed to allocate reader threads");
+        exit(EXIT_FAILURE);
+    }
+
+    for ( i = 0; i < num; i++ )
+        if ( pthread_create(&readers[i], NULL, reader_thread, (void *)i) )
+        {
+            PERROR("Failed to start reader thread");
+            exit(EXIT_FAILURE);
+        }
+}
+
+static void readers_stop(unsigned int num)
+{
+    unsigned int i;
+
+    pthread_mutex_lock(&sweep_lock);
+    sweep_exit = 1;
+    pthread_cond_broadcast(&sweep_start);
+    pthread_mutex_unlock(&sweep_lock);
+
+    for ( i = 0; i < num; i++ )
+        pthread_join(readers[i], NULL);
+
+    free(readers);
+}
+
+/**
+ * sweep_buffers - have every reader drain its buffer once
+ * @num:           number of trace buffers / reader threads
+ *
+ * Returns the size of the fullest window drained.
+ */
+static unsigned long sweep_buffers(unsigned int num)
+{
+    unsigned long max_fill;
+
+    pthread_mutex_lock(&sweep_lock);
+    sweep_gen++;
+    sweep_busy = num;
+    sweep_max_fill = 0;
+    pthread_cond_broadcast(&sweep_start);
+    while ( sweep_busy != 0 )
+        pthread_cond_wait(&sweep_end, &sweep_lock);
+    max_fill = sweep_max_fill;
+    pthread_mutex_unlock(&sweep_lock);
+
+    return max_fill;
+}
+
 /**
  * monitor_tbufs - monitor the contents of tbufs and output to a file
  * @logfile:       the FILE * representing the file to log to
@@ -639,14 +1115,10 @@ static int monitor_tbufs(void)
     int i;
 
     void *tbufs_mapped;          /* pointer to where the tbufs are mapped    */
-    struct t_buf **meta;         /* pointers to the trace buffer metadata    */
-    unsigned char **data;        /* pointers to the trace buffer data areas
-                                  * where they are mapped into user space.   */
     unsigned long tbufs_mfn;     /* mfn of the tbufs                         */
     unsigned int  num;           /* number of trace buffers / logical CPUS   */
     unsigned long size;          /* size of a single trace buffer            */
-
-    unsigned long data_size;
+    unsigned long sleep_ms, fill;
 
     /* prepare to listen for VIRQ_TBUF */
     event_init();
@@ -664,77 +1136,68 @@ static int monitor_tbufs(void)
     meta  = init_bufs_ptrs(tbufs_mapped, num, size);
     data  = init_rec_ptrs(meta, num);
 
+    if ( opts.highwater != 0 &&
+         xc_tbuf_set_highwater(xc_handle, 0, opts.highwater) != 0 )
+    {
+        PERROR("Failed to set trace buffer high water mark");
+        exit(EXIT_FAILURE);
+    }
+
+    if ( !opts.memory_buffer )
+        write_format_record();
+
+    if ( opts.compress_level )
+        writers_start(num);
+
     if ( opts.discard )
         for ( i = 0; i < num; i++ )
             meta[i]->cons = meta[i]->prod;
 
+    readers_start(num);
+
     /* now, scan buffers for events */
+    sleep_ms = opts.poll_sleep;
     while ( 1 )
     {
-        for ( i = 0; i < num; i++ )
-        {
-            unsigned long start_offset, end_offset, window_size, cons, prod;
-                
-            /* Read window information only once. */
-            cons = meta[i]->cons;
-            prod = meta[i]->prod;
-            xen_rmb(); /* read prod, then read item. */
-
-            if ( cons == prod )
-                continue;
-           
-            assert(cons < 2*data_size);
-            assert(prod < 2*data_size);
-
-            // NB: if (prod<cons), then (prod-cons)%data_size will not yield
-            // the correct answer because data_size is not a power of 2.
-            if ( prod < cons )
-                window_size = (prod + 2*data_size) - cons;
-            else
-                window_size = prod - cons;
-            assert(window_size > 0);
-            assert(window_size <= data_size);
-
-            start_offset = cons % data_size;
-            end_offset = prod % data_size;
-
-            if ( end_offset > start_offset )
-            {
-                /* If window does not wrap, write in one big chunk */
-                write_buffer(i, data[i]+start_offset,
-                             window_size,
-                             window_size);
-            }
-            else
-            {
-                /* If wrapped, write in two chunks:
-                 * - first, start to the end of the buffer
-                 * - second, start of buffer to end of window
-                 */
-                write_buffer(i, data[i] + start_offset,
-                             data_size - start_offset,
-                             window_size);
-                write_buffer(i, data[i],
-                             end_offset,
-                             0);
-            }
-
-            xen_mb(); /* read buffer, then update cons. */
-            meta[i]->cons = prod;
-
-        }
+        fill = sweep_buffers(num);
 
         if ( interrupted )
             break;
 
-        wait_for_event_or_timeout(opts.poll_sleep);
+        /*
+         * Poll more often while some buffer fills quickly, so bursts are
+         * drained before Xen runs out of space, and back off again once
+         * they have calmed down.
+         */
+        if ( (fill > data_size / 2) && (sleep_ms > POLL_SLEEP_MIN_MILLIS) )
+        {
+            sleep_ms /= 2;
+            if ( sleep_ms < POLL_SLEEP_MIN_MILLIS )
+                sleep_ms = POLL_SLEEP_MIN_MILLIS;
+        }
+        else if ( (fill < data_size / 8) && (sleep_ms < opts.poll_sleep) )
+        {
+            sleep_ms *= 2;
+            if ( sleep_ms > opts.poll_sleep )
+                sleep_ms = opts.poll_sleep;
+        }
+
+        wait_for_event_or_timeout(sleep_ms);
     }
 
+    readers_stop(num);
+
     if ( opts.disable_tracing )
         disable_tbufs();
 
+    if ( opts.compress_level )
+        writers_stop(num);
+
     if ( opts.memory_buffer )
+    {
+        write_format_record();
         membuf_dump();
+    }
 
     /* cleanup */
     free(meta);
@@ -753,7 +1216,7 @@ static int monitor_tbufs(void)
 #define xstr(x) str(x)
 #define str(x) #x
 
-const char *program_version     = "xentrace v1.2";
+const char *program_version     = "xentrace v1.3";
 const char *program_bug_address = "<mark.a.williamson@intel.com>";
 
 static void usage(void)
@@ -784,6 +1247,14 @@ static void usage(void)
 "  -V, --version           Print program version\n" \
 "  -M, --memory-buffer=b   Copy trace records to a circular memory buffer.\n" \
 "                          Dump to file on exit.\n" \
+"  -W, --highwater=p       Ask Xen to notify xentrace when a trace buffer is\n" \
+"                          p percent full (default 50).\n" \
+"  -d, --tsc-delta         Ask Xen to store 32-bit TSC deltas rather than\n" \
+"                          full TSCs in records.  Like the buffer size,\n" \
+"                          this is ignored if the buffers already exist.\n" \
+"  -z, --compress[=l]      Write gzip-compressed output at level l\n" \
+"                          (default " xstr(DEFAULT_COMPRESS_LEVEL) "), using one thread per CPU.\n" \
+"                          Cannot be combined with --memory-buffer.\n" \
 "\n" \
 "This tool is used to capture trace buffer data from Xen. The\n" \
 "data is output in a binary format, in the following order:\n" \
@@ -900,6 +1371,9 @@ static void parse_args(int argc, char **argv)
         { "reserve-disk-space", required_argument, 0, 'r' },
         { "time-interval",  required_argument, 0, 'T' },
         { "memory-buffer",  required_argument, 0, 'M' },
+        { "highwater",      required_argument, 0, 'W' },
+        { "tsc-delta",      no_argument,       0, 'd' },
+        { "compress",       optional_argument, 0, 'z' },
         { "discard-buffers", no_argument,      0, 'D' },
         { "dont-disable-tracing", no_argument, 0, 'x' },
         { "help",           no_argument,       0, '?' },
@@ -907,7 +1381,7 @@ static void parse_args(int argc, char **argv)
         { 0, 0, 0, 0 }
     };
 
-    while ( (option = getopt_long(argc, argv, "t:s:c:e:S:r:T:M:Dx?V",
+    while ( (option = getopt_long(argc, argv, "t:s:c:e:S:r:T:M:W:dz::Dx?V",
                     long_options, NULL)) != -1) 
     {
         switch ( option )
@@ -953,6 +1427,29 @@ static void parse_args(int argc, char **argv)
             opts.memory_buffer = sargtol(optarg, 0);
             break;
 
+        case 'W': /* VIRQ_TBUF threshold */
+            opts.highwater = argtol(optarg, 0);
+            if ( opts.highwater < 1 || opts.highwater > 100 )
+            {
+                fprintf(stderr, "High water mark must be 1-100\n\n");
+                usage();
+            }
+            break;
+
+        case 'd': /* TSC-delta records */
+            opts.tsc_delta = 1;
+            break;
+
+        case 'z': /* gzip output */
+            opts.compress_level =
+                optarg ? argtol(optarg, 0) : DEFAULT_COMPRESS_LEVEL;
+            if ( opts.compress_level < 1 || opts.compress_level > 9 )
+            {
+                fprintf(stderr, "Compression level must be 1-9\n\n");
+                usage();
+            }
+            break;
+
         default:
             usage();
         }
@@ -985,6 +1482,12 @@ int main(int argc, char **argv)
 
     parse_args(argc, argv);
 
+    if ( opts.compress_level && opts.memory_buffer )
+    {
+        fprintf(stderr, "--compress cannot be used with --memory-buffer.\n");
+        exit(EXIT_FAILURE);
+    }
+
     xc_handle = xc_interface_open();
     if ( xc_handle < 0 ) 
     {
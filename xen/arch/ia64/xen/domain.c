@@ -360,6 +360,7 @@ static void continue_cpu_idle_loop(void)
 #else
 	    irq_stat[cpu].idle_timestamp = jiffies;
 #endif
+	    page_scrub_idle();
 	    while ( !softirq_pending(cpu) )
 	        default_idle();
 	    raise_softirq(SCHEDULE_SOFTIRQ);
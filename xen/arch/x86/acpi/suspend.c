@@ -72,6 +72,10 @@ void restore_rest_processor_state(void)
         write_debugreg(7, v->arch.guest_context.debugreg[7]);
     }
 
+    /* XCR0 is reset to 1 across S3. */
+    if ( cpu_has_xsave_enabled )
+        set_xcr0(this_cpu(xcr0));
+
     /* Reload FPU state on next FPU use. */
     stts();
 
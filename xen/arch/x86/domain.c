@@ -120,6 +120,7 @@ void idle_loop(void)
     {
         if ( cpu_is_offline(smp_processor_id()) )
             play_dead();
+        page_scrub_idle();
         (*pm_idle)();
         do_softirq();
     }
@@ -343,10 +344,16 @@ int vcpu_initialise(struct vcpu *v)
 
     paging_vcpu_init(v);
 
+    if ( !is_idle_domain(d) && ((rc = xsave_alloc_save_area(v)) != 0) )
+        return rc;
+
     if ( is_hvm_domain(d) )
     {
         if ( (rc = hvm_vcpu_initialise(v)) != 0 )
+        {
+            xsave_free_save_area(v);
             return rc;
+        }
     }
     else
     {
@@ -376,7 +383,11 @@ int vcpu_initialise(struct vcpu *v)
 
     spin_lock_init(&v->arch.shadow_ldt_lock);
 
-    return (is_pv_32on64_vcpu(v) ? setup_compat_l4(v) : 0);
+    rc = is_pv_32on64_vcpu(v) ? setup_compat_l4(v) : 0;
+    if ( rc != 0 )
+        xsave_free_save_area(v);
+
+    return rc;
 }
 
 void vcpu_destroy(struct vcpu *v)
@@ -386,6 +397,8 @@ void vcpu_destroy(struct vcpu *v)
 
     if ( is_hvm_vcpu(v) )
         hvm_vcpu_destroy(v);
+
+    xsave_free_save_area(v);
 }
 
 int arch_domain_create(struct domain *d, unsigned int domcr_flags)
@@ -660,6 +673,8 @@ int arch_set_info_guest(
         XLAT_vcpu_guest_context(&v->arch.guest_context, c.cmp);
 #endif
 
+    fpu_ctxt_to_xsave(v);
+
     v->arch.guest_context.user_regs.eflags |= 2;
 
     if ( is_hvm_vcpu(v) )
@@ -1287,7 +1302,7 @@ static void __context_switch(void)
         memcpy(&p->arch.guest_context.user_regs,
                stack_regs,
                CTXT_SWITCH_STACK_BYTES);
-        unlazy_fpu(p);
+        fpu_ctxt_switch_from(p);
         p->arch.ctxt_switch_from(p);
     }
 
@@ -1297,6 +1312,7 @@ static void __context_switch(void)
                &n->arch.guest_context.user_regs,
                CTXT_SWITCH_STACK_BYTES);
         n->arch.ctxt_switch_to(n);
+        fpu_ctxt_switch_to(n);
     }
 
     if ( p->domain != n->domain )
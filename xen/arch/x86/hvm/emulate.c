@@ -951,6 +951,48 @@ static struct x86_emulate_ops hvm_emulate_ops = {
     .invlpg        = hvmemul_invlpg
 };
 
+/*
+ * Find a cached decode of the instruction in the prefetch buffer, or claim
+ * an entry for x86_emulate() to fill in. Hot MMIO sites (e.g., a driver
+ * polling a device register) then skip prefix/ModRM decode on later exits.
+ */
+static struct x86_emulate_decode *hvmemul_decode_cache_lookup(
+    struct hvm_emulate_ctxt *hvmemul_ctxt)
+{
+    struct vcpu *curr = current;
+    struct hvm_decode_cache_entry *ent;
+    unsigned long eip = hvmemul_ctxt->insn_buf_eip;
+    unsigned long cr3 = curr->arch.hvm_vcpu.guest_cr[3];
+    unsigned int i;
+
+    /* We can only vouch for the bytes if we managed to prefetch them. */
+    if ( hvmemul_ctxt->insn_buf_bytes != sizeof(hvmemul_ctxt->insn_buf) )
+        return NULL;
+
+    for ( i = 0; i < HVM_DECODE_CACHE_SIZE; i++ )
+    {
+        ent = &curr->arch.hvm_vcpu.decode_cache[i];
+        if ( ent->decode.valid && (ent->eip == eip) && (ent->cr3 == cr3) &&
+             (ent->decode.addr_size == hvmemul_ctxt->ctxt.addr_size) &&
+             !memcmp(ent->insn, hvmemul_ctxt->insn_buf, ent->decode.len) )
+        {
+            perfc_incr(hvm_decode_cache_hit);
+            return &ent->decode;
+        }
+    }
+
+    perfc_incr(hvm_decode_cache_miss);
+
+    i = curr->arch.hvm_vcpu.decode_cache_next++ % HVM_DECODE_CACHE_SIZE;
+    ent = &curr->arch.hvm_vcpu.decode_cache[i];
+    ent->cr3 = cr3;
+    ent->eip = eip;
+    memcpy(ent->insn, hvmemul_ctxt->insn_buf, sizeof(ent->insn));
+    ent->decode.valid = 0;
+
+    return &ent->decode;
+}
+
 int hvm_emulate_one(
     struct hvm_emulate_ctxt *hvmemul_ctxt)
 {
@@ -987,6 +1029,8 @@ int hvm_emulate_one(
              sizeof(hvmemul_ctxt->insn_buf), pfec))
         ? sizeof(hvmemul_ctxt->insn_buf) : 0;
 
+    hvmemul_ctxt->ctxt.decode = hvmemul_decode_cache_lookup(hvmemul_ctxt);
+
     hvmemul_ctxt->exn_pending = 0;
 
     rc = x86_emulate(&hvmemul_ctxt->ctxt, &hvm_emulate_ops);
@@ -49,6 +49,7 @@
 #include <asm/hvm/hvm.h>
 #include <asm/hvm/vpt.h>
 #include <asm/hvm/support.h>
+#include <asm/i387.h>
 #include <asm/hvm/cacheattr.h>
 #include <asm/hvm/trace.h>
 #include <public/sched.h>
@@ -502,7 +503,10 @@ static int hvm_save_cpu_ctxt(struct domain *d, hvm_domain_context_t *h)
         vc = &v->arch.guest_context;
 
         if ( v->fpu_initialised )
+        {
+            xsave_to_fpu_ctxt(v);
             memcpy(ctxt.fpu_regs, &vc->fpu_ctxt, sizeof(ctxt.fpu_regs));
+        }
         else 
             memset(ctxt.fpu_regs, 0, sizeof(ctxt.fpu_regs));
 
@@ -675,6 +679,7 @@ static int hvm_load_cpu_ctxt(struct domain *d, hvm_domain_context_t *h)
     hvm_set_segment_register(v, x86_seg_ldtr, &seg);
 
     memcpy(&vc->fpu_ctxt, ctxt.fpu_regs, sizeof(ctxt.fpu_regs));
+    fpu_ctxt_to_xsave(v);
 
     vc->user_regs.eax = ctxt.rax;
     vc->user_regs.ebx = ctxt.rbx;
@@ -717,6 +722,84 @@ static int hvm_load_cpu_ctxt(struct domain *d, hvm_domain_context_t *h)
 HVM_REGISTER_SAVE_RESTORE(CPU, hvm_save_cpu_ctxt, hvm_load_cpu_ctxt,
                           1, HVMSR_PER_VCPU);
 
+static int hvm_save_cpu_xsave(struct domain *d, hvm_domain_context_t *h)
+{
+    struct vcpu *v;
+    struct hvm_hw_cpu_xsave ctxt;
+
+    if ( !cpu_has_xsave_enabled )
+        return 0;
+
+    for_each_vcpu ( d, v )
+    {
+        if ( !v->fpu_initialised || (v->arch.xsave_area == NULL) )
+            continue;
+
+        memset(&ctxt, 0, sizeof(ctxt));
+        ctxt.xfeature_mask = xfeature_mask;
+        ctxt.xcr0 = v->arch.xcr0;
+        ctxt.xcr0_accum = v->arch.xcr0_accum;
+        memcpy(&ctxt.save_area, v->arch.xsave_area, sizeof(ctxt.save_area));
+
+        if ( hvm_save_entry(CPU_XSAVE, v->vcpu_id, h, &ctxt) != 0 )
+            return 1;
+    }
+
+    return 0;
+}
+
+static int hvm_load_cpu_xsave(struct domain *d, hvm_domain_context_t *h)
+{
+    int vcpuid;
+    struct vcpu *v;
+    struct hvm_hw_cpu_xsave ctxt;
+
+    vcpuid = hvm_load_instance(h);
+    if ( vcpuid >= d->max_vcpus || (v = d->vcpu[vcpuid]) == NULL )
+    {
+        gdprintk(XENLOG_ERR, "HVM restore: domain has no vcpu %u\n", vcpuid);
+        return -EINVAL;
+    }
+
+    if ( hvm_load_entry(CPU_XSAVE, h, &ctxt) != 0 )
+        return -EINVAL;
+
+    /* Legacy state alone is fully described by the CPU record. */
+    if ( v->arch.xsave_area == NULL )
+    {
+        if ( ctxt.xcr0_accum & ~XSTATE_FP_SSE )
+        {
+            gdprintk(XENLOG_ERR, "HVM restore: vcpu %u has extended state "
+                     "%#"PRIx64" but XSAVE is not enabled\n",
+                     vcpuid, ctxt.xcr0_accum);
+            return -EINVAL;
+        }
+        return 0;
+    }
+
+    if ( !(ctxt.xcr0 & XSTATE_FP) ||
+         (ctxt.xcr0 & ~ctxt.xcr0_accum) ||
+         (ctxt.xcr0_accum & ~xfeature_mask) ||
+         (ctxt.save_area.hdr.xstate_bv & ~ctxt.xcr0_accum) )
+    {
+        gdprintk(XENLOG_ERR, "HVM restore: vcpu %u has unsupported XSAVE "
+                 "state (xcr0 %#"PRIx64", accum %#"PRIx64", host %#"PRIx64")\n",
+                 vcpuid, ctxt.xcr0, ctxt.xcr0_accum, xfeature_mask);
+        return -EINVAL;
+    }
+
+    v->arch.xcr0 = ctxt.xcr0;
+    v->arch.xcr0_accum = ctxt.xcr0_accum;
+    memcpy(v->arch.xsave_area, &ctxt.save_area, sizeof(ctxt.save_area));
+    memset(v->arch.xsave_area->xsave_hdr.reserved, 0,
+           sizeof(v->arch.xsave_area->xsave_hdr.reserved));
+
+    return 0;
+}
+
+HVM_REGISTER_SAVE_RESTORE(CPU_XSAVE, hvm_save_cpu_xsave, hvm_load_cpu_xsave,
+                          1, HVMSR_PER_VCPU);
+
 int hvm_vcpu_initialise(struct vcpu *v)
 {
     int rc;
@@ -1739,6 +1822,7 @@ void hvm_cpuid(unsigned int input, unsigned int *eax, unsigned int *ebx,
                                    unsigned int *ecx, unsigned int *edx)
 {
     struct vcpu *v = current;
+    unsigned int count = *ecx;
 
     if ( cpuid_viridian_leaves(input, eax, ebx, ecx, edx) )
         return;
@@ -1750,12 +1834,56 @@ void hvm_cpuid(unsigned int input, unsigned int *eax, unsigned int *ebx,
 
     switch ( input )
     {
+    case 0x0:
+        /* Leaf 0xd is synthesised below for guests offered XSAVE. */
+        if ( cpu_has_xsave_enabled && (*eax < XSTATE_CPUID) )
+        {
+            unsigned int a, b, c, d;
+            domain_cpuid(v->domain, 1, 0, &a, &b, &c, &d);
+            if ( c & bitmaskof(X86_FEATURE_XSAVE) )
+                *eax = XSTATE_CPUID;
+        }
+        break;
     case 0x1:
         /* Fix up VLAPIC details. */
         *ebx &= 0x00FFFFFFu;
         *ebx |= (v->vcpu_id * 2) << 24;
         if ( vlapic_hw_disabled(vcpu_vlapic(v)) )
             __clear_bit(X86_FEATURE_APIC & 31, edx);
+        /* OSXSAVE reflects the guest's CR4, not Xen's. */
+        __clear_bit(X86_FEATURE_OSXSAVE & 31, ecx);
+        if ( !cpu_has_xsave_enabled )
+        {
+            __clear_bit(X86_FEATURE_XSAVE & 31, ecx);
+            __clear_bit(X86_FEATURE_AVX & 31, ecx);
+        }
+        else if ( v->arch.hvm_vcpu.guest_cr[4] & X86_CR4_OSXSAVE )
+            __set_bit(X86_FEATURE_OSXSAVE & 31, ecx);
+        break;
+    case XSTATE_CPUID:
+        /* Only the components Xen saves and restores may be enabled. */
+        if ( !cpu_has_xsave_enabled || (count > 2) )
+        {
+            *eax = *ebx = *ecx = *edx = 0;
+            break;
+        }
+        cpuid_count(XSTATE_CPUID, count, eax, ebx, ecx, edx);
+        if ( count == 0 )
+        {
+            *eax &= (u32)xfeature_mask;
+            *edx &= (u32)(xfeature_mask >> 32);
+            *ebx = XSTATE_YMM_OFFSET +
+                ((v->arch.xcr0 & XSTATE_YMM) ? XSTATE_YMM_SIZE : 0);
+            *ecx = xsave_cntxt_size;
+        }
+        else if ( count == 1 )
+        {
+            /* XSAVEOPT only. */
+            *eax &= 1;
+            *ebx = *ecx = *edx = 0;
+        }
+        else if ( !(xfeature_mask & XSTATE_YMM) )
+            *eax = *ebx = *ecx = *edx = 0;
         break;
     case 0xb:
         /* Fix the x2APIC identifier. */
@@ -1764,6 +1892,17 @@ void hvm_cpuid(unsigned int input, unsigned int *eax, unsigned int *ebx,
     }
 }
 
+int hvm_handle_xsetbv(u32 index, u64 new_bv)
+{
+    if ( xsetbv_guest(current, index, new_bv) != 0 )
+    {
+        hvm_inject_exception(TRAP_gp_fault, 0, 0);
+        return -1;
+    }
+
+    return 0;
+}
+
 void hvm_rdtsc_intercept(struct cpu_user_regs *regs)
 {
     uint64_t tsc;
@@ -323,6 +323,8 @@ struct hvm_intack hvm_vcpu_has_pending_irq(struct vcpu *v)
     struct hvm_domain *plat = &v->domain->arch.hvm_domain;
     int vector;
 
+    vlapic_sync_irr(v);
+
     if ( unlikely(v->nmi_pending) )
         return hvm_intack_nmi;
 
@@ -715,6 +715,9 @@ static void svm_do_resume(struct vcpu *v)
     v->arch.hvm_svm.vmcb->vintr.fields.tpr = 
         (vlapic_get_reg(vcpu_vlapic(v), APIC_TASKPRI) & 0xFF) >> 4;
 
+    if ( fpu_restore_eager(v) )
+        svm_fpu_dirty_intercept();
+
     hvm_do_resume(v);
     reset_stack_and_jump(svm_asm_do_resume);
 }
@@ -1233,6 +1236,18 @@ static void svm_vmexit_do_rdtsc(struct cpu_user_regs *regs)
     hvm_rdtsc_intercept(regs);
 }
 
+static void svm_vmexit_do_xsetbv(struct cpu_user_regs *regs)
+{
+    unsigned int inst_len;
+    u64 new_bv = ((u64)regs->edx << 32) | (u32)regs->eax;
+
+    if ( (inst_len = __get_instruction_length(current, INSTR_XSETBV)) == 0 )
+        return;
+
+    if ( hvm_handle_xsetbv(regs->ecx, new_bv) == 0 )
+        __update_guest_eip(regs, inst_len);
+}
+
 static void svm_vmexit_ud_intercept(struct cpu_user_regs *regs)
 {
     struct hvm_emulate_ctxt ctxt;
@@ -1419,6 +1434,10 @@ asmlinkage void svm_vmexit_handler(struct cpu_user_regs *regs)
         svm_vmexit_do_invalidate_cache(regs);
         break;
 
+    case VMEXIT_XSETBV:
+        svm_vmexit_do_xsetbv(regs);
+        break;
+
     case VMEXIT_TASK_SWITCH: {
         enum hvm_task_switch_reason reason;
         int32_t errcode = -1;
@@ -29,6 +29,7 @@
 #include <xen/lib.h>
 #include <xen/sched.h>
 #include <xen/numa.h>
+#include <xen/perfc.h>
 #include <asm/current.h>
 #include <asm/page.h>
 #include <asm/hvm/hvm.h>
@@ -112,38 +113,113 @@ static int vlapic_find_highest_vector(void *bitmap)
 
 /*
  * IRR-specific bitmap update & search routines.
+ *
+ * Senders post vectors straight into the IRR with atomic bitops and then set
+ * irr_dirty. Only the sender which sets irr_dirty needs to kick the target:
+ * the flag stays set until the target next scans its IRR, which it does on
+ * its way back into guest context, so later senders know a notification is
+ * already in flight. While irr_dirty is clear, nothing has been added to the
+ * IRR since the vcpu last looked and its cached highest vector still holds.
+ * The target consumes irr_dirty on every pass through interrupt assist, see
+ * vlapic_sync_irr(), whether or not it goes on to look at the IRR.
  */
 
+#define VLAPIC_VECTOR_UNKNOWN (-2)
+
 static int vlapic_test_and_set_irr(int vector, struct vlapic *vlapic)
 {
     return vlapic_test_and_set_vector(vector, &vlapic->regs->data[APIC_IRR]);
 }
 
+/* Returns non-zero if the caller must notify the target vcpu. */
+static int vlapic_mark_irr_dirty(struct vlapic *vlapic)
+{
+    if ( !test_and_set_bit(0, &vlapic->irr_dirty) )
+        return 1;
+    perfc_incr(vlapic_notify_coalesced);
+    return 0;
+}
+
 static void vlapic_clear_irr(int vector, struct vlapic *vlapic)
 {
     vlapic_clear_vector(vector, &vlapic->regs->data[APIC_IRR]);
+    if ( vector == vlapic->irr_highest )
+        vlapic->irr_highest = VLAPIC_VECTOR_UNKNOWN;
+}
+
+/*
+ * Consume a pending notification: later senders must kick again, and the
+ * cached highest vector no longer holds. Only the vcpu itself does this.
+ */
+static void vlapic_consume_irr_dirty(struct vlapic *vlapic)
+{
+    ASSERT(vlapic_vcpu(vlapic) == current);
+    if ( test_and_clear_bit(0, &vlapic->irr_dirty) )
+        vlapic->irr_highest = VLAPIC_VECTOR_UNKNOWN;
+}
+
+void vlapic_sync_irr(struct vcpu *v)
+{
+    if ( v == current )
+        vlapic_consume_irr_dirty(vcpu_vlapic(v));
 }
 
 static int vlapic_find_highest_irr(struct vlapic *vlapic)
 {
-    return vlapic_find_highest_vector(&vlapic->regs->data[APIC_IRR]);
+    /* Only the vcpu itself consumes notifications and updates the cache. */
+    if ( vlapic_vcpu(vlapic) != current )
+        return vlapic_find_highest_vector(&vlapic->regs->data[APIC_IRR]);
+
+    vlapic_consume_irr_dirty(vlapic);
+    if ( vlapic->irr_highest == VLAPIC_VECTOR_UNKNOWN )
+        vlapic->irr_highest =
+            vlapic_find_highest_vector(&vlapic->regs->data[APIC_IRR]);
+    else
+        perfc_incr(vlapic_irr_scan_avoided);
+
+    return vlapic->irr_highest;
 }
 
+/* Record @vec's trigger mode, ahead of posting it in the IRR. */
+static void vlapic_set_tmr(int vector, int trig, struct vlapic *vlapic)
+{
+    if ( trig )
+        vlapic_set_vector(vector, &vlapic->regs->data[APIC_TMR]);
+    else
+        vlapic_clear_vector(vector, &vlapic->regs->data[APIC_TMR]);
+}
+
+/*
+ * Post @vec to @vlapic. Returns non-zero if the caller should kick the
+ * target vcpu: zero if the vector was already pending, or if a kick for
+ * some earlier vector has not yet been acted upon.
+ */
 int vlapic_set_irq(struct vlapic *vlapic, uint8_t vec, uint8_t trig)
 {
-    int ret;
+    vlapic_set_tmr(vec, trig, vlapic);
 
-    ret = !vlapic_test_and_set_irr(vec, vlapic);
-    if ( trig )
-        vlapic_set_vector(vec, &vlapic->regs->data[APIC_TMR]);
+    if ( vlapic_test_and_set_irr(vec, vlapic) )
+        return 0;
 
-    /* We may need to wake up target vcpu, besides set pending bit here */
-    return ret;
+    return vlapic_mark_irr_dirty(vlapic);
 }
 
 static int vlapic_find_highest_isr(struct vlapic *vlapic)
 {
-    return vlapic_find_highest_vector(&vlapic->regs->data[APIC_ISR]);
+    /* The ISR is only changed by the vcpu itself, on ack and EOI. */
+    if ( vlapic_vcpu(vlapic) != current )
+        return vlapic_find_highest_vector(&vlapic->regs->data[APIC_ISR]);
+
+    if ( vlapic->isr_highest == VLAPIC_VECTOR_UNKNOWN )
+        vlapic->isr_highest =
+            vlapic_find_highest_vector(&vlapic->regs->data[APIC_ISR]);
+
+    return vlapic->isr_highest;
+}
+
+static void vlapic_invalidate_highest(struct vlapic *vlapic)
+{
+    vlapic->irr_highest = vlapic->isr_highest = VLAPIC_VECTOR_UNKNOWN;
 }
 
 uint32_t vlapic_get_ppr(struct vlapic *vlapic)
@@ -326,21 +402,24 @@ static int vlapic_accept_irq(struct vcpu *v, int delivery_mode,
         if ( unlikely(!vlapic_enabled(vlapic)) )
             break;
 
-        if ( vlapic_test_and_set_irr(vector, vlapic) && trig_mode )
+        vlapic_set_tmr(vector, trig_mode, vlapic);
+
+        if ( vlapic_test_and_set_irr(vector, vlapic) )
         {
-            HVM_DBG_LOG(DBG_LEVEL_VLAPIC,
-                        "level trig mode repeatedly for vector %d", vector);
+            if ( trig_mode )
+                HVM_DBG_LOG(DBG_LEVEL_VLAPIC,
+                            "level trig mode repeatedly for vector %d",
+                            vector);
+            /* Already pending: the target has been notified. */
             break;
         }
 
         if ( trig_mode )
-        {
             HVM_DBG_LOG(DBG_LEVEL_VLAPIC,
                         "level trig mode for vector %d", vector);
-            vlapic_set_vector(vector, &vlapic->regs->data[APIC_TMR]);
-        }
 
-        vcpu_kick(v);
+        if ( vlapic_mark_irr_dirty(vlapic) )
+            vcpu_kick(v);
         break;
 
     case APIC_DM_REMRD:
@@ -414,6 +493,7 @@ void vlapic_EOI_set(struct vlapic *vlapic)
         return;
 
     vlapic_clear_vector(vector, &vlapic->regs->data[APIC_ISR]);
+    vlapic->isr_highest = VLAPIC_VECTOR_UNKNOWN;
 
     if ( vlapic_test_and_clear_vector(vector, &vlapic->regs->data[APIC_TMR]) )
         vioapic_update_EOI(vlapic_domain(vlapic), vector);
@@ -845,6 +925,9 @@ int vlapic_ack_pending_irq(struct vcpu *v, int vector)
     struct vlapic *vlapic = vcpu_vlapic(v);
 
     vlapic_set_vector(vector, &vlapic->regs->data[APIC_ISR]);
+    if ( (vlapic->isr_highest != VLAPIC_VECTOR_UNKNOWN) &&
+         (vector > vlapic->isr_highest) )
+        vlapic->isr_highest = vector;
     vlapic_clear_irr(vector, vlapic);
 
     return 1;
@@ -865,6 +948,7 @@ void vlapic_reset(struct vlapic *vlapic)
         vlapic_set_reg(vlapic, APIC_ISR + 0x10 * i, 0);
         vlapic_set_reg(vlapic, APIC_TMR + 0x10 * i, 0);
     }
+    vlapic_invalidate_highest(vlapic);
     vlapic_set_reg(vlapic, APIC_ICR,     0);
     vlapic_set_reg(vlapic, APIC_ICR2,    0);
     vlapic_set_reg(vlapic, APIC_LDR,     0);
@@ -975,6 +1059,7 @@ static int lapic_load_regs(struct domain *d, hvm_domain_context_t *h)
     
     if ( hvm_load_entry(LAPIC_REGS, h, s->regs) != 0 ) 
         return -EINVAL;
+    vlapic_invalidate_highest(s);
 
     vlapic_adjust_i8259_target(d);
     lapic_rearm(s);
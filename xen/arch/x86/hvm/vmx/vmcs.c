@@ -955,6 +955,9 @@ void vmx_do_resume(struct vcpu *v)
         vmx_update_debug_state(v);
     }
 
+    if ( fpu_restore_eager(v) )
+        hvm_funcs.fpu_dirty_intercept();
+
     hvm_do_resume(v);
     reset_stack_and_jump(vmx_asm_do_vmentry);
 }
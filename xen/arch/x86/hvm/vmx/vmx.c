@@ -2587,6 +2587,18 @@ asmlinkage void vmx_vmexit_handler(struct cpu_user_regs *regs)
         break;
     }
 
+    case EXIT_REASON_XSETBV:
+    {
+        u64 new_bv = ((u64)regs->edx << 32) | (u32)regs->eax;
+
+        if ( hvm_handle_xsetbv(regs->ecx, new_bv) == 0 )
+        {
+            inst_len = __get_instruction_length(); /* Safe: XSETBV */
+            __update_guest_eip(inst_len);
+        }
+        break;
+    }
+
     case EXIT_REASON_EPT_VIOLATION:
     {
         paddr_t gpa = __vmread(GUEST_PHYSICAL_ADDRESS);
@@ -18,6 +18,7 @@
  */
 
 #include <xen/time.h>
+#include <xen/perfc.h>
 #include <asm/hvm/support.h>
 #include <asm/hvm/vpt.h>
 #include <asm/event.h>
@@ -25,6 +26,24 @@
 #define mode_is(d, name) \
     ((d)->arch.hvm_domain.params[HVM_PARAM_TIMER_MODE] == HVMPTM_##name)
 
+/*
+ * Periodic ticks may be deferred by up to this many microseconds (but never
+ * by more than a quarter of their period), so that the ticks of many guests
+ * can be delivered from a single wakeup of the host CPU.
+ */
+static unsigned int opt_vpt_slack __read_mostly = 100;
+integer_param("vpt_slack", opt_vpt_slack);
+
+/*
+ * Do not re-arm a periodic timer while an earlier tick is still pending:
+ * its vcpu is either not running or has the interrupt masked, so further
+ * wakeups achieve nothing. The ticks missed meanwhile are accounted for when
+ * the timer is re-armed, on delivery of the pending tick or when the vcpu is
+ * next scheduled.
+ */
+static int opt_vpt_lazy __read_mostly = 1;
+boolean_param("vpt_lazy", opt_vpt_lazy);
+
 void hvm_init_guest_time(struct domain *d)
 {
     struct pl_time *pl = &d->arch.hvm_domain.pl_time;
@@ -120,6 +139,17 @@ static void pt_unlock(struct periodic_time *pt)
     spin_unlock(&pt->vcpu->arch.hvm_vcpu.tm_lock);
 }
 
+static void pt_set_timer(struct periodic_time *pt)
+{
+    s_time_t slack = 0;
+
+    if ( !pt->one_shot )
+        slack = min_t(s_time_t, MICROSECS(opt_vpt_slack), pt->period / 4);
+
+    pt->lazy_stopped = 0;
+    set_timer_range(&pt->timer, pt->scheduled, slack);
+}
+
 static void pt_process_missed_ticks(struct periodic_time *pt)
 {
     s_time_t missed_ticks, now = NOW();
@@ -188,7 +218,7 @@ void pt_restore_timer(struct vcpu *v)
     list_for_each_entry ( pt, head, list )
     {
         pt_process_missed_ticks(pt);
-        set_timer(&pt->timer, pt->scheduled);
+        pt_set_timer(pt);
     }
 
     pt_thaw_time(v);
@@ -202,6 +232,8 @@ static void pt_timer_fn(void *data)
 
     pt_lock(pt);
 
+    perfc_incr(vpt_timer_fired);
+
     pt->pending_intr_nr++;
     pt->do_not_freeze = 0;
 
@@ -209,7 +241,14 @@ static void pt_timer_fn(void *data)
     {
         pt->scheduled += pt->period;
         pt_process_missed_ticks(pt);
-        set_timer(&pt->timer, pt->scheduled);
+        if ( opt_vpt_lazy && (pt->pending_intr_nr > 1) )
+        {
+            /* Previous tick not yet taken: wait for the vcpu to catch up. */
+            pt->lazy_stopped = 1;
+            perfc_incr(vpt_timer_lazy_stop);
+        }
+        else
+            pt_set_timer(pt);
     }
 
     if ( !pt_irq_masked(pt) )
@@ -301,6 +340,13 @@ void pt_intr_post(struct vcpu *v, struct hvm_intack intack)
     }
     else
     {
+        if ( pt->lazy_stopped )
+        {
+            /* Account the ticks we slept through, then resume ticking. */
+            pt_process_missed_ticks(pt);
+            pt_set_timer(pt);
+        }
+
         if ( mode_is(v->domain, one_missed_tick_pending) ||
              mode_is(v->domain, no_missed_ticks_pending) )
         {
@@ -339,7 +385,7 @@ void pt_reset(struct vcpu *v)
         pt->pending_intr_nr = 0;
         pt->last_plt_gtime = hvm_get_guest_time(pt->vcpu);
         pt->scheduled = NOW() + pt->period;
-        set_timer(&pt->timer, pt->scheduled);
+        pt_set_timer(pt);
     }
 
     spin_unlock(&v->arch.hvm_vcpu.tm_lock);
@@ -371,6 +417,7 @@ void create_periodic_time(
     pt->pending_intr_nr = 0;
     pt->do_not_freeze = 0;
     pt->irq_issued = 0;
+    pt->lazy_stopped = 0;
 
     /* Periodic timer must be at least 0.1ms. */
     if ( (period < 100000) && period )
@@ -414,7 +461,7 @@ void create_periodic_time(
     list_add(&pt->list, &v->arch.hvm_vcpu.tm_list);
 
     init_timer(&pt->timer, pt_timer_fn, pt, v->processor);
-    set_timer(&pt->timer, pt->scheduled);
+    pt_set_timer(pt);
 
     spin_unlock(&v->arch.hvm_vcpu.tm_lock);
 }
@@ -10,18 +10,260 @@
 
 #include <xen/config.h>
 #include <xen/sched.h>
+#include <xen/perfc.h>
 #include <asm/current.h>
 #include <asm/processor.h>
 #include <asm/hvm/support.h>
 #include <asm/i387.h>
 #include <asm/asm_defns.h>
 
+/*
+ * FPU state is switched lazily by default: CR0.TS is set when a vcpu is
+ * scheduled in and its state is only restored on the first #NM. A vcpu that
+ * keeps using the FPU in consecutive time slices takes that trap every
+ * time, so after 'fpu_eager' such slices its state is restored as soon as
+ * it is scheduled in instead. Every FPU_EAGER_RESAMPLE switches a slice is
+ * run lazily again, to notice if the vcpu has stopped using the FPU.
+ * fpu_eager=0 disables eager restore altogether.
+ */
+static unsigned int __read_mostly fpu_eager_threshold = 4;
+integer_param("fpu_eager", fpu_eager_threshold);
+#define FPU_EAGER_RESAMPLE 32
+
+/* Use XSAVE/XRSTOR for FPU context if available (disable with "no-xsave"). */
+static int __read_mostly opt_xsave = 1;
+boolean_param("xsave", opt_xsave);
+
+u64 __read_mostly xfeature_mask;
+unsigned int __read_mostly xsave_cntxt_size;
+static bool_t __read_mostly cpu_has_xsaveopt;
+
+/* Cached value of XCR0 on each cpu. */
+DEFINE_PER_CPU(u64, xcr0);
+
+#ifdef __x86_64__
+#define XSAVE_INSN    ".byte 0x48,0x0f,0xae,0x27" /* xsaveq (%rdi)    */
+#define XSAVEOPT_INSN ".byte 0x48,0x0f,0xae,0x37" /* xsaveoptq (%rdi) */
+#define XRSTOR_INSN   ".byte 0x48,0x0f,0xae,0x2f" /* xrstorq (%rdi)   */
+#else
+#define XSAVE_INSN    ".byte 0x0f,0xae,0x27"      /* xsave (%edi)     */
+#define XSAVEOPT_INSN ".byte 0x0f,0xae,0x37"      /* xsaveopt (%edi)  */
+#define XRSTOR_INSN   ".byte 0x0f,0xae,0x2f"      /* xrstor (%edi)    */
+#endif
+
+static void xsave_set_xcr0(u64 xfeatures)
+{
+    if ( this_cpu(xcr0) != xfeatures )
+    {
+        set_xcr0(xfeatures);
+        this_cpu(xcr0) = xfeatures;
+    }
+}
+
+void __cpuinit xsave_init(void)
+{
+    u32 eax, ebx, ecx, edx;
+    u64 mask;
+
+    if ( !boot_cpu_has(X86_FEATURE_XSAVE) )
+        return;
+
+    if ( !opt_xsave || (boot_cpu_data.cpuid_level < XSTATE_CPUID) )
+        goto disable;
+
+    cpuid_count(XSTATE_CPUID, 0, &eax, &ebx, &ecx, &edx);
+    mask = (((u64)edx << 32) | eax) & XCNTXT_MASK;
+    if ( (mask & XSTATE_FP_SSE) != XSTATE_FP_SSE )
+        goto disable;
+
+    set_in_cr4(X86_CR4_OSXSAVE);
+    set_xcr0(mask);
+    this_cpu(xcr0) = mask;
+
+    /* EBX now reports the save area size for the features in XCR0. */
+    cpuid_count(XSTATE_CPUID, 0, &eax, &ebx, &ecx, &edx);
+    BUG_ON(ebx > sizeof(struct xsave_struct));
+
+    if ( xfeature_mask == 0 )
+    {
+        xfeature_mask = mask;
+        xsave_cntxt_size = ebx;
+        cpuid_count(XSTATE_CPUID, 1, &eax, &ebx, &ecx, &edx);
+        cpu_has_xsaveopt = !!(eax & 1);
+        printk("XSAVE enabled: features %#"PRIx64", context size %u%s\n",
+               xfeature_mask, xsave_cntxt_size,
+               cpu_has_xsaveopt ? ", XSAVEOPT" : "");
+    }
+    else
+    {
+        /* All cpus must agree: vcpus move freely between them. */
+        BUG_ON(mask != xfeature_mask);
+        BUG_ON(ebx != xsave_cntxt_size);
+    }
+    return;
+
+ disable:
+    /* Only reachable on the boot cpu, before any vcpu exists. */
+    BUG_ON(xfeature_mask != 0);
+    clear_bit(X86_FEATURE_XSAVE, boot_cpu_data.x86_capability);
+}
+
+int xsave_alloc_save_area(struct vcpu *v)
+{
+    struct xsave_struct *area;
+
+    if ( !cpu_has_xsave_enabled )
+        return 0;
+
+    area = xmalloc(struct xsave_struct);
+    if ( area == NULL )
+        return -ENOMEM;
+    memset(area, 0, sizeof(*area));
+
+    /* Default FCW and MXCSR, as loaded by init_fpu(). */
+    *(u16 *)&area->fpu_sse.x[0] = 0x37f;
+    *(u32 *)&area->fpu_sse.x[24] = 0x1f80;
+
+    v->arch.xsave_area = area;
+    v->arch.xcr0 = XSTATE_FP_SSE;
+    v->arch.xcr0_accum = XSTATE_FP_SSE;
+
+    return 0;
+}
+
+void xsave_free_save_area(struct vcpu *v)
+{
+    xfree(v->arch.xsave_area);
+    v->arch.xsave_area = NULL;
+}
+
+/*
+ * The 512-byte legacy region of the XSAVE area has the FXSAVE layout and
+ * is copied to and from guest_context.fpu_ctxt, which remains the format
+ * seen by the toolstack and the HVM save/restore code.
+ */
+void xsave_to_fpu_ctxt(struct vcpu *v)
+{
+    struct xsave_struct *area = v->arch.xsave_area;
+    char *fpu_ctxt = v->arch.guest_context.fpu_ctxt.x;
+
+    if ( area == NULL )
+        return;
+
+    memcpy(fpu_ctxt, area->fpu_sse.x, sizeof(area->fpu_sse));
+
+    /* Components in their initial state may not have been written out. */
+    if ( !(area->xsave_hdr.xstate_bv & XSTATE_FP) )
+    {
+        memset(fpu_ctxt, 0, 24);
+        memset(fpu_ctxt + 32, 0, 128);
+        *(u16 *)fpu_ctxt = 0x37f;
+    }
+    if ( !(area->xsave_hdr.xstate_bv & XSTATE_SSE) )
+        memset(fpu_ctxt + 160, 0, 256);
+}
+
+void fpu_ctxt_to_xsave(struct vcpu *v)
+{
+    struct xsave_struct *area = v->arch.xsave_area;
+
+    if ( area == NULL )
+        return;
+
+    memcpy(area->fpu_sse.x, v->arch.guest_context.fpu_ctxt.x,
+           sizeof(area->fpu_sse));
+    area->xsave_hdr.xstate_bv |= XSTATE_FP_SSE;
+}
+
+/* Emulate XSETBV for @v (which must be current). Returns -EINVAL on #GP. */
+int xsetbv_guest(struct vcpu *v, u32 index, u64 new_bv)
+{
+    ASSERT(v == current);
+
+    if ( (index != 0) || !cpu_has_xsave_enabled ||
+         !(new_bv & XSTATE_FP) || (new_bv & ~xfeature_mask) ||
+         ((new_bv & XSTATE_YMM) && !(new_bv & XSTATE_SSE)) )
+        return -EINVAL;
+
+    v->arch.xcr0 = new_bv;
+    v->arch.xcr0_accum |= new_bv;
+    xsave_set_xcr0(new_bv);
+
+    return 0;
+}
+
+static void xsave(struct vcpu *v)
+{
+    struct xsave_struct *ptr = v->arch.xsave_area;
+    u64 mask = v->arch.xcr0_accum;
+
+    /* Save every component the guest has ever enabled. */
+    xsave_set_xcr0(mask);
+    if ( cpu_has_xsaveopt )
+        asm volatile ( XSAVEOPT_INSN
+                       : "=m" (*ptr)
+                       : "a" ((u32)mask), "d" ((u32)(mask >> 32)), "D" (ptr) );
+    else
+        asm volatile ( XSAVE_INSN
+                       : "=m" (*ptr)
+                       : "a" ((u32)mask), "d" ((u32)(mask >> 32)), "D" (ptr) );
+    xsave_set_xcr0(v->arch.xcr0);
+}
+
+static void xrstor(struct vcpu *v)
+{
+    struct xsave_struct *ptr = v->arch.xsave_area;
+    u64 mask = v->arch.xcr0_accum;
+
+    /*
+     * XRSTOR can fault if passed a corrupted data block. As with FXRSTOR
+     * below, handle this by silently clearing the block: an all-zeroes
+     * header loads the initial state of every component.
+     */
+    xsave_set_xcr0(mask);
+    asm volatile (
+        "1: " XRSTOR_INSN "\n"
+        ".section .fixup,\"ax\"   \n"
+        "2: push %%"__OP"ax       \n"
+        "   push %%"__OP"cx       \n"
+        "   push %%"__OP"di       \n"
+        "   mov  %3,%%ecx         \n"
+        "   xor  %%eax,%%eax      \n"
+        "   rep ; stosl           \n"
+        "   pop  %%"__OP"di       \n"
+        "   pop  %%"__OP"cx       \n"
+        "   pop  %%"__OP"ax       \n"
+        "   jmp  1b               \n"
+        ".previous                \n"
+        ".section __ex_table,\"a\"\n"
+        "   "__FIXUP_ALIGN"       \n"
+        "   "__FIXUP_WORD" 1b,2b  \n"
+        ".previous                \n"
+        :
+        : "m" (*ptr), "a" ((u32)mask), "d" ((u32)(mask >> 32)),
+          "i" (sizeof(*ptr)/4), "D" (ptr) );
+    xsave_set_xcr0(v->arch.xcr0);
+}
+
 void init_fpu(void)
 {
-    asm volatile ( "fninit" );
-    if ( cpu_has_xmm )
-        load_mxcsr(0x1f80);
-    current->fpu_initialised = 1;
+    struct vcpu *v = current;
+
+    if ( v->arch.xsave_area != NULL )
+    {
+        /* Load the initial state of every component, including YMM. */
+        memset(&v->arch.xsave_area->xsave_hdr, 0,
+               sizeof(v->arch.xsave_area->xsave_hdr));
+        *(u32 *)&v->arch.xsave_area->fpu_sse.x[24] = 0x1f80;
+        xrstor(v);
+    }
+    else
+    {
+        asm volatile ( "fninit" );
+        if ( cpu_has_xmm )
+            load_mxcsr(0x1f80);
+    }
+    v->fpu_initialised = 1;
 }
 
 void save_init_fpu(struct vcpu *v)
@@ -33,7 +275,26 @@ void save_init_fpu(struct vcpu *v)
     if ( cr0 & X86_CR0_TS )
         clts();
 
-    if ( cpu_has_fxsr )
+    perfc_incr(fpu_save);
+
+    if ( v->arch.xsave_area != NULL )
+    {
+        xsave(v);
+
+        /* Clear exception flags if FSW.ES is set. */
+        if ( unlikely(v->arch.xsave_area->fpu_sse.x[2] & 0x80) )
+            asm volatile ("fnclex");
+
+        /* See the FXSAVE case below. */
+        if ( boot_cpu_data.x86_vendor == X86_VENDOR_AMD )
+        {
+            asm volatile (
+                "emms\n\t"
+                "fildl %0"
+                : : "m" (*fpu_ctxt) );
+        }
+    }
+    else if ( cpu_has_fxsr )
     {
 #ifdef __i386__
         asm volatile (
@@ -83,6 +344,14 @@ void restore_fpu(struct vcpu *v)
 {
     char *fpu_ctxt = v->arch.guest_context.fpu_ctxt.x;
 
+    perfc_incr(fpu_restore);
+
+    if ( v->arch.xsave_area != NULL )
+    {
+        xrstor(v);
+        return;
+    }
+
     /*
      * FXRSTOR can fault if passed a corrupted data block. We handle this
      * possibility, which may occur if the block was passed to us by control
@@ -128,6 +397,56 @@ void restore_fpu(struct vcpu *v)
     }
 }
 
+void fpu_ctxt_switch_from(struct vcpu *v)
+{
+    if ( v->fpu_dirtied )
+    {
+        if ( v->arch.fpu_used < fpu_eager_threshold )
+            v->arch.fpu_used++;
+        save_init_fpu(v);
+    }
+    else
+    {
+        v->arch.fpu_used = 0;
+    }
+
+    v->arch.fpu_eager = ((fpu_eager_threshold != 0) &&
+                         (v->arch.fpu_used >= fpu_eager_threshold));
+}
+
+void fpu_ctxt_switch_to(struct vcpu *v)
+{
+    if ( v->arch.xsave_area != NULL )
+        xsave_set_xcr0(v->arch.xcr0);
+
+    /* HVM vcpus are handled on VM entry, once their VMCS/VMCB is loaded. */
+    if ( !is_hvm_vcpu(v) && fpu_restore_eager(v) )
+        setup_fpu(v);
+}
+
+/*
+ * Should @v's FPU state be restored now, rather than on its first use?
+ * Never if the guest has itself set CR0.TS: it expects to take the #NM.
+ */
+int fpu_restore_eager(struct vcpu *v)
+{
+    unsigned long cr0;
+
+    if ( !v->arch.fpu_eager || v->fpu_dirtied )
+        return 0;
+
+    if ( (++v->arch.fpu_eager_switches % FPU_EAGER_RESAMPLE) == 0 )
+        return 0;
+
+    cr0 = is_hvm_vcpu(v) ? v->arch.hvm_vcpu.guest_cr[0]
+                         : v->arch.guest_context.ctrlreg[0];
+    if ( cr0 & X86_CR0_TS )
+        return 0;
+
+    perfc_incr(fpu_eager_restore);
+    return 1;
+}
+
 /*
  * Local variables:
  * mode: C
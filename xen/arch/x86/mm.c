@@ -113,6 +113,7 @@
 #include <public/sched.h>
 #include <xsm/xsm.h>
 #include <xen/trace.h>
+#include <xen/multicall.h>
 
 /*
  * Mapping of first 2 or 4 megabytes of memory. This is mapped with 4kB
@@ -863,8 +864,12 @@ get_page_from_l2e(
         unsigned long m = mfn;
         int writeable = !!(l2e_get_flags(l2e) & _PAGE_RW);
   
+        /*
+         * Every frame of the superpage is referenced individually, so a
+         * frame mapped writable this way can never become a pagetable.
+         */
         do {
-            rc = get_data_page(mfn_to_page(m), d, writeable);
+            rc = mfn_valid(m) && get_data_page(mfn_to_page(m), d, writeable);
             if ( unlikely(!rc) )
             {
                 while ( m-- > mfn )
@@ -1060,7 +1065,11 @@ void put_page_from_l1e(l1_pgentry_t l1e, struct domain *l1e_owner)
  */
 static int put_page_from_l2e(l2_pgentry_t l2e, unsigned long pfn)
 {
-    if ( !(l2e_get_flags(l2e) & _PAGE_PRESENT) || (l2e_get_pfn(l2e) == pfn) )
+    if ( !(l2e_get_flags(l2e) & _PAGE_PRESENT) )
+        return 1;
+
+    /* Only a linear self-mapping holds no reference (superpages always do). */
+    if ( !(l2e_get_flags(l2e) & _PAGE_PSE) && (l2e_get_pfn(l2e) == pfn) )
         return 1;
 
     if ( l2e_get_flags(l2e) & _PAGE_PSE )
@@ -1125,7 +1134,13 @@ static int put_page_from_l4e(l4_pgentry_t l4e, unsigned long pfn,
 }
 #endif
 
-static int alloc_l1_table(struct page_info *page)
+/*
+ * L1 validation may be preempted every L1_VALIDATE_BATCH entries, so that
+ * pinning a freshly populated L1 does not have to be done in one go.
+ */
+#define L1_VALIDATE_BATCH 64
+
+static int alloc_l1_table(struct page_info *page, int preemptible)
 {
     struct domain *d = page_get_owner(page);
     unsigned long  pfn = page_to_mfn(page);
@@ -1134,8 +1149,17 @@ static int alloc_l1_table(struct page_info *page)
 
     pl1e = map_domain_page(pfn);
 
-    for ( i = 0; i < L1_PAGETABLE_ENTRIES; i++ )
+    for ( i = page->nr_validated_ptes; i < L1_PAGETABLE_ENTRIES; i++ )
     {
+        if ( preemptible && i && !(i % L1_VALIDATE_BATCH) &&
+             hypercall_preempt_check() )
+        {
+            page->nr_validated_ptes = i;
+            unmap_domain_page(pl1e);
+            perfc_incr(pt_validate_preempted);
+            return -EAGAIN;
+        }
+
         if ( is_guest_l1_slot(i) &&
              unlikely(!get_page_from_l1e(pl1e[i], d, d)) )
             goto fail;
@@ -1485,7 +1509,8 @@ static void free_l1_table(struct page_info *page)
 
     pl1e = map_domain_page(pfn);
 
-    for ( i = 0; i < L1_PAGETABLE_ENTRIES; i++ )
+    /* Only the first nr_validated_ptes entries of a partial L1 hold refs. */
+    for ( i = 0; i < page->nr_validated_ptes; i++ )
         if ( is_guest_l1_slot(i) )
             put_page_from_l1e(pl1e[i], d);
 
@@ -1774,8 +1799,13 @@ static int mod_l2_entry(l2_pgentry_t *pl2e,
             return 0;
         }
 
-        /* Fast path for identical mapping and presence. */
-        if ( !l2e_has_changed(ol2e, nl2e, _PAGE_PRESENT) )
+        /*
+         * Fast path for identical mapping and presence. A superpage's
+         * references depend on its writability, so those must not change.
+         */
+        if ( !l2e_has_changed(ol2e, nl2e, unlikely(opt_allow_hugepage) ?
+                              _PAGE_PRESENT|_PAGE_PSE|_PAGE_RW :
+                              _PAGE_PRESENT) )
         {
             adjust_guest_l2e(nl2e, d);
             rc = UPDATE_ENTRY(l2, pl2e, ol2e, nl2e, pfn, vcpu, preserve_ad);
@@ -2037,7 +2067,7 @@ static int alloc_page_type(struct page_info *page, unsigned long type,
     switch ( type & PGT_type_mask )
     {
     case PGT_l1_page_table:
-        rc = alloc_l1_table(page);
+        rc = alloc_l1_table(page, preemptible);
         break;
     case PGT_l2_page_table:
         rc = alloc_l2_table(page, type, preemptible);
@@ -2083,6 +2113,7 @@ static int alloc_page_type(struct page_info *page, unsigned long type,
     }
     else
     {
+        perfc_incra(pt_validate, (type & PGT_type_mask) >> PG_shift(3));
         page->u.inuse.type_info |= PGT_validated;
     }
 
@@ -2116,6 +2147,8 @@ int free_page_type(struct page_info *page, unsigned long type,
         page->partial_pte = 0;
     }
 
+    perfc_incra(pt_devalidate, (type & PGT_type_mask) >> PG_shift(3));
+
     switch ( type & PGT_type_mask )
     {
     case PGT_l1_page_table:
@@ -3000,6 +3033,64 @@ int do_mmuext_op(
     return rc;
 }
 
+/*
+ * do_mmu_update() keeps the frame targeted by the previous request mapped,
+ * referenced and locked (or writable-typed), so that runs of updates to the
+ * same pagetable -- populating or tearing down an L1, say -- pay for that
+ * once rather than once per entry.
+ */
+struct mmu_update_frame {
+    struct page_info *page;     /* NULL if nothing is held */
+    unsigned long mfn;
+    void *va;
+    bool_t locked;              /* page_lock() held, else a writable ref */
+};
+
+static int mmu_update_get_frame(struct mmu_update_frame *f, unsigned long mfn,
+                                struct domain *d,
+                                struct domain_mmap_cache *cache)
+{
+    struct page_info *page;
+
+    if ( unlikely(!get_page_from_pagenr(mfn, d)) )
+    {
+        MEM_LOG("Could not get page for normal update");
+        return 0;
+    }
+
+    page = mfn_to_page(mfn);
+    if ( page_lock(page) )
+        f->locked = 1;
+    else if ( get_page_type(page, PGT_writable_page) )
+        f->locked = 0;
+    else
+    {
+        put_page(page);
+        return 0;
+    }
+
+    f->page = page;
+    f->mfn = mfn;
+    f->va = map_domain_page_with_cache(mfn, cache);
+
+    return 1;
+}
+
+static void mmu_update_put_frame(struct mmu_update_frame *f,
+                                 struct domain_mmap_cache *cache)
+{
+    if ( f->page == NULL )
+        return;
+
+    unmap_domain_page_with_cache(f->va, cache);
+    if ( f->locked )
+        page_unlock(f->page);
+    else
+        put_page_type(f->page);
+    put_page(f->page);
+    f->page = NULL;
+}
+
 int do_mmu_update(
     XEN_GUEST_HANDLE(mmu_update_t) ureqs,
     unsigned int count,
@@ -3015,6 +3106,7 @@ int do_mmu_update(
     struct domain *d = current->domain, *pt_owner = d;
     struct vcpu *v = current;
     struct domain_mmap_cache mapcache;
+    struct mmu_update_frame frame = { .page = NULL };
 
     if ( unlikely(count & MMU_UPDATE_PREEMPTED) )
     {
@@ -3096,18 +3188,20 @@ int do_mmu_update(
             gmfn = req.ptr >> PAGE_SHIFT;
             mfn = gmfn_to_mfn(pt_owner, gmfn);
 
-            if ( unlikely(!get_page_from_pagenr(mfn, pt_owner)) )
+            if ( (frame.page != NULL) && (frame.mfn == mfn) )
+                perfc_incr(mmu_update_batched);
+            else
             {
-                MEM_LOG("Could not get page for normal update");
-                break;
+                mmu_update_put_frame(&frame, &mapcache);
+                if ( !mmu_update_get_frame(&frame, mfn, pt_owner, &mapcache) )
+                    break;
             }
 
-            va = map_domain_page_with_cache(mfn, &mapcache);
-            va = (void *)((unsigned long)va +
+            va = (void *)((unsigned long)frame.va +
                           (unsigned long)(req.ptr & ~PAGE_MASK));
-            page = mfn_to_page(mfn);
+            page = frame.page;
 
-            if ( page_lock(page) )
+            if ( frame.locked )
             {
                 switch ( page->u.inuse.type_info & PGT_type_mask )
                 {
@@ -3149,20 +3243,15 @@ int do_mmu_update(
                         v, va, req.val, _mfn(mfn));
                     break;
                 }
-                page_unlock(page);
                 if ( rc == -EINTR )
                     rc = -EAGAIN;
             }
-            else if ( get_page_type(page, PGT_writable_page) )
+            else
             {
                 perfc_incr(writable_mmu_updates);
                 okay = paging_write_guest_entry(
                     v, va, req.val, _mfn(mfn));
-                put_page_type(page);
             }
-
-            unmap_domain_page_with_cache(va, &mapcache);
-            put_page(page);
             break;
 
         case MMU_MACHPHYS_UPDATE:
@@ -3210,6 +3299,8 @@ int do_mmu_update(
         guest_handle_add_offset(ureqs, 1);
     }
 
+    mmu_update_put_frame(&frame, &mapcache);
+
     if ( rc == -EAGAIN )
         rc = hypercall_create_continuation(
             __HYPERVISOR_mmu_update, "hihi",
@@ -3717,6 +3808,70 @@ int steal_page(
     return -1;
 }
 
+/*
+ * Remote TLB flushes requested by a run of update_va_mapping entries in a
+ * multicall are merged and issued once, when the run ends.  The local TLB
+ * is still flushed before each entry completes.  Deferring the remote part
+ * is safe because a page freed by one of the updates cannot be reused
+ * before the allocator's tlbflush_timestamp check has flushed it.
+ */
+struct mc_flush {
+    cpumask_t     mask;
+    unsigned long va;
+    bool_t        pending, full;
+};
+static DEFINE_PER_CPU(struct mc_flush, mc_flush);
+
+static inline bool_t mc_defer_flush(void)
+{
+    return !!(this_cpu(mc_state).flags & MCSF_in_multicall);
+}
+
+/* @mask is clobbered.  @full requests a whole TLB flush rather than @va. */
+static void mc_flush_mask(cpumask_t *mask, unsigned long va, bool_t full)
+{
+    struct mc_flush *mcf = &this_cpu(mc_flush);
+
+    if ( cpu_test_and_clear(smp_processor_id(), *mask) )
+    {
+        if ( full )
+            this_cpu(percpu_mm_info).deferred_ops |= DOP_FLUSH_TLB;
+        else if ( !(this_cpu(percpu_mm_info).deferred_ops & DOP_FLUSH_TLB) )
+            flush_tlb_one_local(va);
+    }
+
+    if ( cpus_empty(*mask) )
+        return;
+
+    if ( !mcf->pending )
+    {
+        mcf->mask = *mask;
+        mcf->va = va;
+        mcf->full = full;
+        mcf->pending = 1;
+        return;
+    }
+
+    perfc_incr(update_va_flush_merged);
+    cpus_or(mcf->mask, mcf->mask, *mask);
+    if ( full || (va != mcf->va) )
+        mcf->full = 1;
+}
+
+void arch_multicall_end_run(void)
+{
+    struct mc_flush *mcf = &this_cpu(mc_flush);
+
+    if ( likely(!mcf->pending) )
+        return;
+
+    mcf->pending = 0;
+    if ( mcf->full )
+        flush_tlb_mask(&mcf->mask);
+    else
+        flush_tlb_one_mask(&mcf->mask, mcf->va);
+}
+
 int do_update_va_mapping(unsigned long va, u64 val64,
                          unsigned long flags)
 {
@@ -3772,6 +3927,12 @@ int do_update_va_mapping(unsigned long va, u64 val64,
             this_cpu(percpu_mm_info).deferred_ops |= DOP_FLUSH_TLB;
             break;
         case UVMF_ALL:
+            if ( mc_defer_flush() )
+            {
+                pmask = d->domain_dirty_cpumask;
+                mc_flush_mask(&pmask, 0, 1);
+                break;
+            }
             this_cpu(percpu_mm_info).deferred_ops |= DOP_FLUSH_ALL_TLBS;
             break;
         default:
@@ -3780,6 +3941,11 @@ int do_update_va_mapping(unsigned long va, u64 val64,
             rc = vcpumask_to_pcpumask(d, const_guest_handle_from_ptr(bmap_ptr,
                                                                      void),
                                       &pmask);
+            if ( mc_defer_flush() )
+            {
+                mc_flush_mask(&pmask, 0, 1);
+                break;
+            }
             if ( cpu_isset(smp_processor_id(), pmask) )
                 this_cpu(percpu_mm_info).deferred_ops &= ~DOP_FLUSH_TLB;
             flush_tlb_mask(&pmask);
@@ -3800,12 +3966,23 @@ int do_update_va_mapping(unsigned long va, u64 val64,
                 flush_tlb_one_local(va);
             break;
         case UVMF_ALL:
+            if ( mc_defer_flush() )
+            {
+                pmask = d->domain_dirty_cpumask;
+                mc_flush_mask(&pmask, va, 0);
+                break;
+            }
             flush_tlb_one_mask(&d->domain_dirty_cpumask, va);
             break;
         default:
             rc = vcpumask_to_pcpumask(d, const_guest_handle_from_ptr(bmap_ptr,
                                                                      void),
                                       &pmask);
+            if ( mc_defer_flush() )
+            {
+                mc_flush_mask(&pmask, va, 0);
+                break;
+            }
             if ( this_cpu(percpu_mm_info).deferred_ops & DOP_FLUSH_TLB )
                 cpu_clear(smp_processor_id(), pmask);
             flush_tlb_one_mask(&pmask, va);
@@ -4466,6 +4643,7 @@ int ptwr_do_page_fault(struct vcpu *v, unsigned long addr,
 
     ptwr_ctxt.ctxt.regs = regs;
     ptwr_ctxt.ctxt.force_writeback = 0;
+    ptwr_ctxt.ctxt.decode = NULL;
     ptwr_ctxt.ctxt.addr_size = ptwr_ctxt.ctxt.sp_size =
         is_pv_32on64_domain(d) ? 32 : BITS_PER_LONG;
     ptwr_ctxt.cr2 = addr;
@@ -454,6 +454,215 @@ int paging_log_dirty_op(struct domain *d, struct xen_domctl_shadow_op *sc)
     return rv;
 }
 
+/* Number of pfns covered by one leaf of the log-dirty tree. */
+#define LOGDIRTY_LEAF_PFNS (1UL << (PAGE_SHIFT+3))
+#if BITS_PER_LONG == 64
+#define LOGDIRTY_L3_SPAN_MASK \
+    ((1UL << (PAGE_SHIFT+3+PAGETABLE_ORDER*2)) - 1)
+#define LOGDIRTY_MAX_PFN      \
+    ((1UL << (PAGE_SHIFT+3+PAGETABLE_ORDER*3)) - 1)
+#else
+#define LOGDIRTY_L3_SPAN_MASK (~0UL)
+#define LOGDIRTY_MAX_PFN      (~0UL)
+#endif
+
+/* Map the log-dirty leaf covering @pfn. If there is none, return NULL and
+ * set *@hole to the mask of the (all-clean) aligned pfn span it is in. */
+static unsigned long *paging_map_log_dirty_leaf(
+    struct domain *d, unsigned long pfn, unsigned long *hole)
+{
+    mfn_t *l4, *l3, *l2, mfn;
+
+    l4 = map_domain_page(mfn_x(d->arch.paging.log_dirty.top));
+    mfn = l4[L4_LOGDIRTY_IDX(pfn)];
+    unmap_domain_page(l4);
+    if ( !mfn_valid(mfn) )
+    {
+        *hole = LOGDIRTY_L3_SPAN_MASK;
+        return NULL;
+    }
+
+    l3 = map_domain_page(mfn_x(mfn));
+    mfn = l3[L3_LOGDIRTY_IDX(pfn)];
+    unmap_domain_page(l3);
+    if ( !mfn_valid(mfn) )
+    {
+        *hole = (1UL << (PAGE_SHIFT+3+PAGETABLE_ORDER)) - 1;
+        return NULL;
+    }
+
+    l2 = map_domain_page(mfn_x(mfn));
+    mfn = l2[L2_LOGDIRTY_IDX(pfn)];
+    unmap_domain_page(l2);
+    if ( !mfn_valid(mfn) )
+    {
+        *hole = LOGDIRTY_LEAF_PFNS - 1;
+        return NULL;
+    }
+
+    return map_domain_page(mfn_x(mfn));
+}
+
+/* Clear bits [start, end) of a log-dirty leaf. */
+static void paging_clear_log_dirty_bits(
+    unsigned long *l1, unsigned int start, unsigned int end)
+{
+    unsigned int first = start / BITS_PER_LONG, last = end / BITS_PER_LONG;
+    unsigned long head = ~0UL << (start % BITS_PER_LONG);
+    unsigned long tail = (1UL << (end % BITS_PER_LONG)) - 1;
+
+    if ( first == last )
+    {
+        l1[first] &= ~(head & tail);
+        return;
+    }
+
+    l1[first++] &= ~head;
+    while ( first < last )
+        l1[first++] = 0;
+    if ( tail )
+        l1[last] &= ~tail;
+}
+
+#define LOGDIRTY_RANGE_BATCH 32
+
+/* Report the dirty pfns in [sc->begin_pfn, sc->begin_pfn + sc->pages) as
+ * a list of ranges, optionally cleaning them.  Whole words of the bitmap
+ * are skipped at a time, as are subtrees which were never populated, so
+ * the cost depends on the number of dirty runs rather than the size of the
+ * guest. */
+int paging_log_dirty_ranges_op(struct domain *d,
+                               struct xen_domctl_shadow_op *sc)
+{
+    xen_domctl_shadow_op_range_t buf[LOGDIRTY_RANGE_BATCH], cur = { 0, 0 };
+    unsigned int nr = 0, copied = 0, nbuf = 0;
+    unsigned long pfn, end, hole = 0, *l1;
+    unsigned int off, lim, s, e;
+    int rv = 0, clean;
+
+    clean = (sc->op == XEN_DOMCTL_SHADOW_OP_CLEAN_RANGES);
+
+    pfn = sc->begin_pfn;
+    if ( pfn > LOGDIRTY_MAX_PFN )
+        end = pfn;
+    else if ( sc->pages > LOGDIRTY_MAX_PFN - pfn )
+        end = LOGDIRTY_MAX_PFN;
+    else
+        end = pfn + sc->pages;
+
+    domain_pause(d);
+    log_dirty_lock(d);
+
+    sc->stats.fault_count = d->arch.paging.log_dirty.fault_count;
+    sc->stats.dirty_count = d->arch.paging.log_dirty.dirty_count;
+
+    /* The counters describe a whole pass, which starts at pfn 0. */
+    if ( clean && (sc->begin_pfn == 0) )
+    {
+        d->arch.paging.log_dirty.fault_count = 0;
+        d->arch.paging.log_dirty.dirty_count = 0;
+    }
+
+    if ( !mfn_valid(d->arch.paging.log_dirty.top) )
+    {
+        rv = -EINVAL;
+        goto out;
+    }
+
+    if ( unlikely(d->arch.paging.log_dirty.failed_allocs) )
+    {
+        printk("%s: %d failed page allocs while logging dirty pages\n",
+               __FUNCTION__, d->arch.paging.log_dirty.failed_allocs);
+        rv = -ENOMEM;
+        goto out;
+    }
+
+    while ( pfn < end )
+    {
+        unsigned long base = pfn & ~(LOGDIRTY_LEAF_PFNS - 1);
+
+        l1 = paging_map_log_dirty_leaf(d, pfn, &hole);
+        if ( l1 == NULL )
+        {
+            pfn = ((pfn | hole) >= end - 1) ? end : (pfn | hole) + 1;
+            continue;
+        }
+
+        off = pfn - base;
+        lim = min_t(unsigned long, end - base, LOGDIRTY_LEAF_PFNS);
+
+        while ( (off < lim) &&
+                ((s = find_next_bit(l1, lim, off)) < lim) )
+        {
+            e = find_next_zero_bit(l1, lim, s);
+
+            if ( nr && (cur.first_pfn + cur.nr_pfns == base + s) )
+                cur.nr_pfns += e - s;
+            else if ( nr == sc->nr_ranges )
+            {
+                /* Out of space: stop the scan in front of this run. */
+                unmap_domain_page(l1);
+                end = base + s;
+                goto done;
+            }
+            else
+            {
+                if ( nr++ )
+                    buf[nbuf++] = cur;
+                cur.first_pfn = base + s;
+                cur.nr_pfns = e - s;
+                if ( nbuf == LOGDIRTY_RANGE_BATCH )
+                {
+                    if ( copy_to_guest_offset(sc->dirty_ranges, copied,
+                                              buf, nbuf) != 0 )
+                    {
+                        unmap_domain_page(l1);
+                        rv = -EFAULT;
+                        goto out;
+                    }
+                    copied += nbuf;
+                    nbuf = 0;
+                }
+            }
+
+            if ( clean )
+                paging_clear_log_dirty_bits(l1, s, e);
+            off = e;
+        }
+
+        unmap_domain_page(l1);
+        pfn = base + lim;
+    }
+
+ done:
+    if ( nr )
+        buf[nbuf++] = cur;
+    if ( nbuf && copy_to_guest_offset(sc->dirty_ranges, copied, buf, nbuf) )
+    {
+        rv = -EFAULT;
+        goto out;
+    }
+
+    sc->nr_ranges = nr;
+    sc->pages = end - sc->begin_pfn;
+
+    log_dirty_unlock(d);
+
+    if ( clean )
+    {
+        /* As for paging_log_dirty_op(): reprotect the whole address space,
+         * which is a superset of the range just cleaned. */
+        d->arch.paging.log_dirty.clean_dirty_bitmap(d);
+    }
+    domain_unpause(d);
+    return 0;
+
+ out:
+    log_dirty_unlock(d);
+    domain_unpause(d);
+    return rv;
+}
+
 int paging_log_dirty_range(struct domain *d,
                             unsigned long begin_pfn,
                             unsigned long nr,
@@ -726,6 +935,10 @@ int paging_domctl(struct domain *d, xen_domctl_shadow_op_t *sc,
     case XEN_DOMCTL_SHADOW_OP_CLEAN:
     case XEN_DOMCTL_SHADOW_OP_PEEK:
         return paging_log_dirty_op(d, sc);
+
+    case XEN_DOMCTL_SHADOW_OP_CLEAN_RANGES:
+    case XEN_DOMCTL_SHADOW_OP_PEEK_RANGES:
+        return paging_log_dirty_ranges_op(d, sc);
     }
 
     /* Here, dispatch domctl to the appropriate paging code */
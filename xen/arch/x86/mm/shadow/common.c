@@ -378,6 +378,7 @@ struct x86_emulate_ops *shadow_init_emulation(
 
     sh_ctxt->ctxt.regs = regs;
     sh_ctxt->ctxt.force_writeback = 0;
+    sh_ctxt->ctxt.decode = NULL;
 
     if ( !is_hvm_vcpu(v) )
     {
@@ -1777,6 +1778,8 @@ static void p2m_install_entry_in_monitors(struct domain *d,
 }
 #endif
 
+static void shadow_hash_resize(struct domain *d);
+
 /* Set the pool of shadow pages to the required number of pages.
  * Input will be rounded up to at least shadow_min_acceptable_pages(),
  * plus space for the p2m table.
@@ -1851,6 +1854,10 @@ static unsigned int sh_set_allocation(struct domain *d,
         }
     }
 
+    /* Keep the hash table in proportion to the new pool size */
+    if ( d->arch.paging.shadow.hash_table )
+        shadow_hash_resize(d);
+
     return 0;
 }
 
@@ -1867,18 +1874,35 @@ static unsigned int shadow_get_allocation(struct domain *d)
  * The table itself is an array of pointers to shadows; the shadows are then 
  * threaded on a singly-linked list of shadows with the same hash value */
 
-#define SHADOW_HASH_BUCKETS 251
-/* Other possibly useful primes are 509, 1021, 2039, 4093, 8191, 16381 */
+/* The number of buckets grows with the shadow pool, so that chains stay
+ * short on guests with many thousands of shadows.  We size the table to
+ * be the smallest of these primes that gives no more than
+ * SHADOW_HASH_PAGES_PER_BUCKET pool pages per bucket. */
+static const unsigned int sh_hash_sizes[] = {
+    251, 509, 1021, 2039, 4093, 8191, 16381, 32749, 65521
+};
+#define SHADOW_HASH_PAGES_PER_BUCKET 8
+
+static unsigned int shadow_hash_buckets_for(struct domain *d)
+{
+    unsigned int i, want;
+
+    want = d->arch.paging.shadow.total_pages / SHADOW_HASH_PAGES_PER_BUCKET;
+    for ( i = 0; i < ARRAY_SIZE(sh_hash_sizes) - 1; i++ )
+        if ( sh_hash_sizes[i] >= want )
+            break;
+    return sh_hash_sizes[i];
+}
 
 /* Hash function that takes a gfn or mfn, plus another byte of type info */
 typedef u32 key_t;
-static inline key_t sh_hash(unsigned long n, unsigned int t) 
+static inline key_t sh_hash(struct domain *d, unsigned long n, unsigned int t) 
 {
     unsigned char *p = (unsigned char *)&n;
     key_t k = t;
     int i;
     for ( i = 0; i < sizeof(n) ; i++ ) k = (u32)p[i] + (k<<6) + (k<<16) - k;
-    return k % SHADOW_HASH_BUCKETS;
+    return k % d->arch.paging.shadow.hash_buckets;
 }
 
 #if SHADOW_AUDIT & (SHADOW_AUDIT_HASH|SHADOW_AUDIT_HASH_FULL)
@@ -1902,7 +1926,7 @@ static void sh_hash_audit_bucket(struct domain *d, int bucket)
         BUG_ON( sp->u.sh.type == 0 );
         BUG_ON( sp->u.sh.type > SH_type_max_shadow );
         /* Wrong bucket? */
-        BUG_ON( sh_hash(sp->v.sh.back, sp->u.sh.type) != bucket );
+        BUG_ON( sh_hash(d, sp->v.sh.back, sp->u.sh.type) != bucket );
         /* Duplicate entry? */
         for ( x = next_shadow(sp); x; x = next_shadow(x) )
             BUG_ON( x->v.sh.back == sp->v.sh.back &&
@@ -1967,7 +1991,7 @@ static void sh_hash_audit(struct domain *d)
     if ( !(SHADOW_AUDIT_ENABLE) )
         return;
 
-    for ( i = 0; i < SHADOW_HASH_BUCKETS; i++ ) 
+    for ( i = 0; i < d->arch.paging.shadow.hash_buckets; i++ ) 
     {
         sh_hash_audit_bucket(d, i);
     }
@@ -1982,18 +2006,73 @@ static void sh_hash_audit(struct domain *d)
 static int shadow_hash_alloc(struct domain *d)
 {
     struct page_info **table;
+    unsigned int buckets;
 
     ASSERT(shadow_locked_by_me(d));
     ASSERT(!d->arch.paging.shadow.hash_table);
 
-    table = xmalloc_array(struct page_info *, SHADOW_HASH_BUCKETS);
+    buckets = shadow_hash_buckets_for(d);
+    table = xmalloc_array(struct page_info *, buckets);
     if ( !table ) return 1;
     memset(table, 0, 
-           SHADOW_HASH_BUCKETS * sizeof (struct page_info *));
+           buckets * sizeof (struct page_info *));
     d->arch.paging.shadow.hash_table = table;
+    d->arch.paging.shadow.hash_buckets = buckets;
     return 0;
 }
 
+/* Re-size the table to suit the current size of the shadow pool, moving
+ * every entry to its new bucket.  Failure to allocate the new table is
+ * not an error: we just carry on with longer chains. */
+static void shadow_hash_resize(struct domain *d)
+{
+    struct page_info **table, **old_table, *sp, *next;
+    unsigned int i, buckets, old_buckets;
+    key_t key;
+
+    ASSERT(shadow_locked_by_me(d));
+    ASSERT(d->arch.paging.shadow.hash_table);
+
+    /* Can't move entries around under someone walking the chains */
+    if ( d->arch.paging.shadow.hash_walking != 0 )
+        return;
+
+    old_buckets = d->arch.paging.shadow.hash_buckets;
+    buckets = shadow_hash_buckets_for(d);
+    if ( buckets == old_buckets )
+        return;
+
+    table = xmalloc_array(struct page_info *, buckets);
+    if ( !table )
+        return;
+    memset(table, 0, buckets * sizeof (struct page_info *));
+
+    sh_hash_audit(d);
+
+    old_table = d->arch.paging.shadow.hash_table;
+    d->arch.paging.shadow.hash_table = table;
+    d->arch.paging.shadow.hash_buckets = buckets;
+
+    for ( i = 0; i < old_buckets; i++ )
+    {
+        for ( sp = old_table[i]; sp; sp = next )
+        {
+            next = next_shadow(sp);
+            key = sh_hash(d, sp->v.sh.back, sp->u.sh.type);
+            set_next_shadow(sp, table[key]);
+            table[key] = sp;
+        }
+    }
+
+    xfree(old_table);
+    perfc_incr(shadow_hash_resizes);
+
+    SHADOW_PRINTK("d=%u hash resized from %u to %u buckets\n",
+                  d->domain_id, old_buckets, buckets);
+
+    sh_hash_audit(d);
+}
+
 /* Tear down the hash table and return all memory to Xen.
  * This function does not care whether the table is populated. */
 static void shadow_hash_teardown(struct domain *d)
@@ -2003,6 +2082,7 @@ static void shadow_hash_teardown(struct domain *d)
 
     xfree(d->arch.paging.shadow.hash_table);
     d->arch.paging.shadow.hash_table = NULL;
+    d->arch.paging.shadow.hash_buckets = 0;
 }
 
 
@@ -2021,7 +2101,7 @@ mfn_t shadow_hash_lookup(struct vcpu *v, unsigned long n, unsigned int t)
     sh_hash_audit(d);
 
     perfc_incr(shadow_hash_lookups);
-    key = sh_hash(n, t);
+    key = sh_hash(d, n, t);
     sh_hash_audit_bucket(d, key);
 
     sp = d->arch.paging.shadow.hash_table[key];
@@ -2075,7 +2155,7 @@ void shadow_hash_insert(struct vcpu *v, unsigned long n, unsigned int t,
     sh_hash_audit(d);
 
     perfc_incr(shadow_hash_inserts);
-    key = sh_hash(n, t);
+    key = sh_hash(d, n, t);
     sh_hash_audit_bucket(d, key);
     
     /* Insert this shadow at the top of the bucket */
@@ -2101,7 +2181,7 @@ void shadow_hash_delete(struct vcpu *v, unsigned long n, unsigned int t,
     sh_hash_audit(d);
 
     perfc_incr(shadow_hash_deletes);
-    key = sh_hash(n, t);
+    key = sh_hash(d, n, t);
     sh_hash_audit_bucket(d, key);
     
     sp = mfn_to_page(smfn);
@@ -2153,7 +2233,7 @@ static void hash_foreach(struct vcpu *v,
     ASSERT(d->arch.paging.shadow.hash_walking == 0);
     d->arch.paging.shadow.hash_walking = 1;
 
-    for ( i = 0; i < SHADOW_HASH_BUCKETS; i++ ) 
+    for ( i = 0; i < d->arch.paging.shadow.hash_buckets; i++ ) 
     {
         /* WARNING: This is not safe against changes to the hash table.
          * The callback *must* return non-zero if it has inserted or
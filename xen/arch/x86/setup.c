@@ -38,6 +38,7 @@
 #include <asm/edd.h>
 #include <xsm/xsm.h>
 #include <asm/tboot.h>
+#include <asm/i387.h>
 
 int __init bzimage_headroom(char *image_start, unsigned long image_length);
 
@@ -944,6 +945,7 @@ void __init __start_xen(unsigned long mbi_p)
         set_in_cr4(X86_CR4_OSFXSR);
     if ( cpu_has_xmm )
         set_in_cr4(X86_CR4_OSXMMEXCPT);
+    xsave_init();
 
     local_irq_enable();
 
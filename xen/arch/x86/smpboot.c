@@ -51,6 +51,7 @@
 #include <asm/flushtlb.h>
 #include <asm/msr.h>
 #include <asm/mtrr.h>
+#include <asm/i387.h>
 #include <mach_apic.h>
 #include <mach_wakecpu.h>
 #include <smpboot_hooks.h>
@@ -491,6 +492,7 @@ void __devinit start_secondary(void *unused)
 	cpu_init();
 	/*preempt_disable();*/
 	smp_callin();
+	xsave_init();
 	while (!cpu_isset(smp_processor_id(), smp_commenced_mask))
 		rep_nop();
 
@@ -1202,8 +1202,10 @@ x86_emulate(
     /* Shadow copy of register state. Committed on successful emulation. */
     struct cpu_user_regs _regs = *ctxt->regs;
 
-    uint8_t b, d, sib, sib_index, sib_base, twobyte = 0, rex_prefix = 0;
+    uint8_t b, d, sib = 0, sib_index, sib_base, twobyte = 0, rex_prefix = 0;
     uint8_t modrm = 0, modrm_mod = 0, modrm_reg = 0, modrm_rm = 0;
+    int32_t disp = 0;
+    struct x86_emulate_decode *dc = ctxt->decode;
     unsigned int op_bytes, def_op_bytes, ad_bytes, def_ad_bytes;
 #define REPE_PREFIX  1
 #define REPNE_PREFIX 2
@@ -1229,6 +1231,25 @@ x86_emulate(
 #endif
     }
 
+    if ( (dc != NULL) && dc->valid && (dc->addr_size == ctxt->addr_size) )
+    {
+        /* Caller vouches that the instruction bytes are unchanged. */
+        b            = dc->b;
+        d            = dc->d;
+        twobyte      = dc->twobyte;
+        rex_prefix   = dc->rex_prefix;
+        modrm        = dc->modrm;
+        sib          = dc->sib;
+        disp         = dc->disp;
+        op_bytes     = dc->op_bytes;
+        ad_bytes     = dc->ad_bytes;
+        lock_prefix  = dc->lock_prefix;
+        rep_prefix   = dc->rep_prefix;
+        override_seg = dc->override_seg;
+        _regs.eip   += dc->len;
+        goto decoded;
+    }
+
     /* Prefix bytes. */
     for ( ; ; )
     {
@@ -1304,10 +1325,74 @@ x86_emulate(
     /* Lock prefix is allowed only on RMW instructions. */
     generate_exception_if((d & Mov) && lock_prefix, EXC_GP, 0);
 
-    /* ModRM and SIB bytes. */
+    /* ModRM, SIB and displacement bytes. */
     if ( d & ModRM )
     {
         modrm = insn_fetch_type(uint8_t);
+        modrm_mod = (modrm & 0xc0) >> 6;
+        modrm_rm  = modrm & 0x07;
+
+        /* Register operands (mod == 3) have no SIB or displacement. */
+        if ( (modrm_mod != 3) && (ad_bytes == 2) )
+        {
+            switch ( modrm_mod )
+            {
+            case 0:
+                if ( modrm_rm == 6 )
+                    disp = insn_fetch_type(int16_t);
+                break;
+            case 1:
+                disp = insn_fetch_type(int8_t);
+                break;
+            case 2:
+                disp = insn_fetch_type(int16_t);
+                break;
+            }
+        }
+        else if ( modrm_mod != 3 )
+        {
+            if ( modrm_rm == 4 )
+                sib = insn_fetch_type(uint8_t);
+            switch ( modrm_mod )
+            {
+            case 0:
+                if ( (modrm_rm == 5) ||
+                     ((modrm_rm == 4) && ((sib & 7) == 5)) )
+                    disp = insn_fetch_type(int32_t);
+                break;
+            case 1:
+                disp = insn_fetch_type(int8_t);
+                break;
+            case 2:
+                disp = insn_fetch_type(int32_t);
+                break;
+            }
+        }
+    }
+
+    if ( dc != NULL )
+    {
+        dc->b            = b;
+        dc->d            = d;
+        dc->twobyte      = twobyte;
+        dc->rex_prefix   = rex_prefix;
+        dc->modrm        = modrm;
+        dc->sib          = sib;
+        dc->disp         = disp;
+        dc->op_bytes     = op_bytes;
+        dc->ad_bytes     = ad_bytes;
+        dc->lock_prefix  = lock_prefix;
+        dc->rep_prefix   = rep_prefix;
+        dc->override_seg = override_seg;
+        dc->len          = _regs.eip - ctxt->regs->eip;
+        dc->addr_size    = ctxt->addr_size;
+        dc->valid        = 1;
+    }
+
+ decoded:
+    /* Effective address from ModRM and SIB. */
+    if ( d & ModRM )
+    {
         modrm_mod = (modrm & 0xc0) >> 6;
         modrm_reg = ((rex_prefix & 4) << 1) | ((modrm & 0x38) >> 3);
         modrm_rm  = modrm & 0x07;
@@ -1354,19 +1439,7 @@ x86_emulate(
                 ea.mem.off = _regs.ebx;
                 break;
             }
-            switch ( modrm_mod )
-            {
-            case 0:
-                if ( modrm_rm == 6 )
-                    ea.mem.off = insn_fetch_type(int16_t);
-                break;
-            case 1:
-                ea.mem.off += insn_fetch_type(int8_t);
-                break;
-            case 2:
-                ea.mem.off += insn_fetch_type(int16_t);
-                break;
-            }
+            ea.mem.off += disp;
             ea.mem.off = truncate_ea(ea.mem.off);
         }
         else
@@ -1374,14 +1447,13 @@ x86_emulate(
             /* 32/64-bit ModR/M decode. */
             if ( modrm_rm == 4 )
             {
-                sib = insn_fetch_type(uint8_t);
                 sib_index = ((sib >> 3) & 7) | ((rex_prefix << 2) & 8);
                 sib_base  = (sib & 7) | ((rex_prefix << 3) & 8);
                 if ( sib_index != 4 )
                     ea.mem.off = *(long*)decode_register(sib_index, &_regs, 0);
                 ea.mem.off <<= (sib >> 6) & 3;
                 if ( (modrm_mod == 0) && ((sib_base & 7) == 5) )
-                    ea.mem.off += insn_fetch_type(int32_t);
+                    ea.mem.off += disp;
                 else if ( sib_base == 4 )
                 {
                     ea.mem.seg  = x86_seg_ss;
@@ -1411,7 +1483,7 @@ x86_emulate(
             case 0:
                 if ( (modrm_rm & 7) != 5 )
                     break;
-                ea.mem.off = insn_fetch_type(int32_t);
+                ea.mem.off = disp;
                 if ( !mode_64bit() )
                     break;
                 /* Relative to RIP of next instruction. Argh! */
@@ -1431,10 +1503,8 @@ x86_emulate(
                     ea.mem.off++;
                 break;
             case 1:
-                ea.mem.off += insn_fetch_type(int8_t);
-                break;
             case 2:
-                ea.mem.off += insn_fetch_type(int32_t);
+                ea.mem.off += disp;
                 break;
             }
             ea.mem.off = truncate_ea(ea.mem.off);
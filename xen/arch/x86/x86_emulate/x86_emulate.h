@@ -363,6 +363,22 @@ struct x86_emulate_ops
 
 struct cpu_user_regs;
 
+/*
+ * Decoded prefix, opcode and ModRM/SIB/displacement state of an instruction.
+ * Depends only on the instruction bytes and the default address size, so a
+ * caller which knows the bytes at an address are unchanged may hand a
+ * previously filled-in copy back to x86_emulate() to skip decoding them.
+ */
+struct x86_emulate_decode {
+    uint8_t valid;          /* Filled in by x86_emulate()? */
+    uint8_t addr_size;      /* ctxt->addr_size at the time of decode. */
+    uint8_t len;            /* Bytes consumed, excluding any immediate. */
+    uint8_t b, d, twobyte, rex_prefix, modrm, sib;
+    uint8_t op_bytes, ad_bytes, lock_prefix, rep_prefix;
+    int8_t  override_seg;
+    int32_t disp;
+};
+
 struct x86_emulate_ctxt
 {
     /* Register state before/after emulation. */
@@ -377,6 +393,12 @@ struct x86_emulate_ctxt
     /* Set this if writes may have side effects. */
     uint8_t force_writeback;
 
+    /*
+     * Optional decode cache entry (may be NULL). If valid it is used in
+     * place of decoding the instruction; if not, it is filled in.
+     */
+    struct x86_emulate_decode *decode;
+
     /* Retirement state, set by the emulator (valid only on X86EMUL_OKAY). */
     union {
         struct {
@@ -30,6 +30,7 @@
 #include <asm/debugger.h>
 #include <public/sched.h>
 #include <public/vcpu.h>
+#include <public/sysctl.h>
 #include <xsm/xsm.h>
 #include <xen/trace.h>
 #include <xen/tmem.h>
@@ -215,8 +216,8 @@ struct domain *domain_create(
     init_status |= INIT_xsm;
 
     atomic_set(&d->refcnt, 1);
-    spin_lock_init(&d->domain_lock);
-    spin_lock_init(&d->page_alloc_lock);
+    spin_lock_init_prof(d, domain_lock);
+    spin_lock_init_prof(d, page_alloc_lock);
     spin_lock_init(&d->shutdown_lock);
     spin_lock_init(&d->hypercall_deadlock_mutex);
     INIT_PAGE_LIST_HEAD(&d->page_list);
@@ -286,6 +287,8 @@ struct domain *domain_create(
         rcu_assign_pointer(*pd, d);
         rcu_assign_pointer(domain_hash[DOMAIN_HASH(domid)], d);
         spin_unlock(&domlist_update_lock);
+
+        lock_profile_register_struct(LOCKPROF_TYPE_PERDOM, d, domid);
     }
 
     return d;
@@ -305,6 +308,7 @@ struct domain *domain_create(
         xsm_free_security_domain(d);
     xfree(d->pirq_mask);
     xfree(d->pirq_to_evtchn);
+    lock_profile_deregister_struct(LOCKPROF_TYPE_PERDOM, d);
     free_domain_struct(d);
     return NULL;
 }
@@ -591,6 +595,7 @@ static void complete_domain_destroy(struct rcu_head *head)
     xfree(d->pirq_to_evtchn);
 
     xsm_free_security_domain(d);
+    lock_profile_deregister_struct(LOCKPROF_TYPE_PERDOM, d);
     free_domain_struct(d);
 
     send_guest_global_virq(dom0, VIRQ_DOM_EXC);
@@ -624,8 +629,11 @@ void domain_destroy(struct domain *d)
     rcu_assign_pointer(*pd, d->next_in_hashbucket);
     spin_unlock(&domlist_update_lock);
 
-    /* Schedule RCU asynchronous completion of domain destroy. */
-    call_rcu(&d->rcu, complete_domain_destroy);
+    /*
+     * Schedule RCU asynchronous completion of domain destroy. The grace
+     * period is expedited so that the domain's memory is reclaimed promptly.
+     */
+    call_rcu_expedited(&d->rcu, complete_domain_destroy);
 }
 
 void vcpu_pause(struct vcpu *v)
@@ -32,6 +32,10 @@
 #include <public/event_channel.h>
 #include <xsm/xsm.h>
 
+#ifdef CONFIG_COMPAT
+#include <compat/event_channel.h>
+#endif
+
 #define bucket_from_port(d,p) \
     ((d)->evtchn[(p)/EVTCHNS_PER_BUCKET])
 #define port_is_valid(d,p)    \
@@ -804,6 +808,78 @@ int evtchn_unmask(unsigned int port)
 }
 
 
+/*
+ * EVTCHNOP_send_batch and EVTCHNOP_unmask_batch.  The IPIs that wake or
+ * kick the notified VCPUs are sent once per CPU at the end of the batch.
+ * <done> doubles as the point to resume from after preemption.
+ */
+static long evtchn_port_batch(int cmd, XEN_GUEST_HANDLE(void) arg)
+{
+    XEN_GUEST_HANDLE(evtchn_port_batch_t) uarg =
+        guest_handle_cast(arg, evtchn_port_batch_t);
+    struct evtchn_port_batch batch;
+    evtchn_port_t ports[64];
+    unsigned int i, n;
+    long rc = 0;
+
+#ifdef CONFIG_COMPAT
+    if ( is_pv_32on64_vcpu(current) )
+    {
+        /* Only the handle differs: the other fields sit at the same place. */
+        struct compat_evtchn_port_batch cmp;
+
+        if ( copy_from_guest(&cmp, arg, 1) != 0 )
+            return -EFAULT;
+        batch.nr_ports = cmp.nr_ports;
+        batch.done = cmp.done;
+        guest_from_compat_handle(batch.ports, cmp.ports);
+    }
+    else
+#endif
+    if ( copy_from_guest(&batch, arg, 1) != 0 )
+        return -EFAULT;
+
+    if ( batch.done > batch.nr_ports )
+        return -EINVAL;
+
+    cpu_raise_softirq_batch_begin();
+
+    while ( batch.done < batch.nr_ports )
+    {
+        n = min_t(unsigned int, batch.nr_ports - batch.done, ARRAY_SIZE(ports));
+        if ( copy_from_guest_offset(ports, batch.ports, batch.done, n) != 0 )
+        {
+            rc = -EFAULT;
+            break;
+        }
+
+        for ( i = 0; i < n; i++, batch.done++ )
+        {
+            rc = (cmd == EVTCHNOP_send_batch) ?
+                 evtchn_send(current->domain, ports[i]) :
+                 evtchn_unmask(ports[i]);
+            if ( rc )
+                goto out;
+        }
+
+        if ( (batch.done < batch.nr_ports) && hypercall_preempt_check() )
+        {
+            rc = hypercall_create_continuation(
+                __HYPERVISOR_event_channel_op, "ih", cmd, arg);
+            break;
+        }
+    }
+
+ out:
+    cpu_raise_softirq_batch_finish();
+
+    if ( __copy_field_to_guest(uarg, &batch, done) )
+        rc = -EFAULT;
+
+    return rc;
+}
+
+
 static long evtchn_reset(evtchn_reset_t *r)
 {
     domid_t dom = r->dom;
@@ -936,6 +1012,11 @@ long do_event_channel_op(int cmd, XEN_GUEST_HANDLE(void) arg)
         break;
     }
 
+    case EVTCHNOP_send_batch:
+    case EVTCHNOP_unmask_batch:
+        rc = evtchn_port_batch(cmd, arg);
+        break;
+
     default:
         rc = -ENOSYS;
         break;
@@ -1024,7 +1105,7 @@ void notify_via_xen_event_channel(int lport)
 
 int evtchn_init(struct domain *d)
 {
-    spin_lock_init(&d->event_lock);
+    spin_lock_init_prof(d, event_lock);
     if ( get_free_port(d) != 0 )
         return -EINVAL;
     evtchn_from_port(d, 0)->state = ECS_RESERVED;
@@ -1669,7 +1669,7 @@ grant_table_create(
 
     /* Simple stuff. */
     memset(t, 0, sizeof(*t));
-    spin_lock_init(&t->lock);
+    spin_lock_init_prof_in(d, &t->lock, "grant_table");
     t->nr_grant_frames = INITIAL_NR_GRANT_FRAMES;
 
     /* Active grant table. */
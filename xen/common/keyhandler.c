@@ -353,6 +353,13 @@ void __init initialize_keytable(void)
         'P', perfc_reset,    "reset performance counters");
 #endif
 
+#ifdef LOCK_PROFILE
+    register_keyhandler(
+        'l', spinlock_profile_printall, "print lock profile info");
+    register_keyhandler(
+        'L', spinlock_profile_reset,    "reset lock profile info");
+#endif
+
     register_keyhandler(
         '0', dump_dom0_registers, "dump Dom0 registers");
 
@@ -25,7 +25,10 @@ do_multicall(
     XEN_GUEST_HANDLE(multicall_entry_t) call_list, unsigned int nr_calls)
 {
     struct mc_state *mcs = &this_cpu(mc_state);
-    unsigned int     i;
+    unsigned int     i, flags = nr_calls & ~MULTICALL_nr_mask;
+    unsigned long    prev_op = ~0UL;
+
+    nr_calls &= MULTICALL_nr_mask;
 
     if ( unlikely(__test_and_set_bit(_MCSF_in_multicall, &mcs->flags)) )
     {
@@ -44,6 +47,17 @@ do_multicall(
         if ( unlikely(__copy_from_guest(&mcs->call, call_list, 1)) )
             goto fault;
 
+        /*
+         * Consecutive entries with the same op form a run, over which the
+         * arch code may defer work (e.g. remote TLB flushes); it must be
+         * completed before anything else is done on the guest's behalf.
+         */
+        if ( mcs->call.op != prev_op )
+        {
+            arch_multicall_end_run();
+            prev_op = mcs->call.op;
+        }
+
         do_multicall_call(&mcs->call);
 
 #ifndef NDEBUG
@@ -71,24 +85,37 @@ do_multicall(
             goto preempted;
         }
 
+        if ( (flags & MULTICALL_stop_on_error) &&
+             unlikely((ret_t)mcs->call.result < 0) )
+        {
+            arch_multicall_end_run();
+            perfc_incr(calls_to_multicall);
+            perfc_add(calls_from_multicall, i + 1);
+            mcs->flags = 0;
+            return nr_calls - i;
+        }
+
         guest_handle_add_offset(call_list, 1);
     }
 
+    arch_multicall_end_run();
     perfc_incr(calls_to_multicall);
     perfc_add(calls_from_multicall, nr_calls);
     mcs->flags = 0;
     return 0;
 
  fault:
+    arch_multicall_end_run();
     perfc_incr(calls_to_multicall);
     mcs->flags = 0;
     return -EFAULT;
 
  preempted:
+    arch_multicall_end_run();
     perfc_add(calls_from_multicall, i);
     mcs->flags = 0;
     return hypercall_create_continuation(
-        __HYPERVISOR_multicall, "hi", call_list, nr_calls-i);
+        __HYPERVISOR_multicall, "hi", call_list, (nr_calls - i) | flags);
 }
 
 /*
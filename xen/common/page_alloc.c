@@ -1080,12 +1080,143 @@ int assign_pages(
 }
 
 
+/*
+ * Pages freed by a dying domain must be scrubbed before they are reused.
+ * Rather than doing that synchronously while the domain is torn down, they
+ * are queued here, per node, and scrubbed by idle CPUs (see
+ * page_scrub_idle()).  An allocation that cannot be satisfied from the heap
+ * scrubs a bounded batch of the queued pages it could use before giving up.
+ */
+static struct page_list_head page_scrub_list[MAX_NUMNODES];
+static DEFINE_SPINLOCK(page_scrub_lock);
+static unsigned long nr_scrub_pages;
+
+/* Most pages an allocation will scrub itself before failing. */
+#define SCRUB_RECLAIM_BATCH 512
+
+static int __init page_scrub_init(void)
+{
+    unsigned int i;
+
+    for ( i = 0; i < MAX_NUMNODES; i++ )
+        INIT_PAGE_LIST_HEAD(&page_scrub_list[i]);
+    return 0;
+}
+__initcall(page_scrub_init);
+
+static void queue_scrub_pages(struct page_info *pg, unsigned int order)
+{
+    unsigned int i, node = phys_to_nid(page_to_maddr(pg));
+
+    spin_lock(&page_scrub_lock);
+    for ( i = 0; i < (1 << order); i++ )
+        page_list_add_tail(&pg[i], &page_scrub_list[node]);
+    nr_scrub_pages += 1UL << order;
+    spin_unlock(&page_scrub_lock);
+}
+
+/*
+ * Scrub up to @max pages queued on @node whose zone lies in [@zone_lo,
+ * @zone_hi] and return them to the heap, stopping early once this CPU has
+ * other work to do.  Pages outside the zone range are left queued, but
+ * count against @max so that a queue full of them is not walked in full.
+ * Returns the number of pages scrubbed.
+ */
+static unsigned long scrub_queued_pages(
+    unsigned int node, unsigned int zone_lo, unsigned int zone_hi,
+    unsigned long max)
+{
+    struct page_info *pg;
+    unsigned long done = 0, seen;
+    unsigned int zone;
+
+    for ( seen = 0; seen < max; seen++ )
+    {
+        if ( softirq_pending(smp_processor_id()) )
+            break;
+
+        spin_lock(&page_scrub_lock);
+        if ( (pg = page_list_remove_head(&page_scrub_list[node])) != NULL )
+        {
+            zone = page_to_zone(pg);
+            if ( (zone < zone_lo) || (zone > zone_hi) )
+            {
+                page_list_add_tail(pg, &page_scrub_list[node]);
+                pg = NULL;
+            }
+            else
+                nr_scrub_pages--;
+        }
+        spin_unlock(&page_scrub_lock);
+
+        if ( pg == NULL )
+        {
+            if ( page_list_empty(&page_scrub_list[node]) )
+                break;
+            continue;
+        }
+
+        scrub_one_page(pg);
+        free_heap_pages(pg, 0);
+        done++;
+    }
+
+    return done;
+}
+
+void page_scrub_idle(void)
+{
+    unsigned int i, node = cpu_to_node(smp_processor_id());
+
+    if ( nr_scrub_pages == 0 )
+        return;
+
+    /* Local memory first, then help out with everyone else's. */
+    for ( i = 0; i < MAX_NUMNODES; i++ )
+    {
+        if ( softirq_pending(smp_processor_id()) )
+            break;
+        scrub_queued_pages((node + i) % MAX_NUMNODES, 0, NR_ZONES - 1, ~0UL);
+    }
+}
+
+/*
+ * Scrub at most SCRUB_RECLAIM_BATCH queued pages from zones [@zone_lo,
+ * @zone_hi] for an allocation that failed, from @node only if the caller
+ * asked for one.  Returns the number of pages given back to the heap.
+ */
+static unsigned long scrub_reclaim(
+    unsigned int node, unsigned int zone_lo, unsigned int zone_hi)
+{
+    unsigned long done = 0;
+    unsigned int i;
+
+    if ( nr_scrub_pages == 0 )
+        return 0;
+
+    if ( node != NUMA_NO_NODE )
+        return scrub_queued_pages(node, zone_lo, zone_hi, SCRUB_RECLAIM_BATCH);
+
+    node = cpu_to_node(smp_processor_id());
+    for ( i = 0; (i < MAX_NUMNODES) && (done < SCRUB_RECLAIM_BATCH); i++ )
+        done += scrub_queued_pages((node + i) % MAX_NUMNODES, zone_lo, zone_hi,
+                                   SCRUB_RECLAIM_BATCH - done);
+
+    return done;
+}
+
+unsigned long avail_scrub_pages(void)
+{
+    return nr_scrub_pages;
+}
+
 struct page_info *alloc_domheap_pages(
     struct domain *d, unsigned int order, unsigned int memflags)
 {
     struct page_info *pg = NULL;
     unsigned int bits = memflags >> _MEMF_bits, zone_hi = NR_ZONES - 1;
     unsigned int node = (uint8_t)((memflags >> _MEMF_node) - 1), dma_zone;
+    bool_t scrubbed = 0;
 
     ASSERT(!in_irq());
 
@@ -1096,13 +1227,32 @@ struct page_info *alloc_domheap_pages(
     if ( (zone_hi = min_t(unsigned int, bits_to_zone(bits), zone_hi)) == 0 )
         return NULL;
 
-    if ( dma_bitsize && ((dma_zone = bits_to_zone(dma_bitsize)) < zone_hi) )
-        pg = alloc_heap_pages(dma_zone + 1, zone_hi, node, order, memflags);
+    for ( ; ; )
+    {
+        if ( dma_bitsize &&
+             ((dma_zone = bits_to_zone(dma_bitsize)) < zone_hi) )
+            pg = alloc_heap_pages(dma_zone + 1, zone_hi, node, order, memflags);
+
+        if ( (pg == NULL) &&
+             ((pg = alloc_heap_pages(MEMZONE_XEN + 1, zone_hi,
+                                     node, order, memflags)) == NULL) )
+        {
+            /*
+             * Reclaim a batch of the memory still waiting to be scrubbed and
+             * retry once.  That is bounded work whatever the queue length;
+             * if it was not enough, the rest is left to page_scrub_idle().
+             */
+            if ( !scrubbed &&
+                 (scrub_reclaim(node, MEMZONE_XEN + 1, zone_hi) != 0) )
+            {
+                scrubbed = 1;
+                continue;
+            }
+            return NULL;
+        }
 
-    if ( (pg == NULL) &&
-         ((pg = alloc_heap_pages(MEMZONE_XEN + 1, zone_hi,
-                                 node, order, memflags)) == NULL) )
-         return NULL;
+        break;
+    }
 
     if ( (d != NULL) && assign_pages(d, pg, order, memflags) )
     {
@@ -1155,10 +1305,9 @@ void free_domheap_pages(struct page_info *pg, unsigned int order)
          * domain has died we assume responsibility for erasure.
          */
         if ( unlikely(d->is_dying) )
-            for ( i = 0; i < (1 << order); i++ )
-                scrub_one_page(&pg[i]);
-
-        free_heap_pages(pg, order);
+            queue_scrub_pages(pg, order);
+        else
+            free_heap_pages(pg, order);
     }
     else
     {
@@ -1217,6 +1366,7 @@ static void pagealloc_keyhandler(unsigned char key)
     }
 
     printk("    Dom heap: %lukB free\n", total << (PAGE_SHIFT-10));
+    printk("    Scrub queue: %lukB\n", nr_scrub_pages << (PAGE_SHIFT-10));
 }
 
 
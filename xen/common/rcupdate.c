@@ -41,6 +41,7 @@
 #include <xen/sched.h>
 #include <asm/atomic.h>
 #include <xen/bitops.h>
+#include <xen/bitmap.h>
 #include <xen/percpu.h>
 #include <xen/softirq.h>
 
@@ -48,8 +49,8 @@
 struct rcu_ctrlblk rcu_ctrlblk = {
     .cur = -300,
     .completed = -300,
+    .expedite = -300,
     .lock = SPIN_LOCK_UNLOCKED,
-    .cpumask = CPU_MASK_NONE,
 };
 
 DEFINE_PER_CPU(struct rcu_data, rcu_data) = { 0L };
@@ -59,6 +60,27 @@ static int qhimark = 10000;
 static int qlowmark = 100;
 static int rsinterval = 1000;
 
+/*
+ * Collect the cpus that have yet to pass a quiescent state in the current
+ * batch. The node masks are sampled without locking, so the result is only
+ * a hint: it is used to decide whom to prod, never to complete a batch.
+ */
+static void rcu_waiting_cpus(struct rcu_ctrlblk *rcp, cpumask_t *mask)
+{
+    int n, i, cpu;
+    unsigned long qsmask;
+
+    cpus_clear(*mask);
+    for (n = 0; n < RCU_NR_NODES; n++) {
+        qsmask = rcp->node[n].qsmask;
+        for (i = 0; qsmask != 0; i++, qsmask >>= 1) {
+            cpu = n * RCU_FANOUT + i;
+            if ((qsmask & 1) && cpu < NR_CPUS)
+                cpu_set(cpu, *mask);
+        }
+    }
+}
+
 static void force_quiescent_state(struct rcu_data *rdp,
                                   struct rcu_ctrlblk *rcp)
 {
@@ -70,12 +92,24 @@ static void force_quiescent_state(struct rcu_data *rdp,
          * Don't send IPI to itself. With irqs disabled,
          * rdp->cpu is the current cpu.
          */
-        cpumask = rcp->cpumask;
+        rcu_waiting_cpus(rcp, &cpumask);
         cpu_clear(rdp->cpu, cpumask);
         cpumask_raise_softirq(cpumask, SCHEDULE_SOFTIRQ);
     }
 }
 
+/*
+ * Make every other online cpu run its RCU softirq. That both notices the
+ * current batch and, on the following pass, reports the quiescent state.
+ */
+static void rcu_kick_cpus(void)
+{
+    cpumask_t cpumask = cpu_online_map;
+
+    cpu_clear(smp_processor_id(), cpumask);
+    cpumask_raise_softirq(cpumask, RCU_SOFTIRQ);
+}
+
 /**
  * call_rcu - Queue an RCU callback for invocation after a grace period.
  * @head: structure to be used for queueing the RCU updates.
@@ -106,6 +140,31 @@ void fastcall call_rcu(struct rcu_head *head,
     local_irq_restore(flags);
 }
 
+/**
+ * call_rcu_expedited - Queue an RCU callback and expedite its grace period.
+ * @head: structure to be used for queueing the RCU updates.
+ * @func: actual update function to be invoked after the grace period
+ *
+ * The callback will be invoked after the batch currently in progress (if
+ * any) and the one that follows it complete. Both are forced along by
+ * kicking all online cpus through a quiescent state.
+ */
+void call_rcu_expedited(struct rcu_head *head,
+                        void (*func)(struct rcu_head *rcu))
+{
+    struct rcu_ctrlblk *rcp = &rcu_ctrlblk;
+
+    call_rcu(head, func);
+
+    spin_lock(&rcp->lock);
+    if (rcu_batch_before(rcp->expedite, rcp->cur + 2))
+        rcp->expedite = rcp->cur + 2;
+    spin_unlock(&rcp->lock);
+
+    raise_softirq(RCU_SOFTIRQ);
+    rcu_kick_cpus();
+}
+
 /*
  * Invoke the completed RCU callbacks. They are expected to be in
  * a per-cpu list.
@@ -138,15 +197,17 @@ static void rcu_do_batch(struct rcu_data *rdp)
  * - A new grace period is started.
  *   This is done by rcu_start_batch. The start is not broadcasted to
  *   all cpus, they must pick this up by comparing rcp->cur with
- *   rdp->quiescbatch. All cpus are recorded  in the
- *   rcu_ctrlblk.cpumask bitmap.
+ *   rdp->quiescbatch. All cpus are recorded in the qsmask of the
+ *   rcu_node covering them, and every node with cpus to wait for is
+ *   recorded in the rcu_ctrlblk.nodemask bitmap.
  * - All cpus must go through a quiescent state.
  *   Since the start of the grace period is not broadcasted, at least two
  *   calls to rcu_check_quiescent_state are required:
  *   The first call just notices that a new grace period is running. The
  *   following calls check if there was a quiescent state since the beginning
- *   of the grace period. If so, it updates rcu_ctrlblk.cpumask. If
- *   the bitmap is empty, then the grace period is completed.
+ *   of the grace period. If so, it clears the cpu in its node's qsmask, and
+ *   the last cpu of a node clears the node in rcu_ctrlblk.nodemask. If
+ *   that bitmap is empty, then the grace period is completed.
  *   rcu_check_quiescent_state calls rcu_start_batch(0) to start the next grace
  *   period (if necessary).
  */
@@ -157,9 +218,34 @@ static void rcu_do_batch(struct rcu_data *rdp)
  */
 static void rcu_start_batch(struct rcu_ctrlblk *rcp)
 {
+    struct rcu_node *rnp;
+    unsigned long qsmask;
+    int n, i;
+
     if (rcp->next_pending &&
         rcp->completed == rcp->cur) {
         rcp->next_pending = 0;
+
+        /*
+         * Set up the nodes before publishing the new batch number, so
+         * that no cpu can try to report a quiescent state for it first.
+         * Lock order is rcu_ctrlblk.lock, then rcu_node.lock.
+         */
+        bitmap_zero(rcp->nodemask, RCU_NR_NODES);
+        for (n = 0; n < RCU_NR_NODES; n++) {
+            qsmask = 0;
+            for (i = 0; i < RCU_FANOUT && n * RCU_FANOUT + i < NR_CPUS; i++)
+                if (cpu_online(n * RCU_FANOUT + i))
+                    qsmask |= 1UL << i;
+            rnp = &rcp->node[n];
+            spin_lock(&rnp->lock);
+            rnp->gpnum = rcp->cur + 1;
+            rnp->qsmask = qsmask;
+            spin_unlock(&rnp->lock);
+            if (qsmask)
+                __set_bit(n, rcp->nodemask);
+        }
+
         /*
          * next_pending == 0 must be visible in
          * __rcu_process_callbacks() before it can see new value of cur.
@@ -167,23 +253,50 @@ static void rcu_start_batch(struct rcu_ctrlblk *rcp)
         smp_wmb();
         rcp->cur++;
 
-        rcp->cpumask = cpu_online_map;
+        if (!rcu_batch_after(rcp->cur, rcp->expedite))
+            rcu_kick_cpus();
     }
 }
 
 /*
  * cpu went through a quiescent state since the beginning of the grace period.
- * Clear it from the cpu mask and complete the grace period if it was the last
- * cpu. Start another grace period if someone has further entries pending
+ * Clear it from its node's mask; the last cpu of the node clears the node
+ * from the global mask and completes the grace period if it was the last
+ * node. Start another grace period if someone has further entries pending.
+ * The node lock is dropped before the global lock is taken: the batch cannot
+ * complete, and so the nodes cannot be reinitialised, until we report.
  */
-static void cpu_quiet(int cpu, struct rcu_ctrlblk *rcp)
+static void cpu_quiet(struct rcu_data *rdp, struct rcu_ctrlblk *rcp)
 {
-    cpu_clear(cpu, rcp->cpumask);
-    if (cpus_empty(rcp->cpumask)) {
+    int n = rdp->cpu / RCU_FANOUT;
+    unsigned long bit = 1UL << (rdp->cpu % RCU_FANOUT);
+    struct rcu_node *rnp = &rcp->node[n];
+    int last;
+
+    spin_lock(&rnp->lock);
+    /*
+     * rdp->quiescbatch/rnp->gpnum and the node mask can come out of sync
+     * during cpu startup. Ignore the quiescent state.
+     */
+    if (unlikely(rnp->gpnum != rdp->quiescbatch) || !(rnp->qsmask & bit)) {
+        spin_unlock(&rnp->lock);
+        return;
+    }
+    rnp->qsmask &= ~bit;
+    last = (rnp->qsmask == 0);
+    spin_unlock(&rnp->lock);
+
+    if (!last)
+        return;
+
+    spin_lock(&rcp->lock);
+    __clear_bit(n, rcp->nodemask);
+    if (bitmap_empty(rcp->nodemask, RCU_NR_NODES)) {
         /* batch completed ! */
         rcp->completed = rcp->cur;
         rcu_start_batch(rcp);
     }
+    spin_unlock(&rcp->lock);
 }
 
 /*
@@ -210,15 +323,7 @@ static void rcu_check_quiescent_state(struct rcu_ctrlblk *rcp,
 
     rdp->qs_pending = 0;
 
-    spin_lock(&rcp->lock);
-    /*
-     * rdp->quiescbatch/rcp->cur and the cpu bitmap can come out of sync
-     * during cpu startup. Ignore the quiescent state.
-     */
-    if (likely(rdp->quiescbatch == rcp->cur))
-        cpu_quiet(rdp->cpu, rcp);
-
-    spin_unlock(&rcp->lock);
+    cpu_quiet(rdp, rcp);
 }
 
 
@@ -343,6 +448,13 @@ void __devinit rcu_online_cpu(int cpu)
 
 void __init rcu_init(void)
 {
+    int n;
+
+    for (n = 0; n < RCU_NR_NODES; n++) {
+        spin_lock_init(&rcu_ctrlblk.node[n].lock);
+        rcu_ctrlblk.node[n].gpnum = rcu_ctrlblk.completed;
+    }
+
     rcu_online_cpu(smp_processor_id());
     open_softirq(RCU_SOFTIRQ, rcu_process_callbacks);
 }
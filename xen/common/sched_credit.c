@@ -108,6 +108,8 @@
 struct csched_pcpu {
     struct list_head runq;
     uint32_t runq_sort_last;
+    unsigned int runq_len;      /* non-idle VCPUs waiting on runq */
+    domid_t gang_hint;          /* co-scheduled domain to favour, if any */
     struct timer ticker;
     unsigned int tick;
 };
@@ -123,6 +125,7 @@ struct csched_vcpu {
     atomic_t credit;
     uint16_t flags;
     int16_t pri;
+    bool_t yield;               /* spinning: run a sibling instead */
 #ifdef CSCHED_STATS
     struct {
         int credit_last;
@@ -145,6 +148,7 @@ struct csched_dom {
     uint16_t active_vcpu_count;
     uint16_t weight;
     uint16_t cap;
+    bool_t cosched;
 };
 
 /*
@@ -192,6 +196,9 @@ __runq_insert(unsigned int cpu, struct csched_vcpu *svc)
     BUG_ON( __vcpu_on_runq(svc) );
     BUG_ON( cpu != svc->vcpu->processor );
 
+    if ( !is_idle_vcpu(svc->vcpu) )
+        CSCHED_PCPU(cpu)->runq_len++;
+
     list_for_each( iter, runq )
     {
         const struct csched_vcpu * const iter_svc = __runq_elem(iter);
@@ -207,6 +214,8 @@ __runq_remove(struct csched_vcpu *svc)
 {
     BUG_ON( !__vcpu_on_runq(svc) );
     list_del_init(&svc->runq_elem);
+    if ( !is_idle_vcpu(svc->vcpu) )
+        CSCHED_PCPU(svc->vcpu->processor)->runq_len--;
 }
 
 static inline void
@@ -280,6 +289,8 @@ csched_pcpu_init(int cpu)
     init_timer(&spc->ticker, csched_tick, (void *)(unsigned long)cpu, cpu);
     INIT_LIST_HEAD(&spc->runq);
     spc->runq_sort_last = csched_priv.runq_sort;
+    spc->runq_len = 0;
+    spc->gang_hint = DOMID_INVALID;
     per_cpu(schedule_data, cpu).sched_priv = spc;
 
     /* Start off idling... */
@@ -539,6 +550,7 @@ csched_vcpu_init(struct vcpu *vc)
     svc->vcpu = vc;
     atomic_set(&svc->credit, 0);
     svc->flags = 0U;
+    svc->yield = 0;
     svc->pri = is_idle_domain(dom) ? CSCHED_PRI_IDLE : CSCHED_PRI_TS_UNDER;
     CSCHED_VCPU_STATS_RESET(svc);
     vc->sched_priv = svc;
@@ -658,6 +670,7 @@ csched_dom_cntl(
     {
         op->u.credit.weight = sdom->weight;
         op->u.credit.cap = sdom->cap;
+        op->u.credit.cosched = sdom->cosched;
     }
     else
     {
@@ -678,12 +691,22 @@ csched_dom_cntl(
         if ( op->u.credit.cap != (uint16_t)~0U )
             sdom->cap = op->u.credit.cap;
 
+        if ( op->u.credit.cosched != (uint16_t)~0U )
+            sdom->cosched = !!op->u.credit.cosched;
+
         spin_unlock_irqrestore(&csched_priv.lock, flags);
     }
 
     return 0;
 }
 
+static void
+csched_vcpu_yield(struct vcpu *vc)
+{
+    /* Acted upon, and cleared, by the csched_schedule() this leads to. */
+    CSCHED_VCPU(vc)->yield = 1;
+}
+
 static int
 csched_dom_init(struct domain *dom)
 {
@@ -705,6 +728,7 @@ csched_dom_init(struct domain *dom)
     sdom->dom = dom;
     sdom->weight = CSCHED_DEFAULT_WEIGHT;
     sdom->cap = 0U;
+    sdom->cosched = 0;
     dom->sched_priv = sdom;
 
     return 0;
@@ -739,7 +763,7 @@ csched_runq_sort(unsigned int cpu)
 
     spc->runq_sort_last = sort_epoch;
 
-    spin_lock_irqsave(&per_cpu(schedule_data, cpu).schedule_lock, flags);
+    spin_lock_irqsave(per_cpu(schedule_data, cpu).schedule_lock, flags);
 
     runq = &spc->runq;
     elem = runq->next;
@@ -764,7 +788,7 @@ csched_runq_sort(unsigned int cpu)
         elem = next;
     }
 
-    spin_unlock_irqrestore(&per_cpu(schedule_data, cpu).schedule_lock, flags);
+    spin_unlock_irqrestore(per_cpu(schedule_data, cpu).schedule_lock, flags);
 }
 
 static void
@@ -1079,7 +1103,7 @@ csched_load_balance(int cpu, struct csched_vcpu *snext)
          * cause a deadlock if the peer CPU is also load balancing and trying
          * to lock this CPU.
          */
-        if ( !spin_trylock(&per_cpu(schedule_data, peer_cpu).schedule_lock) )
+        if ( !spin_trylock(per_cpu(schedule_data, peer_cpu).schedule_lock) )
         {
             CSCHED_STAT_CRANK(steal_trylock_failed);
             continue;
@@ -1088,10 +1112,14 @@ csched_load_balance(int cpu, struct csched_vcpu *snext)
         /*
          * Any work over there to steal?
          */
+        SCHED_STAT_CRANK(cpu, steal_attempts);
         speer = csched_runq_steal(peer_cpu, cpu, snext->pri);
-        spin_unlock(&per_cpu(schedule_data, peer_cpu).schedule_lock);
+        spin_unlock(per_cpu(schedule_data, peer_cpu).schedule_lock);
         if ( speer != NULL )
+        {
+            SCHED_STAT_CRANK(cpu, steal_successes);
             return speer;
+        }
     }
 
  out:
@@ -1100,6 +1128,135 @@ csched_load_balance(int cpu, struct csched_vcpu *snext)
     return snext;
 }
 
+/*
+ * Directed yield: scurr is spinning (it yielded or took a PAUSE-loop exit),
+ * most likely on a lock held by a preempted sibling.  Run a sibling waiting
+ * on our runq or, failing that, pull one from a peer's runq.  As in load
+ * balancing, peer locks are only tried.  Returns NULL if there is none.
+ */
+static struct csched_vcpu *
+csched_yield_to_sibling(int cpu, struct csched_vcpu *scurr)
+{
+    struct csched_vcpu *svc;
+    struct list_head *iter;
+    struct vcpu *vc;
+    spinlock_t *lock;
+    int peer_cpu;
+
+    list_for_each( iter, RUNQ(cpu) )
+    {
+        svc = __runq_elem(iter);
+        if ( svc->pri == CSCHED_PRI_IDLE )
+            break;
+        if ( svc->sdom == scurr->sdom && svc != scurr )
+        {
+            __runq_remove(svc);
+            return svc;
+        }
+    }
+
+    for_each_vcpu ( scurr->vcpu->domain, vc )
+    {
+        svc = CSCHED_VCPU(vc);
+        peer_cpu = vc->processor;
+        if ( peer_cpu == cpu || vc->is_running || !__vcpu_on_runq(svc) ||
+             !cpu_isset(cpu, vc->cpu_affinity) )
+            continue;
+
+        lock = per_cpu(schedule_data, peer_cpu).schedule_lock;
+        if ( !spin_trylock(lock) )
+        {
+            CSCHED_STAT_CRANK(steal_trylock_failed);
+            continue;
+        }
+
+        /* Check again now that its runq cannot change under us. */
+        if ( vc->processor == peer_cpu && !vc->is_running &&
+             __vcpu_on_runq(svc) )
+        {
+            CSCHED_VCPU_STAT_CRANK(svc, migrate_q);
+            CSCHED_STAT_CRANK(migrate_queued);
+            __runq_remove(svc);
+            vc->processor = cpu;
+            spin_unlock(lock);
+            return svc;
+        }
+        spin_unlock(lock);
+    }
+
+    return NULL;
+}
+
+/*
+ * A VCPU of a co-scheduled domain starts a time slice on cpu: ask the
+ * CPUs whose runqs hold its waiting siblings to run them now, so that
+ * they share the slice.  Hints are set without locks and may be stale;
+ * csched_gang_pick() checks them against the runq.
+ */
+static void
+csched_gang_kick(int cpu, struct csched_vcpu *snext)
+{
+    struct domain *d = snext->vcpu->domain;
+    struct vcpu *vc;
+    cpumask_t mask;
+    int peer_cpu;
+
+    cpus_clear(mask);
+    for_each_vcpu ( d, vc )
+    {
+        peer_cpu = vc->processor;
+        if ( peer_cpu == cpu || vc->is_running ||
+             !__vcpu_on_runq(CSCHED_VCPU(vc)) )
+            continue;
+        CSCHED_PCPU(peer_cpu)->gang_hint = d->domain_id;
+        cpu_set(peer_cpu, mask);
+    }
+
+    if ( !cpus_empty(mask) )
+    {
+        CSCHED_STAT_CRANK(gang_kick);
+        cpumask_raise_softirq(mask, SCHEDULE_SOFTIRQ);
+    }
+}
+
+/*
+ * Consume this CPU's co-scheduling hint: take the first waiting VCPU of
+ * the hinted domain off our runq, unless a VCPU boosted on wakeup is
+ * waiting too.  Credit accounting is unchanged, so this only reorders
+ * work within the accounting period.
+ */
+static struct csched_vcpu *
+csched_gang_pick(int cpu)
+{
+    struct csched_pcpu * const spc = CSCHED_PCPU(cpu);
+    struct list_head * const runq = RUNQ(cpu);
+    struct csched_vcpu *svc;
+    struct list_head *iter;
+    domid_t domid = spc->gang_hint;
+
+    if ( likely(domid == DOMID_INVALID) )
+        return NULL;
+    spc->gang_hint = DOMID_INVALID;
+
+    if ( __runq_elem(runq->next)->pri == CSCHED_PRI_TS_BOOST )
+        return NULL;
+
+    list_for_each( iter, runq )
+    {
+        svc = __runq_elem(iter);
+        if ( svc->pri == CSCHED_PRI_IDLE )
+            break;
+        if ( svc->vcpu->domain->domain_id == domid )
+        {
+            CSCHED_STAT_CRANK(gang_pick);
+            __runq_remove(svc);
+            return svc;
+        }
+    }
+
+    return NULL;
+}
+
 /*
  * This function is in the critical path. It is designed to be simple and
  * fast for the common case.
@@ -1116,6 +1273,8 @@ csched_schedule(s_time_t now)
     CSCHED_STAT_CRANK(schedule);
     CSCHED_VCPU_CHECK(current);
 
+    sched_stat_runq_len(cpu, CSCHED_PCPU(cpu)->runq_len);
+
     /*
      * Select next runnable local VCPU (ie top of local runq)
      */
@@ -1124,20 +1283,38 @@ csched_schedule(s_time_t now)
     else
         BUG_ON( is_idle_vcpu(current) || list_empty(runq) );
 
-    snext = __runq_elem(runq->next);
-
     /*
-     * SMP Load balance:
-     *
-     * If the next highest priority local runnable VCPU has already eaten
-     * through its credits, look on other PCPUs to see if we have more
-     * urgent work... If not, csched_load_balance() will return snext, but
-     * already removed from the runq.
+     * A spinning VCPU hands the CPU to a preempted sibling if it can, and
+     * a CPU asked to co-schedule a domain runs its waiting VCPU.
      */
-    if ( snext->pri > CSCHED_PRI_TS_OVER )
-        __runq_remove(snext);
-    else
-        snext = csched_load_balance(cpu, snext);
+    snext = NULL;
+    if ( unlikely(scurr->yield) )
+    {
+        scurr->yield = 0;
+        if ( vcpu_runnable(current) &&
+             (snext = csched_yield_to_sibling(cpu, scurr)) != NULL )
+            CSCHED_STAT_CRANK(yield_directed);
+    }
+    if ( snext == NULL && (snext = csched_gang_pick(cpu)) == NULL )
+    {
+        snext = __runq_elem(runq->next);
+
+        /*
+         * SMP Load balance:
+         *
+         * If the next highest priority local runnable VCPU has already
+         * eaten through its credits, look on other PCPUs to see if we have
+         * more urgent work... If not, csched_load_balance() will return
+         * snext, but already removed from the runq.
+         */
+        if ( snext->pri > CSCHED_PRI_TS_OVER )
+            __runq_remove(snext);
+        else
+            snext = csched_load_balance(cpu, snext);
+
+        if ( snext != scurr && snext->sdom != NULL && snext->sdom->cosched )
+            csched_gang_kick(cpu, snext);
+    }
 
     /*
      * Update idlers mask if necessary. When we're idling, other CPUs
@@ -1178,7 +1355,8 @@ csched_dump_vcpu(struct csched_vcpu *svc)
 
     if ( sdom )
     {
-        printk(" credit=%i [w=%u]", atomic_read(&svc->credit), sdom->weight);
+        printk(" credit=%i [w=%u%s]", atomic_read(&svc->credit), sdom->weight,
+               sdom->cosched ? ",gang" : "");
 #ifdef CSCHED_STATS
         printk(" (%d+%u) {a/i=%u/%u m=%u+%u}",
                 svc->stats.credit_last,
@@ -1357,6 +1535,7 @@ struct scheduler sched_credit_def = {
 
     .sleep          = csched_vcpu_sleep,
     .wake           = csched_vcpu_wake,
+    .yield          = csched_vcpu_yield,
 
     .adjust         = csched_dom_cntl,
 
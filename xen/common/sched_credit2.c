@@ -0,0 +1,989 @@
+/****************************************************************************
+ *
+ *        File: common/sched_credit2.c
+ *
+ * Description: Credit-based SMP CPU scheduler with shared runqueues
+ *
+ * Every runqueue serves a group of pCPUs (a socket by default, or a core)
+ * and is protected by a single lock, which becomes the schedule_lock of
+ * all its member CPUs.  There is no periodic accounting: a vCPU burns
+ * credit for the time it actually ran, weighted by its domain's weight,
+ * and the runqueue is kept sorted by credit.  When the best candidate has
+ * run out of credit, every vCPU competing on that runqueue is given a
+ * fresh allocation; vCPUs not currently queued or running pick up their
+ * share lazily when they next queue up.  Load is tracked per runqueue and
+ * idle runqueues periodically pull work from busier ones.
+ */
+
+#include <xen/config.h>
+#include <xen/init.h>
+#include <xen/lib.h>
+#include <xen/sched.h>
+#include <xen/domain.h>
+#include <xen/delay.h>
+#include <xen/event.h>
+#include <xen/time.h>
+#include <xen/perfc.h>
+#include <xen/sched-if.h>
+#include <xen/softirq.h>
+#include <asm/atomic.h>
+#include <xen/errno.h>
+#include <xen/inttypes.h>
+
+/*
+ * Basic constants
+ */
+#define CSCHED2_DEFAULT_WEIGHT      256
+#define CSCHED2_CREDIT_INIT         MILLISECS(10)
+#define CSCHED2_MIN_TIMER           MICROSECS(500)
+#define CSCHED2_MAX_TIMER           MILLISECS(2)
+#define CSCHED2_BALANCE_INTERVAL    MILLISECS(10)
+
+/*
+ * Runqueue load is a decaying average over a ~1s window, in fixed point
+ * with CSCHED2_LOAD_SHIFT fractional bits (1 << CSCHED2_LOAD_SHIFT is one
+ * continuously runnable vCPU).
+ */
+#define CSCHED2_LOAD_WINDOW_SHIFT   30
+#define CSCHED2_LOAD_SHIFT          16
+#define CSCHED2_LOAD_ONE            (1ULL << CSCHED2_LOAD_SHIFT)
+/* Bias towards the current runqueue when picking a CPU: half a vCPU. */
+#define CSCHED2_MIGRATE_RESIST      (CSCHED2_LOAD_ONE / 2)
+
+
+/*
+ * Flags (bit numbers in csched2_vcpu.flags)
+ */
+/* vCPU is current on a CPU, or still being switched out of it. */
+#define __CSFLAG_scheduled          0
+/* Put vCPU on the runqueue once its context has been saved. */
+#define __CSFLAG_delayed_runq_add   1
+/* vCPU is counted in the load of csched2_vcpu.load_rqd. */
+#define __CSFLAG_loaded             2
+
+
+/*
+ * Useful macros
+ */
+#define CSCHED2_RQD(_c)     \
+    ((struct csched2_runqueue *)per_cpu(schedule_data, _c).sched_priv)
+#define CSCHED2_VCPU(_vcpu) ((struct csched2_vcpu *) (_vcpu)->sched_priv)
+#define CSCHED2_DOM(_dom)   ((struct csched2_dom *) (_dom)->sched_priv)
+
+#define CSCHED2_STAT_CRANK(_X)  (perfc_incr(_X))
+
+
+/*
+ * Runqueue, shared by the CPUs in cpumask active
+ */
+struct csched2_runqueue {
+    spinlock_t lock;
+    unsigned int id;
+    struct list_head runq;      /* queued vCPUs, highest credit first */
+    unsigned int queued;        /* length of runq */
+    cpumask_t active;           /* CPUs served by this runqueue */
+    cpumask_t idle;             /* ... which are idle and not yet tickled */
+    unsigned int load;          /* queued and running vCPUs */
+    uint64_t avgload;           /* decaying average of load */
+    s_time_t load_last_update;
+    s_time_t next_balance;
+    uint32_t reset_epoch;       /* bumped on every credit reset */
+} __cacheline_aligned;
+
+/*
+ * Virtual CPU
+ */
+struct csched2_vcpu {
+    struct list_head runq_elem;
+    struct csched2_dom *sdom;
+    struct vcpu *vcpu;
+    struct csched2_runqueue *load_rqd;
+    unsigned long flags;
+    s_time_t credit;
+    s_time_t start_time;        /* when credit was last burnt */
+    uint32_t reset_epoch;
+};
+
+/*
+ * Domain
+ */
+struct csched2_dom {
+    struct domain *dom;
+    uint16_t weight;
+};
+
+/*
+ * System-wide private data.  The lock only covers the set of runqueues and
+ * which CPUs they serve; it is never taken when scheduling.
+ */
+struct csched2_private {
+    spinlock_t lock;
+    unsigned int nr_runqs;
+    bool_t started;
+};
+
+
+/*
+ * Global variables
+ */
+static struct csched2_private csched2_priv;
+static struct csched2_runqueue csched2_runqs[NR_CPUS];
+
+/* Group CPUs into runqueues by "socket" or by "core". */
+static char opt_credit2_runqueue[8] = "socket";
+string_param("credit2_runqueue", opt_credit2_runqueue);
+
+
+/* Credit a vCPU of this weight burns in time t, and the reverse. */
+static inline s_time_t
+t2c(const struct csched2_vcpu *svc, s_time_t t)
+{
+    return t * CSCHED2_DEFAULT_WEIGHT / svc->sdom->weight;
+}
+
+static inline s_time_t
+c2t(const struct csched2_vcpu *svc, s_time_t credit)
+{
+    return credit * svc->sdom->weight / CSCHED2_DEFAULT_WEIGHT;
+}
+
+static inline int
+__vcpu_on_runq(struct csched2_vcpu *svc)
+{
+    return !list_empty(&svc->runq_elem);
+}
+
+static inline struct csched2_vcpu *
+__runq_elem(struct list_head *elem)
+{
+    return list_entry(elem, struct csched2_vcpu, runq_elem);
+}
+
+/* The runqueue's average load as of now, without updating it. */
+static uint64_t
+__avgload(const struct csched2_runqueue *rqd, s_time_t now)
+{
+    const uint64_t window = 1ULL << CSCHED2_LOAD_WINDOW_SHIFT;
+    uint64_t cur = (uint64_t)rqd->load << CSCHED2_LOAD_SHIFT;
+    s_time_t delta = now - rqd->load_last_update;
+
+    if ( delta <= 0 )
+        return rqd->avgload;
+    if ( delta >= window )
+        return cur;
+
+    return (delta * cur + (window - delta) * rqd->avgload)
+           >> CSCHED2_LOAD_WINDOW_SHIFT;
+}
+
+static void
+__update_load(struct csched2_runqueue *rqd, int change, s_time_t now)
+{
+    rqd->avgload = __avgload(rqd, now);
+    rqd->load_last_update = now;
+    rqd->load += change;
+}
+
+static inline void
+__load_inc(struct csched2_runqueue *rqd, struct csched2_vcpu *svc,
+           s_time_t now)
+{
+    if ( __test_and_set_bit(__CSFLAG_loaded, &svc->flags) )
+        return;
+    svc->load_rqd = rqd;
+    __update_load(rqd, 1, now);
+}
+
+static inline void
+__load_dec(struct csched2_vcpu *svc, s_time_t now)
+{
+    if ( !__test_and_clear_bit(__CSFLAG_loaded, &svc->flags) )
+        return;
+    BUG_ON( svc->load_rqd->load == 0 );
+    __update_load(svc->load_rqd, -1, now);
+}
+
+static void
+burn_credits(struct csched2_vcpu *svc, s_time_t now)
+{
+    s_time_t delta = now - svc->start_time;
+
+    if ( delta > 0 )
+    {
+        svc->credit -= t2c(svc, delta);
+        svc->start_time = now;
+    }
+}
+
+static inline void
+__credit_reset(struct csched2_runqueue *rqd, struct csched2_vcpu *svc)
+{
+    svc->credit += CSCHED2_CREDIT_INIT;
+    if ( svc->credit > CSCHED2_CREDIT_INIT )
+        svc->credit = CSCHED2_CREDIT_INIT;
+    svc->reset_epoch = rqd->reset_epoch;
+}
+
+static void
+__runq_insert(struct csched2_runqueue *rqd, struct csched2_vcpu *svc,
+              s_time_t now)
+{
+    struct list_head *iter;
+
+    BUG_ON( __vcpu_on_runq(svc) );
+    BUG_ON( CSCHED2_RQD(svc->vcpu->processor) != rqd );
+
+    /* Missed a reset while blocked or elsewhere?  Catch up once. */
+    if ( svc->reset_epoch != rqd->reset_epoch )
+        __credit_reset(rqd, svc);
+
+    list_for_each( iter, &rqd->runq )
+        if ( svc->credit > __runq_elem(iter)->credit )
+            break;
+
+    list_add_tail(&svc->runq_elem, iter);
+    rqd->queued++;
+    __load_inc(rqd, svc, now);
+}
+
+static inline void
+__runq_remove(struct csched2_vcpu *svc)
+{
+    BUG_ON( !__vcpu_on_runq(svc) );
+    list_del_init(&svc->runq_elem);
+    CSCHED2_RQD(svc->vcpu->processor)->queued--;
+}
+
+/*
+ * Hand out a new allocation of credit to every vCPU competing on rqd.
+ * Adding the same amount and capping preserves the runqueue's order, so
+ * it need not be re-sorted.
+ */
+static void
+reset_credit(struct csched2_runqueue *rqd)
+{
+    struct list_head *iter;
+    struct vcpu *curr;
+    int cpu;
+
+    CSCHED2_STAT_CRANK(c2_credit_reset);
+
+    rqd->reset_epoch++;
+
+    list_for_each( iter, &rqd->runq )
+        __credit_reset(rqd, __runq_elem(iter));
+
+    for_each_cpu_mask ( cpu, rqd->active )
+    {
+        curr = per_cpu(schedule_data, cpu).curr;
+        if ( curr != NULL && !is_idle_vcpu(curr) )
+            __credit_reset(rqd, CSCHED2_VCPU(curr));
+    }
+}
+
+/*
+ * A vCPU was queued on rqd: get an idle CPU to pick it up or, failing
+ * that, preempt the running vCPU with the least credit if it has less
+ * than the newcomer.
+ */
+static void
+runq_tickle(struct csched2_runqueue *rqd, struct csched2_vcpu *new,
+            s_time_t now)
+{
+    struct csched2_vcpu *cur;
+    s_time_t lowest = new->credit;
+    cpumask_t mask;
+    int cpu, ipid = -1;
+
+    cpus_and(mask, rqd->idle, new->vcpu->cpu_affinity);
+    cpus_and(mask, mask, cpu_online_map);
+    if ( !cpus_empty(mask) )
+    {
+        CSCHED2_STAT_CRANK(c2_tickle_idle);
+        ipid = cpu_isset(new->vcpu->processor, mask)
+               ? new->vcpu->processor : first_cpu(mask);
+        /* Let the next wakeup find a different idler. */
+        cpu_clear(ipid, rqd->idle);
+        goto tickle;
+    }
+
+    cpus_and(mask, rqd->active, new->vcpu->cpu_affinity);
+    cpus_and(mask, mask, cpu_online_map);
+    for_each_cpu_mask ( cpu, mask )
+    {
+        cur = CSCHED2_VCPU(per_cpu(schedule_data, cpu).curr);
+        if ( is_idle_vcpu(cur->vcpu) )
+            continue;
+        burn_credits(cur, now);
+        if ( cur->credit < lowest )
+        {
+            lowest = cur->credit;
+            ipid = cpu;
+        }
+    }
+
+    if ( ipid == -1 )
+        return;
+
+    CSCHED2_STAT_CRANK(c2_tickle_preempt);
+
+ tickle:
+    cpu_raise_softirq(ipid, SCHEDULE_SOFTIRQ);
+}
+
+static void
+__runq_init(struct csched2_runqueue *rqd, unsigned int id)
+{
+    spin_lock_init(&rqd->lock);
+    rqd->id = id;
+    INIT_LIST_HEAD(&rqd->runq);
+    rqd->queued = 0;
+    cpus_clear(rqd->active);
+    cpus_clear(rqd->idle);
+    rqd->load = 0;
+    rqd->avgload = 0;
+    rqd->load_last_update = NOW();
+    rqd->next_balance = 0;
+    rqd->reset_epoch = 0;
+}
+
+/*
+ * The runqueue serving cpu's socket (or core), or a new one.  Siblings are
+ * only known once a CPU has booted; until then it gets a runqueue of its
+ * own.  Called with csched2_priv.lock held; a new runqueue is returned
+ * with *new set, unlocked.
+ */
+static struct csched2_runqueue *
+__runq_for_cpu(int cpu, bool_t *new)
+{
+    const cpumask_t *peers;
+    unsigned int i;
+
+    peers = strcmp(opt_credit2_runqueue, "core") == 0
+            ? &per_cpu(cpu_sibling_map, cpu) : &per_cpu(cpu_core_map, cpu);
+
+    *new = 0;
+    for ( i = 0; i < csched2_priv.nr_runqs; i++ )
+        if ( cpus_intersects(csched2_runqs[i].active, *peers) )
+            return &csched2_runqs[i];
+
+    /* Reuse a runqueue left without CPUs (the boot-time one). */
+    for ( i = 0; i < csched2_priv.nr_runqs; i++ )
+        if ( cpus_empty(csched2_runqs[i].active) )
+            return &csched2_runqs[i];
+
+    BUG_ON( csched2_priv.nr_runqs >= NR_CPUS );
+    *new = 1;
+    __runq_init(&csched2_runqs[i], i);
+    csched2_priv.nr_runqs++;
+
+    return &csched2_runqs[i];
+}
+
+static int
+csched2_pcpu_init(int cpu)
+{
+    struct csched2_runqueue *rqd;
+    unsigned long flags;
+    bool_t new;
+
+    spin_lock_irqsave(&csched2_priv.lock, flags);
+
+    /*
+     * All CPUs share the first runqueue until the SMP topology is known:
+     * see csched2_start_runqueues().
+     */
+    if ( csched2_priv.started )
+        rqd = __runq_for_cpu(cpu, &new);
+    else if ( csched2_priv.nr_runqs == 0 )
+    {
+        __runq_init(&csched2_runqs[0], 0);
+        csched2_priv.nr_runqs = 1;
+        rqd = &csched2_runqs[0];
+    }
+    else
+        rqd = &csched2_runqs[0];
+
+    spin_lock(&rqd->lock);
+    cpu_set(cpu, rqd->active);
+    BUG_ON( !is_idle_vcpu(per_cpu(schedule_data, cpu).curr) );
+    cpu_set(cpu, rqd->idle);
+    per_cpu(schedule_data, cpu).sched_priv = rqd;
+    per_cpu(schedule_data, cpu).schedule_lock = &rqd->lock;
+    spin_unlock(&rqd->lock);
+
+    spin_unlock_irqrestore(&csched2_priv.lock, flags);
+
+    return 0;
+}
+
+static int
+csched2_vcpu_init(struct vcpu *vc)
+{
+    struct domain * const dom = vc->domain;
+    struct csched2_vcpu *svc;
+
+    svc = xmalloc(struct csched2_vcpu);
+    if ( svc == NULL )
+        return -1;
+
+    INIT_LIST_HEAD(&svc->runq_elem);
+    svc->sdom = CSCHED2_DOM(dom);
+    svc->vcpu = vc;
+    svc->load_rqd = NULL;
+    svc->flags = 0UL;
+    svc->credit = is_idle_domain(dom) ? 0 : CSCHED2_CREDIT_INIT;
+    svc->start_time = NOW();
+    vc->sched_priv = svc;
+
+    if ( unlikely(!CSCHED2_RQD(vc->processor)) )
+    {
+        if ( csched2_pcpu_init(vc->processor) != 0 )
+            return -1;
+    }
+
+    svc->reset_epoch = CSCHED2_RQD(vc->processor)->reset_epoch;
+
+    return 0;
+}
+
+static void
+csched2_vcpu_destroy(struct vcpu *vc)
+{
+    struct csched2_vcpu * const svc = CSCHED2_VCPU(vc);
+    unsigned long flags;
+
+    BUG_ON( svc->sdom == NULL );
+
+    vcpu_schedule_lock_irqsave(vc, flags);
+    BUG_ON( __vcpu_on_runq(svc) );
+    __load_dec(svc, NOW());
+    vcpu_schedule_unlock_irqrestore(vc, flags);
+
+    xfree(svc);
+}
+
+static void
+csched2_vcpu_sleep(struct vcpu *vc)
+{
+    struct csched2_vcpu * const svc = CSCHED2_VCPU(vc);
+
+    BUG_ON( is_idle_vcpu(vc) );
+
+    if ( per_cpu(schedule_data, vc->processor).curr == vc )
+        cpu_raise_softirq(vc->processor, SCHEDULE_SOFTIRQ);
+    else if ( __vcpu_on_runq(svc) )
+    {
+        __runq_remove(svc);
+        __load_dec(svc, NOW());
+    }
+    else if ( __test_and_clear_bit(__CSFLAG_delayed_runq_add, &svc->flags) )
+        __load_dec(svc, NOW());
+}
+
+static void
+csched2_vcpu_wake(struct vcpu *vc)
+{
+    struct csched2_vcpu * const svc = CSCHED2_VCPU(vc);
+    struct csched2_runqueue * const rqd = CSCHED2_RQD(vc->processor);
+    s_time_t now = NOW();
+
+    BUG_ON( is_idle_vcpu(vc) );
+
+    if ( unlikely(per_cpu(schedule_data, vc->processor).curr == vc) )
+        return;
+    if ( unlikely(__vcpu_on_runq(svc)) )
+        return;
+
+    CSCHED2_STAT_CRANK(c2_vcpu_wake);
+
+    /*
+     * Still being switched out of its last CPU: it can only be queued
+     * (and so picked up elsewhere) once its context has been saved.
+     */
+    if ( unlikely(test_bit(__CSFLAG_scheduled, &svc->flags)) )
+    {
+        __set_bit(__CSFLAG_delayed_runq_add, &svc->flags);
+        __load_inc(rqd, svc, now);
+        return;
+    }
+
+    __runq_insert(rqd, svc, now);
+    runq_tickle(rqd, svc, now);
+}
+
+static void
+csched2_context_saved(struct vcpu *vc)
+{
+    struct csched2_vcpu * const svc = CSCHED2_VCPU(vc);
+    s_time_t now;
+
+    if ( is_idle_vcpu(vc) )
+        return;
+
+    vcpu_schedule_lock_irq(vc);
+
+    now = NOW();
+    __clear_bit(__CSFLAG_scheduled, &svc->flags);
+
+    if ( __test_and_clear_bit(__CSFLAG_delayed_runq_add, &svc->flags) )
+    {
+        if ( likely(vcpu_runnable(vc)) )
+        {
+            struct csched2_runqueue * const rqd = CSCHED2_RQD(vc->processor);
+
+            __runq_insert(rqd, svc, now);
+            runq_tickle(rqd, svc, now);
+        }
+        else
+            __load_dec(svc, now);
+    }
+
+    vcpu_schedule_unlock_irq(vc);
+}
+
+/*
+ * Prefer the least loaded runqueue, with some resistance to leaving the
+ * current one, then an idle CPU within it.  Runqueue loads are read
+ * without their locks: they only steer the choice.
+ */
+static int
+csched2_cpu_pick(struct vcpu *vc)
+{
+    struct csched2_vcpu * const svc = CSCHED2_VCPU(vc);
+    struct csched2_runqueue * const cur = CSCHED2_RQD(vc->processor);
+    struct csched2_runqueue *rqd, *best = NULL;
+    uint64_t load, best_load = ~0ULL;
+    s_time_t now = NOW();
+    cpumask_t cpus, mask;
+    unsigned int i;
+
+    cpus_and(cpus, cpu_online_map, vc->cpu_affinity);
+    ASSERT( !cpus_empty(cpus) );
+
+    for ( i = 0; i < csched2_priv.nr_runqs; i++ )
+    {
+        rqd = &csched2_runqs[i];
+        if ( !cpus_intersects(rqd->active, cpus) )
+            continue;
+
+        load = __avgload(rqd, now);
+        if ( rqd == cur )
+            load = (load > CSCHED2_MIGRATE_RESIST)
+                   ? load - CSCHED2_MIGRATE_RESIST : 0;
+        if ( load < best_load )
+        {
+            best_load = load;
+            best = rqd;
+        }
+    }
+
+    if ( best == NULL )
+        return cpu_isset(vc->processor, cpus)
+               ? vc->processor : cycle_cpu(vc->processor, cpus);
+
+    if ( best != cur )
+    {
+        CSCHED2_STAT_CRANK(c2_migrate_runq);
+        BUG_ON( __vcpu_on_runq(svc) );
+        __load_dec(svc, now);
+    }
+
+    cpus_and(mask, best->idle, cpus);
+    if ( cpus_empty(mask) )
+        cpus_and(mask, best->active, cpus);
+    if ( cpus_empty(mask) )
+        mask = cpus;
+
+    return cpu_isset(vc->processor, mask)
+           ? vc->processor : cycle_cpu(vc->processor, mask);
+}
+
+/*
+ * Called periodically from csched2_schedule(): if another runqueue is
+ * busier than ours by more than one vCPU's worth of load, pull a queued
+ * vCPU that may run here.  The peer's lock is only tried, as its CPUs may
+ * be balancing against us at the same time.
+ */
+static void
+balance_load(struct csched2_runqueue *rqd, int cpu, s_time_t now)
+{
+    struct csched2_runqueue *orqd, *busiest = NULL;
+    struct csched2_vcpu *svc;
+    struct list_head *iter;
+    uint64_t load, my_load, max_load = 0;
+    cpumask_t mask;
+    unsigned int i;
+
+    rqd->next_balance = now + CSCHED2_BALANCE_INTERVAL;
+    my_load = __avgload(rqd, now);
+
+    for ( i = 0; i < csched2_priv.nr_runqs; i++ )
+    {
+        orqd = &csched2_runqs[i];
+        if ( orqd == rqd || list_empty(&orqd->runq) )
+            continue;
+        load = __avgload(orqd, now);
+        if ( load > max_load )
+        {
+            max_load = load;
+            busiest = orqd;
+        }
+    }
+
+    if ( busiest == NULL || max_load <= my_load + CSCHED2_LOAD_ONE )
+        return;
+
+    if ( !spin_trylock(&busiest->lock) )
+    {
+        CSCHED2_STAT_CRANK(c2_balance_trylock_failed);
+        return;
+    }
+
+    SCHED_STAT_CRANK(cpu, steal_attempts);
+
+    /* Take the least urgent vCPU: it would have waited longest there. */
+    list_for_each_prev( iter, &busiest->runq )
+    {
+        svc = __runq_elem(iter);
+
+        cpus_and(mask, svc->vcpu->cpu_affinity, rqd->active);
+        cpus_and(mask, mask, cpu_online_map);
+        if ( cpus_empty(mask) )
+            continue;
+
+        CSCHED2_STAT_CRANK(c2_balance_pull);
+        SCHED_STAT_CRANK(cpu, steal_successes);
+        __runq_remove(svc);
+        __load_dec(svc, now);
+        svc->vcpu->processor = cpu_isset(cpu, mask) ? cpu : first_cpu(mask);
+        __runq_insert(rqd, svc, now);
+        if ( svc->vcpu->processor != cpu )
+            runq_tickle(rqd, svc, now);
+        break;
+    }
+
+    spin_unlock(&busiest->lock);
+}
+
+/* The best vCPU to run on cpu: current if still runnable, or the queue's. */
+static struct csched2_vcpu *
+runq_candidate(struct csched2_runqueue *rqd, struct csched2_vcpu *scurr,
+               int cpu)
+{
+    struct csched2_vcpu *snext = NULL, *svc;
+    struct list_head *iter;
+
+    if ( unlikely(!cpu_online(cpu)) )
+        return CSCHED2_VCPU(idle_vcpu[cpu]);
+
+    if ( !is_idle_vcpu(scurr->vcpu) && vcpu_runnable(scurr->vcpu) )
+        snext = scurr;
+
+    /* The runqueue is shared, so skip vCPUs that may not run here. */
+    list_for_each( iter, &rqd->runq )
+    {
+        svc = __runq_elem(iter);
+        if ( !cpu_isset(cpu, svc->vcpu->cpu_affinity) )
+            continue;
+        if ( snext == NULL || svc->credit > snext->credit )
+            snext = svc;
+        break;
+    }
+
+    return snext ?: CSCHED2_VCPU(idle_vcpu[cpu]);
+}
+
+/* Run until our credit falls to that of the best waiting vCPU. */
+static s_time_t
+csched2_runtime(struct csched2_runqueue *rqd, struct csched2_vcpu *snext)
+{
+    s_time_t time, max = CSCHED2_MAX_TIMER;
+
+    if ( is_idle_vcpu(snext->vcpu) )
+        return -1;
+
+    if ( list_empty(&rqd->runq) )
+    {
+        /* Nobody waiting: only wake up to refresh our credit. */
+        max = CSCHED2_CREDIT_INIT;
+        time = c2t(snext, snext->credit);
+    }
+    else
+        time = c2t(snext, snext->credit -
+                   __runq_elem(rqd->runq.next)->credit);
+
+    if ( time < CSCHED2_MIN_TIMER )
+        time = CSCHED2_MIN_TIMER;
+    else if ( time > max )
+        time = max;
+
+    return time;
+}
+
+static struct task_slice
+csched2_schedule(s_time_t now)
+{
+    const int cpu = smp_processor_id();
+    struct csched2_runqueue * const rqd = CSCHED2_RQD(cpu);
+    struct csched2_vcpu * const scurr = CSCHED2_VCPU(current);
+    struct csched2_vcpu *snext;
+    struct task_slice ret;
+
+    CSCHED2_STAT_CRANK(c2_schedule);
+    sched_stat_runq_len(cpu, rqd->queued);
+
+    if ( !is_idle_vcpu(current) )
+        burn_credits(scurr, now);
+
+    if ( now >= rqd->next_balance )
+        balance_load(rqd, cpu, now);
+
+    snext = runq_candidate(rqd, scurr, cpu);
+    if ( !is_idle_vcpu(snext->vcpu) && snext->credit <= 0 )
+    {
+        reset_credit(rqd);
+        snext = runq_candidate(rqd, scurr, cpu);
+    }
+
+    if ( snext != scurr )
+    {
+        if ( !is_idle_vcpu(snext->vcpu) )
+        {
+            __runq_remove(snext);
+            __set_bit(__CSFLAG_scheduled, &snext->flags);
+            snext->start_time = now;
+            snext->vcpu->processor = cpu;
+        }
+
+        /* A runnable current is requeued once its context is saved. */
+        if ( !is_idle_vcpu(current) )
+        {
+            if ( vcpu_runnable(current) )
+                __set_bit(__CSFLAG_delayed_runq_add, &scurr->flags);
+            else
+                __load_dec(scurr, now);
+        }
+    }
+
+    if ( is_idle_vcpu(snext->vcpu) )
+        cpu_set(cpu, rqd->idle);
+    else
+        cpu_clear(cpu, rqd->idle);
+
+    ret.time = csched2_runtime(rqd, snext);
+    ret.task = snext->vcpu;
+
+    return ret;
+}
+
+static int
+csched2_dom_cntl(
+    struct domain *d,
+    struct xen_domctl_scheduler_op *op)
+{
+    struct csched2_dom * const sdom = CSCHED2_DOM(d);
+
+    if ( op->cmd == XEN_DOMCTL_SCHEDOP_getinfo )
+    {
+        op->u.credit2.weight = sdom->weight;
+    }
+    else
+    {
+        ASSERT(op->cmd == XEN_DOMCTL_SCHEDOP_putinfo);
+
+        if ( op->u.credit2.weight != 0 )
+            sdom->weight = op->u.credit2.weight;
+    }
+
+    return 0;
+}
+
+static int
+csched2_dom_init(struct domain *dom)
+{
+    struct csched2_dom *sdom;
+
+    if ( is_idle_domain(dom) )
+        return 0;
+
+    sdom = xmalloc(struct csched2_dom);
+    if ( sdom == NULL )
+        return -ENOMEM;
+
+    sdom->dom = dom;
+    sdom->weight = CSCHED2_DEFAULT_WEIGHT;
+    dom->sched_priv = sdom;
+
+    return 0;
+}
+
+static void
+csched2_dom_destroy(struct domain *dom)
+{
+    xfree(CSCHED2_DOM(dom));
+}
+
+static void
+csched2_dump_vcpu(struct csched2_vcpu *svc)
+{
+    printk("[%i.%i] flags=%lx cpu=%i",
+            svc->vcpu->domain->domain_id,
+            svc->vcpu->vcpu_id,
+            svc->flags,
+            svc->vcpu->processor);
+
+    if ( svc->sdom )
+        printk(" credit=%"PRId64" [w=%u]", svc->credit, svc->sdom->weight);
+
+    printk("\n");
+}
+
+static void
+csched2_dump_pcpu(int cpu)
+{
+    struct csched2_runqueue * const rqd = CSCHED2_RQD(cpu);
+    struct csched2_vcpu *svc;
+    struct list_head *iter;
+    int loop;
+
+    printk(" runq=%u\n", rqd->id);
+
+    svc = CSCHED2_VCPU(per_cpu(schedule_data, cpu).curr);
+    if ( svc )
+    {
+        printk("\trun: ");
+        csched2_dump_vcpu(svc);
+    }
+
+    /* Each runqueue is shown once, with its first CPU. */
+    if ( cpu != first_cpu(rqd->active) )
+        return;
+
+    loop = 0;
+    list_for_each( iter, &rqd->runq )
+    {
+        printk("\t%3d: ", ++loop);
+        csched2_dump_vcpu(__runq_elem(iter));
+    }
+}
+
+static void
+csched2_dump(void)
+{
+    struct csched2_runqueue *rqd;
+    char cpustr[100];
+    unsigned int i;
+    s_time_t now = NOW();
+
+    printk("info:\n"
+           "\trunqueues          = %u (per %s)\n"
+           "\tdefault-weight     = %d\n"
+           "\tcredit init        = %"PRId64"us\n"
+           "\tmin/max timeslice  = %"PRId64"/%"PRId64"us\n",
+           csched2_priv.nr_runqs,
+           opt_credit2_runqueue,
+           CSCHED2_DEFAULT_WEIGHT,
+           CSCHED2_CREDIT_INIT / MICROSECS(1),
+           CSCHED2_MIN_TIMER / MICROSECS(1),
+           CSCHED2_MAX_TIMER / MICROSECS(1));
+
+    for ( i = 0; i < csched2_priv.nr_runqs; i++ )
+    {
+        rqd = &csched2_runqs[i];
+        cpumask_scnprintf(cpustr, sizeof(cpustr), rqd->active);
+        printk("runq %u: cpus=%s load=%u avgload=%"PRIu64"/%llu"
+               " resets=%u\n",
+               rqd->id, cpustr, rqd->load, __avgload(rqd, now),
+               CSCHED2_LOAD_ONE, rqd->reset_epoch);
+    }
+}
+
+static void
+csched2_init(void)
+{
+    spin_lock_init(&csched2_priv.lock);
+    csched2_priv.nr_runqs = 0;
+    csched2_priv.started = 0;
+}
+
+/*
+ * Sibling maps are only valid once the secondary CPUs have booted, so
+ * until now every CPU has shared the first runqueue.  Split it by socket
+ * or core.  Only idle vCPUs exist yet, so no queued work has to move.
+ */
+static __init int csched2_start_runqueues(void)
+{
+    struct csched2_runqueue *rq0 = &csched2_runqs[0], *rqd;
+    unsigned long flags;
+    unsigned int i;
+    cpumask_t cpus;
+    bool_t new;
+    int cpu;
+
+    /* Is the credit2 scheduler initialised? */
+    if ( csched2_priv.nr_runqs == 0 )
+        return 0;
+
+    spin_lock_irqsave(&csched2_priv.lock, flags);
+
+    /*
+     * Every runqueue stays locked until all CPUs are assigned.  The first
+     * group of CPUs keeps the boot-time runqueue (and its lock).
+     */
+    spin_lock(&rq0->lock);
+    BUG_ON( !list_empty(&rq0->runq) );
+    cpus = rq0->active;
+    cpus_clear(rq0->active);
+    cpus_clear(rq0->idle);
+    csched2_priv.started = 1;
+
+    for_each_cpu_mask ( cpu, cpus )
+    {
+        rqd = __runq_for_cpu(cpu, &new);
+        if ( new )
+            spin_lock(&rqd->lock);
+
+        cpu_set(cpu, rqd->active);
+        if ( is_idle_vcpu(per_cpu(schedule_data, cpu).curr) )
+            cpu_set(cpu, rqd->idle);
+        per_cpu(schedule_data, cpu).sched_priv = rqd;
+        per_cpu(schedule_data, cpu).schedule_lock = &rqd->lock;
+    }
+
+    for ( i = csched2_priv.nr_runqs; i-- > 0; )
+        spin_unlock(&csched2_runqs[i].lock);
+
+    printk("credit2: %u runqueue(s), one per %s\n",
+           csched2_priv.nr_runqs, opt_credit2_runqueue);
+
+    spin_unlock_irqrestore(&csched2_priv.lock, flags);
+
+    return 0;
+}
+__initcall(csched2_start_runqueues);
+
+struct scheduler sched_credit2_def = {
+    .name           = "SMP Credit Scheduler rev2",
+    .opt_name       = "credit2",
+    .sched_id       = XEN_SCHEDULER_CREDIT2,
+
+    .init_domain    = csched2_dom_init,
+    .destroy_domain = csched2_dom_destroy,
+
+    .init_vcpu      = csched2_vcpu_init,
+    .destroy_vcpu   = csched2_vcpu_destroy,
+
+    .sleep          = csched2_vcpu_sleep,
+    .wake           = csched2_vcpu_wake,
+    .context_saved  = csched2_context_saved,
+
+    .adjust         = csched2_dom_cntl,
+
+    .pick_cpu       = csched2_cpu_pick,
+    .do_schedule    = csched2_schedule,
+
+    .dump_cpu_state = csched2_dump_pcpu,
+    .dump_settings  = csched2_dump,
+    .init           = csched2_init,
+};
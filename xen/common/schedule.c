@@ -32,6 +32,7 @@
 #include <xen/guest_access.h>
 #include <xen/multicall.h>
 #include <public/sched.h>
+#include <public/sysctl.h>
 #include <xsm/xsm.h>
 
 /* opt_sched: scheduler - default to credit */
@@ -58,9 +59,11 @@ DEFINE_PER_CPU(struct schedule_data, schedule_data);
 
 extern struct scheduler sched_sedf_def;
 extern struct scheduler sched_credit_def;
+extern struct scheduler sched_credit2_def;
 static struct scheduler *schedulers[] = { 
     &sched_sedf_def,
     &sched_credit_def,
+    &sched_credit2_def,
     NULL
 };
 
@@ -108,7 +111,7 @@ static inline void vcpu_runstate_change(
     s_time_t delta;
 
     ASSERT(v->runstate.state != new_state);
-    ASSERT(spin_is_locked(&per_cpu(schedule_data,v->processor).schedule_lock));
+    ASSERT(spin_is_locked(per_cpu(schedule_data,v->processor).schedule_lock));
 
     trace_runstate_change(v, new_state);
 
@@ -241,7 +244,12 @@ void vcpu_wake(struct vcpu *v)
     if ( likely(vcpu_runnable(v)) )
     {
         if ( v->runstate.state >= RUNSTATE_blocked )
-            vcpu_runstate_change(v, RUNSTATE_runnable, NOW());
+        {
+            s_time_t now = NOW();
+            vcpu_runstate_change(v, RUNSTATE_runnable, now);
+            v->sched_stats.wake_time = now;
+            v->sched_stats.wakeups++;
+        }
         SCHED_OP(wake, v);
     }
     else if ( !test_bit(_VPF_blocked, &v->pause_flags) )
@@ -299,7 +307,7 @@ static void vcpu_migrate(struct vcpu *v)
     old_cpu = v->processor;
     v->processor = SCHED_OP(pick_cpu, v);
     spin_unlock_irqrestore(
-        &per_cpu(schedule_data, old_cpu).schedule_lock, flags);
+        per_cpu(schedule_data, old_cpu).schedule_lock, flags);
 
     /* Wake on new CPU. */
     vcpu_wake(v);
@@ -529,10 +537,15 @@ static long do_poll(struct sched_poll *sched_poll)
     return rc;
 }
 
-/* Voluntarily yield the processor for this allocation. */
+/*
+ * Voluntarily yield the processor for this allocation.  Also used for
+ * PAUSE-loop exits, so the scheduler may treat it as a hint that the vCPU
+ * is spinning on a lock held by a preempted sibling.
+ */
 static long do_yield(void)
 {
     TRACE_2D(TRC_SCHED_YIELD, current->domain->domain_id, current->vcpu_id);
+    SCHED_OP(yield, current);
     raise_softirq(SCHEDULE_SOFTIRQ);
     return 0;
 }
@@ -798,6 +811,7 @@ static void schedule(void)
     s_time_t              now = NOW();
     struct schedule_data *sd;
     struct task_slice     next_slice;
+    spinlock_t           *lock;
 
     ASSERT(!in_irq());
     ASSERT(this_cpu(mc_state).flags == 0);
@@ -806,7 +820,8 @@ static void schedule(void)
 
     sd = &this_cpu(schedule_data);
 
-    spin_lock_irq(&sd->schedule_lock);
+    local_irq_disable();
+    lock = pcpu_schedule_lock(smp_processor_id());
 
     stop_timer(&sd->s_timer);
     
@@ -816,13 +831,14 @@ static void schedule(void)
     next = next_slice.task;
 
     sd->curr = next;
+    sd->stats.schedules++;
 
     if ( next_slice.time >= 0 ) /* -ve means no limit */
         set_timer(&sd->s_timer, now + next_slice.time);
 
     if ( unlikely(prev == next) )
     {
-        spin_unlock_irq(&sd->schedule_lock);
+        spin_unlock_irq(lock);
         trace_continue_running(next);
         return continue_running(prev);
     }
@@ -836,6 +852,21 @@ static void schedule(void)
              (now - next->runstate.state_entry_time) : 0,
              next_slice.time);
 
+    if ( !is_idle_vcpu(prev) && vcpu_runnable(prev) )
+    {
+        sd->stats.preemptions++;
+        prev->sched_stats.preemptions++;
+    }
+
+    if ( next->sched_stats.wake_time != 0 )
+    {
+        unsigned int b = sched_stats_bucket(
+            (now - next->sched_stats.wake_time) / MICROSECS(1));
+        sd->stats.wake_latency[b]++;
+        next->sched_stats.wake_latency[b]++;
+        next->sched_stats.wake_time = 0;
+    }
+
     ASSERT(prev->runstate.state == RUNSTATE_running);
     vcpu_runstate_change(
         prev,
@@ -850,7 +881,7 @@ static void schedule(void)
     ASSERT(!next->is_running);
     next->is_running = 1;
 
-    spin_unlock_irq(&sd->schedule_lock);
+    spin_unlock_irq(lock);
 
     perfc_incr(sched_ctx);
 
@@ -877,6 +908,8 @@ void context_saved(struct vcpu *prev)
     /* Check for migration request /after/ clearing running flag. */
     smp_mb();
 
+    SCHED_OP(context_saved, prev);
+
     if ( unlikely(test_bit(_VPF_migrating, &prev->pause_flags)) )
         vcpu_migrate(prev);
 }
@@ -920,7 +953,9 @@ void __init scheduler_init(void)
 
     for_each_possible_cpu ( i )
     {
-        spin_lock_init(&per_cpu(schedule_data, i).schedule_lock);
+        spin_lock_init(&per_cpu(schedule_data, i)._lock);
+        per_cpu(schedule_data, i).schedule_lock =
+            &per_cpu(schedule_data, i)._lock;
         init_timer(&per_cpu(schedule_data, i).s_timer, s_timer_fn, NULL, i);
     }
 
@@ -938,11 +973,101 @@ void __init scheduler_init(void)
     SCHED_OP(init);
 }
 
+static s_time_t sched_stats_start;
+
+int sched_stats_control(xen_sysctl_schedstats_op_t *op)
+{
+    struct domain *d;
+    struct vcpu *v;
+    unsigned int cpu, n;
+
+    BUILD_BUG_ON(SCHED_STATS_BUCKETS != XEN_SCHEDSTATS_BUCKETS);
+
+    switch ( op->cmd )
+    {
+    case XEN_SYSCTL_SCHEDSTATS_reset:
+        for_each_possible_cpu ( cpu )
+            memset(&per_cpu(schedule_data, cpu).stats, 0,
+                   sizeof(per_cpu(schedule_data, cpu).stats));
+        rcu_read_lock(&domlist_read_lock);
+        for_each_domain ( d )
+            for_each_vcpu ( d, v )
+                memset(&v->sched_stats, 0, sizeof(v->sched_stats));
+        rcu_read_unlock(&domlist_read_lock);
+        sched_stats_start = NOW();
+        return 0;
+
+    case XEN_SYSCTL_SCHEDSTATS_query:
+        break;
+
+    default:
+        return -EINVAL;
+    }
+
+    /* Counters are read without locks: a snapshot may be slightly torn. */
+    n = 0;
+    for_each_online_cpu ( cpu )
+    {
+        struct sched_pcpu_stats *st = &per_cpu(schedule_data, cpu).stats;
+        xen_sysctl_sched_pcpustats_t ps;
+
+        if ( n < op->max_pcpus )
+        {
+            memset(&ps, 0, sizeof(ps));
+            ps.cpu = cpu;
+            ps.schedules = st->schedules;
+            ps.preemptions = st->preemptions;
+            ps.steal_attempts = st->steal_attempts;
+            ps.steal_successes = st->steal_successes;
+            memcpy(ps.wake_latency, st->wake_latency, sizeof(ps.wake_latency));
+            memcpy(ps.runq_len, st->runq_len, sizeof(ps.runq_len));
+            if ( copy_to_guest_offset(op->pcpu, n, &ps, 1) )
+                return -EFAULT;
+        }
+        n++;
+    }
+    op->nr_pcpus = n;
+
+    n = 0;
+    rcu_read_lock(&domlist_read_lock);
+    for_each_domain ( d )
+    {
+        for_each_vcpu ( d, v )
+        {
+            xen_sysctl_sched_vcpustats_t vs;
+
+            if ( n < op->max_vcpus )
+            {
+                memset(&vs, 0, sizeof(vs));
+                vs.domid = d->domain_id;
+                vs.vcpu = v->vcpu_id;
+                vs.wakeups = v->sched_stats.wakeups;
+                vs.preemptions = v->sched_stats.preemptions;
+                memcpy(vs.wake_latency, v->sched_stats.wake_latency,
+                       sizeof(vs.wake_latency));
+                if ( copy_to_guest_offset(op->vcpu, n, &vs, 1) )
+                {
+                    rcu_read_unlock(&domlist_read_lock);
+                    return -EFAULT;
+                }
+            }
+            n++;
+        }
+    }
+    rcu_read_unlock(&domlist_read_lock);
+    op->nr_vcpus = n;
+
+    op->time = NOW() - sched_stats_start;
+
+    return 0;
+}
+
 void dump_runq(unsigned char key)
 {
     s_time_t      now = NOW();
     int           i;
     unsigned long flags;
+    spinlock_t   *lock;
 
     local_irq_save(flags);
 
@@ -954,10 +1079,10 @@ void dump_runq(unsigned char key)
 
     for_each_online_cpu ( i )
     {
-        spin_lock(&per_cpu(schedule_data, i).schedule_lock);
+        lock = pcpu_schedule_lock(i);
         printk("CPU[%02d] ", i);
         SCHED_OP(dump_cpu_state, i);
-        spin_unlock(&per_cpu(schedule_data, i).schedule_lock);
+        spin_unlock(lock);
     }
 
     local_irq_restore(flags);
@@ -22,6 +22,9 @@ irq_cpustat_t irq_stat[NR_CPUS];
 
 static softirq_handler softirq_handlers[NR_SOFTIRQS];
 
+static DEFINE_PER_CPU(unsigned int, batching);
+static DEFINE_PER_CPU(cpumask_t, batch_mask);
+
 asmlinkage void do_softirq(void)
 {
     unsigned int i, cpu;
@@ -47,6 +50,58 @@ asmlinkage void do_softirq(void)
     }
 }
 
+void cpumask_raise_softirq(cpumask_t mask, unsigned int nr)
+{
+    unsigned int cpu, this_cpu = smp_processor_id();
+    bool_t batch = per_cpu(batching, this_cpu) && !in_irq();
+
+    for_each_cpu_mask(cpu, mask)
+    {
+        if ( test_and_set_bit(nr, &softirq_pending(cpu)) )
+            cpu_clear(cpu, mask);
+        else if ( batch && (cpu != this_cpu) )
+            cpu_set(cpu, per_cpu(batch_mask, this_cpu));
+    }
+
+    if ( !batch )
+        smp_send_event_check_mask(&mask);
+}
+
+void cpu_raise_softirq(unsigned int cpu, unsigned int nr)
+{
+    unsigned int this_cpu = smp_processor_id();
+
+    if ( test_and_set_bit(nr, &softirq_pending(cpu)) )
+        return;
+
+    if ( !per_cpu(batching, this_cpu) || in_irq() )
+        smp_send_event_check_cpu(cpu);
+    else if ( cpu != this_cpu )
+        cpu_set(cpu, per_cpu(batch_mask, this_cpu));
+}
+
+void cpu_raise_softirq_batch_begin(void)
+{
+    ++this_cpu(batching);
+}
+
+void cpu_raise_softirq_batch_finish(void)
+{
+    unsigned int cpu, this_cpu = smp_processor_id();
+    cpumask_t *mask = &per_cpu(batch_mask, this_cpu);
+
+    ASSERT(per_cpu(batching, this_cpu));
+    if ( --per_cpu(batching, this_cpu) )
+        return;
+
+    /* Skip CPUs that have already found their softirqs by themselves. */
+    for_each_cpu_mask ( cpu, *mask )
+        if ( !softirq_pending(cpu) )
+            cpu_clear(cpu, *mask);
+    smp_send_event_check_mask(mask);
+    cpus_clear(*mask);
+}
+
 void open_softirq(int nr, softirq_handler handler)
 {
     ASSERT(nr < NR_SOFTIRQS);
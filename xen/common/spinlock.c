@@ -1,7 +1,12 @@
 #include <xen/config.h>
+#include <xen/init.h>
 #include <xen/irq.h>
 #include <xen/smp.h>
+#include <xen/time.h>
 #include <xen/spinlock.h>
+#include <xen/guest_access.h>
+#include <xen/xmalloc.h>
+#include <public/sysctl.h>
 #include <asm/processor.h>
 
 #ifndef NDEBUG
@@ -41,56 +46,84 @@ void spin_debug_disable(void)
 
 #endif
 
+#ifdef LOCK_PROFILE
+
+#define LOCK_PROFILE_REL                                                     \
+    if ( lock->profile )                                                     \
+    {                                                                        \
+        lock->profile->time_hold += NOW() - lock->profile->time_locked;      \
+        lock->profile->lock_cnt++;                                           \
+    }
+#define LOCK_PROFILE_VAR    s_time_t block = 0
+#define LOCK_PROFILE_BLOCK  block = lock->profile ? NOW() : 0
+#define LOCK_PROFILE_GOT                                                     \
+    if ( lock->profile )                                                     \
+    {                                                                        \
+        lock->profile->time_locked = NOW();                                  \
+        if ( block )                                                         \
+        {                                                                    \
+            lock->profile->time_block += lock->profile->time_locked - block; \
+            lock->profile->block_cnt++;                                      \
+        }                                                                    \
+    }
+
+#else
+
+#define LOCK_PROFILE_REL
+#define LOCK_PROFILE_VAR
+#define LOCK_PROFILE_BLOCK
+#define LOCK_PROFILE_GOT
+
+#endif
+
 void _spin_lock(spinlock_t *lock)
 {
+    LOCK_PROFILE_VAR;
+
     check_lock(&lock->debug);
-    while ( unlikely(!_raw_spin_trylock(&lock->raw)) )
-        while ( likely(_raw_spin_is_locked(&lock->raw)) )
-            cpu_relax();
+    if ( unlikely(!_raw_spin_trylock(&lock->raw)) )
+    {
+        LOCK_PROFILE_BLOCK;
+        _raw_spin_lock(&lock->raw);
+    }
+    LOCK_PROFILE_GOT;
 }
 
+/*
+ * Once a ticket is taken the lock must be waited for, so unlike the old
+ * test-and-set lock we cannot re-enable interrupts while spinning.
+ */
 void _spin_lock_irq(spinlock_t *lock)
 {
     ASSERT(local_irq_is_enabled());
     local_irq_disable();
-    check_lock(&lock->debug);
-    while ( unlikely(!_raw_spin_trylock(&lock->raw)) )
-    {
-        local_irq_enable();
-        while ( likely(_raw_spin_is_locked(&lock->raw)) )
-            cpu_relax();
-        local_irq_disable();
-    }
+    _spin_lock(lock);
 }
 
 unsigned long _spin_lock_irqsave(spinlock_t *lock)
 {
     unsigned long flags;
     local_irq_save(flags);
-    check_lock(&lock->debug);
-    while ( unlikely(!_raw_spin_trylock(&lock->raw)) )
-    {
-        local_irq_restore(flags);
-        while ( likely(_raw_spin_is_locked(&lock->raw)) )
-            cpu_relax();
-        local_irq_save(flags);
-    }
+    _spin_lock(lock);
     return flags;
 }
 
 void _spin_unlock(spinlock_t *lock)
 {
+    LOCK_PROFILE_REL;
     _raw_spin_unlock(&lock->raw);
 }
 
 void _spin_unlock_irq(spinlock_t *lock)
 {
+    LOCK_PROFILE_REL;
     _raw_spin_unlock(&lock->raw);
     local_irq_enable();
 }
 
 void _spin_unlock_irqrestore(spinlock_t *lock, unsigned long flags)
 {
+    LOCK_PROFILE_REL;
     _raw_spin_unlock(&lock->raw);
     local_irq_restore(flags);
 }
@@ -104,13 +137,20 @@ int _spin_is_locked(spinlock_t *lock)
 int _spin_trylock(spinlock_t *lock)
 {
     check_lock(&lock->debug);
-    return _raw_spin_trylock(&lock->raw);
+    if ( !_raw_spin_trylock(&lock->raw) )
+        return 0;
+#ifdef LOCK_PROFILE
+    if ( lock->profile )
+        lock->profile->time_locked = NOW();
+#endif
+    return 1;
 }
 
 void _spin_barrier(spinlock_t *lock)
 {
     check_lock(&lock->debug);
-    do { mb(); } while ( _raw_spin_is_locked(&lock->raw) );
+    mb();
+    _raw_spin_barrier(&lock->raw);
     mb();
 }
 
@@ -248,3 +288,226 @@ int _rw_is_write_locked(rwlock_t *lock)
     check_lock(&lock->debug);
     return _raw_rw_is_write_locked(&lock->raw);
 }
+
+#ifdef LOCK_PROFILE
+
+struct lock_profile_anc {
+    struct lock_profile_qhead *head_q;   /* first queue of this type */
+    const char                *name;     /* descriptive string for print */
+};
+
+typedef void lock_profile_subfunc(
+    struct lock_profile *, int32_t, int32_t, void *);
+
+extern struct lock_profile *__lock_profile_start;
+extern struct lock_profile *__lock_profile_end;
+
+static s_time_t lock_profile_start;
+static struct lock_profile_anc lock_profile_ancs[LOCKPROF_TYPE_N];
+static struct lock_profile_qhead lock_profile_glb_q;
+static spinlock_t lock_profile_lock = SPIN_LOCK_UNLOCKED;
+
+static void spinlock_profile_iterate(lock_profile_subfunc *sub, void *par)
+{
+    int i;
+    struct lock_profile_qhead *hq;
+    struct lock_profile *eq;
+
+    spin_lock(&lock_profile_lock);
+    for ( i = 0; i < LOCKPROF_TYPE_N; i++ )
+        for ( hq = lock_profile_ancs[i].head_q; hq; hq = hq->head_q )
+            for ( eq = hq->elem_q; eq; eq = eq->next )
+                sub(eq, i, hq->idx, par);
+    spin_unlock(&lock_profile_lock);
+}
+
+static void spinlock_profile_print_elem(struct lock_profile *data,
+    int32_t type, int32_t idx, void *par)
+{
+    if ( type == LOCKPROF_TYPE_GLOBAL )
+        printk("%s %s:\n", lock_profile_ancs[type].name, data->name);
+    else
+        printk("%s %d %s:\n", lock_profile_ancs[type].name, idx, data->name);
+    printk("  lock:%12"PRIu64"(%12"PRId64"ns), "
+           "block:%12"PRIu64"(%12"PRId64"ns)\n",
+           data->lock_cnt, data->time_hold,
+           data->block_cnt, data->time_block);
+}
+
+void spinlock_profile_printall(unsigned char key)
+{
+    s_time_t now = NOW();
+    s_time_t diff = now - lock_profile_start;
+
+    printk("Xen lock profile info SHOW  (now = %08X:%08X, "
+           "total = %08X:%08X)\n", (u32)(now>>32), (u32)now,
+           (u32)(diff>>32), (u32)diff);
+    spinlock_profile_iterate(spinlock_profile_print_elem, NULL);
+}
+
+static void spinlock_profile_reset_elem(struct lock_profile *data,
+    int32_t type, int32_t idx, void *par)
+{
+    data->lock_cnt = 0;
+    data->block_cnt = 0;
+    data->time_hold = 0;
+    data->time_block = 0;
+}
+
+void spinlock_profile_reset(unsigned char key)
+{
+    s_time_t now = NOW();
+
+    if ( key != '\0' )
+        printk("Xen lock profile info RESET (now = %08X:%08X)\n",
+               (u32)(now>>32), (u32)now);
+    lock_profile_start = now;
+    spinlock_profile_iterate(spinlock_profile_reset_elem, NULL);
+}
+
+struct lock_profile_par {
+    int                                        rc;
+    uint32_t                                   nr_elem;
+    uint32_t                                   max_elem;
+    XEN_GUEST_HANDLE_64(xen_sysctl_lockprof_data_t) data;
+};
+
+static void spinlock_profile_ucopy_elem(struct lock_profile *data,
+    int32_t type, int32_t idx, void *par)
+{
+    struct lock_profile_par *p = par;
+    xen_sysctl_lockprof_data_t elem;
+
+    if ( p->rc )
+        return;
+
+    if ( p->nr_elem < p->max_elem )
+    {
+        memset(&elem, 0, sizeof(elem));
+        safe_strcpy(elem.name, data->name);
+        elem.type = type;
+        elem.idx = idx;
+        elem.lock_cnt = data->lock_cnt;
+        elem.block_cnt = data->block_cnt;
+        elem.lock_time = data->time_hold;
+        elem.block_time = data->time_block;
+        if ( copy_to_guest_offset(p->data, p->nr_elem, &elem, 1) )
+            p->rc = -EFAULT;
+    }
+
+    if ( !p->rc )
+        p->nr_elem++;
+}
+
+/* Dom0 control of lock profiling. */
+int spinlock_profile_control(xen_sysctl_lockprof_op_t *pc)
+{
+    int rc = 0;
+    struct lock_profile_par par;
+
+    switch ( pc->cmd )
+    {
+    case XEN_SYSCTL_LOCKPROF_reset:
+        spinlock_profile_reset('\0');
+        break;
+    case XEN_SYSCTL_LOCKPROF_query:
+        pc->nr_elem = 0;
+        par.rc = 0;
+        par.nr_elem = 0;
+        par.max_elem = pc->max_elem;
+        par.data = pc->data;
+        spinlock_profile_iterate(spinlock_profile_ucopy_elem, &par);
+        pc->time = NOW() - lock_profile_start;
+        rc = par.rc;
+        pc->nr_elem = par.nr_elem;
+        break;
+    default:
+        rc = -EINVAL;
+        break;
+    }
+
+    return rc;
+}
+
+void _spin_lock_init_prof(struct lock_profile_qhead *q, spinlock_t *lock,
+                          const char *name)
+{
+    struct lock_profile *prof;
+
+    spin_lock_init(lock);
+
+    if ( (prof = xmalloc(struct lock_profile)) == NULL )
+        return;
+
+    memset(prof, 0, sizeof(*prof));
+    prof->name = name;
+    prof->lock = lock;
+    lock->profile = prof;
+
+    spin_lock(&lock_profile_lock);
+    prof->next = q->elem_q;
+    q->elem_q = prof;
+    spin_unlock(&lock_profile_lock);
+}
+
+void _lock_profile_register_struct(
+    int32_t type, struct lock_profile_qhead *qhead, int32_t idx)
+{
+    qhead->idx = idx;
+    spin_lock(&lock_profile_lock);
+    qhead->head_q = lock_profile_ancs[type].head_q;
+    lock_profile_ancs[type].head_q = qhead;
+    spin_unlock(&lock_profile_lock);
+}
+
+/*
+ * Unlink @qhead if it was registered and free the profile records that
+ * _spin_lock_init_prof() attached to it.  The locks themselves must no
+ * longer be in use.
+ */
+void _lock_profile_deregister_struct(
+    int32_t type, struct lock_profile_qhead *qhead)
+{
+    struct lock_profile_qhead **q;
+    struct lock_profile *prof;
+
+    spin_lock(&lock_profile_lock);
+    for ( q = &lock_profile_ancs[type].head_q; *q; q = &(*q)->head_q )
+    {
+        if ( *q == qhead )
+        {
+            *q = qhead->head_q;
+            break;
+        }
+    }
+    spin_unlock(&lock_profile_lock);
+
+    while ( (prof = qhead->elem_q) != NULL )
+    {
+        qhead->elem_q = prof->next;
+        xfree(prof);
+    }
+}
+
+static int __init lock_prof_init(void)
+{
+    struct lock_profile **q;
+
+    for ( q = &__lock_profile_start; q < &__lock_profile_end; q++ )
+    {
+        (*q)->next = lock_profile_glb_q.elem_q;
+        lock_profile_glb_q.elem_q = *q;
+        (*q)->lock->profile = *q;
+    }
+
+    _lock_profile_register_struct(
+        LOCKPROF_TYPE_GLOBAL, &lock_profile_glb_q, 0);
+
+    lock_profile_ancs[LOCKPROF_TYPE_GLOBAL].name = "Global";
+    lock_profile_ancs[LOCKPROF_TYPE_PERDOM].name = "Domain";
+
+    return 0;
+}
+__initcall(lock_prof_init);
+
+#endif /* LOCK_PROFILE */
@@ -131,6 +131,99 @@ long do_sysctl(XEN_GUEST_HANDLE(xen_sysctl_t) u_sysctl)
     }
     break;
 
+    case XEN_SYSCTL_getdomstats:
+    {
+        struct xen_sysctl_getdomstats *gs = &op->u.getdomstats;
+        struct domain *d;
+        struct vcpu *v;
+        struct xen_sysctl_domstats ds;
+        struct xen_sysctl_vcpustats vs;
+        struct vcpu_runstate_info runstate;
+        uint32_t used = 0, num_domains = 0, need, i;
+        domid_t next = DOMID_FIRST_RESERVED;
+
+        rcu_read_lock(&domlist_read_lock);
+
+        for_each_domain ( d )
+        {
+            if ( d->domain_id < gs->first_domain )
+                continue;
+
+            if ( xsm_getdomaininfo(d) )
+                continue;
+
+            memset(&ds, 0, sizeof(ds));
+            getdomaininfo(d, &ds.info);
+            for_each_vcpu ( d, v )
+                ds.nr_vcpus++;
+
+            need = sizeof(ds) + ds.nr_vcpus * sizeof(vs);
+            if ( used + need > gs->size )
+            {
+                next = d->domain_id;
+                break;
+            }
+
+            if ( copy_to_guest_offset(gs->buffer, used, (uint8_t *)&ds,
+                                      sizeof(ds)) )
+            {
+                ret = -EFAULT;
+                break;
+            }
+            used += sizeof(ds);
+
+            i = 0;
+            for_each_vcpu ( d, v )
+            {
+                /* Don't overrun the space checked above. */
+                if ( i++ == ds.nr_vcpus )
+                    break;
+
+                vcpu_runstate_get(v, &runstate);
+
+                memset(&vs, 0, sizeof(vs));
+                vs.vcpu = v->vcpu_id;
+                vs.cpu = v->processor;
+                vs.state = runstate.state;
+                vs.state_entry_time = runstate.state_entry_time;
+                memcpy(vs.time, runstate.time, sizeof(vs.time));
+                if ( !test_bit(_VPF_down, &v->pause_flags) )
+                    vs.flags |= XEN_VCPUSTATS_online;
+                if ( test_bit(_VPF_blocked, &v->pause_flags) )
+                    vs.flags |= XEN_VCPUSTATS_blocked;
+                if ( v->is_running )
+                    vs.flags |= XEN_VCPUSTATS_running;
+                if ( vcpu_info(v, evtchn_upcall_pending) )
+                    vs.flags |= XEN_VCPUSTATS_pending;
+
+                if ( copy_to_guest_offset(gs->buffer, used, (uint8_t *)&vs,
+                                          sizeof(vs)) )
+                {
+                    ret = -EFAULT;
+                    break;
+                }
+                used += sizeof(vs);
+            }
+            if ( ret != 0 )
+                break;
+
+            num_domains++;
+        }
+
+        rcu_read_unlock(&domlist_read_lock);
+
+        if ( ret != 0 )
+            break;
+
+        gs->num_domains = num_domains;
+        gs->used = used;
+        gs->next_domain = next;
+
+        if ( copy_to_guest(u_sysctl, op, 1) )
+            ret = -EFAULT;
+    }
+    break;
+
 #ifdef PERF_COUNTERS
     case XEN_SYSCTL_perfc_op:
     {
@@ -145,6 +238,32 @@ long do_sysctl(XEN_GUEST_HANDLE(xen_sysctl_t) u_sysctl)
     break;
 #endif
 
+#ifdef LOCK_PROFILE
+    case XEN_SYSCTL_lockprof_op:
+    {
+        ret = xsm_perfcontrol();
+        if ( ret )
+            break;
+
+        ret = spinlock_profile_control(&op->u.lockprof_op);
+        if ( copy_to_guest(u_sysctl, op, 1) )
+            ret = -EFAULT;
+    }
+    break;
+#endif
+
+    case XEN_SYSCTL_schedstats_op:
+    {
+        ret = xsm_perfcontrol();
+        if ( ret )
+            break;
+
+        ret = sched_stats_control(&op->u.schedstats_op);
+        if ( copy_to_guest(u_sysctl, op, 1) )
+            ret = -EFAULT;
+    }
+    break;
+
     case XEN_SYSCTL_debug_keys:
     {
         char c;
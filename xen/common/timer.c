@@ -28,12 +28,35 @@
 static unsigned int timer_slop __read_mostly = 50000; /* 50 us */
 integer_param("timer_slop", timer_slop);
 
+/*
+ * Timers are kept in a per-CPU hierarchical timing wheel. Level 0 has one
+ * slot per wheel tick (2^TIMER_WHEEL_SHIFT ns); each slot of level L spans
+ * TIMER_WHEEL_SIZE slots of level L-1. Arming and cancelling a timer is O(1);
+ * timers in upper levels are cascaded down as the wheel clock reaches their
+ * slot. A timer retains its exact expiry time: the wheel only buckets it.
+ */
+#define TIMER_WHEEL_SHIFT     10 /* ~1us per level-0 tick */
+#define TIMER_WHEEL_BITS      6
+#define TIMER_WHEEL_SIZE      (1U << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK      (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS    6  /* 2^46ns (~19.5 hours) before clamping */
+#define TIMER_WHEEL_MAX_DELTA (1LL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+struct timer_wheel {
+    uint64_t          pending[TIMER_WHEEL_LEVELS];
+    struct hlist_head slot[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+};
+
 struct timers {
-    spinlock_t     lock;
-    bool_t         overflow;
-    struct timer **heap;
-    struct timer  *list;
-    struct timer  *running;
+    spinlock_t          lock;
+    s_time_t            clk;    /* Wheel time in ticks; earlier slots done. */
+    struct timer_wheel *wheel;
+    struct hlist_head   batch;  /* Expired timers awaiting execution. */
+    struct timer       *running;
+
+    /* Statistics, reported by the 'a' keyhandler. */
+    unsigned long       nr_set, nr_stop, nr_cascade, nr_expired, nr_softirq;
+    unsigned long       nr_level[TIMER_WHEEL_LEVELS];
 } __cacheline_aligned;
 
 static DEFINE_PER_CPU(struct timers, timers);
@@ -41,125 +64,245 @@ static DEFINE_PER_CPU(struct timers, timers);
 DEFINE_PER_CPU(s_time_t, timer_deadline);
 
 /****************************************************************************
- * HEAP OPERATIONS.
+ * TIMER WHEEL OPERATIONS.
  */
 
-#define GET_HEAP_SIZE(_h)     ((int)(((u16 *)(_h))[0]))
-#define SET_HEAP_SIZE(_h,_v)  (((u16 *)(_h))[0] = (u16)(_v))
+#define level_shift(l) ((l) * TIMER_WHEEL_BITS)
 
-#define GET_HEAP_LIMIT(_h)    ((int)(((u16 *)(_h))[1]))
-#define SET_HEAP_LIMIT(_h,_v) (((u16 *)(_h))[1] = (u16)(_v))
-
-/* Sink down element @pos of @heap. */
-static void down_heap(struct timer **heap, int pos)
+/*
+ * Distance (0 .. TIMER_WHEEL_SIZE-1) from slot @from to the next pending
+ * slot, walking round the level in increasing order. @map must be non-zero.
+ */
+static inline unsigned int next_pending(uint64_t map, unsigned int from)
 {
-    int sz = GET_HEAP_SIZE(heap), nxt;
-    struct timer *t = heap[pos];
+    if ( from != 0 )
+        map = (map >> from) | (map << (TIMER_WHEEL_SIZE - from));
+    if ( (uint32_t)map != 0 )
+        return find_first_set_bit((uint32_t)map);
+    return 32 + find_first_set_bit((uint32_t)(map >> 32));
+}
 
-    while ( (nxt = (pos << 1)) <= sz )
+static void wheel_insert(struct timers *ts, struct timer *t)
+{
+    struct timer_wheel *w = ts->wheel;
+    s_time_t tick = t->expires >> TIMER_WHEEL_SHIFT;
+    s_time_t delta = tick - ts->clk;
+    unsigned int level = 0, idx;
+
+    /* Overdue timers go in the current slot; far-off ones are clamped. */
+    if ( delta < 0 )
+        tick = ts->clk;
+    else if ( delta >= TIMER_WHEEL_MAX_DELTA )
+        tick = ts->clk + TIMER_WHEEL_MAX_DELTA - 1;
+    delta = tick - ts->clk;
+
+    while ( delta >= TIMER_WHEEL_SIZE )
     {
-        if ( ((nxt+1) <= sz) && (heap[nxt+1]->expires < heap[nxt]->expires) )
-            nxt++;
-        if ( heap[nxt]->expires > t->expires )
-            break;
-        heap[pos] = heap[nxt];
-        heap[pos]->heap_offset = pos;
-        pos = nxt;
+        delta >>= TIMER_WHEEL_BITS;
+        level++;
     }
 
-    heap[pos] = t;
-    t->heap_offset = pos;
+    idx = (tick >> level_shift(level)) & TIMER_WHEEL_MASK;
+    hlist_add_head(&t->wheel_node, &w->slot[level][idx]);
+    w->pending[level] |= 1ULL << idx;
+    t->wheel_level = level;
+    t->wheel_slot = idx;
+    t->status = TIMER_STATUS_in_wheel;
+    ts->nr_level[level]++;
+}
+
+static void wheel_remove(struct timers *ts, struct timer *t)
+{
+    struct timer_wheel *w = ts->wheel;
+    unsigned int level = t->wheel_level, idx = t->wheel_slot;
+
+    hlist_del(&t->wheel_node);
+    if ( hlist_empty(&w->slot[level][idx]) )
+        w->pending[level] &= ~(1ULL << idx);
 }
 
-/* Float element @pos up @heap. */
-static void up_heap(struct timer **heap, int pos)
+/* Move every timer in level-0 slot @idx with expiry before @now to the batch. */
+static void wheel_expire_slot(struct timers *ts, unsigned int idx, s_time_t now)
 {
-    struct timer *t = heap[pos];
+    struct timer_wheel *w = ts->wheel;
+    struct timer *t;
+    struct hlist_node *pos, *n;
+
+    if ( !(w->pending[0] & (1ULL << idx)) )
+        return;
 
-    while ( (pos > 1) && (t->expires < heap[pos>>1]->expires) )
+    hlist_for_each_entry_safe ( t, pos, n, &w->slot[0][idx], wheel_node )
     {
-        heap[pos] = heap[pos>>1];
-        heap[pos]->heap_offset = pos;
-        pos >>= 1;
+        if ( t->expires >= now )
+            continue;
+        hlist_del(&t->wheel_node);
+        hlist_add_head(&t->wheel_node, &ts->batch);
+        t->status = TIMER_STATUS_in_batch;
     }
 
-    heap[pos] = t;
-    t->heap_offset = pos;
+    if ( hlist_empty(&w->slot[0][idx]) )
+        w->pending[0] &= ~(1ULL << idx);
 }
 
-
-/* Delete @t from @heap. Return TRUE if new top of heap. */
-static int remove_from_heap(struct timer **heap, struct timer *t)
+/* The wheel clock has reached a slot boundary: pull upper-level slots down. */
+static void wheel_cascade(struct timers *ts)
 {
-    int sz = GET_HEAP_SIZE(heap);
-    int pos = t->heap_offset;
+    struct timer_wheel *w = ts->wheel;
+    struct hlist_head list;
+    struct timer *t;
+    unsigned int level = 1, idx;
+
+    while ( (level < TIMER_WHEEL_LEVELS) &&
+            !(ts->clk & ((1LL << level_shift(level)) - 1)) )
+        level++;
 
-    if ( unlikely(pos == sz) )
+    while ( --level > 0 )
     {
-        SET_HEAP_SIZE(heap, sz-1);
-        goto out;
-    }
+        idx = (ts->clk >> level_shift(level)) & TIMER_WHEEL_MASK;
+        if ( !(w->pending[level] & (1ULL << idx)) )
+            continue;
 
-    heap[pos] = heap[sz];
-    heap[pos]->heap_offset = pos;
+        list.first = w->slot[level][idx].first;
+        list.first->pprev = &list.first;
+        INIT_HLIST_HEAD(&w->slot[level][idx]);
+        w->pending[level] &= ~(1ULL << idx);
 
-    SET_HEAP_SIZE(heap, --sz);
+        while ( !hlist_empty(&list) )
+        {
+            t = hlist_entry(list.first, struct timer, wheel_node);
+            hlist_del(&t->wheel_node);
+            wheel_insert(ts, t);
+            ts->nr_cascade++;
+            perfc_incr(timer_cascade);
+        }
+    }
+}
 
-    if ( (pos > 1) && (heap[pos]->expires < heap[pos>>1]->expires) )
-        up_heap(heap, pos);
-    else
-        down_heap(heap, pos);
+/* Earliest wheel tick after ts->clk at which some slot needs attention. */
+static s_time_t wheel_next_tick(struct timers *ts)
+{
+    struct timer_wheel *w = ts->wheel;
+    s_time_t next = STIME_MAX, base, tick;
+    unsigned int level, cur;
 
- out:
-    return (pos == 1);
-}
+    for ( level = 0; level < TIMER_WHEEL_LEVELS; level++ )
+    {
+        if ( w->pending[level] == 0 )
+            continue;
+        base = ts->clk >> level_shift(level);
+        cur = base & TIMER_WHEEL_MASK;
+        tick = (base + 1 + next_pending(w->pending[level],
+                                        (cur + 1) & TIMER_WHEEL_MASK))
+            << level_shift(level);
+        if ( tick < next )
+            next = tick;
+    }
 
+    return next;
+}
 
-/* Add new entry @t to @heap. Return TRUE if new top of heap. */
-static int add_to_heap(struct timer **heap, struct timer *t)
+/*
+ * Advance the wheel clock to @now, moving all timers that expire before @now
+ * to the batch list. Empty stretches of the wheel are skipped.
+ */
+static void wheel_advance(struct timers *ts, s_time_t now)
 {
-    int sz = GET_HEAP_SIZE(heap);
-
-    /* Fail if the heap is full. */
-    if ( unlikely(sz == GET_HEAP_LIMIT(heap)) )
-        return 0;
+    s_time_t target = now >> TIMER_WHEEL_SHIFT, next;
 
-    SET_HEAP_SIZE(heap, ++sz);
-    heap[sz] = t;
-    t->heap_offset = sz;
-    up_heap(heap, sz);
+    while ( ts->clk < target )
+    {
+        wheel_expire_slot(ts, ts->clk & TIMER_WHEEL_MASK, now);
+        next = wheel_next_tick(ts);
+        ts->clk = (next < target) ? next : target;
+        if ( !(ts->clk & TIMER_WHEEL_MASK) )
+            wheel_cascade(ts);
+    }
 
-    return (t->heap_offset == 1);
+    wheel_expire_slot(ts, ts->clk & TIMER_WHEEL_MASK, now);
 }
 
-
-/****************************************************************************
- * LINKED LIST OPERATIONS.
+/*
+ * Walk the pending slots of each level in expiry order, as long as a slot
+ * may hold timers that can share a deadline with those already seen, and
+ * narrow @end to the earliest expires_end found. Returns a lower bound on the
+ * expiry of any timer in the slots not walked, and records how many slots
+ * were walked per level in @walked. With @start set, instead revisit exactly
+ * those slots and raise @start to the latest expiry no later than @end.
  */
-
-static int remove_from_list(struct timer **pprev, struct timer *t)
+static s_time_t wheel_walk(
+    struct timers *ts, unsigned int *walked, s_time_t *end, s_time_t *start)
 {
-    struct timer *curr, **_pprev = pprev;
+    struct timer_wheel *w = ts->wheel;
+    struct timer *t;
+    struct hlist_node *pos;
+    s_time_t bound = STIME_MAX, base, slot_start;
+    uint64_t map;
+    unsigned int level, first, d, idx, n;
+
+    for ( level = 0; level < TIMER_WHEEL_LEVELS; level++ )
+    {
+        base = ts->clk >> level_shift(level);
+        /* The current slot of an upper level has already been cascaded. */
+        first = (level != 0);
 
-    while ( (curr = *_pprev) != t )
-        _pprev = &curr->list_next;
+        for ( map = w->pending[level], n = 0; map != 0;
+              map &= ~(1ULL << idx), n++ )
+        {
+            d = first + next_pending(map, (base + first) & TIMER_WHEEL_MASK);
+            idx = (base + d) & TIMER_WHEEL_MASK;
+            slot_start = ((base + d) << level_shift(level)) << TIMER_WHEEL_SHIFT;
+
+            if ( start != NULL )
+            {
+                if ( n == walked[level] )
+                    break;
+            }
+            else if ( (d != 0) && (slot_start > *end) )
+            {
+                if ( slot_start < bound )
+                    bound = slot_start;
+                break;
+            }
+
+            hlist_for_each_entry ( t, pos, &w->slot[level][idx], wheel_node )
+            {
+                if ( start != NULL )
+                {
+                    if ( (t->expires <= *end) && (t->expires > *start) )
+                        *start = t->expires;
+                }
+                else if ( t->expires_end < *end )
+                    *end = t->expires_end;
+            }
+        }
 
-    *_pprev = t->list_next;
+        if ( start == NULL )
+            walked[level] = n;
+    }
 
-    return (_pprev == pprev);
+    return bound;
 }
 
-static int add_to_list(struct timer **pprev, struct timer *t)
+/*
+ * Find the latest deadline at which every timer due by then is still within
+ * its [expires, expires_end] range. This groups timers with overlapping
+ * ranges onto a single timer interrupt.
+ */
+static s_time_t wheel_deadline(struct timers *ts)
 {
-    struct timer *curr, **_pprev = pprev;
+    unsigned int walked[TIMER_WHEEL_LEVELS];
+    s_time_t end = STIME_MAX, start = 0, bound;
 
-    while ( ((curr = *_pprev) != NULL) && (curr->expires <= t->expires) )
-        _pprev = &curr->list_next;
+    bound = wheel_walk(ts, walked, &end, NULL);
+    if ( end == STIME_MAX )
+        return 0;
+    if ( bound < end )
+        end = bound;
 
-    t->list_next = curr;
-    *_pprev = t;
+    /* Second pass over the same slots picks the latest expiry by @end. */
+    wheel_walk(ts, walked, &end, &start);
 
-    return (_pprev == pprev);
+    return start;
 }
 
 
@@ -167,57 +310,52 @@ static int add_to_list(struct timer **pprev, struct timer *t)
  * TIMER OPERATIONS.
  */
 
-static int remove_entry(struct timers *timers, struct timer *t)
+static void remove_entry(struct timers *timers, struct timer *t)
 {
-    int rc;
-
     switch ( t->status )
     {
-    case TIMER_STATUS_in_heap:
-        rc = remove_from_heap(timers->heap, t);
+    case TIMER_STATUS_in_wheel:
+        wheel_remove(timers, t);
         break;
-    case TIMER_STATUS_in_list:
-        rc = remove_from_list(&timers->list, t);
+    case TIMER_STATUS_in_batch:
+        hlist_del(&t->wheel_node);
         break;
     default:
-        rc = 0;
         BUG();
     }
 
     t->status = TIMER_STATUS_inactive;
-    return rc;
 }
 
-static int add_entry(struct timers *timers, struct timer *t)
+static void add_entry(struct timers *timers, struct timer *t)
 {
-    int rc;
-
     ASSERT(t->status == TIMER_STATUS_inactive);
-
-    /* Try to add to heap. t->heap_offset indicates whether we succeed. */
-    t->heap_offset = 0;
-    t->status = TIMER_STATUS_in_heap;
-    rc = add_to_heap(timers->heap, t);
-    if ( t->heap_offset != 0 )
-        return rc;
-
-    /* Fall back to adding to the slower linked list. */
-    timers->overflow = 1;
-    t->status = TIMER_STATUS_in_list;
-    return add_to_list(&timers->list, t);
+    wheel_insert(timers, t);
 }
 
 static inline void __add_timer(struct timer *timer)
 {
     int cpu = timer->cpu;
-    if ( add_entry(&per_cpu(timers, cpu), timer) )
+    s_time_t deadline = per_cpu(timer_deadline, cpu);
+
+    add_entry(&per_cpu(timers, cpu), timer);
+    per_cpu(timers, cpu).nr_set++;
+    perfc_incr(timer_set);
+
+    /* Reprogram only if the current deadline is too late for this timer. */
+    if ( (deadline == 0) || (timer->expires_end < deadline) )
         cpu_raise_softirq(cpu, TIMER_SOFTIRQ);
 }
 
 static inline void __stop_timer(struct timer *timer)
 {
     int cpu = timer->cpu;
-    if ( remove_entry(&per_cpu(timers, cpu), timer) )
+
+    remove_entry(&per_cpu(timers, cpu), timer);
+    per_cpu(timers, cpu).nr_stop++;
+    perfc_incr(timer_stop);
+
+    if ( timer->expires == per_cpu(timer_deadline, cpu) )
         cpu_raise_softirq(cpu, TIMER_SOFTIRQ);
 }
 
@@ -251,7 +389,7 @@ static inline void timer_unlock(struct timer *timer)
     do { timer_unlock(t); local_irq_restore(flags); } while ( 0 )
 
 
-void set_timer(struct timer *timer, s_time_t expires)
+void set_timer_range(struct timer *timer, s_time_t expires, s_time_t slack)
 {
     unsigned long flags;
 
@@ -261,7 +399,7 @@ void set_timer(struct timer *timer, s_time_t expires)
         __stop_timer(timer);
 
     timer->expires = expires;
-    timer->expires_end = expires + timer_slop;
+    timer->expires_end = expires + max_t(s_time_t, slack, timer_slop);
 
     if ( likely(timer->status != TIMER_STATUS_killed) )
         __add_timer(timer);
@@ -270,6 +408,12 @@ void set_timer(struct timer *timer, s_time_t expires)
 }
 
 
+void set_timer(struct timer *timer, s_time_t expires)
+{
+    set_timer_range(timer, expires, timer_slop);
+}
+
+
 void stop_timer(struct timer *timer)
 {
     unsigned long flags;
@@ -316,6 +460,7 @@ void migrate_timer(struct timer *timer, unsigned int new_cpu)
         __stop_timer(timer);
         timer->cpu = new_cpu;
         __add_timer(timer);
+        perfc_incr(timer_migrate);
     }
     else
     {
@@ -363,100 +508,33 @@ static void execute_timer(struct timers *ts, struct timer *t)
 
 static void timer_softirq_action(void)
 {
-    struct timer  *t, **heap, *next;
+    struct timer  *t;
     struct timers *ts;
     s_time_t       now;
 
     ts = &this_cpu(timers);
-    heap = ts->heap;
-
-    /* If we overflowed the heap, try to allocate a larger heap. */
-    if ( unlikely(ts->overflow) )
-    {
-        /* old_limit == (2^n)-1; new_limit == (2^(n+4))-1 */
-        int old_limit = GET_HEAP_LIMIT(heap);
-        int new_limit = ((old_limit + 1) << 4) - 1;
-        struct timer **newheap = xmalloc_array(struct timer *, new_limit + 1);
-        if ( newheap != NULL )
-        {
-            spin_lock_irq(&ts->lock);
-            memcpy(newheap, heap, (old_limit + 1) * sizeof(*heap));
-            SET_HEAP_LIMIT(newheap, new_limit);
-            ts->heap = newheap;
-            spin_unlock_irq(&ts->lock);
-            if ( old_limit != 0 )
-                xfree(heap);
-            heap = newheap;
-        }
-    }
 
     spin_lock_irq(&ts->lock);
 
+    ts->nr_softirq++;
+    perfc_incr(timer_softirq);
+
     now = NOW();
 
-    /* Execute ready heap timers. */
-    while ( (GET_HEAP_SIZE(heap) != 0) &&
-            ((t = heap[1])->expires < now) )
-    {
-        remove_from_heap(heap, t);
-        t->status = TIMER_STATUS_inactive;
-        execute_timer(ts, t);
-    }
+    /* Collect every expired timer, then execute them as one batch. */
+    wheel_advance(ts, now);
 
-    /* Execute ready list timers. */
-    while ( ((t = ts->list) != NULL) && (t->expires < now) )
+    while ( !hlist_empty(&ts->batch) )
     {
-        ts->list = t->list_next;
+        t = hlist_entry(ts->batch.first, struct timer, wheel_node);
+        hlist_del(&t->wheel_node);
         t->status = TIMER_STATUS_inactive;
+        ts->nr_expired++;
+        perfc_incr(timer_expired);
         execute_timer(ts, t);
     }
 
-    /* Try to move timers from linked list to more efficient heap. */
-    next = ts->list;
-    ts->list = NULL;
-    while ( unlikely((t = next) != NULL) )
-    {
-        next = t->list_next;
-        t->status = TIMER_STATUS_inactive;
-        add_entry(ts, t);
-    }
-
-    ts->overflow = (ts->list != NULL);
-    if ( unlikely(ts->overflow) )
-    {
-        /* Find earliest deadline at head of list or top of heap. */
-        this_cpu(timer_deadline) = ts->list->expires;
-        if ( (GET_HEAP_SIZE(heap) != 0) &&
-             ((t = heap[1])->expires < this_cpu(timer_deadline)) )
-            this_cpu(timer_deadline) = t->expires;
-    }
-    else
-    {
-        /*
-         * Find the earliest deadline that encompasses largest number of timers
-         * on the heap. To do this we take timers from the heap while their
-         * valid deadline ranges continue to intersect.
-         */
-        s_time_t start = 0, end = STIME_MAX;
-        struct timer **list_tail = &ts->list;
-
-        while ( (GET_HEAP_SIZE(heap) != 0) &&
-                ((t = heap[1])->expires <= end) )
-        {
-            remove_entry(ts, t);
-
-            t->status = TIMER_STATUS_in_list;
-            t->list_next = NULL;
-            *list_tail = t;
-            list_tail = &t->list_next;
-
-            start = t->expires;
-            if ( end > t->expires_end )
-                end = t->expires_end;
-        }
-
-        this_cpu(timer_deadline) = start;
-    }
+    this_cpu(timer_deadline) = wheel_deadline(ts);
 
     if ( !reprogram_timer(this_cpu(timer_deadline)) )
         raise_softirq(TIMER_SOFTIRQ);
@@ -485,9 +563,11 @@ static void dump_timerq(unsigned char key)
 {
     struct timer  *t;
     struct timers *ts;
+    struct hlist_node *pos;
     unsigned long  flags;
     s_time_t       now = NOW();
-    int            i, j;
+    unsigned int   level, idx, nr;
+    int            i;
 
     printk("Dumping timer queues: NOW=0x%08X%08X\n",
            (u32)(now>>32), (u32)now);
@@ -496,19 +576,29 @@ static void dump_timerq(unsigned char key)
     {
         ts = &per_cpu(timers, i);
 
-        printk("CPU[%02d] ", i);
+        printk("CPU[%02d] clk=0x%08X%08X set=%lu stop=%lu expired=%lu "
+               "cascaded=%lu softirqs=%lu\n", i,
+               (u32)(ts->clk>>32), (u32)ts->clk, ts->nr_set, ts->nr_stop,
+               ts->nr_expired, ts->nr_cascade, ts->nr_softirq);
         spin_lock_irqsave(&ts->lock, flags);
-        for ( j = 1; j <= GET_HEAP_SIZE(ts->heap); j++ )
+        for ( level = 0; level < TIMER_WHEEL_LEVELS; level++ )
         {
-            t = ts->heap[j];
-            printk ("  %d : %p ex=0x%08X%08X %p %p\n",
-                    j, t, (u32)(t->expires>>32), (u32)t->expires,
-                    t->data, t->function);
+            nr = 0;
+            for ( idx = 0; idx < TIMER_WHEEL_SIZE; idx++ )
+                hlist_for_each_entry ( t, pos, &ts->wheel->slot[level][idx],
+                                       wheel_node )
+                    nr++;
+            printk("  level %u: %u timers in %lu slots, %lu inserts\n",
+                   level, nr, hweight64(ts->wheel->pending[level]),
+                   ts->nr_level[level]);
         }
-        for ( t = ts->list, j = 0; t != NULL; t = t->list_next, j++ )
-            printk (" L%d : %p ex=0x%08X%08X %p %p\n",
-                    j, t, (u32)(t->expires>>32), (u32)t->expires,
-                    t->data, t->function);
+        for ( level = 0; level < TIMER_WHEEL_LEVELS; level++ )
+            for ( idx = 0; idx < TIMER_WHEEL_SIZE; idx++ )
+                hlist_for_each_entry ( t, pos, &ts->wheel->slot[level][idx],
+                                       wheel_node )
+                    printk ("  %u/%02u : %p ex=0x%08X%08X %p %p\n",
+                            level, idx, t, (u32)(t->expires>>32),
+                            (u32)t->expires, t->data, t->function);
         spin_unlock_irqrestore(&ts->lock, flags);
         printk("\n");
     }
@@ -517,22 +607,21 @@ static void dump_timerq(unsigned char key)
 
 void __init timer_init(void)
 {
-    static struct timer *dummy_heap;
+    struct timers *ts;
+    s_time_t now = NOW();
     int i;
 
     open_softirq(TIMER_SOFTIRQ, timer_softirq_action);
 
-    /*
-     * All CPUs initially share an empty dummy heap. Only those CPUs that
-     * are brought online will be dynamically allocated their own heap.
-     */
-    SET_HEAP_SIZE(&dummy_heap, 0);
-    SET_HEAP_LIMIT(&dummy_heap, 0);
-
     for_each_possible_cpu ( i )
     {
-        spin_lock_init(&per_cpu(timers, i).lock);
-        per_cpu(timers, i).heap = &dummy_heap;
+        ts = &per_cpu(timers, i);
+        spin_lock_init(&ts->lock);
+        ts->wheel = xmalloc(struct timer_wheel);
+        BUG_ON(ts->wheel == NULL);
+        memset(ts->wheel, 0, sizeof(*ts->wheel));
+        ts->clk = now >> TIMER_WHEEL_SHIFT;
+        INIT_HLIST_HEAD(&ts->batch);
     }
 
     register_keyhandler('a', dump_timerq, "dump timer queues");
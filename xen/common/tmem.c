@@ -79,8 +79,10 @@ static int global_obj_count_max = 0;
 static int global_pgp_count_max = 0;
 static int global_page_count_max = 0;
 static int global_rtree_node_count_max = 0;
-static long global_eph_count_max = 0;
+static int global_eph_count_max = 0;
 static unsigned long failed_copies;
+static int global_pcd_count_max = 0;
+static unsigned long dedup_hits = 0, dedup_misses = 0;
 
 DECL_CYC_COUNTER(succ_get);
 DECL_CYC_COUNTER(succ_put);
@@ -110,7 +112,8 @@ struct client {
     struct tm_pool *pools[MAX_POOLS_PER_DOMAIN];
     tmh_client_t *tmh;
     struct list_head ephemeral_page_list;
-    long eph_count, eph_count_max;
+    atomic_t eph_count;
+    long eph_count_max;
     cli_id_t cli_id;
     uint32_t weight;
     uint32_t cap;
@@ -141,15 +144,15 @@ struct tm_pool {
     client_t *client;
     uint64_t uuid[2]; /* 0 for private, non-zero for shared */
     uint32_t pool_id;
-    rwlock_t pool_rwlock;
-    struct rb_root obj_rb_root[OBJ_HASH_BUCKETS]; /* protected by pool_rwlock */
+    rwlock_t obj_rb_rwlock[OBJ_HASH_BUCKETS]; /* one per bucket */
+    struct rb_root obj_rb_root[OBJ_HASH_BUCKETS]; /* protected by above */
     struct list_head share_list; /* valid if shared */
     DECL_SENTINEL
     int shared_count; /* valid if shared */
     atomic_t pgp_count;
     int pgp_count_max;
-    long obj_count;  /* atomicity depends on pool_rwlock held for write */
-    long obj_count_max;  
+    atomic_t obj_count;
+    int obj_count_max;
     unsigned long objnode_count, objnode_count_max;
     uint64_t sum_life_cycles;
     uint64_t sum_evicted_cycles;
@@ -169,7 +172,7 @@ typedef struct tm_pool pool_t;
 struct tmem_object_root {
     DECL_SENTINEL
     uint64_t oid;
-    struct rb_node rb_tree_node; /* protected by pool->pool_rwlock */
+    struct rb_node rb_tree_node; /* protected by pool's bucket rwlock */
     unsigned long objnode_count; /* atomicity depends on obj_spinlock */
     long pgp_count; /* atomicity depends on obj_spinlock */
     struct radix_tree_root tree_root; /* tree of pages within object */
@@ -188,9 +191,31 @@ struct tmem_object_node {
 };
 typedef struct tmem_object_node objnode_t;
 
+/*
+ * With dedup enabled, the data of full pages put into ephemeral pools is
+ * held by a reference-counted content descriptor, shared by all pgps with
+ * identical contents. Such a pgp's pfp/cdata and size mirror those of its
+ * pcd, so readers need not care; the data must never be modified in place.
+ */
+struct tmem_page_content_descriptor {
+    struct list_head hash_list; /* protected by pcd_hash_lock[bucket] */
+    uint32_t hash;
+    uint32_t refcnt;
+    size_t size; /* as for pgp_t */
+    union {
+        pfp_t *pfp;
+        char *cdata;
+    };
+};
+typedef struct tmem_page_content_descriptor pcd_t;
+
+#define PCD_HASH_BUCKETS 1024 /* must be power of two */
+#define PCD_HASH(_h) ((_h) & (PCD_HASH_BUCKETS-1))
+
 struct tmem_page_descriptor {
-    struct list_head global_eph_pages;
+    struct list_head global_eph_pages; /* or the per-cpu staging list */
     struct list_head client_eph_pages;
+    int eph_stage_cpu; /* cpu whose staging list holds us, else -1 */
     obj_t *obj;
     uint32_t index;
     size_t size; /* 0 == PAGE_SIZE (pfp), else compressed data (cdata) */
@@ -198,6 +223,7 @@ struct tmem_page_descriptor {
         pfp_t *pfp;  /* page frame pointer */
         char *cdata; /* compressed data */
     };
+    pcd_t *pcd; /* non-NULL iff data is shared, see above */
     uint64_t timestamp;
     DECL_SENTINEL
 };
@@ -230,12 +256,37 @@ static DEFINE_SPINLOCK(eph_lists_spinlock); /* protects global AND clients */
 #define ASSERT_SPINLOCK(_l) ASSERT(tmh_lock_all || spin_is_locked(_l))
 #define ASSERT_WRITELOCK(_l) ASSERT(tmh_lock_all || rw_is_write_locked(_l))
 
+/* objects are hashed into buckets, each with its own rbtree and lock */
+#define obj_bucket_rwlock(_pool,_oid) (&(_pool)->obj_rb_rwlock[OBJ_HASH(_oid)])
+
+/*
+ * Newly put ephemeral pages are first queued on a per-cpu staging list and
+ * moved onto the (global and per-client) LRU lists in batches, so that
+ * eph_lists_spinlock is taken once per EPH_STAGE_BATCH puts rather than on
+ * every put. Staged pages are the most recently used, so eviction, which
+ * takes from the cold end of the LRU lists, can safely ignore them. They
+ * are counted in the ephemeral page counts from the moment they are staged,
+ * which is why those counts are atomic rather than under the list lock.
+ * Lock order: eph_lists_spinlock, then a staging list's lock.
+ */
+#define EPH_STAGE_BATCH 16
+struct eph_stage {
+    spinlock_t lock;
+    struct list_head list;
+    int count;
+};
+static DEFINE_PER_CPU(struct eph_stage, eph_stage);
+
 /* global counters (should use long_atomic_t access) */
-static long global_eph_count = 0; /* atomicity depends on eph_lists_spinlock */
+static atomic_t global_eph_count = ATOMIC_INIT(0); /* includes staged pages */
 static atomic_t global_obj_count = ATOMIC_INIT(0);
 static atomic_t global_pgp_count = ATOMIC_INIT(0);
 static atomic_t global_page_count = ATOMIC_INIT(0);
 static atomic_t global_rtree_node_count = ATOMIC_INIT(0);
+static atomic_t global_pcd_count = ATOMIC_INIT(0);
+
+static struct list_head pcd_hash_table[PCD_HASH_BUCKETS];
+static spinlock_t pcd_hash_lock[PCD_HASH_BUCKETS];
 
 #define atomic_inc_and_max(_c) do { \
     atomic_inc(&_c); \
@@ -319,7 +370,9 @@ static NOINLINE pgp_t *pgp_alloc(obj_t *obj)
     pgp->obj = obj;
     INIT_LIST_HEAD(&pgp->global_eph_pages);
     INIT_LIST_HEAD(&pgp->client_eph_pages);
+    pgp->eph_stage_cpu = -1;
     pgp->pfp = NULL;
+    pgp->pcd = NULL;
     pgp->size = -1;
     pgp->index = -1;
     pgp->timestamp = get_cycles();
@@ -339,10 +392,43 @@ static pgp_t *pgp_lookup_in_obj(obj_t *obj, uint32_t index)
     return radix_tree_lookup(&obj->tree_root, index);
 }
 
+/************ PAGE CONTENT DESCRIPTOR (DEDUP) ROUTINES ***************/
+
+/* drop a pgp's reference to shared data, freeing the data on last put */
+static void pcd_put(pgp_t *pgp)
+{
+    pcd_t *pcd = pgp->pcd;
+    spinlock_t *lock = &pcd_hash_lock[PCD_HASH(pcd->hash)];
+
+    tmem_spin_lock(lock);
+    ASSERT(pcd->refcnt > 0);
+    if ( --pcd->refcnt )
+        tmem_spin_unlock(lock);
+    else
+    {
+        list_del(&pcd->hash_list);
+        tmem_spin_unlock(lock);
+        if ( !pcd->size )
+            tmem_page_free(NULL,pcd->pfp);
+        else
+            tmem_free(pcd->cdata,pcd->size,NULL);
+        tmem_free(pcd,sizeof(pcd_t),NULL);
+        atomic_dec_and_assert(global_pcd_count);
+    }
+    pgp->pcd = NULL;
+    pgp->pfp = NULL;
+    pgp->size = -1;
+}
+
 static NOINLINE void pgp_free_data(pgp_t *pgp, pool_t *pool)
 {
     if ( pgp->pfp == NULL )
         return;
+    if ( pgp->pcd != NULL )
+    {
+        pcd_put(pgp);
+        return;
+    }
     if ( !pgp->size )
         tmem_page_free(pgp->obj->pool,pgp->pfp);
     else
@@ -358,6 +444,76 @@ static NOINLINE void pgp_free_data(pgp_t *pgp, pool_t *pool)
     pgp->size = -1;
 }
 
+/*
+ * Called once a full page has been stored in a pgp of an ephemeral pool:
+ * if identical data is already held, share it and free the pgp's copy,
+ * otherwise make the pgp's data available for sharing.
+ */
+static NOINLINE void pcd_associate(pgp_t *pgp)
+{
+    client_t *client = pgp->obj->pool->client;
+    pcd_t *pcd, *newpcd;
+    spinlock_t *lock;
+    uint32_t hash;
+
+    ASSERT(pgp->pcd == NULL);
+    ASSERT(pgp->size != -1);
+    ASSERT(is_ephemeral(pgp->obj->pool));
+
+    if ( !pgp->size )
+        hash = tmh_page_hash(pgp->pfp);
+    else
+        hash = tmh_hash_data(pgp->cdata, pgp->size);
+
+    /* allocate up front: we can't allocate with the bucket lock held */
+    newpcd = tmem_malloc(pcd_t,NULL);
+
+    lock = &pcd_hash_lock[PCD_HASH(hash)];
+    tmem_spin_lock(lock);
+    list_for_each_entry(pcd, &pcd_hash_table[PCD_HASH(hash)], hash_list)
+    {
+        if ( (pcd->hash != hash) || (pcd->size != pgp->size) )
+            continue;
+        if ( pgp->size ? memcmp(pcd->cdata, pgp->cdata, pgp->size)
+                       : tmh_page_cmp(pcd->pfp, pgp->pfp) )
+            continue;
+        pcd->refcnt++;
+        tmem_spin_unlock(lock);
+        dedup_hits++;
+        if ( newpcd != NULL )
+            tmem_free(newpcd,sizeof(pcd_t),NULL);
+        pgp_free_data(pgp,pgp->obj->pool);
+        pgp->pcd = pcd;
+        pgp->size = pcd->size;
+        pgp->pfp = pcd->pfp; /* or cdata, same union member */
+        return;
+    }
+
+    dedup_misses++;
+    if ( newpcd == NULL )
+    {
+        /* no memory to track it: just keep the data private */
+        tmem_spin_unlock(lock);
+        return;
+    }
+
+    /* hand the pgp's data over to the pcd */
+    newpcd->hash = hash;
+    newpcd->refcnt = 1;
+    newpcd->size = pgp->size;
+    newpcd->pfp = pgp->pfp;
+    list_add(&newpcd->hash_list, &pcd_hash_table[PCD_HASH(hash)]);
+    tmem_spin_unlock(lock);
+    atomic_inc_and_max(global_pcd_count);
+    if ( pgp->size )
+    {
+        /* shared compressed data is no longer charged to the client */
+        client->compressed_pages--;
+        client->compressed_sum_size -= pgp->size;
+    }
+    pgp->pcd = newpcd;
+}
+
 static NOINLINE void pgp_free(pgp_t *pgp, int from_delete)
 {
     pool_t *pool = NULL;
@@ -382,6 +538,73 @@ static NOINLINE void pgp_free(pgp_t *pgp, int from_delete)
     tmem_free(pgp,sizeof(pgp_t),pool);
 }
 
+/* move a cpu's staged ephemeral pages onto the LRU lists */
+static void eph_stage_drain(unsigned int cpu)
+{
+    struct eph_stage *stage = &per_cpu(eph_stage, cpu);
+    client_t *client;
+    pgp_t *pgp;
+
+    tmem_spin_lock(&eph_lists_spinlock);
+    tmem_spin_lock(&stage->lock);
+    while ( !list_empty(&stage->list) )
+    {
+        pgp = list_entry(stage->list.next, pgp_t, global_eph_pages);
+        client = pgp->obj->pool->client;
+
+        ASSERT(pgp->eph_stage_cpu == cpu);
+        pgp->eph_stage_cpu = -1;
+        list_move_tail(&pgp->global_eph_pages, &global_ephemeral_page_list);
+        list_add_tail(&pgp->client_eph_pages, &client->ephemeral_page_list);
+    }
+    stage->count = 0;
+    tmem_spin_unlock(&stage->lock);
+    tmem_spin_unlock(&eph_lists_spinlock);
+}
+
+/* queue a newly put ephemeral page on this cpu's staging list */
+static void eph_stage_add(pgp_t *pgp)
+{
+    unsigned int cpu = smp_processor_id();
+    struct eph_stage *stage = &per_cpu(eph_stage, cpu);
+    client_t *client = pgp->obj->pool->client;
+    int count;
+
+    atomic_inc_and_max(global_eph_count);
+    atomic_inc_and_max(client->eph_count);
+
+    tmem_spin_lock(&stage->lock);
+    pgp->eph_stage_cpu = cpu;
+    list_add_tail(&pgp->global_eph_pages, &stage->list);
+    count = ++stage->count;
+    tmem_spin_unlock(&stage->lock);
+
+    if ( count >= EPH_STAGE_BATCH )
+        eph_stage_drain(cpu);
+}
+
+/* take the page off a staging list if it is (still) on one */
+static bool_t eph_stage_remove(pgp_t *pgp)
+{
+    int cpu = pgp->eph_stage_cpu;
+    struct eph_stage *stage;
+    bool_t removed = 0;
+
+    if ( cpu < 0 )
+        return 0;
+    stage = &per_cpu(eph_stage, cpu);
+    tmem_spin_lock(&stage->lock);
+    if ( pgp->eph_stage_cpu == cpu ) /* not drained meanwhile */
+    {
+        list_del_init(&pgp->global_eph_pages);
+        pgp->eph_stage_cpu = -1;
+        stage->count--;
+        removed = 1;
+    }
+    tmem_spin_unlock(&stage->lock);
+    return removed;
+}
+
 /* remove the page from appropriate lists but not from parent object */
 static void pgp_delist(pgp_t *pgp, bool_t no_eph_lock)
 {
@@ -391,15 +614,19 @@ static void pgp_delist(pgp_t *pgp, bool_t no_eph_lock)
     ASSERT(pgp->obj->pool->client != NULL);
     if ( is_ephemeral(pgp->obj->pool) )
     {
+        if ( eph_stage_remove(pgp) )
+        {
+            atomic_dec_and_assert(pgp->obj->pool->client->eph_count);
+            atomic_dec_and_assert(global_eph_count);
+            return;
+        }
         if ( !no_eph_lock )
             tmem_spin_lock(&eph_lists_spinlock);
         if ( !list_empty(&pgp->client_eph_pages) )
-            pgp->obj->pool->client->eph_count--;
-        ASSERT(pgp->obj->pool->client->eph_count >= 0);
+            atomic_dec_and_assert(pgp->obj->pool->client->eph_count);
         list_del_init(&pgp->client_eph_pages);
         if ( !list_empty(&pgp->global_eph_pages) )
-            global_eph_count--;
-        ASSERT(global_eph_count >= 0);
+            atomic_dec_and_assert(global_eph_count);
         list_del_init(&pgp->global_eph_pages);
         if ( !no_eph_lock )
             tmem_spin_unlock(&eph_lists_spinlock);
@@ -523,7 +750,7 @@ static NOINLINE obj_t * obj_find(pool_t *pool, uint64_t oid)
     obj_t *obj;
 
 restart_find:
-    tmem_read_lock(&pool->pool_rwlock);
+    tmem_read_lock(obj_bucket_rwlock(pool,oid));
     node = pool->obj_rb_root[OBJ_HASH(oid)].rb_node;
     while ( node )
     {
@@ -536,10 +763,10 @@ restart_find:
             {
                 if ( !tmem_spin_trylock(&obj->obj_spinlock) )
                 {
-                    tmem_read_unlock(&pool->pool_rwlock);
+                    tmem_read_unlock(obj_bucket_rwlock(pool,oid));
                     goto restart_find;
                 }
-                tmem_read_unlock(&pool->pool_rwlock);
+                tmem_read_unlock(obj_bucket_rwlock(pool,oid));
             }
             return obj;
         }
@@ -548,7 +775,7 @@ restart_find:
         else
             node = node->rb_right;
     }
-    tmem_read_unlock(&pool->pool_rwlock);
+    tmem_read_unlock(obj_bucket_rwlock(pool,oid));
     return NULL;
 }
 
@@ -564,13 +791,12 @@ static NOINLINE void obj_free(obj_t *obj, int no_rebalance)
     ASSERT(obj->pgp_count == 0);
     pool = obj->pool;
     ASSERT(pool != NULL);
-    ASSERT_WRITELOCK(&pool->pool_rwlock);
+    ASSERT_WRITELOCK(obj_bucket_rwlock(pool,obj->oid));
     if ( obj->tree_root.rnode != NULL ) /* may be a "stump" with no leaves */
         radix_tree_destroy(&obj->tree_root, pgp_destroy, rtn_free);
     ASSERT((long)obj->objnode_count == 0);
     ASSERT(obj->tree_root.rnode == NULL);
-    pool->obj_count--;
-    ASSERT(pool->obj_count >= 0);
+    atomic_dec_and_assert(pool->obj_count);
     INVERT_SENTINEL(obj,OBJ);
     obj->pool = NULL;
     old_oid = obj->oid;
@@ -583,6 +809,16 @@ static NOINLINE void obj_free(obj_t *obj, int no_rebalance)
     tmem_free(obj,sizeof(obj_t),pool);
 }
 
+/* as obj_free, but takes the object's bucket lock itself */
+static void obj_free_bucket(obj_t *obj)
+{
+    rwlock_t *lock = obj_bucket_rwlock(obj->pool,obj->oid);
+
+    tmem_write_lock(lock);
+    obj_free(obj,0);
+    tmem_write_unlock(lock);
+}
+
 static NOINLINE int obj_rb_insert(struct rb_root *root, obj_t *obj)
 {
     struct rb_node **new, *parent = NULL;
@@ -614,12 +850,10 @@ static NOINLINE obj_t * obj_new(pool_t *pool, uint64_t oid)
     obj_t *obj;
 
     ASSERT(pool != NULL);
-    ASSERT_WRITELOCK(&pool->pool_rwlock);
+    ASSERT_WRITELOCK(obj_bucket_rwlock(pool,oid));
     if ( (obj = tmem_malloc(obj_t,pool)) == NULL )
         return NULL;
-    pool->obj_count++;
-    if (pool->obj_count > pool->obj_count_max)
-        pool->obj_count_max = pool->obj_count;
+    atomic_inc_and_max(pool->obj_count);
     atomic_inc_and_max(global_obj_count);
     INIT_RADIX_TREE(&obj->tree_root,0);
     spin_lock_init(&obj->obj_spinlock);
@@ -639,7 +873,7 @@ static NOINLINE obj_t * obj_new(pool_t *pool, uint64_t oid)
 /* free an object after destroying any pgps in it */
 static NOINLINE void obj_destroy(obj_t *obj, int no_rebalance)
 {
-    ASSERT_WRITELOCK(&obj->pool->pool_rwlock);
+    ASSERT_WRITELOCK(obj_bucket_rwlock(obj->pool,obj->oid));
     radix_tree_destroy(&obj->tree_root, pgp_destroy, rtn_free);
     obj_free(obj,no_rebalance);
 }
@@ -651,9 +885,9 @@ static void pool_destroy_objs(pool_t *pool, bool_t selective, cli_id_t cli_id)
     obj_t *obj;
     int i;
 
-    tmem_write_lock(&pool->pool_rwlock);
     for (i = 0; i < OBJ_HASH_BUCKETS; i++)
     {
+        tmem_write_lock(&pool->obj_rb_rwlock[i]);
         node = rb_first(&pool->obj_rb_root[i]);
         while ( node != NULL )
         {
@@ -668,8 +902,8 @@ static void pool_destroy_objs(pool_t *pool, bool_t selective, cli_id_t cli_id)
             else
                 tmem_spin_unlock(&obj->obj_spinlock);
         }
+        tmem_write_unlock(&pool->obj_rb_rwlock[i]);
     }
-    tmem_write_unlock(&pool->pool_rwlock);
 }
 
 
@@ -683,13 +917,15 @@ static pool_t * pool_alloc(void)
     if ( (pool = tmem_malloc(pool_t,NULL)) == NULL )
         return NULL;
     for (i = 0; i < OBJ_HASH_BUCKETS; i++)
+    {
         pool->obj_rb_root[i] = RB_ROOT;
+        rwlock_init(&pool->obj_rb_rwlock[i]);
+    }
     INIT_LIST_HEAD(&pool->pool_list);
-    rwlock_init(&pool->pool_rwlock);
     pool->pgp_count_max = pool->obj_count_max = 0;
     pool->objnode_count = pool->objnode_count_max = 0;
     atomic_set(&pool->pgp_count,0);
-    pool->obj_count = 0;
+    atomic_set(&pool->obj_count,0);
     pool->good_puts = pool->puts = pool->dup_puts_flushed = 0;
     pool->dup_puts_replaced = pool->no_mem_puts = 0;
     pool->found_gets = pool->gets = 0;
@@ -746,8 +982,8 @@ static NOINLINE void shared_pool_reassign(pool_t *pool)
         if (new_client->pools[poolid] == pool)
             break;
     ASSERT(poolid != MAX_POOLS_PER_DOMAIN);
-    new_client->eph_count += _atomic_read(pool->pgp_count);
-    old_client->eph_count -= _atomic_read(pool->pgp_count);
+    atomic_add(_atomic_read(pool->pgp_count), &new_client->eph_count);
+    atomic_sub(_atomic_read(pool->pgp_count), &old_client->eph_count);
     list_splice_init(&old_client->ephemeral_page_list,
                      &new_client->ephemeral_page_list);
     printk("reassigned shared pool from %s=%d to %s=%d pool_id=%d\n",
@@ -843,7 +1079,8 @@ static client_t *client_create(void)
 #endif
     list_add_tail(&client->client_list, &global_client_list);
     INIT_LIST_HEAD(&client->ephemeral_page_list);
-    client->eph_count = client->eph_count_max = 0;
+    atomic_set(&client->eph_count, 0);
+    client->eph_count_max = 0;
     client->total_cycles = 0; client->succ_pers_puts = 0;
     client->succ_eph_gets = 0; client->succ_pers_gets = 0;
     printk("ok\n");
@@ -878,12 +1115,14 @@ static void client_flush(client_t *client, bool_t destroy)
 static bool_t client_over_quota(client_t *client)
 {
     int total = _atomic_read(client_weight_total);
+    int eph_count;
 
     ASSERT(client != NULL);
+    eph_count = _atomic_read(client->eph_count);
     if ( (total == 0) || (client->weight == 0) || 
-          (client->eph_count == 0) )
+          (eph_count == 0) )
         return 0;
-    return ( ((global_eph_count*100L) / client->eph_count ) >
+    return ( ((_atomic_read(global_eph_count)*100L) / eph_count ) >
              ((total*100L) / client->weight) );
 }
 
@@ -896,9 +1135,14 @@ static int tmem_evict(void)
     obj_t *obj;
     pool_t *pool;
     int ret = 0;
-    bool_t hold_pool_rwlock = 0;
+    rwlock_t *bucket_rwlock = NULL;
+    unsigned int cpu;
 
     evict_attempts++;
+    eph_stage_drain(smp_processor_id());
+    if ( list_empty(&global_ephemeral_page_list) )
+        for_each_online_cpu ( cpu )
+            eph_stage_drain(cpu);
     tmem_spin_lock(&eph_lists_spinlock);
     if ( (client != NULL) && client_over_quota(client) &&
          !list_empty(&client->ephemeral_page_list) )
@@ -913,9 +1157,9 @@ static int tmem_evict(void)
             {
                 if ( obj->pgp_count > 1 )
                     goto found;
-                if ( tmem_write_trylock(&pool->pool_rwlock) )
+                if ( tmem_write_trylock(obj_bucket_rwlock(pool,obj->oid)) )
                 {
-                    hold_pool_rwlock = 1;
+                    bucket_rwlock = obj_bucket_rwlock(pool,obj->oid);
                     goto found;
                 }
                 tmem_spin_unlock(&obj->obj_spinlock);
@@ -934,9 +1178,9 @@ static int tmem_evict(void)
             {
                 if ( obj->pgp_count > 1 )
                     goto found;
-                if ( tmem_write_trylock(&pool->pool_rwlock) )
+                if ( tmem_write_trylock(obj_bucket_rwlock(pool,obj->oid)) )
                 {
-                    hold_pool_rwlock = 1;
+                    bucket_rwlock = obj_bucket_rwlock(pool,obj->oid);
                     goto found;
                 }
                 tmem_spin_unlock(&obj->obj_spinlock);
@@ -962,13 +1206,13 @@ found:
     pgp_delete(pgp,1);
     if ( obj->pgp_count == 0 )
     {
-        ASSERT_WRITELOCK(&pool->pool_rwlock);
+        ASSERT_WRITELOCK(obj_bucket_rwlock(pool,obj->oid));
         obj_free(obj,0);
     }
     else
         tmem_spin_unlock(&obj->obj_spinlock);
-    if ( hold_pool_rwlock )
-        tmem_write_unlock(&pool->pool_rwlock);
+    if ( bucket_rwlock != NULL )
+        tmem_write_unlock(bucket_rwlock);
     evicted_pgs++;
     ret = 1;
 
@@ -1079,6 +1323,9 @@ copy_uncompressed:
 
 done:
     /* successfully replaced data, clean up and return success */
+    if ( is_ephemeral(pool) && tmh_dedup_enabled() && (len == PAGE_SIZE) &&
+         !tmem_offset && !pfn_offset )
+        pcd_associate(pgp);
     if ( is_shared(pool) )
         obj->last_client = client->cli_id;
     obj->no_evict = 0;
@@ -1102,11 +1349,9 @@ failed_dup:
     ASSERT(pgpfound == pgp);
     pgp_delete(pgpfound,0);
     if ( obj->pgp_count == 0 )
+        obj_free_bucket(obj);
+    else
     {
-        tmem_write_lock(&pool->pool_rwlock);
-        obj_free(obj,0);
-        tmem_write_unlock(&pool->pool_rwlock);
-    } else {
         obj->no_evict = 0;
         tmem_spin_unlock(&obj->obj_spinlock);
     }
@@ -1140,14 +1385,14 @@ static NOINLINE int do_tmem_put(pool_t *pool, uint64_t oid, uint32_t index,
 
     if ( (objfound == NULL) )
     {
-        tmem_write_lock(&pool->pool_rwlock);
+        tmem_write_lock(obj_bucket_rwlock(pool,oid));
         if ( (obj = objnew = obj_new(pool,oid)) == NULL )
         {
-            tmem_write_unlock(&pool->pool_rwlock);
+            tmem_write_unlock(obj_bucket_rwlock(pool,oid));
             return -ENOMEM;
         }
         ASSERT_SPINLOCK(&objnew->obj_spinlock);
-        tmem_write_unlock(&pool->pool_rwlock);
+        tmem_write_unlock(obj_bucket_rwlock(pool,oid));
     }
 
     ASSERT((obj != NULL)&&((objnew==obj)||(objfound==obj))&&(objnew!=objfound));
@@ -1197,16 +1442,10 @@ copy_uncompressed:
 insert_page:
     if ( is_ephemeral(pool) )
     {
-        tmem_spin_lock(&eph_lists_spinlock);
-        list_add_tail(&pgp->global_eph_pages,
-            &global_ephemeral_page_list);
-        if (++global_eph_count > global_eph_count_max)
-            global_eph_count_max = global_eph_count;
-        list_add_tail(&pgp->client_eph_pages,
-            &client->ephemeral_page_list);
-        if (++client->eph_count > client->eph_count_max)
-            client->eph_count_max = client->eph_count;
-        tmem_spin_unlock(&eph_lists_spinlock);
+        if ( tmh_dedup_enabled() && (len == PAGE_SIZE) &&
+             !tmem_offset && !pfn_offset )
+            pcd_associate(pgp);
+        eph_stage_add(pgp);
     }
     ASSERT( ((objnew==obj)||(objfound==obj)) && (objnew!=objfound));
     if ( is_shared(pool) )
@@ -1232,11 +1471,7 @@ free:
         tmem_spin_unlock(&objfound->obj_spinlock);
     }
     if ( objnew )
-    {
-        tmem_write_lock(&pool->pool_rwlock);
-        obj_free(objnew,0);
-        tmem_write_unlock(&pool->pool_rwlock);
-    }
+        obj_free_bucket(objnew);
     pool->no_mem_puts++;
     return ret;
 
@@ -1293,18 +1528,22 @@ static NOINLINE int do_tmem_get(pool_t *pool, uint64_t oid, uint32_t index,
             pgp_delete(pgp,0);
             if ( obj->pgp_count == 0 )
             {
-                tmem_write_lock(&pool->pool_rwlock);
-                obj_free(obj,0);
+                obj_free_bucket(obj);
                 obj = NULL;
-                tmem_write_unlock(&pool->pool_rwlock);
             }
         } else {
-            tmem_spin_lock(&eph_lists_spinlock);
-            list_del(&pgp->global_eph_pages);
-            list_add_tail(&pgp->global_eph_pages,&global_ephemeral_page_list);
-            list_del(&pgp->client_eph_pages);
-            list_add_tail(&pgp->client_eph_pages,&client->ephemeral_page_list);
-            tmem_spin_unlock(&eph_lists_spinlock);
+            /* staged pages are recent enough already: no need to touch */
+            if ( pgp->eph_stage_cpu < 0 )
+            {
+                tmem_spin_lock(&eph_lists_spinlock);
+                list_del(&pgp->global_eph_pages);
+                list_add_tail(&pgp->global_eph_pages,
+                              &global_ephemeral_page_list);
+                list_del(&pgp->client_eph_pages);
+                list_add_tail(&pgp->client_eph_pages,
+                              &client->ephemeral_page_list);
+                tmem_spin_unlock(&eph_lists_spinlock);
+            }
             ASSERT(obj != NULL);
             obj->last_client = tmh_get_cli_id_from_current();
         }
@@ -1347,11 +1586,9 @@ static NOINLINE int do_tmem_flush_page(pool_t *pool, uint64_t oid, uint32_t inde
     }
     pgp_delete(pgp,0);
     if ( obj->pgp_count == 0 )
+        obj_free_bucket(obj);
+    else
     {
-        tmem_write_lock(&pool->pool_rwlock);
-        obj_free(obj,0);
-        tmem_write_unlock(&pool->pool_rwlock);
-    } else {
         obj->no_evict = 0;
         tmem_spin_unlock(&obj->obj_spinlock);
     }
@@ -1372,10 +1609,10 @@ static NOINLINE int do_tmem_flush_object(pool_t *pool, uint64_t oid)
     obj = obj_find(pool,oid);
     if ( obj == NULL )
         goto out;
-    tmem_write_lock(&pool->pool_rwlock);
+    tmem_write_lock(obj_bucket_rwlock(pool,oid));
     obj_destroy(obj,0);
     pool->flush_objs_found++;
-    tmem_write_unlock(&pool->pool_rwlock);
+    tmem_write_unlock(obj_bucket_rwlock(pool,oid));
 
 out:
     if ( pool->client->frozen )
@@ -1558,8 +1795,8 @@ static int tmemc_list_client(client_t *c, tmem_cli_va_t buf, int off,
         use_long ? ',' : '\n');
     if (use_long)
         n += scnprintf(info+n,BSIZE-n,
-             "Ec:%ld,Em:%ld,cp:%ld,cb:%"PRId64",cn:%ld,cm:%ld\n",
-             c->eph_count, c->eph_count_max,
+             "Ec:%d,Em:%ld,cp:%ld,cb:%"PRId64",cn:%ld,cm:%ld\n",
+             _atomic_read(c->eph_count), c->eph_count_max,
              c->compressed_pages, c->compressed_sum_size,
              c->compress_poor, c->compress_nomem);
     tmh_copy_to_client_buf_offset(buf,off+sum,info,n+1);
@@ -1578,11 +1815,11 @@ static int tmemc_list_client(client_t *c, tmem_cli_va_t buf, int off,
                       use_long ? ',' : '\n');
         if (use_long)
             n += scnprintf(info+n,BSIZE-n,
-             "Pc:%d,Pm:%d,Oc:%ld,Om:%ld,Nc:%lu,Nm:%lu,"
+             "Pc:%d,Pm:%d,Oc:%d,Om:%d,Nc:%lu,Nm:%lu,"
              "ps:%lu,pt:%lu,pd:%lu,pr:%lu,px:%lu,gs:%lu,gt:%lu,"
              "fs:%lu,ft:%lu,os:%lu,ot:%lu\n",
              _atomic_read(p->pgp_count), p->pgp_count_max,
-             p->obj_count, p->obj_count_max,
+             _atomic_read(p->obj_count), p->obj_count_max,
              p->objnode_count, p->objnode_count_max,
              p->good_puts, p->puts,p->dup_puts_flushed, p->dup_puts_replaced,
              p->no_mem_puts, 
@@ -1617,11 +1854,11 @@ static int tmemc_list_shared(tmem_cli_va_t buf, int off, uint32_t len,
         n += scnprintf(info+n,BSIZE-n,"%c", use_long ? ',' : '\n');
         if (use_long)
             n += scnprintf(info+n,BSIZE-n,
-             "Pc:%d,Pm:%d,Oc:%ld,Om:%ld,Nc:%lu,Nm:%lu,"
+             "Pc:%d,Pm:%d,Oc:%d,Om:%d,Nc:%lu,Nm:%lu,"
              "ps:%lu,pt:%lu,pd:%lu,pr:%lu,px:%lu,gs:%lu,gt:%lu,"
              "fs:%lu,ft:%lu,os:%lu,ot:%lu\n",
              _atomic_read(p->pgp_count), p->pgp_count_max,
-             p->obj_count, p->obj_count_max,
+             _atomic_read(p->obj_count), p->obj_count_max,
              p->objnode_count, p->objnode_count_max,
              p->good_puts, p->puts,p->dup_puts_flushed, p->dup_puts_replaced,
              p->no_mem_puts, 
@@ -1687,11 +1924,14 @@ static int tmemc_list_global(tmem_cli_va_t buf, int off, uint32_t len,
       total_flush_pool, use_long ? ',' : '\n');
     if (use_long)
         n += scnprintf(info+n,BSIZE-n,
-          "Ec:%ld,Em:%ld,Oc:%d,Om:%d,Nc:%d,Nm:%d,Pc:%d,Pm:%d\n",
-          global_eph_count, global_eph_count_max,
+          "Ec:%d,Em:%d,Oc:%d,Om:%d,Nc:%d,Nm:%d,Pc:%d,Pm:%d,"
+          "Dc:%d,Dm:%d,Dh:%lu,Dx:%lu\n",
+          _atomic_read(global_eph_count), global_eph_count_max,
           _atomic_read(global_obj_count), global_obj_count_max,
           _atomic_read(global_rtree_node_count), global_rtree_node_count_max,
-          _atomic_read(global_pgp_count), global_pgp_count_max);
+          _atomic_read(global_pgp_count), global_pgp_count_max,
+          _atomic_read(global_pcd_count), global_pcd_count_max,
+          dedup_hits, dedup_misses);
     if ( sum + n >= len )
         return sum;
     tmh_copy_to_client_buf_offset(buf,off+sum,info,n+1);
@@ -2079,14 +2319,26 @@ EXPORT void *tmem_relinquish_pages(unsigned int order, unsigned int memflags)
 /* called at hypervisor startup */
 EXPORT void init_tmem(void)
 {
+    int i;
+
     if ( !tmh_enabled() )
         return;
 
     radix_tree_init();
+    for_each_possible_cpu ( i )
+    {
+        spin_lock_init(&per_cpu(eph_stage, i).lock);
+        INIT_LIST_HEAD(&per_cpu(eph_stage, i).list);
+    }
+    for ( i = 0; i < PCD_HASH_BUCKETS; i++ )
+    {
+        spin_lock_init(&pcd_hash_lock[i]);
+        INIT_LIST_HEAD(&pcd_hash_table[i]);
+    }
     if ( tmh_init() )
     {
-        printk("tmem: initialized comp=%d global-lock=%d\n",
-            tmh_compression_enabled(), tmh_lock_all);
+        printk("tmem: initialized comp=%d dedup=%d global-lock=%d\n",
+            tmh_compression_enabled(), tmh_dedup_enabled(), tmh_lock_all);
         tmem_initialized = 1;
     }
     else
@@ -20,6 +20,9 @@ boolean_param("tmem", opt_tmem);
 EXPORT int opt_tmem_compress = 0;
 boolean_param("tmem_compress", opt_tmem_compress);
 
+EXPORT int opt_tmem_dedup = 0;
+boolean_param("tmem_dedup", opt_tmem_dedup);
+
 EXPORT int opt_tmem_lock = 0;
 integer_param("tmem_lock", opt_tmem_lock);
 
@@ -182,6 +185,60 @@ EXPORT int tmh_decompress_to_client(tmem_cli_mfn_t cmfn, void *tmem_va, size_t s
     return 1;
 }
 
+/*
+ * Hash used to find identical pages for deduplication. Four independent
+ * multiply/xor lanes over whole words keep the loop free of dependencies
+ * so that it pipelines (or vectorises) well; any tail bytes are folded in
+ * at the end.
+ */
+#define TMH_HASH_MULT 0x9E3779B97F4A7C15ULL
+EXPORT uint32_t tmh_hash_data(const void *data, size_t len)
+{
+    const uint64_t *p = data;
+    const unsigned char *tail;
+    uint64_t h0 = len, h1 = ~(uint64_t)len, h2 = TMH_HASH_MULT, h3 = 0;
+    size_t i, n = len / sizeof(uint64_t);
+
+    for ( i = 0; i + 4 <= n; i += 4 )
+    {
+        h0 = (h0 ^ p[i]) * TMH_HASH_MULT;
+        h1 = (h1 ^ p[i+1]) * TMH_HASH_MULT;
+        h2 = (h2 ^ p[i+2]) * TMH_HASH_MULT;
+        h3 = (h3 ^ p[i+3]) * TMH_HASH_MULT;
+    }
+    for ( ; i < n; i++ )
+        h0 = (h0 ^ p[i]) * TMH_HASH_MULT;
+    tail = (const unsigned char *)&p[n];
+    for ( i = 0; i < len % sizeof(uint64_t); i++ )
+        h1 = (h1 ^ tail[i]) * TMH_HASH_MULT;
+
+    h0 ^= (h1 << 17) | (h1 >> 47);
+    h0 ^= (h2 << 31) | (h2 >> 33);
+    h0 ^= (h3 << 47) | (h3 >> 17);
+    h0 *= TMH_HASH_MULT;
+    return (uint32_t)(h0 >> 32) ^ (uint32_t)h0;
+}
+
+EXPORT uint32_t tmh_page_hash(pfp_t *pfp)
+{
+    void *va = map_domain_page(page_to_mfn(pfp));
+    uint32_t hash = tmh_hash_data(va, PAGE_SIZE);
+
+    unmap_domain_page(va);
+    return hash;
+}
+
+EXPORT int tmh_page_cmp(pfp_t *pfp1, pfp_t *pfp2)
+{
+    void *va1 = map_domain_page(page_to_mfn(pfp1));
+    void *va2 = map_domain_page(page_to_mfn(pfp2));
+    int ret = memcmp(va1, va2, PAGE_SIZE);
+
+    unmap_domain_page(va2);
+    unmap_domain_page(va1);
+    return ret;
+}
+
 /******************  XEN-SPECIFIC MEMORY ALLOCATION ********************/
 
 EXPORT struct xmem_pool *tmh_mempool = 0;
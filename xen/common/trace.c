@@ -29,6 +29,7 @@
 #include <xen/init.h>
 #include <xen/mm.h>
 #include <xen/percpu.h>
+#include <xen/guest_access.h>
 #include <asm/atomic.h>
 #include <public/sysctl.h>
 
@@ -45,19 +46,33 @@ CHECK_t_buf;
 static unsigned int opt_tbuf_size = 0;
 integer_param("tbuf_size", opt_tbuf_size);
 
+/* opt_tbuf_tsc_delta: record 32-bit TSC deltas rather than full TSCs */
+static int opt_tbuf_tsc_delta = 0;
+boolean_param("tbuf_tsc_delta", opt_tbuf_tsc_delta);
+
 /* Pointers to the meta-data objects for all system trace buffers */
 static DEFINE_PER_CPU_READ_MOSTLY(struct t_buf *, t_bufs);
 static DEFINE_PER_CPU_READ_MOSTLY(unsigned char *, t_data);
 static int data_size;
 
-/* High water mark for trace buffers; */
+/* High water mark for trace buffers, in percent of the buffer size */
+static unsigned int opt_tbuf_highwater = 50;
+integer_param("tbuf_highwater", opt_tbuf_highwater);
+
+/* Per-CPU high water mark for trace buffers; */
 /* Send virtual interrupt when buffer level reaches this point */
-static int t_buf_highwater;
+static DEFINE_PER_CPU(int, t_buf_highwater);
 
 /* Number of records lost due to per-CPU trace buffer being full. */
 static DEFINE_PER_CPU(unsigned long, lost_records);
 static DEFINE_PER_CPU(unsigned long, lost_records_first_tsc);
 
+/* Timestamp layout of records (XEN_SYSCTL_TBUF_FORMAT_*). */
+static unsigned int tb_format = XEN_SYSCTL_TBUF_FORMAT_tsc64;
+
+/* TSC that the next delta32 timestamp on this CPU is relative to. */
+static DEFINE_PER_CPU(u64, last_tsc);
+
 /* a flag recording whether initialization has been done */
 /* or more properly, if the tbuf subsystem is enabled right now */
 int tb_init_done __read_mostly;
@@ -88,6 +103,9 @@ static int alloc_trace_bufs(void)
     if ( opt_tbuf_size == 0 )
         return -EINVAL;
 
+    if ( opt_tbuf_tsc_delta )
+        tb_format = XEN_SYSCTL_TBUF_FORMAT_delta32;
+
     nr_pages = num_online_cpus() * opt_tbuf_size;
     order    = get_order_from_pages(nr_pages);
     data_size  = (opt_tbuf_size * PAGE_SIZE - sizeof(struct t_buf));
@@ -110,9 +128,13 @@ static int alloc_trace_bufs(void)
             &rawbuf[i*opt_tbuf_size*PAGE_SIZE];
         buf->cons = buf->prod = 0;
         per_cpu(t_data, i) = (unsigned char *)(buf + 1);
+        per_cpu(last_tsc, i) = 0;
     }
 
-    t_buf_highwater = data_size >> 1; /* 50% high water */
+    if ( (opt_tbuf_highwater == 0) || (opt_tbuf_highwater > 100) )
+        opt_tbuf_highwater = 50;
+    for_each_online_cpu ( i )
+        per_cpu(t_buf_highwater, i) = data_size / 100 * opt_tbuf_highwater;
 
     return 0;
 }
@@ -212,6 +234,7 @@ int tb_control(xen_sysctl_tbuf_op_t *tbc)
         tbc->evt_mask   = tb_event_mask;
         tbc->buffer_mfn = opt_tbuf_size ? virt_to_mfn(per_cpu(t_bufs, 0)) : 0;
         tbc->size       = opt_tbuf_size * PAGE_SIZE;
+        tbc->format     = tb_format;
         break;
     case XEN_SYSCTL_TBUFOP_set_cpu_mask:
         xenctl_cpumap_to_cpumask(&tb_cpu_mask, &tbc->cpu_mask);
@@ -222,6 +245,41 @@ int tb_control(xen_sysctl_tbuf_op_t *tbc)
     case XEN_SYSCTL_TBUFOP_set_size:
         rc = !tb_init_done ? tb_set_size(tbc->size) : -EINVAL;
         break;
+    case XEN_SYSCTL_TBUFOP_set_format:
+        /*
+         * Like the size, the record format can only be chosen before the
+         * buffers are allocated: both producer and consumer size records
+         * from it.
+         */
+        if ( opt_tbuf_size != 0 )
+            rc = (tbc->format == tb_format) ? 0 : -EBUSY;
+        else if ( tbc->format == XEN_SYSCTL_TBUF_FORMAT_tsc64 )
+            opt_tbuf_tsc_delta = 0;
+        else if ( tbc->format == XEN_SYSCTL_TBUF_FORMAT_delta32 )
+            opt_tbuf_tsc_delta = 1;
+        else
+            rc = -EINVAL;
+        break;
+    case XEN_SYSCTL_TBUFOP_set_highwater:
+    {
+        cpumask_t mask = cpu_online_map;
+        int cpu;
+
+        if ( (opt_tbuf_size == 0) || (tbc->highwater == 0) ||
+             (tbc->highwater > 100) )
+        {
+            rc = -EINVAL;
+            break;
+        }
+        if ( !guest_handle_is_null(tbc->cpu_mask.bitmap) )
+        {
+            xenctl_cpumap_to_cpumask(&mask, &tbc->cpu_mask);
+            cpus_and(mask, mask, cpu_online_map);
+        }
+        for_each_cpu_mask ( cpu, mask )
+            per_cpu(t_buf_highwater, cpu) = data_size / 100 * tbc->highwater;
+        break;
+    }
     case XEN_SYSCTL_TBUFOP_enable:
         /* Enable trace buffers. Check buffers are already allocated. */
         if ( opt_tbuf_size == 0 ) 
@@ -246,12 +304,17 @@ int tb_control(xen_sysctl_tbuf_op_t *tbc)
     return rc;
 }
 
+static inline int calc_tsc_size(void)
+{
+    return (tb_format == XEN_SYSCTL_TBUF_FORMAT_delta32) ? 4 : 8;
+}
+
 static inline int calc_rec_size(int cycles, int extra) 
 {
     int rec_size;
     rec_size = 4;
     if ( cycles )
-        rec_size += 8;
+        rec_size += calc_tsc_size();
     rec_size += extra;
     return rec_size;
 }
@@ -303,7 +366,8 @@ static inline int __insert_record(struct t_buf *buf,
                                   int extra,
                                   int cycles,
                                   int rec_size,
-                                  unsigned char *extra_data)
+                                  unsigned char *extra_data,
+                                  u64 tsc)
 {
     struct t_rec *rec;
     unsigned char *dst;
@@ -333,10 +397,20 @@ static inline int __insert_record(struct t_buf *buf,
     dst = (unsigned char *)rec->u.nocycles.extra_u32;
     if ( (rec->cycles_included = cycles) != 0 )
     {
-        u64 tsc = (u64)get_cycles();
-        rec->u.cycles.cycles_lo = (uint32_t)tsc;
-        rec->u.cycles.cycles_hi = (uint32_t)(tsc >> 32);
-        dst = (unsigned char *)rec->u.cycles.extra_u32;
+        if ( tb_format == XEN_SYSCTL_TBUF_FORMAT_delta32 )
+        {
+            /* __trace_var() emitted a TSC base if the delta doesn't fit. */
+            ASSERT((tsc - this_cpu(last_tsc)) <= ~0U);
+            rec->u.cycles.cycles_lo = (uint32_t)(tsc - this_cpu(last_tsc));
+            this_cpu(last_tsc) = tsc;
+            dst = (unsigned char *)&rec->u.cycles.cycles_hi;
+        }
+        else
+        {
+            rec->u.cycles.cycles_lo = (uint32_t)tsc;
+            rec->u.cycles.cycles_hi = (uint32_t)(tsc >> 32);
+            dst = (unsigned char *)rec->u.cycles.extra_u32;
+        }
     } 
 
     if ( extra_data && extra )
@@ -354,7 +428,7 @@ static inline int __insert_record(struct t_buf *buf,
     return rec_size;
 }
 
-static inline int insert_wrap_record(struct t_buf *buf, int size)
+static inline int insert_wrap_record(struct t_buf *buf, int size, u64 tsc)
 {
     int space_left = calc_bytes_to_wrap(buf);
     unsigned long extra_space = space_left - sizeof(u32);
@@ -366,7 +440,7 @@ static inline int insert_wrap_record(struct t_buf *buf, int size)
     if ( (extra_space/sizeof(u32)) > TRACE_EXTRA_MAX )
     {
         cycles = 1;
-        extra_space -= sizeof(u64);
+        extra_space -= calc_tsc_size();
         ASSERT((extra_space/sizeof(u32)) <= TRACE_EXTRA_MAX);
     }
 
@@ -375,12 +449,14 @@ static inline int insert_wrap_record(struct t_buf *buf, int size)
                     extra_space,
                     cycles,
                     space_left,
-                    NULL);
+                    NULL,
+                    tsc);
 }
 
-#define LOST_REC_SIZE (4 + 8 + 16) /* header + tsc + sizeof(struct ed) */
+/* header + tsc + sizeof(struct ed) */
+#define LOST_REC_SIZE calc_rec_size(1, 16)
 
-static inline int insert_lost_records(struct t_buf *buf)
+static inline int insert_lost_records(struct t_buf *buf, u64 tsc)
 {
     struct {
         u32 lost_records;
@@ -400,7 +476,25 @@ static inline int insert_lost_records(struct t_buf *buf)
                            sizeof(ed),
                            1 /* cycles */,
                            LOST_REC_SIZE,
-                           (unsigned char *)&ed);
+                           (unsigned char *)&ed,
+                           tsc);
+}
+
+#define TSC_BASE_REC_SIZE (4 + 8) /* header + full tsc as extra data */
+
+static inline int insert_tsc_base_record(struct t_buf *buf, u64 tsc)
+{
+    uint32_t ed[2] = { (uint32_t)tsc, (uint32_t)(tsc >> 32) };
+
+    this_cpu(last_tsc) = tsc;
+
+    return __insert_record(buf,
+                           TRC_TRACE_TSC_BASE,
+                           sizeof(ed),
+                           0 /* cycles */,
+                           TSC_BASE_REC_SIZE,
+                           (unsigned char *)ed,
+                           tsc);
 }
 
 /*
@@ -429,6 +523,8 @@ void __trace_var(u32 event, int cycles, int extra, unsigned char *extra_data)
     int rec_size, total_size;
     int extra_word;
     int started_below_highwater;
+    int need_tsc_base = 0;
+    u64 tsc = 0;
 
     if( !tb_init_done )
         return;
@@ -466,10 +562,25 @@ void __trace_var(u32 event, int cycles, int extra, unsigned char *extra_data)
 
     local_irq_save(flags);
 
-    started_below_highwater = (calc_unconsumed_bytes(buf) < t_buf_highwater);
+    started_below_highwater =
+        (calc_unconsumed_bytes(buf) < this_cpu(t_buf_highwater));
 
     /* Calculate the record size */
     rec_size = calc_rec_size(cycles, extra);
+
+    if ( cycles || this_cpu(lost_records) )
+    {
+        tsc = (u64)get_cycles();
+
+        /*
+         * Deltas must be relative to something the consumer has seen: start
+         * from a full TSC whenever the buffer has been drained, or when the
+         * delta would overflow.
+         */
+        if ( tb_format == XEN_SYSCTL_TBUF_FORMAT_delta32 )
+            need_tsc_base = (buf->prod == buf->cons) ||
+                            ((tsc - this_cpu(last_tsc)) > ~0U);
+    }
  
     /* How many bytes are available in the buffer? */
     bytes_to_tail = calc_bytes_avail(buf);
@@ -483,7 +594,22 @@ void __trace_var(u32 event, int cycles, int extra, unsigned char *extra_data)
      */
     total_size = 0;
 
-    /* First, check to see if we need to include a lost_record.
+    /* A TSC base record, if needed, precedes everything else. */
+    if ( need_tsc_base )
+    {
+        if ( TSC_BASE_REC_SIZE > bytes_to_wrap )
+        {
+            total_size += bytes_to_wrap;
+            bytes_to_wrap = data_size;
+        }
+        total_size += TSC_BASE_REC_SIZE;
+        bytes_to_wrap -= TSC_BASE_REC_SIZE;
+
+        if ( bytes_to_wrap == 0 )
+            bytes_to_wrap = data_size;
+    }
+
+    /* Next, check to see if we need to include a lost_record.
      */
     if ( this_cpu(lost_records) )
     {
@@ -520,14 +646,28 @@ void __trace_var(u32 event, int cycles, int extra, unsigned char *extra_data)
      */
     bytes_to_wrap = calc_bytes_to_wrap(buf);
 
+    if ( need_tsc_base )
+    {
+        if ( TSC_BASE_REC_SIZE > bytes_to_wrap )
+        {
+            insert_wrap_record(buf, TSC_BASE_REC_SIZE, tsc);
+            bytes_to_wrap = data_size;
+        }
+        insert_tsc_base_record(buf, tsc);
+        bytes_to_wrap -= TSC_BASE_REC_SIZE;
+
+        if ( bytes_to_wrap == 0 )
+            bytes_to_wrap = data_size;
+    }
+
     if ( this_cpu(lost_records) )
     {
         if ( LOST_REC_SIZE > bytes_to_wrap )
         {
-            insert_wrap_record(buf, LOST_REC_SIZE);
+            insert_wrap_record(buf, LOST_REC_SIZE, tsc);
             bytes_to_wrap = data_size;
         } 
-        insert_lost_records(buf);
+        insert_lost_records(buf, tsc);
         bytes_to_wrap -= LOST_REC_SIZE;
 
         /* LOST_REC might line up perfectly with the buffer wrap */
@@ -536,16 +676,16 @@ void __trace_var(u32 event, int cycles, int extra, unsigned char *extra_data)
     }
 
     if ( rec_size > bytes_to_wrap )
-        insert_wrap_record(buf, rec_size);
+        insert_wrap_record(buf, rec_size, tsc);
 
     /* Write the original record */
-    __insert_record(buf, event, extra, cycles, rec_size, extra_data);
+    __insert_record(buf, event, extra, cycles, rec_size, extra_data, tsc);
 
     local_irq_restore(flags);
 
     /* Notify trace buffer consumer that we've crossed the high water mark. */
     if ( started_below_highwater &&
-         (calc_unconsumed_bytes(buf) >= t_buf_highwater) )
+         (calc_unconsumed_bytes(buf) >= this_cpu(t_buf_highwater)) )
         tasklet_schedule(&trace_notify_dom0_tasklet);
 }
 
@@ -28,6 +28,17 @@ typedef struct {
 #define _raw_spin_is_locked(x)	((x)->lock != 0)
 #define _raw_spin_unlock(x)	do { barrier(); (x)->lock = 0; } while (0)
 #define _raw_spin_trylock(x)	(cmpxchg_acq(&(x)->lock, 0, 1) == 0)
+#define _raw_spin_barrier(x)						\
+do {									\
+	while (_raw_spin_is_locked(x))					\
+		cpu_relax();						\
+} while (0)
+#define _raw_spin_lock(x)						\
+do {									\
+	while (!_raw_spin_trylock(x))					\
+		while (_raw_spin_is_locked(x))				\
+			cpu_relax();					\
+} while (0)
 
 typedef struct {
 	volatile unsigned int read_counter	: 31;
@@ -28,4 +28,8 @@ static inline void do_multicall_call(multicall_entry_t *call)
 		call->result = -ENOSYS;
 }
 
+static inline void arch_multicall_end_run(void)
+{
+}
+
 #endif /* __ASM_IA64_MULTICALL_H__ */
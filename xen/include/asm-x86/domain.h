@@ -92,6 +92,7 @@ struct shadow_domain {
 
     /* Shadow hashtable */
     struct page_info **hash_table;
+    unsigned int hash_buckets; /* Number of buckets in hash_table */
     int hash_walking;  /* Some function is walking the hash table */
 
     /* Fast MMIO path heuristic */
@@ -405,6 +406,20 @@ struct arch_vcpu
     /* Guest-specified relocation of vcpu_info. */
     unsigned long vcpu_info_mfn;
 
+    /*
+     * XSAVE area used in place of guest_context.fpu_ctxt when XSAVE is
+     * enabled. xcr0 is the guest's view of XCR0; xcr0_accum is every
+     * component it has ever enabled, and is what gets saved and restored.
+     */
+    struct xsave_struct *xsave_area;
+    uint64_t xcr0;
+    uint64_t xcr0_accum;
+
+    /* Consecutive time slices in which the FPU was used (see i387.c). */
+    uint8_t fpu_used;
+    bool_t fpu_eager;
+    uint16_t fpu_eager_switches;
+
 #ifdef CONFIG_X86_32
     /* map_domain_page() mapping cache. */
     struct mapcache_vcpu mapcache;
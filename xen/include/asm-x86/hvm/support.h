@@ -129,6 +129,9 @@ void hvm_triple_fault(void);
 extern int opt_softtsc;
 void hvm_rdtsc_intercept(struct cpu_user_regs *regs);
 
+/* Emulate XSETBV; returns 0 on success, or -1 after injecting #GP. */
+int hvm_handle_xsetbv(u32 index, u64 new_bv);
+
 /* These functions all return X86EMUL return codes. */
 int hvm_set_efer(uint64_t value);
 int hvm_set_cr0(unsigned long value);
@@ -76,7 +76,8 @@ enum GenericIntercept2bits
     GENERAL2_INTERCEPT_WBINVD  = 1 << 9,
     GENERAL2_INTERCEPT_MONITOR = 1 << 10,
     GENERAL2_INTERCEPT_MWAIT   = 1 << 11,
-    GENERAL2_INTERCEPT_MWAIT_CONDITIONAL = 1 << 12
+    GENERAL2_INTERCEPT_MWAIT_CONDITIONAL = 1 << 12,
+    GENERAL2_INTERCEPT_XSETBV  = 1 << 13
 };
 
 
@@ -299,6 +300,7 @@ enum VMEXIT_EXITCODE
     VMEXIT_MONITOR          = 138,
     VMEXIT_MWAIT            = 139,
     VMEXIT_MWAIT_CONDITIONAL= 140,
+    VMEXIT_XSETBV           = 141,
     VMEXIT_NPF              = 1024, /* nested paging fault */
     VMEXIT_INVALID          =  -1
 };
@@ -25,6 +25,7 @@
 #include <asm/hvm/vmx/vmcs.h>
 #include <asm/hvm/svm/vmcb.h>
 #include <asm/mtrr.h>
+#include <asm/x86_emulate.h>
 
 enum hvm_io_state {
     HVMIO_none = 0,
@@ -34,6 +35,18 @@ enum hvm_io_state {
     HVMIO_completed
 };
 
+/*
+ * Recently decoded emulation sites. An entry is only reused if the
+ * instruction bytes fetched at the site still match.
+ */
+#define HVM_DECODE_CACHE_SIZE 4
+struct hvm_decode_cache_entry {
+    unsigned long             cr3;
+    unsigned long             eip;
+    uint8_t                   insn[16];
+    struct x86_emulate_decode decode;
+};
+
 struct hvm_vcpu {
     /* Guest control-register and EFER values, just as the guest sees them. */
     unsigned long       guest_cr[5];
@@ -99,6 +112,10 @@ struct hvm_vcpu {
     /* We may write up to m128 as a number of device-model transactions. */
     paddr_t mmio_large_write_pa;
     unsigned int mmio_large_write_bytes;
+
+    /* Decode cache for hvm_emulate_one(), keyed on (CR3, RIP, insn bytes). */
+    struct hvm_decode_cache_entry decode_cache[HVM_DECODE_CACHE_SIZE];
+    unsigned int decode_cache_next;
 };
 
 #endif /* __ASM_X86_HVM_VCPU_H__ */
@@ -59,6 +59,11 @@ struct vlapic {
     s_time_t                 timer_last_update;
     struct page_info         *regs_page;
     struct tasklet           init_tasklet;
+    /* Set by senders of new IRR bits; cleared when the vcpu scans its IRR. */
+    unsigned long            irr_dirty;
+    /* Highest set IRR/ISR vectors, as last seen by the vcpu itself. */
+    int                      irr_highest;
+    int                      isr_highest;
 };
 
 static inline uint32_t vlapic_get_reg(struct vlapic *vlapic, uint32_t reg)
@@ -80,6 +85,7 @@ static inline int is_vlapic_lvtpc_enabled(struct vlapic *vlapic)
 
 int vlapic_set_irq(struct vlapic *vlapic, uint8_t vec, uint8_t trig);
 
+void vlapic_sync_irr(struct vcpu *v);
 int vlapic_has_pending_irq(struct vcpu *v);
 int vlapic_ack_pending_irq(struct vcpu *v, int vector);
 
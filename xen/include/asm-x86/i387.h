@@ -14,9 +14,70 @@
 #include <xen/sched.h>
 #include <asm/processor.h>
 
+/*
+ * XSAVE state components managed by Xen. Only x87, SSE and AVX (YMM) state
+ * are enabled in XCR0, so the standard-format save area has a fixed layout.
+ */
+#define XSTATE_CPUID        0xd
+#define XSTATE_FP           (1ULL << 0)
+#define XSTATE_SSE          (1ULL << 1)
+#define XSTATE_YMM          (1ULL << 2)
+#define XSTATE_FP_SSE       (XSTATE_FP | XSTATE_SSE)
+#define XCNTXT_MASK         (XSTATE_FP | XSTATE_SSE | XSTATE_YMM)
+#define XSTATE_YMM_OFFSET   (512 + 64)
+#define XSTATE_YMM_SIZE     256
+
+struct xsave_struct
+{
+    struct { char x[512]; } fpu_sse;         /* FPU/MMX, SSE */
+
+    struct {
+        u64 xstate_bv;
+        u64 reserved[7];
+    } xsave_hdr;                             /* The 64-byte header */
+
+    struct { char x[XSTATE_YMM_SIZE]; } ymm; /* YMM */
+} __attribute__ ((packed, aligned (64)));
+
+/* Components enabled in XCR0 by Xen; 0 if XSAVE is not in use. */
+extern u64 xfeature_mask;
+/* Size of the save area for all components in xfeature_mask. */
+extern unsigned int xsave_cntxt_size;
+
+#define cpu_has_xsave_enabled (xfeature_mask != 0)
+
+/* Current value of XCR0 on this cpu. */
+DECLARE_PER_CPU(u64, xcr0);
+
+static inline void set_xcr0(u64 xfeatures)
+{
+    asm volatile ( ".byte 0x0f,0x01,0xd1" /* xsetbv */
+                   : : "a" ((u32)xfeatures), "d" ((u32)(xfeatures >> 32)),
+                       "c" (0) );
+}
+
+static inline u64 get_xcr0(void)
+{
+    u32 lo, hi;
+
+    asm volatile ( ".byte 0x0f,0x01,0xd0" /* xgetbv */
+                   : "=a" (lo), "=d" (hi) : "c" (0) );
+    return lo | ((u64)hi << 32);
+}
+
+extern void xsave_init(void);
+extern int xsave_alloc_save_area(struct vcpu *v);
+extern void xsave_free_save_area(struct vcpu *v);
+extern void xsave_to_fpu_ctxt(struct vcpu *v);
+extern void fpu_ctxt_to_xsave(struct vcpu *v);
+extern int xsetbv_guest(struct vcpu *v, u32 index, u64 new_bv);
+
 extern void init_fpu(void);
 extern void save_init_fpu(struct vcpu *v);
 extern void restore_fpu(struct vcpu *v);
+extern void fpu_ctxt_switch_from(struct vcpu *v);
+extern void fpu_ctxt_switch_to(struct vcpu *v);
+extern int fpu_restore_eager(struct vcpu *v);
 
 #define unlazy_fpu(v) do {                      \
     if ( (v)->fpu_dirtied )                     \
@@ -97,4 +97,7 @@
 
 #endif
 
+/* Issue any TLB flushes deferred over a run of identical multicall ops. */
+extern void arch_multicall_end_run(void);
+
 #endif /* __ASM_X86_MULTICALL_H__ */
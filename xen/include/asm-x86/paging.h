@@ -139,6 +139,10 @@ int paging_alloc_log_dirty_bitmap(struct domain *d);
 /* free log dirty bitmap resource */
 void paging_free_log_dirty_bitmap(struct domain *d);
 
+/* get the dirty pfns as a list of ranges (PEEK_RANGES / CLEAN_RANGES) */
+int paging_log_dirty_ranges_op(struct domain *d,
+                               struct xen_domctl_shadow_op *sc);
+
 /* get the dirty bitmap for a specific range of pfns */
 int paging_log_dirty_range(struct domain *d,
                            unsigned long begin_pfn,
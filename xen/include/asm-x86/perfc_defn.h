@@ -9,22 +9,39 @@ PERFCOUNTER_ARRAY(exceptions,           "exceptions", 32)
 PERFCOUNTER_ARRAY(vmexits,              "vmexits", VMX_PERF_EXIT_REASON_SIZE)
 PERFCOUNTER_ARRAY(cause_vector,         "cause vector", VMX_PERF_VECTOR_SIZE)
 
-#define VMEXIT_NPF_PERFC 141
-#define SVM_PERF_EXIT_REASON_SIZE (1+141)
+#define VMEXIT_NPF_PERFC 142
+#define SVM_PERF_EXIT_REASON_SIZE (1+142)
 PERFCOUNTER_ARRAY(svmexits,             "SVMexits", SVM_PERF_EXIT_REASON_SIZE)
 
 PERFCOUNTER(seg_fixups,             "segmentation fixups")
 
+PERFCOUNTER(hvm_decode_cache_hit,   "hvm emulation decode cache hits")
+PERFCOUNTER(hvm_decode_cache_miss,  "hvm emulation decode cache misses")
+
 PERFCOUNTER(apic_timer,             "apic timer interrupts")
+PERFCOUNTER(vlapic_notify_coalesced, "vlapic notifications coalesced")
+PERFCOUNTER(vlapic_irr_scan_avoided, "vlapic IRR scans avoided")
+PERFCOUNTER(vpt_timer_fired,        "vpt timer expiries")
+PERFCOUNTER(vpt_timer_lazy_stop,    "vpt timers left unarmed (tick pending)")
 
 PERFCOUNTER(domain_page_tlb_flush,  "domain page tlb flushes")
 
+PERFCOUNTER(fpu_save,               "fpu state saves")
+PERFCOUNTER(fpu_restore,            "fpu state restores")
+PERFCOUNTER(fpu_eager_restore,      "fpu state restored eagerly")
+
 PERFCOUNTER(calls_to_mmuext_op,         "calls to mmuext_op")
 PERFCOUNTER(num_mmuext_ops,             "mmuext ops")
 PERFCOUNTER(calls_to_mmu_update,        "calls to mmu_update")
 PERFCOUNTER(num_page_updates,           "page updates")
 PERFCOUNTER(writable_mmu_updates,       "mmu_updates of writable pages")
+PERFCOUNTER(mmu_update_batched,         "mmu_updates reusing previous frame")
+/* Indexed by PGT_* type: 1-4 = L1-L4, 5 = GDT/LDT. */
+PERFCOUNTER_ARRAY(pt_validate,          "pagetables validated", 8)
+PERFCOUNTER_ARRAY(pt_devalidate,        "pagetables devalidated", 8)
+PERFCOUNTER(pt_validate_preempted,      "L1 validations preempted")
 PERFCOUNTER(calls_to_update_va,         "calls to update_va_map")
+PERFCOUNTER(update_va_flush_merged,     "update_va_map flushes merged")
 PERFCOUNTER(page_faults,            "page faults")
 PERFCOUNTER(copy_user_faults,       "copy_user faults")
 
@@ -75,6 +92,7 @@ PERFCOUNTER(shadow_hash_lookup_miss, "shadow hash misses")
 PERFCOUNTER(shadow_get_shadow_status, "calls to get_shadow_status")
 PERFCOUNTER(shadow_hash_inserts,   "calls to shadow_hash_insert")
 PERFCOUNTER(shadow_hash_deletes,   "calls to shadow_hash_delete")
+PERFCOUNTER(shadow_hash_resizes,   "shadow hash table resizes")
 PERFCOUNTER(shadow_writeable,      "shadow removes write access")
 PERFCOUNTER(shadow_writeable_h_1,  "shadow writeable: 32b w2k3")
 PERFCOUNTER(shadow_writeable_h_2,  "shadow writeable: 32pae w2k3")
@@ -5,30 +5,75 @@
 #include <xen/lib.h>
 #include <asm/atomic.h>
 
-typedef struct {
-    volatile s16 lock;
+/*
+ * Ticket spinlock.  A locker takes the next ticket from @tail and waits
+ * until @head reaches it; unlock advances @head.  CPUs therefore acquire a
+ * contended lock in the order they arrived, rather than whichever wins the
+ * cache line race, so remote sockets cannot be starved.
+ */
+typedef union {
+    volatile u32 head_tail;
+    struct {
+        volatile u16 head;
+        volatile u16 tail;
+    } t;
 } raw_spinlock_t;
 
-#define _RAW_SPIN_LOCK_UNLOCKED /*(raw_spinlock_t)*/ { 1 }
+#define _RAW_SPIN_LOCK_UNLOCKED /*(raw_spinlock_t)*/ { 0 }
 
-#define _raw_spin_is_locked(x) ((x)->lock <= 0)
+#define _RAW_SPIN_TICKET_HEAD(v) ((u16)(v))
+#define _RAW_SPIN_TICKET_TAIL(v) ((u16)((v) >> 16))
+
+static always_inline int _raw_spin_is_locked(raw_spinlock_t *lock)
+{
+    u32 v = lock->head_tail;
+    return _RAW_SPIN_TICKET_HEAD(v) != _RAW_SPIN_TICKET_TAIL(v);
+}
+
+static always_inline void _raw_spin_lock(raw_spinlock_t *lock)
+{
+    u16 ticket;
+
+    asm volatile (
+        "lock; xaddw %w0,%1"
+        : "=r" (ticket), "+m" (lock->t.tail)
+        : "0" (1) : "memory" );
+
+    while ( unlikely(ticket != lock->t.head) )
+        asm volatile ( "rep; nop" : : : "memory" );
+}
 
 static always_inline void _raw_spin_unlock(raw_spinlock_t *lock)
 {
     ASSERT(_raw_spin_is_locked(lock));
+    /* Only the holder writes @head, so no lock prefix is needed. */
     asm volatile (
-        "movw $1,%0" 
-        : "=m" (lock->lock) : : "memory" );
+        "incw %0"
+        : "+m" (lock->t.head) : : "memory" );
 }
 
 static always_inline int _raw_spin_trylock(raw_spinlock_t *lock)
 {
-    s16 oldval;
-    asm volatile (
-        "xchgw %w0,%1"
-        :"=r" (oldval), "=m" (lock->lock)
-        :"0" (0) : "memory" );
-    return (oldval > 0);
+    u32 old = lock->head_tail;
+
+    if ( _RAW_SPIN_TICKET_HEAD(old) != _RAW_SPIN_TICKET_TAIL(old) )
+        return 0;
+
+    return cmpxchg(&lock->head_tail, old, old + (1u << 16)) == old;
+}
+
+/*
+ * Wait until every locker holding or queued for the lock at the time of the
+ * call has released it.  Waiting for the lock to be seen free instead could
+ * spin forever under steady contention, as @head may never catch up with
+ * @tail.
+ */
+static always_inline void _raw_spin_barrier(raw_spinlock_t *lock)
+{
+    u16 tail = lock->t.tail;
+
+    while ( (s16)(lock->t.head - tail) < 0 )
+        asm volatile ( "rep; nop" : : : "memory" );
 }
 
 typedef struct {
@@ -430,9 +430,31 @@ struct hvm_viridian_context {
 
 DECLARE_HVM_SAVE_TYPE(VIRIDIAN, 15, struct hvm_viridian_context);
 
+/*
+ * Extended processor state (XSAVE area), in the standard XSAVE layout.
+ * The legacy x87/SSE region duplicates fpu_regs in the CPU record and
+ * takes precedence over it.
+ */
+
+struct hvm_hw_cpu_xsave {
+    uint64_t xfeature_mask;     /* XCR0 components enabled by the host */
+    uint64_t xcr0;              /* Guest's XCR0 */
+    uint64_t xcr0_accum;        /* Components present in save_area */
+    struct {
+        uint8_t fpu_sse[512];
+        struct {
+            uint64_t xstate_bv;
+            uint64_t reserved[7];
+        } hdr;
+        uint8_t ymm[256];
+    } save_area;
+};
+
+DECLARE_HVM_SAVE_TYPE(CPU_XSAVE, 16, struct hvm_hw_cpu_xsave);
+
 /* 
  * Largest type-code in use
  */
-#define HVM_SAVE_CODE_MAX 15
+#define HVM_SAVE_CODE_MAX 16
 
 #endif /* __XEN_PUBLIC_HVM_SAVE_X86_H__ */
@@ -34,7 +34,7 @@
 
 #include "xen.h"
 
-#define XEN_DOMCTL_INTERFACE_VERSION 0x00000005
+#define XEN_DOMCTL_INTERFACE_VERSION 0x00000006
 
 struct xenctl_cpumap {
     XEN_GUEST_HANDLE_64(uint8) bitmap;
@@ -180,6 +180,15 @@ DEFINE_XEN_GUEST_HANDLE(xen_domctl_getpageframeinfo2_t);
 #define XEN_DOMCTL_SHADOW_OP_CLEAN       11
  /* Return the bitmap but do not modify internal copy. */
 #define XEN_DOMCTL_SHADOW_OP_PEEK        12
+ /*
+  * Return the dirty pfns in [begin_pfn, begin_pfn + pages) as a list of
+  * contiguous ranges, without modifying the internal copy. If the list
+  * fills up, the scan stops early and 'pages' is updated with the number
+  * of pfns actually examined; callers continue from there.
+  */
+#define XEN_DOMCTL_SHADOW_OP_PEEK_RANGES 13
+ /* As PEEK_RANGES, and clean the examined part of the internal copy. */
+#define XEN_DOMCTL_SHADOW_OP_CLEAN_RANGES 14
 
 /* Memory allocation accessors. */
 #define XEN_DOMCTL_SHADOW_OP_GET_ALLOCATION   30
@@ -221,6 +230,13 @@ struct xen_domctl_shadow_op_stats {
 typedef struct xen_domctl_shadow_op_stats xen_domctl_shadow_op_stats_t;
 DEFINE_XEN_GUEST_HANDLE(xen_domctl_shadow_op_stats_t);
 
+struct xen_domctl_shadow_op_range {
+    uint64_aligned_t first_pfn;
+    uint64_aligned_t nr_pfns;
+};
+typedef struct xen_domctl_shadow_op_range xen_domctl_shadow_op_range_t;
+DEFINE_XEN_GUEST_HANDLE(xen_domctl_shadow_op_range_t);
+
 struct xen_domctl_shadow_op {
     /* IN variables. */
     uint32_t       op;       /* XEN_DOMCTL_SHADOW_OP_* */
@@ -235,6 +251,11 @@ struct xen_domctl_shadow_op {
     XEN_GUEST_HANDLE_64(uint8) dirty_bitmap;
     uint64_aligned_t pages; /* Size of buffer. Updated with actual size. */
     struct xen_domctl_shadow_op_stats stats;
+
+    /* OP_PEEK_RANGES / OP_CLEAN_RANGES ('pages' is the length of the scan) */
+    uint64_aligned_t begin_pfn;
+    XEN_GUEST_HANDLE_64(xen_domctl_shadow_op_range_t) dirty_ranges;
+    uint32_t       nr_ranges; /* Size of array. Updated with entries used. */
 };
 typedef struct xen_domctl_shadow_op xen_domctl_shadow_op_t;
 DEFINE_XEN_GUEST_HANDLE(xen_domctl_shadow_op_t);
@@ -297,6 +318,7 @@ DEFINE_XEN_GUEST_HANDLE(xen_domctl_max_vcpus_t);
 /* Scheduler types. */
 #define XEN_SCHEDULER_SEDF     4
 #define XEN_SCHEDULER_CREDIT   5
+#define XEN_SCHEDULER_CREDIT2  6
 /* Set or get info? */
 #define XEN_DOMCTL_SCHEDOP_putinfo 0
 #define XEN_DOMCTL_SCHEDOP_getinfo 1
@@ -314,7 +336,12 @@ struct xen_domctl_scheduler_op {
         struct xen_domctl_sched_credit {
             uint16_t weight;
             uint16_t cap;
+            /* Co-schedule the domain's VCPUs: 0/1, or ~0 to leave as is. */
+            uint16_t cosched;
         } credit;
+        struct xen_domctl_sched_credit2 {
+            uint16_t weight;
+        } credit2;
     } u;
 };
 typedef struct xen_domctl_scheduler_op xen_domctl_scheduler_op_t;
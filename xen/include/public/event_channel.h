@@ -231,6 +231,29 @@ struct evtchn_reset {
 };
 typedef struct evtchn_reset evtchn_reset_t;
 
+/*
+ * EVTCHNOP_send_batch: Send an event on each of the <nr_ports> local ports
+ * in <ports>, as EVTCHNOP_send would.
+ * EVTCHNOP_unmask_batch: Unmask each of the <nr_ports> local ports in
+ * <ports>, as EVTCHNOP_unmask would.
+ * NOTES:
+ *  1. Notifications due to the same physical CPU are coalesced into one IPI.
+ *  2. <done> must be zero on entry.  On return it is the number of ports
+ *     processed; on error, the index of the port that failed.
+ */
+#define EVTCHNOP_send_batch      11
+#define EVTCHNOP_unmask_batch    12
+struct evtchn_port_batch {
+    /* IN parameters. */
+    uint32_t nr_ports;
+    /* IN/OUT parameters. */
+    uint32_t done;
+    /* IN parameters. */
+    XEN_GUEST_HANDLE(evtchn_port_t) ports;
+};
+typedef struct evtchn_port_batch evtchn_port_batch_t;
+DEFINE_XEN_GUEST_HANDLE(evtchn_port_batch_t);
+
 /*
  * Argument to event_channel_op_compat() hypercall. Superceded by new
  * event_channel_op() hypercall since 0x00030202.
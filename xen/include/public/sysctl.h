@@ -34,7 +34,7 @@
 #include "xen.h"
 #include "domctl.h"
 
-#define XEN_SYSCTL_INTERFACE_VERSION 0x00000006
+#define XEN_SYSCTL_INTERFACE_VERSION 0x00000007
 
 /*
  * Read console content from Xen buffer ring.
@@ -69,6 +69,8 @@ struct xen_sysctl_tbuf_op {
 #define XEN_SYSCTL_TBUFOP_set_size     3
 #define XEN_SYSCTL_TBUFOP_enable       4
 #define XEN_SYSCTL_TBUFOP_disable      5
+#define XEN_SYSCTL_TBUFOP_set_format   6
+#define XEN_SYSCTL_TBUFOP_set_highwater 7
     uint32_t cmd;
     /* IN/OUT variables */
     struct xenctl_cpumap cpu_mask;
@@ -76,6 +78,15 @@ struct xen_sysctl_tbuf_op {
     /* OUT variables */
     uint64_aligned_t buffer_mfn;
     uint32_t size;
+    /* IN (set_format) / OUT (get_info): timestamp layout of records. */
+#define XEN_SYSCTL_TBUF_FORMAT_tsc64   0 /* full 64-bit TSC per record */
+#define XEN_SYSCTL_TBUF_FORMAT_delta32 1 /* 32-bit delta, see TRC_TRACE_TSC_BASE */
+    uint32_t format;
+    /*
+     * IN (set_highwater): buffer fill level, in percent, at which VIRQ_TBUF
+     * is raised for each CPU in cpu_mask (all CPUs if its bitmap is NULL).
+     */
+    uint32_t highwater;
 };
 typedef struct xen_sysctl_tbuf_op xen_sysctl_tbuf_op_t;
 DEFINE_XEN_GUEST_HANDLE(xen_sysctl_tbuf_op_t);
@@ -454,6 +465,137 @@ struct xen_sysctl_page_offline_op {
 
 #define PG_OFFLINE_OWNER_SHIFT 16
 
+/*
+ * Get statistics for many domains and all of their vcpus in one call.
+ * The buffer is filled with a sequence of xen_sysctl_domstats records, each
+ * immediately followed by its nr_vcpus xen_sysctl_vcpustats records.
+ * Domains are returned in ascending order of domain id, starting from
+ * first_domain, for as long as a domain's records fit in the buffer.
+ */
+#define XEN_SYSCTL_getdomstats            15
+struct xen_sysctl_vcpustats {
+    uint32_t vcpu;
+#define XEN_VCPUSTATS_online   (1U<<0)
+#define XEN_VCPUSTATS_blocked  (1U<<1)
+#define XEN_VCPUSTATS_running  (1U<<2)
+#define XEN_VCPUSTATS_pending  (1U<<3) /* event channel upcall pending */
+    uint32_t flags;
+    uint32_t cpu;                       /* current or last processor */
+    uint32_t state;                     /* RUNSTATE_* */
+    uint64_aligned_t state_entry_time;
+    uint64_aligned_t time[4];           /* time spent in each RUNSTATE_* */
+};
+typedef struct xen_sysctl_vcpustats xen_sysctl_vcpustats_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_vcpustats_t);
+struct xen_sysctl_domstats {
+    struct xen_domctl_getdomaininfo info;
+    uint32_t nr_vcpus;                  /* vcpustats records that follow */
+    uint32_t pad;
+};
+typedef struct xen_sysctl_domstats xen_sysctl_domstats_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_domstats_t);
+struct xen_sysctl_getdomstats {
+    /* IN variables. */
+    domid_t               first_domain;
+    uint32_t              size;         /* buffer size in bytes */
+    XEN_GUEST_HANDLE_64(uint8) buffer;
+    /* OUT variables. */
+    uint32_t              num_domains;  /* domstats records written */
+    uint32_t              used;         /* bytes written */
+    domid_t               next_domain;  /* DOMID_FIRST_RESERVED if done */
+};
+typedef struct xen_sysctl_getdomstats xen_sysctl_getdomstats_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_getdomstats_t);
+
+/*
+ * Spinlock profiling (hypervisor built with lock_profile=y).
+ * A query fills at most max_elem records and returns in nr_elem the
+ * number of profiled locks, so a caller can size its buffer with a query
+ * that passes max_elem == 0.
+ */
+#define XEN_SYSCTL_lockprof_op            16
+/* Sub-operations: */
+#define XEN_SYSCTL_LOCKPROF_reset 1   /* Reset all profile data to zero. */
+#define XEN_SYSCTL_LOCKPROF_query 2   /* Get lock profile information. */
+/* Record type: */
+#define LOCKPROF_TYPE_GLOBAL      0   /* global lock, idx meaningless */
+#define LOCKPROF_TYPE_PERDOM      1   /* per-domain lock, idx is domid */
+#define LOCKPROF_TYPE_N           2   /* number of types */
+struct xen_sysctl_lockprof_data {
+    char     name[40];                  /* lock name */
+    int32_t  type;                      /* LOCKPROF_TYPE_??? */
+    int32_t  idx;                       /* index (e.g. domain id) */
+    uint64_aligned_t lock_cnt;          /* # of successful acquisitions */
+    uint64_aligned_t block_cnt;         /* # of acquisitions that waited */
+    uint64_aligned_t lock_time;         /* nsecs lock held */
+    uint64_aligned_t block_time;        /* nsecs spent waiting for lock */
+};
+typedef struct xen_sysctl_lockprof_data xen_sysctl_lockprof_data_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_lockprof_data_t);
+struct xen_sysctl_lockprof_op {
+    /* IN variables. */
+    uint32_t       cmd;                 /* XEN_SYSCTL_LOCKPROF_??? */
+    uint32_t       max_elem;            /* size of output buffer */
+    /* OUT variables (query only). */
+    uint32_t       nr_elem;             /* number of profiled locks */
+    uint64_aligned_t time;              /* nsecs of profile measurement */
+    /* profile information (or NULL) */
+    XEN_GUEST_HANDLE_64(xen_sysctl_lockprof_data_t) data;
+};
+typedef struct xen_sysctl_lockprof_op xen_sysctl_lockprof_op_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_lockprof_op_t);
+
+/*
+ * Scheduler statistics, per physical CPU and per vCPU.
+ * Histogram bucket 0 counts zero values, bucket i (0 < i < last) values
+ * in [2^(i-1), 2^i), and the last bucket everything larger.  Latencies
+ * are from a vCPU waking up to it first running, in microseconds.
+ * A query fills at most max_pcpus and max_vcpus records and returns the
+ * number available in nr_pcpus and nr_vcpus, so a caller can size its
+ * buffers with a query that passes zero for both.
+ */
+#define XEN_SYSCTL_schedstats_op          17
+/* Sub-operations: */
+#define XEN_SYSCTL_SCHEDSTATS_reset 1 /* Reset all statistics to zero. */
+#define XEN_SYSCTL_SCHEDSTATS_query 2 /* Get statistics. */
+#define XEN_SCHEDSTATS_BUCKETS     16
+struct xen_sysctl_sched_pcpustats {
+    uint32_t cpu;
+    uint32_t pad;
+    uint64_aligned_t schedules;         /* runs through the scheduler */
+    uint64_aligned_t preemptions;       /* runnable vCPUs switched out */
+    uint64_aligned_t steal_attempts;    /* peer runqueues tried for work */
+    uint64_aligned_t steal_successes;   /* vCPUs taken from a peer */
+    uint32_t wake_latency[XEN_SCHEDSTATS_BUCKETS];
+    uint32_t runq_len[XEN_SCHEDSTATS_BUCKETS]; /* waiting, per schedule */
+};
+typedef struct xen_sysctl_sched_pcpustats xen_sysctl_sched_pcpustats_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_sched_pcpustats_t);
+struct xen_sysctl_sched_vcpustats {
+    uint32_t domid;
+    uint32_t vcpu;
+    uint64_aligned_t wakeups;
+    uint64_aligned_t preemptions;
+    uint32_t wake_latency[XEN_SCHEDSTATS_BUCKETS];
+};
+typedef struct xen_sysctl_sched_vcpustats xen_sysctl_sched_vcpustats_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_sched_vcpustats_t);
+struct xen_sysctl_schedstats_op {
+    /* IN variables. */
+    uint32_t       cmd;                 /* XEN_SYSCTL_SCHEDSTATS_??? */
+    uint32_t       max_pcpus;           /* size of pcpu buffer */
+    uint32_t       max_vcpus;           /* size of vcpu buffer */
+    /* OUT variables (query only). */
+    uint32_t       nr_pcpus;            /* number of online CPUs */
+    uint32_t       nr_vcpus;            /* number of vCPUs, all domains */
+    uint32_t       pad;
+    uint64_aligned_t time;              /* nsecs since last reset */
+    XEN_GUEST_HANDLE_64(xen_sysctl_sched_pcpustats_t) pcpu;
+    XEN_GUEST_HANDLE_64(xen_sysctl_sched_vcpustats_t) vcpu;
+};
+typedef struct xen_sysctl_schedstats_op xen_sysctl_schedstats_op_t;
+DEFINE_XEN_GUEST_HANDLE(xen_sysctl_schedstats_op_t);
+
 struct xen_sysctl {
     uint32_t cmd;
     uint32_t interface_version; /* XEN_SYSCTL_INTERFACE_VERSION */
@@ -471,6 +613,9 @@ struct xen_sysctl {
         struct xen_sysctl_cpu_hotplug       cpu_hotplug;
         struct xen_sysctl_pm_op             pm_op;
         struct xen_sysctl_page_offline_op   page_offline;
+        struct xen_sysctl_getdomstats       getdomstats;
+        struct xen_sysctl_lockprof_op       lockprof_op;
+        struct xen_sysctl_schedstats_op     schedstats_op;
         uint8_t                             pad[128];
     } u;
 };
@@ -60,6 +60,8 @@
 #define TRC_TRACE_WRAP_BUFFER  (TRC_GEN + 2)
 #define TRC_TRACE_CPU_CHANGE    (TRC_GEN + 3)
 #define TRC_TRACE_IRQ           (TRC_GEN + 4)
+#define TRC_TRACE_TSC_BASE      (TRC_GEN + 5)
+#define TRC_TRACE_FORMAT        (TRC_GEN + 6)
 
 #define TRC_SCHED_RUNSTATE_CHANGE   (TRC_SCHED_MIN + 1)
 #define TRC_SCHED_CONTINUE_RUNNING  (TRC_SCHED_MIN + 2)
@@ -161,7 +163,19 @@
 #define TRC_PM_IDLE_ENTRY       (TRC_PM_IDLE + 0x01)
 #define TRC_PM_IDLE_EXIT        (TRC_PM_IDLE + 0x02)
 
-/* This structure represents a single trace buffer record. */
+/*
+ * This structure represents a single trace buffer record.
+ *
+ * With XEN_SYSCTL_TBUF_FORMAT_delta32 the timestamp of a record that has
+ * cycles_included set is a single 32-bit word holding the TSC delta from
+ * the previous timestamped record on the same CPU, so the extra_u32[] array
+ * starts one word earlier than shown below.  Whenever the delta would not
+ * fit, or the buffer had been drained by the consumer, Xen first emits a
+ * TRC_TRACE_TSC_BASE record (no timestamp, extra_u32[0..1] = the full TSC,
+ * low word first) that subsequent deltas are relative to.  xentrace marks
+ * such output files with a leading TRC_TRACE_FORMAT record whose single
+ * data word is the XEN_SYSCTL_TBUF_FORMAT_* value.
+ */
 struct t_rec {
     uint32_t event:28;
     uint32_t extra_u32:3;         /* # entries in trailing extra_u32[] array */
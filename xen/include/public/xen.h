@@ -388,6 +388,19 @@ struct multicall_entry {
 typedef struct multicall_entry multicall_entry_t;
 DEFINE_XEN_GUEST_HANDLE(multicall_entry_t);
 
+/*
+ * The top bits of HYPERVISOR_multicall()'s nr_calls argument are flags;
+ * the rest is the number of entries.
+ *
+ * MULTICALL_stop_on_error: stop at the first entry whose result is
+ * negative (an error).  The hypercall then returns how many entries were
+ * left undone, counting the failed one, so the caller can deal with that
+ * entry and resubmit the remainder.  Without it every entry is attempted
+ * and the hypercall returns 0.
+ */
+#define MULTICALL_stop_on_error  (1U << 31)
+#define MULTICALL_nr_mask        ((1U << 24) - 1)
+
 /*
  * Event channel endpoints per domain:
  *  1024 if a long is 32 bits; 4096 if a long is 64 bits.
@@ -50,7 +50,26 @@ PERFCOUNTER(dom_destroy,            "csched: dom_destroy")
 PERFCOUNTER(vcpu_init,              "csched: vcpu_init")
 PERFCOUNTER(vcpu_destroy,           "csched: vcpu_destroy")
 PERFCOUNTER(vcpu_hot,               "csched: vcpu_hot")
+PERFCOUNTER(yield_directed,         "csched: yield_directed")
+PERFCOUNTER(gang_kick,              "csched: gang_kick")
+PERFCOUNTER(gang_pick,              "csched: gang_pick")
+
+PERFCOUNTER(c2_schedule,            "csched2: schedule")
+PERFCOUNTER(c2_vcpu_wake,           "csched2: vcpu_wake")
+PERFCOUNTER(c2_credit_reset,        "csched2: credit_reset")
+PERFCOUNTER(c2_tickle_idle,         "csched2: tickle_idle")
+PERFCOUNTER(c2_tickle_preempt,      "csched2: tickle_preempt")
+PERFCOUNTER(c2_migrate_runq,        "csched2: migrate_runq")
+PERFCOUNTER(c2_balance_pull,        "csched2: balance_pull")
+PERFCOUNTER(c2_balance_trylock_failed, "csched2: balance_trylock_failed")
 
 PERFCOUNTER(need_flush_tlb_flush,   "PG_need_flush tlb flushes")
 
+PERFCOUNTER(timer_set,              "timer: set")
+PERFCOUNTER(timer_stop,             "timer: stop")
+PERFCOUNTER(timer_migrate,          "timer: migrate")
+PERFCOUNTER(timer_cascade,          "timer: cascade")
+PERFCOUNTER(timer_expired,          "timer: expired")
+PERFCOUNTER(timer_softirq,          "timer: softirq")
+
 /*#endif*/ /* __XEN_PERFC_DEFN_H__ */
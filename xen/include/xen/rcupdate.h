@@ -55,15 +55,32 @@ struct rcu_head {
 
 
 
+/*
+ * Quiescent states are tracked in two levels: each CPU reports to the leaf
+ * node covering its group of RCU_FANOUT CPUs, and only the last CPU of a
+ * group to report takes the global lock.
+ */
+#define RCU_FANOUT   16
+#define RCU_NR_NODES ((NR_CPUS + RCU_FANOUT - 1) / RCU_FANOUT)
+
+struct rcu_node {
+    spinlock_t    lock;
+    long          gpnum;   /* Batch number that qsmask belongs to.      */
+    unsigned long qsmask;  /* CPUs of this group yet to pass a          */
+                           /* quiescent state in batch gpnum.           */
+} __cacheline_aligned;
+
 /* Global control variables for rcupdate callback mechanism. */
 struct rcu_ctrlblk {
     long cur;           /* Current batch number.                      */
     long completed;     /* Number of the last completed batch         */
     int  next_pending;  /* Is the next batch already waiting?         */
+    long expedite;      /* Batches up to this one are expedited.      */
 
     spinlock_t  lock __cacheline_aligned;
-    cpumask_t   cpumask; /* CPUs that need to switch in order    */
-    /* for current batch to proceed.        */
+    DECLARE_BITMAP(nodemask, RCU_NR_NODES); /* Nodes that need to     */
+    /* report in order for current batch to proceed.                  */
+    struct rcu_node node[RCU_NR_NODES];
 } __cacheline_aligned;
 
 /* Is batch a before batch b ? */
@@ -197,4 +214,13 @@ void rcu_check_callbacks(int cpu);
 void fastcall call_rcu(struct rcu_head *head, 
                        void (*func)(struct rcu_head *head));
 
+/*
+ * As call_rcu(), but also drive the grace period to completion as quickly
+ * as possible by forcing every online CPU through a quiescent state, rather
+ * than waiting for each to pass one in the course of normal activity. This
+ * costs an IPI per CPU, so use it only where prompt reclamation matters.
+ */
+void call_rcu_expedited(struct rcu_head *head,
+                        void (*func)(struct rcu_head *head));
+
 #endif /* __XEN_RCUPDATE_H */
@@ -10,27 +10,78 @@
 
 #include <xen/percpu.h>
 
+/* Scheduler statistics, reported by XEN_SYSCTL_schedstats_op. */
+struct sched_pcpu_stats {
+    uint64_t schedules;
+    uint64_t preemptions;
+    uint64_t steal_attempts;
+    uint64_t steal_successes;
+    uint32_t wake_latency[SCHED_STATS_BUCKETS];
+    uint32_t runq_len[SCHED_STATS_BUCKETS];
+};
+
 struct schedule_data {
-    spinlock_t          schedule_lock;  /* spinlock protecting curr        */
+    spinlock_t         *schedule_lock;  /* spinlock protecting curr        */
+    spinlock_t          _lock;          /* default, private schedule_lock  */
     struct vcpu        *curr;           /* current task                    */
     struct vcpu        *idle;           /* idle task for this cpu          */
     void               *sched_priv;
     struct timer        s_timer;        /* scheduling timer                */
+    struct sched_pcpu_stats stats;
 } __cacheline_aligned;
 
 DECLARE_PER_CPU(struct schedule_data, schedule_data);
 
+/* Histogram bucket: 0 for 0, else log2(val) + 1, the last one open-ended. */
+static inline unsigned int sched_stats_bucket(uint64_t val)
+{
+    if ( val >= (1ULL << (SCHED_STATS_BUCKETS - 2)) )
+        return SCHED_STATS_BUCKETS - 1;
+    return fls((unsigned int)val);
+}
+
+#define SCHED_STAT_CRANK(_cpu, _X) \
+    (per_cpu(schedule_data, _cpu).stats._X++)
+
+/* Called by schedulers when picking work, with the runqueue length. */
+static inline void sched_stat_runq_len(unsigned int cpu, unsigned int len)
+{
+    per_cpu(schedule_data, cpu).stats.runq_len[sched_stats_bucket(len)]++;
+}
+
+/*
+ * A scheduler may point several CPUs' schedule_lock at one shared lock
+ * (e.g. one per runqueue), and may repoint it while holding both the old
+ * and the new lock.  So lockers must check they still hold the right lock.
+ */
+static inline spinlock_t *pcpu_schedule_lock(unsigned int cpu)
+{
+    spinlock_t *lock;
+
+    for ( ; ; )
+    {
+        lock = per_cpu(schedule_data, cpu).schedule_lock;
+        spin_lock(lock);
+        if ( likely(lock == per_cpu(schedule_data, cpu).schedule_lock) )
+            return lock;
+        spin_unlock(lock);
+    }
+}
+
 static inline void vcpu_schedule_lock(struct vcpu *v)
 {
     unsigned int cpu;
+    spinlock_t *lock;
 
     for ( ; ; )
     {
         cpu = v->processor;
-        spin_lock(&per_cpu(schedule_data, cpu).schedule_lock);
-        if ( likely(v->processor == cpu) )
+        lock = per_cpu(schedule_data, cpu).schedule_lock;
+        spin_lock(lock);
+        if ( likely(v->processor == cpu) &&
+             likely(lock == per_cpu(schedule_data, cpu).schedule_lock) )
             break;
-        spin_unlock(&per_cpu(schedule_data, cpu).schedule_lock);
+        spin_unlock(lock);
     }
 }
 
@@ -41,7 +92,7 @@ static inline void vcpu_schedule_lock(struct vcpu *v)
 
 static inline void vcpu_schedule_unlock(struct vcpu *v)
 {
-    spin_unlock(&per_cpu(schedule_data, v->processor).schedule_lock);
+    spin_unlock(per_cpu(schedule_data, v->processor).schedule_lock);
 }
 
 #define vcpu_schedule_unlock_irq(v) \
@@ -69,6 +120,8 @@ struct scheduler {
 
     void         (*sleep)          (struct vcpu *);
     void         (*wake)           (struct vcpu *);
+    void         (*context_saved)  (struct vcpu *);
+    void         (*yield)          (struct vcpu *);
 
     struct task_slice (*do_schedule) (s_time_t);
 
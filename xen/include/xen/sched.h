@@ -69,6 +69,15 @@ struct evtchn
 int  evtchn_init(struct domain *d);
 void evtchn_destroy(struct domain *d);
 
+/* Scheduler statistics, reported by XEN_SYSCTL_schedstats_op. */
+#define SCHED_STATS_BUCKETS 16
+struct sched_vcpu_stats {
+    s_time_t wake_time;            /* last wakeup, 0 once it has run */
+    uint64_t wakeups;
+    uint64_t preemptions;
+    uint32_t wake_latency[SCHED_STATS_BUCKETS];
+};
+
 struct vcpu 
 {
     int              vcpu_id;
@@ -105,6 +114,8 @@ struct vcpu
     /* last time when vCPU is scheduled out */
     uint64_t last_run_time;
 
+    struct sched_vcpu_stats sched_stats;
+
     /* Has the FPU been initialised? */
     bool_t           fpu_initialised;
     /* Has the FPU been used since it was last saved? */
@@ -274,6 +285,9 @@ struct domain
      */
     spinlock_t hypercall_deadlock_mutex;
 
+    /* Profiling data for the locks above (lock_profile=y builds). */
+    struct lock_profile_qhead profile_head;
+
     /* transcendent memory, auto-allocated on first tmem op by each domain */
     void *tmem;
 };
@@ -437,6 +451,8 @@ long sched_adjust(struct domain *, struct xen_domctl_scheduler_op *);
 int  sched_id(void);
 void sched_tick_suspend(void);
 void sched_tick_resume(void);
+struct xen_sysctl_schedstats_op;
+int  sched_stats_control(struct xen_sysctl_schedstats_op *op);
 void vcpu_wake(struct vcpu *d);
 void vcpu_sleep_nosync(struct vcpu *d);
 void vcpu_sleep_sync(struct vcpu *d);
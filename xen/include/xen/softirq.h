@@ -29,24 +29,16 @@ asmlinkage void do_softirq(void);
 void open_softirq(int nr, softirq_handler handler);
 void softirq_init(void);
 
-static inline void cpumask_raise_softirq(cpumask_t mask, unsigned int nr)
-{
-    int cpu;
-
-    for_each_cpu_mask(cpu, mask)
-    {
-        if ( test_and_set_bit(nr, &softirq_pending(cpu)) )
-            cpu_clear(cpu, mask);
-    }
-
-    smp_send_event_check_mask(&mask);
-}
+void cpumask_raise_softirq(cpumask_t mask, unsigned int nr);
+void cpu_raise_softirq(unsigned int cpu, unsigned int nr);
 
-static inline void cpu_raise_softirq(unsigned int cpu, unsigned int nr)
-{
-    if ( !test_and_set_bit(nr, &softirq_pending(cpu)) )
-        smp_send_event_check_cpu(cpu);
-}
+/*
+ * Between these calls, the IPIs that raising softirqs on other CPUs would
+ * send are collected and sent once per CPU at the end.  Raises from
+ * interrupt context are never deferred.  Calls may nest.
+ */
+void cpu_raise_softirq_batch_begin(void);
+void cpu_raise_softirq_batch_finish(void);
 
 static inline void raise_softirq(unsigned int nr)
 {
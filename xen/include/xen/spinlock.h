@@ -19,18 +19,97 @@ struct lock_debug { };
 #define spin_debug_disable() ((void)0)
 #endif
 
-typedef struct {
+#ifdef LOCK_PROFILE
+/*
+ * Lock profiling.  Every lock defined with DEFINE_SPINLOCK() is registered
+ * automatically as a global lock; locks embedded in dynamically allocated
+ * structures are initialised with spin_lock_init_prof() and the structure
+ * is then registered with lock_profile_register_struct().  The collected
+ * data can be printed with the 'l' debug key, reset with 'L', and read
+ * from the toolstack with XEN_SYSCTL_lockprof_op.
+ */
+struct spinlock;
+
+struct lock_profile {
+    struct lock_profile *next;       /* next lock in the same queue */
+    const char          *name;       /* lock name */
+    struct spinlock     *lock;       /* the lock itself */
+    u64                 lock_cnt;    /* # of completed acquisitions */
+    u64                 block_cnt;   /* # of acquisitions that had to wait */
+    s64                 time_hold;   /* cumulative time held */
+    s64                 time_block;  /* cumulative time spent waiting */
+    s64                 time_locked; /* system time of last acquisition */
+};
+
+struct lock_profile_qhead {
+    struct lock_profile_qhead *head_q; /* next queue of the same type */
+    struct lock_profile       *elem_q; /* first lock in this queue */
+    int32_t                   idx;     /* index (e.g. domain id) */
+};
+
+#define _LOCK_PROFILE(name) { NULL, #name, &name, 0, 0, 0, 0, 0 }
+#define _LOCK_PROFILE_PTR(name)                                         \
+    static struct lock_profile *__lock_profile_##name                   \
+    __attribute_used__ __attribute__((__section__(".lockprofile.data"))) = \
+    &__lock_profile_data_##name
+#define _SPIN_LOCK_UNLOCKED(x) { _RAW_SPIN_LOCK_UNLOCKED, 0xfffu, 0,    \
+                                 _LOCK_DEBUG, x }
+#define SPIN_LOCK_UNLOCKED _SPIN_LOCK_UNLOCKED(NULL)
+#define DEFINE_SPINLOCK(l)                                              \
+    spinlock_t l = _SPIN_LOCK_UNLOCKED(NULL);                           \
+    static struct lock_profile __lock_profile_data_##l = _LOCK_PROFILE(l); \
+    _LOCK_PROFILE_PTR(l)
+
+#define spin_lock_init_prof(s, l)                                       \
+    _spin_lock_init_prof(&(s)->profile_head, &(s)->l, #l)
+/* As above, for a lock living outside the registered structure @s. */
+#define spin_lock_init_prof_in(s, l, name)                              \
+    _spin_lock_init_prof(&(s)->profile_head, l, name)
+#define lock_profile_register_struct(type, ptr, idx)                    \
+    _lock_profile_register_struct(type, &(ptr)->profile_head, idx)
+#define lock_profile_deregister_struct(type, ptr)                       \
+    _lock_profile_deregister_struct(type, &(ptr)->profile_head)
+
+#else
+
+struct lock_profile_qhead { };
+
+#define SPIN_LOCK_UNLOCKED { _RAW_SPIN_LOCK_UNLOCKED, 0xfffu, 0, _LOCK_DEBUG }
+#define DEFINE_SPINLOCK(l) spinlock_t l = SPIN_LOCK_UNLOCKED
+
+#define spin_lock_init_prof(s, l) spin_lock_init(&(s)->l)
+#define spin_lock_init_prof_in(s, l, name) spin_lock_init(l)
+#define lock_profile_register_struct(type, ptr, idx) ((void)0)
+#define lock_profile_deregister_struct(type, ptr) ((void)0)
+
+#endif
+
+typedef struct spinlock {
     raw_spinlock_t raw;
     u16 recurse_cpu:12;
     u16 recurse_cnt:4;
     struct lock_debug debug;
+#ifdef LOCK_PROFILE
+    struct lock_profile *profile;
+#endif
 } spinlock_t;
 
-
-#define SPIN_LOCK_UNLOCKED { _RAW_SPIN_LOCK_UNLOCKED, 0xfffu, 0, _LOCK_DEBUG }
-#define DEFINE_SPINLOCK(l) spinlock_t l = SPIN_LOCK_UNLOCKED
 #define spin_lock_init(l) (*(l) = (spinlock_t)SPIN_LOCK_UNLOCKED)
 
+#ifdef LOCK_PROFILE
+struct xen_sysctl_lockprof_op;
+
+void _spin_lock_init_prof(struct lock_profile_qhead *q, spinlock_t *lock,
+                          const char *name);
+void _lock_profile_register_struct(int32_t type,
+                                   struct lock_profile_qhead *q, int32_t idx);
+void _lock_profile_deregister_struct(int32_t type,
+                                     struct lock_profile_qhead *q);
+int spinlock_profile_control(struct xen_sysctl_lockprof_op *pc);
+void spinlock_profile_printall(unsigned char key);
+void spinlock_profile_reset(unsigned char key);
+#endif
+
 typedef struct {
     raw_rwlock_t raw;
     struct lock_debug debug;
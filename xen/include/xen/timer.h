@@ -11,6 +11,7 @@
 #include <xen/spinlock.h>
 #include <xen/time.h>
 #include <xen/string.h>
+#include <xen/list.h>
 
 struct timer {
     /* System time expiry value (nanoseconds since boot). */
@@ -18,12 +19,7 @@ struct timer {
     s_time_t expires_end;
 
     /* Position in active-timer data structure. */
-    union {
-        /* Timer-heap offset. */
-        unsigned int heap_offset;
-        /* Linked list. */
-        struct timer *list_next;
-    };
+    struct hlist_node wheel_node;
 
     /* On expiry, '(*function)(data)' will be executed in softirq context. */
     void (*function)(void *);
@@ -35,9 +31,13 @@ struct timer {
     /* Timer status. */
 #define TIMER_STATUS_inactive 0 /* Not in use; can be activated.    */
 #define TIMER_STATUS_killed   1 /* Not in use; canot be activated.  */
-#define TIMER_STATUS_in_heap  2 /* In use; on timer heap.           */
-#define TIMER_STATUS_in_list  3 /* In use; on overflow linked list. */
+#define TIMER_STATUS_in_wheel 2 /* In use; in a timer-wheel slot.   */
+#define TIMER_STATUS_in_batch 3 /* In use; expired, awaiting run.   */
     uint8_t status;
+
+    /* Timer-wheel level and slot index (valid when in_wheel). */
+    uint8_t wheel_level;
+    uint8_t wheel_slot;
 };
 
 /*
@@ -51,7 +51,7 @@ struct timer {
  */
 static inline int active_timer(struct timer *timer)
 {
-    return (timer->status >= TIMER_STATUS_in_heap);
+    return (timer->status >= TIMER_STATUS_in_wheel);
 }
 
 /*
@@ -78,6 +78,14 @@ static inline void init_timer(
  */
 extern void set_timer(struct timer *timer, s_time_t expires);
 
+/*
+ * As set_timer(), but the callback may be deferred by up to @slack ns past
+ * @expires so that it can be run together with other timers on the same CPU.
+ * set_timer() uses the system-wide default slack (see 'timer_slop').
+ */
+extern void set_timer_range(
+    struct timer *timer, s_time_t expires, s_time_t slack);
+
 /*
  * Deactivate a timer This function has no effect if the timer is not currently
  * active.
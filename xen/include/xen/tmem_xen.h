@@ -55,6 +55,12 @@ static inline int tmh_compression_enabled(void)
     return opt_tmem_compress;
 }
 
+extern int opt_tmem_dedup;
+static inline int tmh_dedup_enabled(void)
+{
+    return opt_tmem_dedup;
+}
+
 extern int opt_tmem;
 static inline int tmh_enabled(void)
 {
@@ -337,6 +343,10 @@ extern int tmh_copy_from_client(pfp_t *pfp,
 extern int tmh_copy_to_client(tmem_cli_mfn_t cmfn, pfp_t *pfp,
     uint32_t tmem_offset, uint32_t pfn_offset, uint32_t len);
 
+extern uint32_t tmh_hash_data(const void *data, size_t len);
+extern uint32_t tmh_page_hash(pfp_t *pfp);
+extern int tmh_page_cmp(pfp_t *pfp1, pfp_t *pfp2);
+
 
 #define TMEM_PERF
 #ifdef TMEM_PERF